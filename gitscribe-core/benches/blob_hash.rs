@@ -0,0 +1,125 @@
+//! Blob hashing benchmark: batch hashing vs one-at-a-time libgit2 hashing
+//!
+//! Run with: cargo bench --bench blob_hash
+//!
+//! Builds a synthetic repository of 10k files (mostly small, 1% above the
+//! stream threshold), rewrites every file with identical contents so stat data
+//! no longer proves them clean, and times hashing the lot plus the full
+//! status scans that have to do it. Linux only.
+
+#[cfg(target_os = "linux")]
+fn main() -> anyhow::Result<()> {
+    use gitscribe_core::blob_hash::{hash_batch, BlobKind};
+    use gitscribe_core::scanner::{scan, ScanOptions};
+    use gitscribe_core::Repository;
+    use std::time::{Duration, Instant};
+
+    const FILES: usize = 10_000;
+    const ITERATIONS: usize = 5;
+
+    let temp_dir = tempfile::TempDir::new()?;
+    println!("Building synthetic repository with {} touched files...", FILES);
+    let paths = build_tree(temp_dir.path(), FILES)?;
+    let bytes: u64 = paths.iter().map(|p| std::fs::metadata(p).map(|m| m.len()).unwrap_or(0)).sum();
+
+    let time = |f: &dyn Fn()| -> (Duration, Duration) {
+        let mut samples: Vec<Duration> = (0..ITERATIONS)
+            .map(|_| {
+                let start = Instant::now();
+                f();
+                start.elapsed()
+            })
+            .collect();
+        samples.sort();
+        (samples[0], samples[ITERATIONS / 2])
+    };
+    let report = |name: &str, (min, median): (Duration, Duration)| {
+        let rate = bytes as f64 / median.as_secs_f64() / (1024.0 * 1024.0);
+        println!("{:<24} {:>12.2?} {:>12.2?} {:>10.0} MiB/s", name, min, median, rate);
+    };
+
+    println!("\n{} files, {:.1} MiB", FILES, bytes as f64 / (1024.0 * 1024.0));
+    println!("{:<24} {:>12} {:>12} {:>16}", "hashing", "min", "median", "throughput");
+
+    report("libgit2 sequential", time(&|| {
+        for path in &paths {
+            git2::Oid::hash_file(git2::ObjectType::Blob, path).unwrap();
+        }
+    }));
+
+    let items: Vec<_> = paths.iter().map(|p| (p.clone(), BlobKind::File)).collect();
+    for threads in [1, 2, 4, 8, 16] {
+        let pool = rayon::ThreadPoolBuilder::new().num_threads(threads).build()?;
+        report(&format!("batch {} threads", threads), time(&|| {
+            let hashes = pool.install(|| hash_batch(&items));
+            assert!(hashes.iter().all(|h| h.is_ok()));
+        }));
+    }
+
+    // Status still has to hash every touched file since the index isn't refreshed
+    let repo = Repository::open(temp_dir.path())?;
+    let expected = repo.status_libgit2()?.len();
+
+    println!("\n{:<24} {:>12} {:>12}", "status", "min", "median");
+    let (min, median) = time(&|| assert_eq!(repo.status_libgit2().unwrap().len(), expected));
+    println!("{:<24} {:>12.2?} {:>12.2?}", "libgit2", min, median);
+
+    for threads in [1, 4, 16] {
+        let options = ScanOptions { threads, ..Default::default() };
+        let (min, median) = time(&|| {
+            assert_eq!(scan(&repo, &options).unwrap().expect("unsupported repo").len(), expected);
+        });
+        println!("{:<24} {:>12.2?} {:>12.2?}", format!("scanner {} threads", threads), min, median);
+    }
+
+    Ok(())
+}
+
+/// Create and commit `files` files, then rewrite them all with the same
+/// contents (new mtimes, same sizes) and modify every 100th one
+#[cfg(target_os = "linux")]
+fn build_tree(root: &std::path::Path, files: usize) -> anyhow::Result<Vec<std::path::PathBuf>> {
+    use gitscribe_core::blob_hash::STREAM_THRESHOLD;
+    use std::fs;
+
+    let repo = git2::Repository::init(root)?;
+    let contents = |i: usize| -> Vec<u8> {
+        let len = if i % 100 == 50 { STREAM_THRESHOLD as usize * 4 } else { 1024 + (i * 7919) % 16384 };
+        (0..len).map(|j| b"abcdefghijklmnopqrstuvwxyz\n"[(i + j) % 27]).collect()
+    };
+
+    let mut paths = Vec::with_capacity(files);
+    for i in 0..files {
+        let path = root.join(format!("d{}/f{}.txt", i / 100, i));
+        if i % 100 == 0 {
+            fs::create_dir_all(path.parent().unwrap())?;
+        }
+        fs::write(&path, contents(i))?;
+        paths.push(path);
+    }
+
+    let mut index = repo.index()?;
+    index.add_all(["*"], git2::IndexAddOption::DEFAULT, None)?;
+    index.write()?;
+
+    let tree = repo.find_tree(index.write_tree()?)?;
+    let sig = git2::Signature::now("Bench", "bench@example.com")?;
+    repo.commit(Some("HEAD"), &sig, &sig, "Synthetic tree", &tree, &[])?;
+
+    // Let the index mtime fall behind so rewritten files aren't merely racy
+    std::thread::sleep(std::time::Duration::from_millis(20));
+    for (i, path) in paths.iter().enumerate() {
+        let mut data = contents(i);
+        if i % 100 == 0 {
+            data[0] = b'#';
+        }
+        fs::write(path, data)?;
+    }
+
+    Ok(paths)
+}
+
+#[cfg(not(target_os = "linux"))]
+fn main() {
+    eprintln!("blob_hash benchmark only runs on Linux");
+}
@@ -0,0 +1,115 @@
+//! Commit search benchmark: persistent search index vs linear revwalk
+//!
+//! Run with: cargo bench --bench commit_search
+//!
+//! Imports a synthetic linux.git-scale history (1M commits, or
+//! GITSCRIBE_BENCH_COMMITS) with `git fast-import`, then times the initial
+//! index build, an incremental update after 1,000 new commits, and queries
+//! through the index and through the linear walk. Needs `git` on PATH.
+
+use gitscribe_core::{GitHistory, SearchIndex};
+use std::io::Write;
+use std::path::Path;
+use std::process::{Command, Stdio};
+use std::time::{Duration, Instant};
+
+const WORDS: &[&str] = &[
+    "fix", "add", "remove", "driver", "memory", "leak", "race", "lock", "scheduler", "network",
+    "buffer", "overflow", "refactor", "cleanup", "support", "device", "interrupt", "cache", "page",
+    "filesystem", "inode", "timer", "power", "regression", "warning", "build", "config", "module",
+];
+const QUERIES: &[&str] = &["memory leak", "Author 4217", "xyzzy", "fs", "e3b0"];
+const LINEAR_LIMIT: usize = 50;
+
+fn main() -> anyhow::Result<()> {
+    let commits: usize = std::env::var("GITSCRIBE_BENCH_COMMITS")
+        .ok()
+        .and_then(|n| n.parse().ok())
+        .unwrap_or(1_000_000);
+
+    let temp_dir = tempfile::TempDir::new()?;
+    let repo_path = temp_dir.path();
+    git2::Repository::init(repo_path)?;
+
+    println!("Importing {} synthetic commits...", commits);
+    let start = Instant::now();
+    import(repo_path, 0, commits)?;
+    println!("import: {:.2?}", start.elapsed());
+
+    let repo = git2::Repository::open(repo_path)?;
+    let index = SearchIndex::open(&repo)?;
+
+    let start = Instant::now();
+    let added = index.update(&repo)?;
+    println!("initial index build: {} commits in {:.2?}", added, start.elapsed());
+
+    import(repo_path, commits, 1_000)?;
+    let start = Instant::now();
+    let added = index.update(&repo)?;
+    println!("incremental update: {} commits in {:.2?}", added, start.elapsed());
+
+    let history = GitHistory::open(repo_path)?;
+    println!("\n{:<14} {:>8} {:>12} {:>12}", "query", "matches", "index", "linear");
+    for query in QUERIES {
+        let mut samples: Vec<Duration> = (0..5)
+            .map(|_| {
+                let start = Instant::now();
+                index.search(query, LINEAR_LIMIT).unwrap();
+                start.elapsed()
+            })
+            .collect();
+        samples.sort();
+        let matches = index.search(query, LINEAR_LIMIT)?.map_or(0, |m| m.len());
+
+        let start = Instant::now();
+        history.search_commits_linear(query, LINEAR_LIMIT)?;
+        let linear = start.elapsed();
+
+        println!("{:<14} {:>8} {:>12.2?} {:>12.2?}", query, matches, samples[2], linear);
+    }
+
+    Ok(())
+}
+
+/// Append `count` commits to refs/heads/master, continuing from mark `first`
+fn import(repo_path: &Path, first: usize, count: usize) -> anyhow::Result<()> {
+    let mut child = Command::new("git")
+        .args(["fast-import", "--quiet"])
+        .current_dir(repo_path)
+        .stdin(Stdio::piped())
+        .spawn()?;
+
+    {
+        let mut stdin = std::io::BufWriter::new(child.stdin.take().unwrap());
+        // Deterministic pseudo-random words (xorshift)
+        let mut state = 0x9e37_79b9_7f4a_7c15u64 ^ first as u64;
+        let mut word = || {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            WORDS[(state % WORDS.len() as u64) as usize]
+        };
+
+        for i in first..first + count {
+            let mut message = format!("{}: {} {} {}\n\n", word(), word(), word(), word());
+            for _ in 0..4 {
+                message.push_str(&format!("{} the {} {} when {} {}.\n", word(), word(), word(), word(), word()));
+            }
+
+            let author = format!("Author {} <author{}@example.com> {} +0000", i % 5_000, i % 5_000, 1_000_000_000 + i * 60);
+            writeln!(stdin, "commit refs/heads/master\nmark :{}\nauthor {}\ncommitter {}", i + 1, author, author)?;
+            writeln!(stdin, "data {}\n{}", message.len(), message)?;
+            if i > 0 {
+                if i == first {
+                    writeln!(stdin, "from refs/heads/master^0")?;
+                } else {
+                    writeln!(stdin, "from :{}", i)?;
+                }
+            }
+            writeln!(stdin)?;
+        }
+    }
+
+    anyhow::ensure!(child.wait()?.success(), "git fast-import failed");
+    Ok(())
+}
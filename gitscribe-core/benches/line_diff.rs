@@ -0,0 +1,88 @@
+//! Line diff benchmark: in-process Myers and histogram vs libgit2's xdiff
+//!
+//! Run with: cargo bench --bench line_diff
+//!
+//! Diffs a synthetic corpus of large files (200k lines, or
+//! GITSCRIBE_BENCH_LINES) with scattered edits: source-like text where most
+//! lines are unique, generated text (lockfiles, fixtures) built from a small
+//! vocabulary, and near-random text where almost every line repeats. Each
+//! case is timed through `LineDiff` with both algorithms and through
+//! `git2::Patch::from_buffers`, including hunk construction.
+
+use gitscribe_core::{DiffAlgorithm, LineDiff};
+use std::time::{Duration, Instant};
+
+/// (name, distinct tokens per line slot, one in N lines edited)
+const CORPUS: &[(&str, u64, u64)] = &[
+    ("source", 1_000_000, 100),
+    ("generated", 50, 20),
+    ("random", 8, 2),
+];
+
+fn main() -> anyhow::Result<()> {
+    let lines: usize = std::env::var("GITSCRIBE_BENCH_LINES")
+        .ok()
+        .and_then(|n| n.parse().ok())
+        .unwrap_or(200_000);
+
+    // Deterministic xorshift so runs are comparable
+    let mut state = 0x9e37_79b9_7f4a_7c15u64;
+    let mut next = move |bound: u64| {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        state % bound
+    };
+
+    println!("{:<10} {:>10} {:>12} {:>12} {:>12}", "corpus", "changed", "myers", "histogram", "libgit2");
+    for &(name, vocab, edit_rate) in CORPUS {
+        let old: Vec<String> = (0..lines).map(|_| format!("line {} {}\n", next(vocab), next(vocab))).collect();
+        let mut new = Vec::with_capacity(old.len());
+        for line in &old {
+            match next(edit_rate) {
+                0 => {}
+                1 => {
+                    new.push(format!("added {}\n", next(vocab)));
+                    new.push(line.clone());
+                }
+                2 => new.push(format!("changed {}\n", next(vocab))),
+                _ => new.push(line.clone()),
+            }
+        }
+        let (old, new) = (old.concat(), new.concat());
+
+        let diff = LineDiff::compute(old.as_bytes(), new.as_bytes(), DiffAlgorithm::Myers);
+        let changed = diff.insertions() + diff.deletions();
+
+        let myers = median(|| {
+            LineDiff::compute(old.as_bytes(), new.as_bytes(), DiffAlgorithm::Myers).hunks(3);
+        });
+        let histogram = median(|| {
+            LineDiff::compute(old.as_bytes(), new.as_bytes(), DiffAlgorithm::Histogram).hunks(3);
+        });
+        let libgit2 = median(|| {
+            let patch = git2::Patch::from_buffers(old.as_bytes(), None, new.as_bytes(), None, None).unwrap();
+            for hunk in 0..patch.num_hunks() {
+                for line in 0..patch.num_lines_in_hunk(hunk).unwrap() {
+                    patch.line_in_hunk(hunk, line).unwrap();
+                }
+            }
+        });
+
+        println!("{:<10} {:>10} {:>12.2?} {:>12.2?} {:>12.2?}", name, changed, myers, histogram, libgit2);
+    }
+
+    Ok(())
+}
+
+fn median(mut run: impl FnMut()) -> Duration {
+    let mut samples: Vec<Duration> = (0..5)
+        .map(|_| {
+            let start = Instant::now();
+            run();
+            start.elapsed()
+        })
+        .collect();
+    samples.sort();
+    samples[2]
+}
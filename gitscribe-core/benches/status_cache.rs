@@ -0,0 +1,87 @@
+//! Status cache benchmark: transactional bulk refresh vs per-row inserts
+//!
+//! Run with: cargo bench --bench status_cache
+//!
+//! Populates a file-backed cache with 100k status entries the old way (one
+//! auto-committed INSERT OR REPLACE per row) and through
+//! `StatusCache::refresh_status`, then times refreshes where 1% of the
+//! entries changed and where nothing changed.
+
+use gitscribe_core::status::FileStatus;
+use gitscribe_core::{FileStatusEntry, RepoFingerprint, StatusCache};
+use rusqlite::{params, Connection};
+use std::time::{Duration, Instant};
+
+const ENTRIES: usize = 100_000;
+const ITERATIONS: usize = 3;
+
+fn main() -> anyhow::Result<()> {
+    let entries: Vec<FileStatusEntry> = (0..ENTRIES)
+        .map(|i| FileStatusEntry {
+            path: format!("src/module{}/file{}.rs", i / 100, i).into(),
+            status: FileStatus::Modified,
+        })
+        .collect();
+    let mut changed = entries.clone();
+    for entry in changed.iter_mut().step_by(100) {
+        entry.status = FileStatus::Added;
+    }
+    let fingerprint = RepoFingerprint { value: 1, watched: false, ..Default::default() };
+
+    println!("{} entries", ENTRIES);
+    println!("{:<28} {:>12} {:>12}", "refresh", "min", "median");
+
+    let report = |name: &str, mut samples: Vec<Duration>| {
+        samples.sort();
+        println!("{:<28} {:>12.2?} {:>12.2?}", name, samples[0], samples[samples.len() / 2]);
+    };
+
+    // Before: each row is its own statement and its own WAL commit
+    let samples = (0..ITERATIONS)
+        .map(|_| -> anyhow::Result<Duration> {
+            let temp_dir = tempfile::TempDir::new()?;
+            let path = temp_dir.path().join("cache.db");
+            StatusCache::new(&path)?;
+            let conn = Connection::open(&path)?;
+
+            let start = Instant::now();
+            conn.execute("DELETE FROM file_status WHERE repo_id = ?", params![1])?;
+            for entry in &entries {
+                conn.execute(
+                    "INSERT OR REPLACE INTO file_status
+                     (repo_id, file_path, work_tree_status, index_status, cache_time, file_mtime)
+                     VALUES (?, ?, ?, ?, ?, ?)",
+                    params![1, entry.path.to_string_lossy().as_ref(), entry.status as i32, 0, 0, 0],
+                )?;
+            }
+            Ok(start.elapsed())
+        })
+        .collect::<anyhow::Result<Vec<_>>>()?;
+    report("per-row populate (before)", samples);
+
+    // After: one transaction with staged bulk upserts
+    let mut populate = Vec::new();
+    let mut one_percent = Vec::new();
+    let mut unchanged = Vec::new();
+    for _ in 0..ITERATIONS {
+        let temp_dir = tempfile::TempDir::new()?;
+        let cache = StatusCache::new(temp_dir.path().join("cache.db"))?;
+
+        let start = Instant::now();
+        cache.refresh_status("/bench/repo", &entries, fingerprint)?;
+        populate.push(start.elapsed());
+
+        let start = Instant::now();
+        cache.refresh_status("/bench/repo", &changed, fingerprint)?;
+        one_percent.push(start.elapsed());
+
+        let start = Instant::now();
+        cache.refresh_status("/bench/repo", &changed, fingerprint)?;
+        unchanged.push(start.elapsed());
+    }
+    report("bulk populate (after)", populate);
+    report("bulk refresh, 1% changed", one_percent);
+    report("bulk refresh, unchanged", unchanged);
+
+    Ok(())
+}
@@ -0,0 +1,82 @@
+//! Status store benchmark: SQLite rows vs the memory-mapped status log
+//!
+//! Run with: cargo bench --bench status_store
+//!
+//! For each backend, populates 100k entries, times refreshes with 1% of the
+//! entries changed, and measures point-lookup latency over random paths
+//! (half cached, half clean).
+
+use gitscribe_core::status::FileStatus;
+use gitscribe_core::{CacheBackend, FileStatusEntry, RepoFingerprint, StatusCache};
+use std::time::{Duration, Instant};
+
+const ENTRIES: usize = 100_000;
+const REFRESHES: usize = 10;
+const LOOKUPS: usize = 200_000;
+
+fn main() -> anyhow::Result<()> {
+    let entries: Vec<FileStatusEntry> = (0..ENTRIES)
+        .map(|i| FileStatusEntry {
+            path: format!("src/module{}/file{}.rs", i / 100, i).into(),
+            status: FileStatus::Modified,
+        })
+        .collect();
+
+    // Deterministic pseudo-random probe order (xorshift)
+    let mut state = 0x2545_f491_4f6c_dd1du64;
+    let probes: Vec<String> = (0..LOOKUPS)
+        .map(|_| {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            let i = (state % (2 * ENTRIES as u64)) as usize;
+            format!("src/module{}/file{}.rs", i / 100, i)
+        })
+        .collect();
+
+    println!("{} entries, {} refreshes, {} lookups", ENTRIES, REFRESHES, LOOKUPS);
+    println!("{:<8} {:>12} {:>14} {:>14} {:>12}", "backend", "populate", "refresh (1%)", "entries/s", "lookup");
+
+    for (name, backend) in [("sqlite", CacheBackend::Sqlite), ("log", CacheBackend::Log)] {
+        let temp_dir = tempfile::TempDir::new()?;
+        let cache = StatusCache::with_backend(temp_dir.path().join("cache.db"), backend)?;
+
+        let start = Instant::now();
+        cache.refresh_status("/bench/repo", &entries, RepoFingerprint { value: 0, watched: true, ..Default::default() })?;
+        let populate = start.elapsed();
+
+        let mut refreshes = Vec::new();
+        let mut current = entries.clone();
+        for round in 0..REFRESHES {
+            for entry in current.iter_mut().skip(round).step_by(100) {
+                entry.status = if entry.status == FileStatus::Modified { FileStatus::Added } else { FileStatus::Modified };
+            }
+            let fingerprint = RepoFingerprint { value: round as u64 + 1, watched: true, ..Default::default() };
+
+            let start = Instant::now();
+            cache.refresh_status("/bench/repo", &current, fingerprint)?;
+            refreshes.push(start.elapsed());
+        }
+        refreshes.sort();
+        let refresh = refreshes[REFRESHES / 2];
+
+        let start = Instant::now();
+        let mut found = 0;
+        for probe in &probes {
+            found += cache.cached_file_status("/bench/repo", probe)?.is_some() as usize;
+        }
+        let lookup = start.elapsed() / LOOKUPS as u32;
+        assert!(found > 0 && found < LOOKUPS);
+
+        println!(
+            "{:<8} {:>12.2?} {:>14.2?} {:>14.0} {:>12.2?}",
+            name,
+            populate,
+            refresh,
+            ENTRIES as f64 / refresh.max(Duration::from_nanos(1)).as_secs_f64(),
+            lookup
+        );
+    }
+
+    Ok(())
+}
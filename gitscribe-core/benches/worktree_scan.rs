@@ -0,0 +1,96 @@
+//! Worktree scan benchmark: parallel scanner thread counts vs libgit2
+//!
+//! Run with: cargo bench --bench worktree_scan
+//!
+//! Builds a synthetic 100k-file repository (plus a 1M-file one when
+//! GITSCRIBE_BENCH_LARGE=1) under the temp directory, touches 1% of the files,
+//! and times warm-cache status scans. Linux only.
+
+#[cfg(target_os = "linux")]
+fn main() -> anyhow::Result<()> {
+    use gitscribe_core::scanner::{scan, ScanOptions};
+    use gitscribe_core::Repository;
+    use std::time::{Duration, Instant};
+
+    const ITERATIONS: usize = 5;
+
+    let mut sizes = vec![100_000];
+    if std::env::var_os("GITSCRIBE_BENCH_LARGE").is_some() {
+        sizes.push(1_000_000);
+    }
+
+    for files in sizes {
+        let temp_dir = tempfile::TempDir::new()?;
+        println!("Building synthetic repository with {} files...", files);
+        build_tree(temp_dir.path(), files)?;
+
+        let repo = Repository::open(temp_dir.path())?;
+        let expected = repo.status_libgit2()?.len();
+
+        let time = |f: &dyn Fn() -> usize| -> (Duration, Duration) {
+            let mut samples: Vec<Duration> = (0..ITERATIONS)
+                .map(|_| {
+                    let start = Instant::now();
+                    assert_eq!(f(), expected);
+                    start.elapsed()
+                })
+                .collect();
+            samples.sort();
+            (samples[0], samples[ITERATIONS / 2])
+        };
+
+        println!("\n{} files, {} changed", files, expected);
+        println!("{:<12} {:>12} {:>12}", "engine", "min", "median");
+
+        let (min, median) = time(&|| repo.status_libgit2().unwrap().len());
+        println!("{:<12} {:>12.2?} {:>12.2?}", "libgit2", min, median);
+
+        for threads in [1, 2, 4, 8, 16] {
+            let options = ScanOptions { threads, ..Default::default() };
+            let (min, median) = time(&|| scan(&repo, &options).unwrap().expect("unsupported repo").len());
+            println!("{:<12} {:>12.2?} {:>12.2?}", format!("{} threads", threads), min, median);
+        }
+    }
+
+    Ok(())
+}
+
+/// Create `files` files, 20 per directory under two levels of 50-way fanout,
+/// commit them, then modify every 100th file
+#[cfg(target_os = "linux")]
+fn build_tree(root: &std::path::Path, files: usize) -> anyhow::Result<()> {
+    use std::fs;
+
+    let repo = git2::Repository::init(root)?;
+    let path_of = |i: usize| {
+        let dir = i / 20;
+        format!("d{}/d{}/d{}/f{}.txt", dir / 2500, (dir / 50) % 50, dir % 50, i)
+    };
+
+    for i in 0..files {
+        let path = root.join(path_of(i));
+        if i % 20 == 0 {
+            fs::create_dir_all(path.parent().unwrap())?;
+        }
+        fs::write(&path, format!("file {}\n", i))?;
+    }
+
+    let mut index = repo.index()?;
+    index.add_all(["*"], git2::IndexAddOption::DEFAULT, None)?;
+    index.write()?;
+
+    let tree = repo.find_tree(index.write_tree()?)?;
+    let sig = git2::Signature::now("Bench", "bench@example.com")?;
+    repo.commit(Some("HEAD"), &sig, &sig, "Synthetic tree", &tree, &[])?;
+
+    for i in (0..files).step_by(100) {
+        fs::write(root.join(path_of(i)), format!("modified {}\n", i))?;
+    }
+
+    Ok(())
+}
+
+#[cfg(not(target_os = "linux"))]
+fn main() {
+    eprintln!("worktree_scan benchmark only runs on Linux");
+}
@@ -21,6 +21,27 @@ typedef struct GSRepository {
   uint8_t _private[0];
 } GSRepository;
 
+/**
+ * Opaque pointer to a background cache warm-up (for C code)
+ */
+typedef struct GSWarmup {
+  uint8_t _private[0];
+} GSWarmup;
+
+/**
+ * Opaque pointer to a background cache maintenance worker (for C code)
+ */
+typedef struct GSMaintenance {
+  uint8_t _private[0];
+} GSMaintenance;
+
+/**
+ * Opaque pointer to an operation scheduler (for C code)
+ */
+typedef struct GSScheduler {
+  uint8_t _private[0];
+} GSScheduler;
+
 /**
  * Repository context information (C-compatible struct)
  */
@@ -31,6 +52,7 @@ typedef struct GSRepoInfo {
   unsigned int conflicted_count;
   unsigned int ahead_count;
   unsigned int behind_count;
+  int remote_pending;
 } GSRepoInfo;
 
 /**
@@ -139,6 +161,128 @@ struct GSStatusList *gs_repository_all_statuses(struct GSRepository *repo);
  */
 void gs_status_list_free(struct GSStatusList *list);
 
+/**
+ * Get the fingerprint of the repository containing `path`
+ *
+ * Cheap enough to call before every cache lookup: reads HEAD and stats a few
+ * files in .git, without opening the repository through libgit2. Cached data
+ * stored alongside an equal fingerprint is still valid.
+ *
+ * # Safety
+ * `path` must be a valid null-terminated C string
+ * `fingerprint` must be a valid pointer to a uint64_t
+ * Returns 1 if a working-tree watcher backs the fingerprint (no TTL needed),
+ * 0 if only HEAD/index/ref changes are detected (keep a TTL), -1 on error
+ */
+int gs_path_fingerprint(const char *path, uint64_t *fingerprint);
+
+/**
+ * Start warming the status cache database at `db_path` in the background
+ *
+ * Opt-in: call once when the host loads. Re-scans the most recently used
+ * repositories at low priority and backs off under foreground queries.
+ *
+ * # Safety
+ * `db_path` must be a valid null-terminated C string
+ * Returns NULL on error. Stop with gs_cache_warmup_free()
+ */
+struct GSWarmup *gs_cache_warmup_start(const char *db_path);
+
+/**
+ * Cancel a warm-up and wait for it to stop (at most one repository scan)
+ *
+ * # Safety
+ * `warmup` must be a valid pointer from gs_cache_warmup_start
+ * Can be called with NULL (no-op)
+ */
+void gs_cache_warmup_free(struct GSWarmup *warmup);
+
+/**
+ * Start periodic maintenance of the status cache database at `db_path`
+ *
+ * Opt-in: call once when the host loads. Each pass evicts repositories
+ * until the cache fits in `budget_bytes` (0 for the default), then
+ * checkpoints and vacuums. The first pass runs after one interval.
+ *
+ * # Safety
+ * `db_path` must be a valid null-terminated C string
+ * Returns NULL on error. Stop with gs_cache_maintenance_free()
+ */
+struct GSMaintenance *gs_cache_maintenance_start(const char *db_path, uint64_t budget_bytes);
+
+/**
+ * Request a maintenance pass now instead of waiting for the next interval
+ *
+ * # Safety
+ * `worker` must be a valid pointer from gs_cache_maintenance_start
+ */
+void gs_cache_maintenance_run_now(struct GSMaintenance *worker);
+
+/**
+ * Stop a maintenance worker, waiting for a running pass to finish
+ *
+ * # Safety
+ * `worker` must be a valid pointer from gs_cache_maintenance_start
+ * Can be called with NULL (no-op)
+ */
+void gs_cache_maintenance_free(struct GSMaintenance *worker);
+
+/**
+ * Start running queued operations (fetch, push, pull) from the status
+ * cache database at `db_path` on background threads
+ *
+ * Opt-in: start one scheduler per database when the host loads.
+ *
+ * # Safety
+ * `db_path` must be a valid null-terminated C string
+ * `workers` is the number of worker threads (0 for the default)
+ * Returns NULL on error. Stop with gs_scheduler_free()
+ */
+struct GSScheduler *gs_scheduler_start(const char *db_path, unsigned int workers);
+
+/**
+ * Queue an operation ("fetch", "push" or "pull") and return at once
+ *
+ * # Safety
+ * `scheduler` must be a valid pointer from gs_scheduler_start
+ * `repo_path` and `operation_type` must be valid null-terminated C strings
+ * `operation_data` is a null-terminated JSON string, or NULL for none
+ * `priority` is -1 (low), 0 (normal) or 1 (high)
+ * Returns the operation id, or -1 on error
+ */
+int64_t gs_scheduler_enqueue(struct GSScheduler *scheduler,
+                             const char *repo_path,
+                             const char *operation_type,
+                             const char *operation_data,
+                             int priority);
+
+/**
+ * Get the status of a queued operation
+ *
+ * # Safety
+ * `scheduler` must be a valid pointer from gs_scheduler_start
+ * `attempts` may be NULL; otherwise receives the attempts made so far
+ * `error` may be NULL; otherwise receives the last error message or NULL.
+ * Caller MUST free a non-NULL message with gs_string_free()
+ * Returns 0 (pending), 1 (running), 2 (complete), 3 (failed), or -1 if the
+ * operation is unknown or on error
+ */
+int gs_scheduler_status(struct GSScheduler *scheduler,
+                        int64_t operation_id,
+                        unsigned int *attempts,
+                        char **error);
+
+/**
+ * Stop a scheduler, waiting for running operations to finish
+ *
+ * Queued operations stay in the database for the next scheduler.
+ *
+ * # Safety
+ * `scheduler` must be a valid pointer from gs_scheduler_start
+ * Can be called with NULL (no-op)
+ */
+void gs_scheduler_free(struct GSScheduler *scheduler);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif  // __cplusplus
@@ -0,0 +1,418 @@
+//! Ahead/Behind Cache
+//!
+//! Process-wide cache of ahead/behind counts keyed by the (local, upstream)
+//! tip oids. The counts for a pair of tips never change, so a hit is free.
+//! Misses are computed on a background worker; interactive callers wait at
+//! most a small budget and otherwise get the last known counts for the branch.
+
+use anyhow::{bail, Context, Result};
+use git2::Oid;
+use std::collections::{BinaryHeap, HashMap, VecDeque};
+use std::path::{Path, PathBuf};
+use std::sync::{mpsc, Condvar, Mutex, OnceLock};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use crate::commit_graph::{self, CommitGraph};
+
+/// How long the interactive path waits on a cache miss before falling back
+pub const DEFAULT_BUDGET: Duration = Duration::from_millis(20);
+
+/// Maximum number of tip pairs kept in the cache
+const MAX_ENTRIES: usize = 4096;
+
+/// Result of an ahead/behind lookup
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct AheadBehind {
+    pub ahead: usize,
+    pub behind: usize,
+    /// True if the counts are the last known values while a recount runs
+    pub pending: bool,
+}
+
+enum Entry {
+    Pending,
+    Ready(usize, usize),
+}
+
+struct Job {
+    git_dir: PathBuf,
+    local: Oid,
+    upstream: Oid,
+}
+
+struct CacheState {
+    entries: HashMap<(Oid, Oid), Entry>,
+    order: VecDeque<(Oid, Oid)>,
+    last_known: HashMap<(PathBuf, String), (usize, usize)>,
+}
+
+struct Cache {
+    state: Mutex<CacheState>,
+    ready: Condvar,
+    jobs: Option<Mutex<mpsc::Sender<Job>>>,
+}
+
+fn cache() -> &'static Cache {
+    static CACHE: OnceLock<Cache> = OnceLock::new();
+
+    CACHE.get_or_init(|| {
+        let (tx, rx) = mpsc::channel();
+        let worker = thread::Builder::new()
+            .name("gitscribe-ahead-behind".to_string())
+            .spawn(move || worker_loop(rx));
+
+        Cache {
+            state: Mutex::new(CacheState {
+                entries: HashMap::new(),
+                order: VecDeque::new(),
+                last_known: HashMap::new(),
+            }),
+            ready: Condvar::new(),
+            jobs: worker.ok().map(|_| Mutex::new(tx)),
+        }
+    })
+}
+
+/// Look up ahead/behind counts for a branch without walking history on the caller's thread
+///
+/// # Arguments
+/// * `git_dir` - The repository's `.git` directory
+/// * `branch` - Local branch name, used to remember the last known counts
+/// * `local` - Tip of the local branch
+/// * `upstream` - Tip of its upstream
+/// * `budget` - Maximum time to wait for a background computation on a miss
+pub fn lookup(git_dir: &Path, branch: &str, local: Oid, upstream: Oid, budget: Duration) -> AheadBehind {
+    let cache = cache();
+    let key = (local, upstream);
+    let branch_key = (git_dir.to_path_buf(), branch.to_string());
+
+    let mut state = cache.state.lock().unwrap();
+
+    if !state.entries.contains_key(&key) {
+        state.insert(key, Entry::Pending);
+
+        let job = Job { git_dir: git_dir.to_path_buf(), local, upstream };
+        match &cache.jobs {
+            Some(jobs) => {
+                let _ = jobs.lock().unwrap().send(job);
+            }
+            None => {
+                // No worker thread available: compute inline rather than never
+                drop(state);
+                let result = compute(&job, &mut HashMap::new());
+                state = cache.state.lock().unwrap();
+                state.finish(key, result.ok());
+            }
+        }
+    }
+
+    let deadline = Instant::now() + budget;
+    loop {
+        if let Some(Entry::Ready(ahead, behind)) = state.entries.get(&key) {
+            let (ahead, behind) = (*ahead, *behind);
+            if state.last_known.len() >= MAX_ENTRIES {
+                state.last_known.clear();
+            }
+            state.last_known.insert(branch_key, (ahead, behind));
+            return AheadBehind { ahead, behind, pending: false };
+        }
+
+        let now = Instant::now();
+        if now >= deadline || !state.entries.contains_key(&key) {
+            break;
+        }
+
+        state = cache.ready.wait_timeout(state, deadline - now).unwrap().0;
+    }
+
+    let (ahead, behind) = state.last_known.get(&branch_key).copied().unwrap_or((0, 0));
+    AheadBehind { ahead, behind, pending: true }
+}
+
+impl CacheState {
+    fn insert(&mut self, key: (Oid, Oid), entry: Entry) {
+        if self.entries.insert(key, entry).is_none() {
+            self.order.push_back(key);
+        }
+
+        while self.entries.len() > MAX_ENTRIES {
+            match self.order.pop_front() {
+                Some(oldest) => {
+                    self.entries.remove(&oldest);
+                }
+                None => break,
+            }
+        }
+    }
+
+    fn finish(&mut self, key: (Oid, Oid), counts: Option<(usize, usize)>) {
+        match counts {
+            Some((ahead, behind)) => self.insert(key, Entry::Ready(ahead, behind)),
+            None => {
+                // Forget failed computations so the next lookup retries
+                self.entries.remove(&key);
+                self.order.retain(|k| *k != key);
+            }
+        }
+    }
+}
+
+fn worker_loop(rx: mpsc::Receiver<Job>) {
+    let mut graphs: HashMap<PathBuf, CommitGraph> = HashMap::new();
+
+    for job in rx {
+        let result = compute(&job, &mut graphs);
+        if let Err(ref e) = result {
+            tracing::debug!("ahead/behind failed for {:?}: {}", job.git_dir, e);
+        }
+
+        let cache = cache();
+        cache.state.lock().unwrap().finish((job.local, job.upstream), result.ok());
+        cache.ready.notify_all();
+    }
+}
+
+/// Count ahead/behind, preferring the commit-graph and falling back to libgit2
+fn compute(job: &Job, graphs: &mut HashMap<PathBuf, CommitGraph>) -> Result<(usize, usize)> {
+    let repo = git2::Repository::open(&job.git_dir)
+        .context("Failed to open repository for ahead/behind")?;
+
+    let objects_dir = commit_graph::objects_dir(&job.git_dir);
+    if graphs.get(&objects_dir).map_or(true, |g| g.is_stale()) {
+        graphs.remove(&objects_dir);
+        if let Ok(Some(graph)) = CommitGraph::open(&objects_dir) {
+            graphs.insert(objects_dir.clone(), graph);
+        }
+    }
+
+    if let Some(graph) = graphs.get(&objects_dir) {
+        let mut generations = HashMap::new();
+        let walked = count(job.local, job.upstream, |oid| graph_node(&repo, graph, oid, &mut generations));
+        if walked.is_ok() {
+            return walked;
+        }
+    }
+
+    Ok(repo.graph_ahead_behind(job.local, job.upstream)?)
+}
+
+/// Parents, generation and commit time for a commit, from the graph if present
+///
+/// `generations` remembers the generations given to commits newer than the graph.
+fn graph_node(repo: &git2::Repository, graph: &CommitGraph, oid: Oid, generations: &mut HashMap<Oid, u32>) -> Result<Node> {
+    if let Some(pos) = graph.find(&oid) {
+        let data = graph.commit(pos).context("Corrupt commit-graph entry")?;
+        if data.generation == 0 {
+            bail!("Commit-graph was written without generation numbers");
+        }
+
+        let parents = graph.parents(pos)?
+            .into_iter()
+            .map(|p| graph.oid_at(p).context("Parent outside commit-graph"))
+            .collect::<Result<Vec<_>>>()?;
+
+        return Ok(Node { generation: data.generation, time: data.commit_time, parents });
+    }
+
+    // Commits newer than the graph get a generation one past their highest
+    // parent, so they still pop after every descendant whatever their dates
+    let commit = repo.find_commit(oid)?;
+    Ok(Node {
+        generation: new_generation(repo, graph, oid, generations)?,
+        time: commit.time().seconds().max(0) as u64,
+        parents: commit.parent_ids().collect(),
+    })
+}
+
+/// Generation of a commit missing from the graph, from its ancestors down to
+/// the first ones the graph knows
+fn new_generation(repo: &git2::Repository, graph: &CommitGraph, oid: Oid, generations: &mut HashMap<Oid, u32>) -> Result<u32> {
+    let mut stack = vec![oid];
+    while let Some(&top) = stack.last() {
+        if generations.contains_key(&top) {
+            stack.pop();
+            continue;
+        }
+
+        let mut generation = 1u32;
+        let mut missing = false;
+        for parent in repo.find_commit(top)?.parent_ids() {
+            let known = match graph.find(&parent) {
+                Some(pos) => Some(graph.commit(pos).context("Corrupt commit-graph entry")?.generation),
+                None => generations.get(&parent).copied(),
+            };
+            match known {
+                Some(g) => generation = generation.max(g.saturating_add(1)),
+                None => {
+                    stack.push(parent);
+                    missing = true;
+                }
+            }
+        }
+
+        if !missing {
+            generations.insert(top, generation);
+            stack.pop();
+        }
+    }
+    Ok(generations[&oid])
+}
+
+/// A commit as seen by the ahead/behind walk
+struct Node {
+    generation: u32,
+    time: u64,
+    parents: Vec<Oid>,
+}
+
+const FROM_LOCAL: u8 = 0x1;
+const FROM_UPSTREAM: u8 = 0x2;
+const FROM_BOTH: u8 = FROM_LOCAL | FROM_UPSTREAM;
+const POPPED: u8 = 0x4;
+
+/// Count commits reachable from only one of two tips
+///
+/// Walks in generation order so every commit's reachability flags are final
+/// when it is popped, and stops as soon as all queued commits are common.
+fn count<F>(local: Oid, upstream: Oid, node: F) -> Result<(usize, usize)>
+where
+    F: FnMut(Oid) -> Result<Node>,
+{
+    if local == upstream {
+        return Ok((0, 0));
+    }
+
+    let mut walk = Walk {
+        node,
+        flags: HashMap::new(),
+        parents: HashMap::new(),
+        queue: BinaryHeap::new(),
+        unresolved: 0,
+    };
+
+    walk.enqueue(local, FROM_LOCAL)?;
+    walk.enqueue(upstream, FROM_UPSTREAM)?;
+
+    let (mut ahead, mut behind) = (0, 0);
+
+    while walk.unresolved > 0 {
+        let (_, _, oid) = match walk.queue.pop() {
+            Some(item) => item,
+            None => break,
+        };
+
+        let bits = walk.flags[&oid];
+        match bits {
+            FROM_LOCAL => ahead += 1,
+            FROM_UPSTREAM => behind += 1,
+            _ => {}
+        }
+        if bits != FROM_BOTH {
+            walk.unresolved -= 1;
+        }
+        walk.flags.insert(oid, bits | POPPED);
+
+        for parent in walk.parents.remove(&oid).unwrap_or_default() {
+            walk.enqueue(parent, bits)?;
+        }
+    }
+
+    Ok((ahead, behind))
+}
+
+/// State of an in-progress ahead/behind walk
+struct Walk<F> {
+    node: F,
+    flags: HashMap<Oid, u8>,
+    parents: HashMap<Oid, Vec<Oid>>,
+    queue: BinaryHeap<(u32, u64, Oid)>,
+    /// Queued commits not yet known to be reachable from both tips
+    unresolved: usize,
+}
+
+impl<F> Walk<F>
+where
+    F: FnMut(Oid) -> Result<Node>,
+{
+    fn enqueue(&mut self, oid: Oid, bits: u8) -> Result<()> {
+        match self.flags.get(&oid).copied() {
+            Some(existing) if existing & POPPED != 0 => {}
+            Some(existing) => {
+                let merged = existing | bits;
+                if existing != FROM_BOTH && merged == FROM_BOTH {
+                    self.unresolved -= 1;
+                }
+                self.flags.insert(oid, merged);
+            }
+            None => {
+                let node = (self.node)(oid)?;
+                self.queue.push((node.generation, node.time, oid));
+                self.parents.insert(oid, node.parents);
+                self.flags.insert(oid, bits);
+                if bits != FROM_BOTH {
+                    self.unresolved += 1;
+                }
+            }
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    fn oid(n: u8) -> Oid {
+        Oid::from_bytes(&[n; 20]).unwrap()
+    }
+
+    #[test]
+    fn test_count_diverged() {
+        // 1 <- 2 <- 3 <- 4 (local)
+        //       \
+        //        5 <- 6 (upstream)
+        let dag: HashMap<Oid, (u32, Vec<Oid>)> = [
+            (oid(1), (1, vec![])),
+            (oid(2), (2, vec![oid(1)])),
+            (oid(3), (3, vec![oid(2)])),
+            (oid(4), (4, vec![oid(3)])),
+            (oid(5), (3, vec![oid(2)])),
+            (oid(6), (4, vec![oid(5)])),
+        ].into_iter().collect();
+
+        let lookup = |o: Oid| -> Result<Node> {
+            let (generation, parents) = dag[&o].clone();
+            Ok(Node { generation, time: generation as u64, parents })
+        };
+
+        assert_eq!(count(oid(4), oid(6), lookup).unwrap(), (2, 2));
+        assert_eq!(count(oid(4), oid(2), lookup).unwrap(), (2, 0));
+        assert_eq!(count(oid(1), oid(6), lookup).unwrap(), (0, 3));
+        assert_eq!(count(oid(6), oid(6), lookup).unwrap(), (0, 0));
+    }
+
+    #[test]
+    fn test_lookup_matches_libgit2() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        let sig = git2::Signature::now("Test", "test@example.com").unwrap();
+        let tree_id = repo.index().unwrap().write_tree().unwrap();
+        let tree = repo.find_tree(tree_id).unwrap();
+
+        let base = repo.commit(None, &sig, &sig, "base", &tree, &[]).unwrap();
+        let mut local = base;
+        for i in 0..3 {
+            let parent = repo.find_commit(local).unwrap();
+            local = repo.commit(None, &sig, &sig, &format!("local {}", i), &tree, &[&parent]).unwrap();
+        }
+        let parent = repo.find_commit(base).unwrap();
+        let upstream = repo.commit(None, &sig, &sig, "upstream", &tree, &[&parent]).unwrap();
+
+        let result = lookup(repo.path(), "main", local, upstream, Duration::from_secs(10));
+        assert!(!result.pending);
+        assert_eq!((result.ahead, result.behind), repo.graph_ahead_behind(local, upstream).unwrap());
+        assert_eq!((result.ahead, result.behind), (3, 1));
+    }
+}
@@ -0,0 +1,503 @@
+//! Incremental Blame
+//!
+//! Blame walks back from a commit through its ancestors, handing each line to
+//! the parent it came from until the commit that introduced it is found. On a
+//! deep file that means diffing every version of it. Finished results are
+//! kept per (path, commit) in `.git/gitscribe/blame.db`, and blaming a
+//! descendant of a cached commit stops the walk there: lines that survive
+//! back to it take their answer from the cache, so moving HEAD forward only
+//! costs the new commits.
+//!
+//! Hunks are yielded as soon as their lines are resolved, newest commits
+//! first rather than in file order. Commits that changed-path Bloom filters
+//! show didn't touch the file are passed over without loading trees. Renames
+//! are not followed: lines older than the file's current path are blamed on
+//! the commit that added it there.
+
+use anyhow::{Context, Result};
+use git2::Oid;
+use rusqlite::{params, Connection, OptionalExtension};
+use serde::{Deserialize, Serialize};
+use std::collections::{BinaryHeap, HashMap, VecDeque};
+use std::fs;
+use std::path::Path;
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+
+use crate::changed_paths::{ChangedPaths, PathQuery};
+use crate::line_diff::{self, DiffAlgorithm, LineDiff};
+
+/// Cached results kept per path; older ones are dropped
+const MAX_CACHED_PER_PATH: usize = 16;
+
+/// Consecutive lines of the blamed file that came from one commit
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct BlameHunk {
+    pub oid: String,
+    pub author_name: String,
+    pub author_email: String,
+    pub timestamp: i64,
+    pub summary: String,
+    /// First line in the blamed file (1-based)
+    pub final_start: u32,
+    /// First line in the file as of `oid` (1-based)
+    pub orig_start: u32,
+    pub lines: u32,
+}
+
+/// Lines waiting at a commit: (line in that commit's version, line in the
+/// blamed file), both 0-based
+type Lines = Vec<(u32, u32)>;
+
+/// A cached result expanded to the origin of each line
+struct Base {
+    oid: Oid,
+    origins: Vec<(Oid, u32)>,
+}
+
+/// Blame of one file at one commit, yielding hunks as they are resolved
+pub struct BlameStream<'r> {
+    repo: &'r git2::Repository,
+    path: String,
+    target: Oid,
+    /// Lines waiting at each commit, and the commits in newest-first order
+    pending: HashMap<Oid, Lines>,
+    queue: BinaryHeap<(i64, Oid)>,
+    base: Option<Base>,
+    /// Origin of each line of the blamed file, once known
+    resolved: Vec<Option<(Oid, u32)>>,
+    ready: VecDeque<BlameHunk>,
+    /// Queued commits, and those a hunk was blamed on
+    commits: HashMap<Oid, git2::Commit<'r>>,
+    filters: Option<(ChangedPaths, PathQuery)>,
+    store: Option<BlameStore>,
+    done: bool,
+}
+
+impl<'r> BlameStream<'r> {
+    /// Start blaming `path` (relative to the repository root) at `oid`
+    pub fn new(repo: &'r git2::Repository, path: &Path, oid: Oid) -> Result<Self> {
+        let path = path.to_string_lossy().replace('\\', "/").trim_matches('/').to_string();
+        let commit = repo.find_commit(oid)?;
+        let blob = file_at(&commit, &path)?
+            .with_context(|| format!("{} does not exist in {}", path, oid))?;
+        let num_lines = line_diff::split_lines(repo.find_blob(blob)?.content()).len();
+
+        let store = BlameStore::open(repo.path())
+            .map_err(|e| tracing::debug!("blame cache unavailable for {:?}: {}", repo.path(), e))
+            .ok();
+        let filters = ChangedPaths::open(repo)
+            .map(|filters| {
+                let query = filters.query(Path::new(&path));
+                (filters, query)
+            })
+            .map_err(|e| tracing::debug!("changed-path filters unavailable for {:?}: {}", repo.path(), e))
+            .ok();
+
+        let mut stream = Self {
+            repo,
+            path,
+            target: oid,
+            pending: HashMap::new(),
+            queue: BinaryHeap::new(),
+            base: None,
+            resolved: vec![None; num_lines],
+            ready: VecDeque::new(),
+            commits: HashMap::new(),
+            filters,
+            store,
+            done: false,
+        };
+
+        if let Some(hunks) = stream.cached(oid) {
+            stream.ready.extend(hunks);
+            stream.done = true;
+            return Ok(stream);
+        }
+
+        stream.base = stream.find_base()?;
+        stream.pass(commit, (0..num_lines as u32).map(|i| (i, i)).collect());
+        Ok(stream)
+    }
+
+    fn cached(&self, oid: Oid) -> Option<Vec<BlameHunk>> {
+        let store = self.store.as_ref()?;
+        match store.get(&self.path, oid) {
+            Ok(hunks) => hunks,
+            Err(e) => {
+                tracing::debug!("unreadable cached blame of {} at {}: {}", self.path, oid, e);
+                None
+            }
+        }
+    }
+
+    /// The newest cached result for an ancestor of the target
+    fn find_base(&self) -> Result<Option<Base>> {
+        let candidates = match &self.store {
+            Some(store) => store.oids(&self.path)?,
+            None => return Ok(None),
+        };
+
+        let mut best: Option<(i64, Oid)> = None;
+        for candidate in candidates {
+            if candidate == self.target || !self.repo.graph_descendant_of(self.target, candidate).unwrap_or(false) {
+                continue;
+            }
+            let time = self.repo.find_commit(candidate)?.time().seconds();
+            if best.map_or(true, |(t, _)| time > t) {
+                best = Some((time, candidate));
+            }
+        }
+
+        let (oid, hunks) = match best.and_then(|(_, oid)| self.cached(oid).map(|hunks| (oid, hunks))) {
+            Some(found) => found,
+            None => return Ok(None),
+        };
+
+        let mut origins = Vec::new();
+        for hunk in hunks {
+            let origin = Oid::from_str(&hunk.oid)?;
+            for i in 0..hunk.lines {
+                let line = (hunk.final_start + i - 1) as usize;
+                if origins.len() <= line {
+                    origins.resize(line + 1, (origin, 0));
+                }
+                origins[line] = (origin, hunk.orig_start + i - 1);
+            }
+        }
+        tracing::debug!("blame of {} at {} resumes from {}", self.path, self.target, oid);
+        Ok(Some(Base { oid, origins }))
+    }
+
+    /// Hand lines to `commit`, queueing it if nothing was waiting there
+    fn pass(&mut self, commit: git2::Commit<'r>, lines: Lines) {
+        if lines.is_empty() {
+            return;
+        }
+        let oid = commit.id();
+        match self.pending.get_mut(&oid) {
+            Some(waiting) => waiting.extend(lines),
+            None => {
+                self.queue.push((commit.time().seconds(), oid));
+                self.pending.insert(oid, lines);
+                self.commits.entry(oid).or_insert(commit);
+            }
+        }
+    }
+
+    /// Process the newest commit with lines waiting
+    fn step(&mut self) -> Result<()> {
+        let (_, oid) = match self.queue.pop() {
+            Some(next) => next,
+            None => return Ok(()),
+        };
+        let lines = match self.pending.remove(&oid) {
+            Some(lines) => lines,
+            None => return Ok(()),
+        };
+
+        if let Some(base) = self.base.as_ref().filter(|base| base.oid == oid) {
+            let resolved: Vec<_> = lines.iter()
+                .map(|&(line, final_line)| {
+                    let (origin, orig) = base.origins[line as usize];
+                    (final_line, origin, orig)
+                })
+                .collect();
+            return self.resolve(resolved);
+        }
+
+        // Only commits that lines are blamed on stay cached
+        let commit = match self.commits.remove(&oid) {
+            Some(commit) => commit,
+            None => self.repo.find_commit(oid)?,
+        };
+        let parents: Vec<git2::Commit<'r>> = commit.parents().collect();
+        if parents.is_empty() {
+            return self.resolve(lines.into_iter().map(|(line, final_line)| (final_line, oid, line)).collect());
+        }
+
+        // Untouched relative to the first parent: everything passes through
+        if let Some((filters, query)) = &self.filters {
+            if !filters.maybe_changed(query, &oid) {
+                self.pass(parents[0].clone(), lines);
+                return Ok(());
+            }
+        }
+
+        let blob = file_at(&commit, &self.path)?.context("Blamed file vanished from a commit")?;
+        let parent_blobs = parents.iter()
+            .map(|parent| file_at(parent, &self.path))
+            .collect::<Result<Vec<_>>>()?;
+        if let Some(same) = parent_blobs.iter().position(|b| *b == Some(blob)) {
+            self.pass(parents[same].clone(), lines);
+            return Ok(());
+        }
+
+        let content = self.repo.find_blob(blob)?;
+        let mut remaining = lines;
+        for (parent, parent_blob) in parents.into_iter().zip(parent_blobs) {
+            let parent_blob = match parent_blob {
+                Some(parent_blob) if !remaining.is_empty() => self.repo.find_blob(parent_blob)?,
+                _ => continue,
+            };
+
+            // Map this commit's lines to the parent's where unchanged
+            let diff = LineDiff::compute(parent_blob.content(), content.content(), DiffAlgorithm::Myers);
+            let mut from_parent = vec![u32::MAX; diff.new_len()];
+            for (old, new) in diff.unchanged() {
+                from_parent[new] = old as u32;
+            }
+
+            let (passed, kept): (Lines, Lines) = remaining.into_iter()
+                .partition(|&(line, _)| from_parent[line as usize] != u32::MAX);
+            let passed = passed.into_iter()
+                .map(|(line, final_line)| (from_parent[line as usize], final_line))
+                .collect();
+            self.pass(parent, passed);
+            remaining = kept;
+        }
+
+        self.resolve(remaining.into_iter().map(|(line, final_line)| (final_line, oid, line)).collect())
+    }
+
+    /// Record origins as (line in the blamed file, commit, line there) and
+    /// queue their hunks
+    fn resolve(&mut self, mut resolved: Vec<(u32, Oid, u32)>) -> Result<()> {
+        resolved.sort_unstable_by_key(|&(final_line, _, _)| final_line);
+        for &(final_line, origin, orig) in &resolved {
+            self.resolved[final_line as usize] = Some((origin, orig));
+        }
+
+        let mut start = 0;
+        while start < resolved.len() {
+            let (final_start, origin, orig_start) = resolved[start];
+            let mut end = start + 1;
+            while end < resolved.len() {
+                let offset = (end - start) as u32;
+                if resolved[end] != (final_start + offset, origin, orig_start + offset) {
+                    break;
+                }
+                end += 1;
+            }
+
+            let hunk = self.hunk(origin, final_start, orig_start, (end - start) as u32)?;
+            self.ready.push_back(hunk);
+            start = end;
+        }
+        Ok(())
+    }
+
+    fn hunk(&mut self, oid: Oid, final_start: u32, orig_start: u32, lines: u32) -> Result<BlameHunk> {
+        let commit = self.commit(oid)?;
+        let author = commit.author();
+        Ok(BlameHunk {
+            oid: oid.to_string(),
+            author_name: author.name().unwrap_or("").to_string(),
+            author_email: author.email().unwrap_or("").to_string(),
+            timestamp: author.when().seconds(),
+            summary: commit.summary().unwrap_or("").to_string(),
+            final_start: final_start + 1,
+            orig_start: orig_start + 1,
+            lines,
+        })
+    }
+
+    fn commit(&mut self, oid: Oid) -> Result<git2::Commit<'r>> {
+        if let Some(commit) = self.commits.get(&oid) {
+            return Ok(commit.clone());
+        }
+        let commit = self.repo.find_commit(oid)?;
+        self.commits.insert(oid, commit.clone());
+        Ok(commit)
+    }
+
+    /// Store the whole result for later blames of this commit and its descendants
+    fn finish(&mut self) -> Result<()> {
+        if self.store.is_none() {
+            return Ok(());
+        }
+
+        let origins: Vec<(Oid, u32)> = self.resolved.iter()
+            .map(|origin| origin.context("Blame finished with unresolved lines"))
+            .collect::<Result<_>>()?;
+        let mut hunks = Vec::new();
+        let mut start = 0;
+        while start < origins.len() {
+            let (origin, orig_start) = origins[start];
+            let mut end = start + 1;
+            while end < origins.len() && origins[end] == (origin, orig_start + (end - start) as u32) {
+                end += 1;
+            }
+            hunks.push(self.hunk(origin, start as u32, orig_start, (end - start) as u32)?);
+            start = end;
+        }
+
+        match &self.store {
+            Some(store) => store.put(&self.path, self.target, &hunks),
+            None => Ok(()),
+        }
+    }
+
+    fn next_hunk(&mut self) -> Result<Option<BlameHunk>> {
+        loop {
+            if let Some(hunk) = self.ready.pop_front() {
+                return Ok(Some(hunk));
+            }
+            if self.done {
+                return Ok(None);
+            }
+            if self.queue.is_empty() {
+                self.done = true;
+                if let Err(e) = self.finish() {
+                    tracing::debug!("failed to store blame of {} at {}: {}", self.path, self.target, e);
+                }
+                continue;
+            }
+            self.step()?;
+        }
+    }
+}
+
+impl Iterator for BlameStream<'_> {
+    type Item = Result<BlameHunk>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let next = self.next_hunk();
+        if next.is_err() {
+            self.done = true;
+            self.ready.clear();
+        }
+        next.transpose()
+    }
+}
+
+/// Id of the blob at `path` in `commit`, if there is one
+fn file_at(commit: &git2::Commit<'_>, path: &str) -> Result<Option<Oid>> {
+    match commit.tree()?.get_path(Path::new(path)) {
+        Ok(entry) if entry.kind() == Some(git2::ObjectType::Blob) => Ok(Some(entry.id())),
+        Ok(_) => Ok(None),
+        Err(e) if e.code() == git2::ErrorCode::NotFound => Ok(None),
+        Err(e) => Err(e.into()),
+    }
+}
+
+/// Finished blames, one database per repository
+struct BlameStore {
+    conn: Connection,
+}
+
+impl BlameStore {
+    fn open(git_dir: &Path) -> Result<Self> {
+        let dir = crate::repository::common_dir(git_dir).join("gitscribe");
+        fs::create_dir_all(&dir).context("Failed to create blame cache directory")?;
+
+        let conn = Connection::open(dir.join("blame.db"))
+            .context("Failed to open blame cache")?;
+        conn.pragma_update(None, "journal_mode", "WAL")?;
+        conn.pragma_update(None, "synchronous", "NORMAL")?;
+        conn.busy_timeout(Duration::from_secs(5))?;
+
+        conn.execute_batch(
+            "CREATE TABLE IF NOT EXISTS blame (
+                 path TEXT NOT NULL,
+                 oid TEXT NOT NULL,
+                 hunks TEXT NOT NULL,
+                 stored INTEGER NOT NULL,
+                 PRIMARY KEY (path, oid)
+             ) WITHOUT ROWID"
+        )?;
+        Ok(Self { conn })
+    }
+
+    fn get(&self, path: &str, oid: Oid) -> Result<Option<Vec<BlameHunk>>> {
+        let json: Option<String> = self.conn
+            .prepare_cached("SELECT hunks FROM blame WHERE path = ? AND oid = ?")?
+            .query_row(params![path, oid.to_string()], |row| row.get(0))
+            .optional()?;
+
+        match json {
+            Some(json) => Ok(Some(serde_json::from_str(&json)?)),
+            None => Ok(None),
+        }
+    }
+
+    fn oids(&self, path: &str) -> Result<Vec<Oid>> {
+        let mut stmt = self.conn.prepare_cached("SELECT oid FROM blame WHERE path = ?")?;
+        let oids = stmt
+            .query_map(params![path], |row| row.get::<_, String>(0))?
+            .filter_map(|oid| oid.ok().and_then(|oid| Oid::from_str(&oid).ok()))
+            .collect();
+        Ok(oids)
+    }
+
+    fn put(&self, path: &str, oid: Oid, hunks: &[BlameHunk]) -> Result<()> {
+        let stored = SystemTime::now().duration_since(UNIX_EPOCH).map_or(0, |d| d.as_nanos() as i64);
+        self.conn
+            .prepare_cached("INSERT OR REPLACE INTO blame (path, oid, hunks, stored) VALUES (?, ?, ?, ?)")?
+            .execute(params![path, oid.to_string(), serde_json::to_string(hunks)?, stored])?;
+
+        self.conn
+            .prepare_cached(
+                "DELETE FROM blame WHERE path = ?1 AND oid NOT IN (
+                     SELECT oid FROM blame WHERE path = ?1 ORDER BY stored DESC LIMIT ?2
+                 )"
+            )?
+            .execute(params![path, MAX_CACHED_PER_PATH as i64])?;
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_incremental_blame_matches_full_blame() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        let sig = git2::Signature::now("Test", "test@example.com").unwrap();
+
+        let commit = |content: &str| {
+            fs::write(temp_dir.path().join("file.txt"), content).unwrap();
+            let mut index = repo.index().unwrap();
+            index.add_path(Path::new("file.txt")).unwrap();
+            let tree = repo.find_tree(index.write_tree().unwrap()).unwrap();
+            let parent = repo.head().ok().and_then(|h| h.peel_to_commit().ok());
+            let parents: Vec<_> = parent.iter().collect();
+            repo.commit(Some("HEAD"), &sig, &sig, "commit", &tree, &parents).unwrap()
+        };
+        let blame = |oid: Oid| {
+            let mut hunks: Vec<BlameHunk> = BlameStream::new(&repo, Path::new("file.txt"), oid)
+                .unwrap()
+                .collect::<Result<_>>()
+                .unwrap();
+            hunks.sort_by_key(|h| h.final_start);
+            hunks.iter().map(|h| (h.oid.clone(), h.final_start, h.orig_start, h.lines)).collect::<Vec<_>>()
+        };
+
+        let first = commit("a\nb\nc\n");
+        let second = commit("a\nB\nc\nd\n");
+        let at_second = blame(second);
+        assert_eq!(at_second, [
+            (first.to_string(), 1, 1, 1),
+            (second.to_string(), 2, 2, 1),
+            (first.to_string(), 3, 3, 1),
+            (second.to_string(), 4, 4, 1),
+        ]);
+        // Served from the cache now
+        assert_eq!(blame(second), at_second);
+
+        // Resumes from the cached blame of `second`
+        let third = commit("new\na\nB\nc\nd\n");
+        let incremental = blame(third);
+        fs::remove_file(temp_dir.path().join(".git/gitscribe/blame.db")).unwrap();
+        assert_eq!(blame(third), incremental);
+        assert_eq!(incremental, [
+            (third.to_string(), 1, 1, 1),
+            (first.to_string(), 2, 1, 1),
+            (second.to_string(), 3, 2, 1),
+            (first.to_string(), 4, 3, 1),
+            (second.to_string(), 5, 4, 1),
+        ]);
+    }
+}
@@ -0,0 +1,199 @@
+//! Batch Blob Hashing
+//!
+//! When stat data can't prove a file clean (racy timestamps, fresh checkouts,
+//! touched files) status has to hash its contents, and after a branch switch
+//! that can be thousands of files. This module hashes such candidates as one
+//! batch spread over the work-stealing pool, so every core keeps a digest in
+//! flight. The sha1 crate picks up the CPU's SHA extensions at runtime.
+//!
+//! Small files are read into a reused per-thread buffer; large files are
+//! streamed through the hasher in fixed-size chunks. Files aren't memory
+//! mapped: a file truncated by another process while mapped raises SIGBUS.
+//!
+//! Only SHA-1 object ids are produced; libgit2 can't open SHA-256
+//! repositories, so the scanner never sees one.
+
+use anyhow::{Context, Result};
+use rayon::prelude::*;
+use sha1::Digest;
+use std::cell::RefCell;
+use std::fmt;
+use std::fs::{self, File};
+use std::io::Read;
+use std::path::Path;
+
+/// Files at least this large are streamed instead of read whole
+pub const STREAM_THRESHOLD: u64 = 256 * 1024;
+
+/// Chunk size for streamed files
+const STREAM_CHUNK: usize = 64 * 1024;
+
+/// SHA-1 object id
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct ObjectId([u8; 20]);
+
+impl ObjectId {
+    /// Raw id bytes
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.0
+    }
+}
+
+impl fmt::Display for ObjectId {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        for byte in self.as_bytes() {
+            write!(f, "{:02x}", byte)?;
+        }
+        Ok(())
+    }
+}
+
+/// How a working tree entry becomes blob content
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum BlobKind {
+    /// Regular file contents
+    File,
+    /// Symlink target path
+    Symlink,
+}
+
+/// Start hashing a blob of `len` bytes
+fn blob_hasher(len: u64) -> sha1::Sha1 {
+    let mut hasher = sha1::Sha1::new();
+    hasher.update(format!("blob {}\0", len).as_bytes());
+    hasher
+}
+
+/// Hash data as a blob object (`blob <len>\0<data>`)
+pub fn hash_bytes(data: &[u8]) -> ObjectId {
+    let mut hasher = blob_hasher(data.len() as u64);
+    hasher.update(data);
+    ObjectId(hasher.finalize().into())
+}
+
+thread_local! {
+    /// Read buffer for files below the stream threshold, reused across files
+    static READ_BUFFER: RefCell<Vec<u8>> = RefCell::new(Vec::new());
+}
+
+/// Hash a file's contents as a blob
+pub fn hash_file(path: &Path) -> Result<ObjectId> {
+    let mut file = File::open(path)
+        .with_context(|| format!("Failed to open {}", path.display()))?;
+    let len = file.metadata()?.len();
+
+    if len >= STREAM_THRESHOLD {
+        return hash_stream(&mut file, len)
+            .with_context(|| format!("Failed to read {}", path.display()));
+    }
+
+    READ_BUFFER.with(|buffer| {
+        let mut buffer = buffer.borrow_mut();
+        buffer.clear();
+        file.read_to_end(&mut buffer)
+            .with_context(|| format!("Failed to read {}", path.display()))?;
+        let id = hash_bytes(&buffer);
+
+        // Don't pin memory for a file that grew past the threshold mid-read
+        if buffer.capacity() > 2 * STREAM_THRESHOLD as usize {
+            *buffer = Vec::new();
+        }
+        Ok(id)
+    })
+}
+
+/// Hash `len` bytes of a large file chunk by chunk
+///
+/// The header carries the length up front, so a file that changes size while
+/// it is read is an error rather than a wrong id.
+fn hash_stream(file: &mut File, len: u64) -> Result<ObjectId> {
+    let mut hasher = blob_hasher(len);
+    let mut chunk = vec![0u8; STREAM_CHUNK];
+    let mut total = 0u64;
+    loop {
+        let n = file.read(&mut chunk)?;
+        if n == 0 {
+            break;
+        }
+        total += n as u64;
+        if total > len {
+            break;
+        }
+        hasher.update(&chunk[..n]);
+    }
+    if total != len {
+        anyhow::bail!("File changed size while hashing");
+    }
+    Ok(ObjectId(hasher.finalize().into()))
+}
+
+/// Hash a symlink's target as a blob
+pub fn hash_symlink(path: &Path) -> Result<ObjectId> {
+    let target = fs::read_link(path)
+        .with_context(|| format!("Failed to read link {}", path.display()))?;
+
+    #[cfg(unix)]
+    let bytes = {
+        use std::os::unix::ffi::OsStrExt;
+        target.as_os_str().as_bytes().to_vec()
+    };
+    #[cfg(not(unix))]
+    let bytes = target.to_str().context("Non UTF-8 symlink target")?.as_bytes().to_vec();
+
+    Ok(hash_bytes(&bytes))
+}
+
+/// Hash many working tree entries in parallel on the current rayon pool
+///
+/// # Returns
+/// One result per input, in input order
+pub fn hash_batch<P>(items: &[(P, BlobKind)]) -> Vec<Result<ObjectId>>
+where
+    P: AsRef<Path> + Sync,
+{
+    items
+        .par_iter()
+        .map(|(path, kind)| match kind {
+            BlobKind::File => hash_file(path.as_ref()),
+            BlobKind::Symlink => hash_symlink(path.as_ref()),
+        })
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_known_blob_ids() {
+        // `echo hello | git hash-object --stdin`
+        assert_eq!(hash_bytes(b"hello\n").to_string(), "ce013625030ba8dba906f756967f9e9ca394464a");
+        assert_eq!(hash_bytes(b"").to_string(), "e69de29bb2d1d6434b8b29ae775ad8c2e48c5391");
+    }
+
+    #[test]
+    fn test_batch_matches_single() {
+        let temp_dir = TempDir::new().unwrap();
+        let large: Vec<u8> = (0..STREAM_THRESHOLD as usize + 1000).map(|i| (i % 251) as u8).collect();
+
+        let mut items = Vec::new();
+        for i in 0..20 {
+            let path = temp_dir.path().join(format!("f{}.txt", i));
+            fs::write(&path, format!("file {}\n", i)).unwrap();
+            items.push((path, BlobKind::File));
+        }
+        let large_path = temp_dir.path().join("large.bin");
+        fs::write(&large_path, &large).unwrap();
+        items.push((large_path, BlobKind::File));
+
+        let hashes = hash_batch(&items);
+        assert_eq!(hashes.len(), items.len());
+        for ((path, _), hash) in items.iter().zip(hashes) {
+            assert_eq!(hash.unwrap(), hash_bytes(&fs::read(path).unwrap()));
+        }
+
+        let missing = vec![(temp_dir.path().join("missing"), BlobKind::File)];
+        assert!(hash_batch(&missing)[0].is_err());
+    }
+}
@@ -0,0 +1,337 @@
+//! Batched Branch Listing
+//!
+//! Listing branches through libgit2 resolves each reference and loads each
+//! tip commit one after another, which is slow with thousands of remote
+//! branches. This reads `packed-refs` and the loose refs under `refs/heads`
+//! and `refs/remotes` in one pass, decodes tip commits in parallel on the
+//! rayon pool, and sorts branches by committer date.
+//!
+//! Results are cached per repository, keyed by the stat data of every ref
+//! file plus HEAD and config (for the current branch and upstreams), so an
+//! unchanged repository is answered without reading a ref or a commit.
+//! Listings that saw a ref file modified within the last couple of seconds
+//! aren't cached, since a rewrite in the same timestamp tick would go
+//! unnoticed.
+
+use anyhow::{Context, Result};
+use git2::Oid;
+use rayon::prelude::*;
+use serde::{Deserialize, Serialize};
+use std::collections::{BTreeMap, HashMap};
+use std::fs;
+use std::hash::{Hash, Hasher};
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+
+use crate::fingerprint::{self, Fnv64};
+use crate::history::Branch;
+use crate::history_scan;
+
+/// Repositories whose listings are kept in memory
+const MAX_CACHED_REPOS: usize = 16;
+
+/// Ref files modified more recently than this are too new to cache on
+const RACY_WINDOW: Duration = Duration::from_secs(2);
+
+/// A branch with its tip commit's metadata
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct BranchTip {
+    #[serde(flatten)]
+    pub branch: Branch,
+    /// Committer time of the tip
+    pub timestamp: i64,
+    pub author_name: String,
+    pub summary: String,
+}
+
+/// Ref files found in the scan, before any are read
+struct RefFiles {
+    /// Loose refs as (full name, path)
+    loose: Vec<(String, PathBuf)>,
+    /// Hash of every file's stat data, HEAD and config
+    key: u64,
+    racy: bool,
+}
+
+struct Cached {
+    key: u64,
+    branches: Arc<Vec<BranchTip>>,
+    last_used: u64,
+}
+
+#[derive(Default)]
+struct Cache {
+    repos: HashMap<PathBuf, Cached>,
+    tick: u64,
+}
+
+fn cache() -> &'static Mutex<Cache> {
+    static CACHE: OnceLock<Mutex<Cache>> = OnceLock::new();
+    CACHE.get_or_init(|| Mutex::new(Cache::default()))
+}
+
+/// All local and remote branches, newest tip first (ties by name)
+pub fn list(repo: &git2::Repository) -> Result<Arc<Vec<BranchTip>>> {
+    let git_dir = repo.path();
+    let common_dir = crate::repository::common_dir(git_dir);
+    let files = scan(git_dir, &common_dir)?;
+
+    {
+        let mut cache = cache().lock().unwrap();
+        cache.tick += 1;
+        let tick = cache.tick;
+        if let Some(cached) = cache.repos.get_mut(&common_dir).filter(|c| c.key == files.key) {
+            cached.last_used = tick;
+            return Ok(cached.branches.clone());
+        }
+    }
+
+    let branches = Arc::new(load(repo, &common_dir, &files)?);
+
+    if !files.racy {
+        let mut cache = cache().lock().unwrap();
+        let last_used = cache.tick;
+        cache.repos.insert(common_dir, Cached { key: files.key, branches: branches.clone(), last_used });
+        if cache.repos.len() > MAX_CACHED_REPOS {
+            let oldest = cache.repos.iter().min_by_key(|(_, c)| c.last_used).map(|(path, _)| path.clone());
+            if let Some(oldest) = oldest {
+                cache.repos.remove(&oldest);
+            }
+        }
+    }
+    Ok(branches)
+}
+
+/// Stat every ref file without reading any
+fn scan(git_dir: &Path, common_dir: &Path) -> Result<RefFiles> {
+    let racy_after = SystemTime::now() - RACY_WINDOW;
+    let mut racy = fs::metadata(common_dir.join("packed-refs"))
+        .and_then(|m| m.modified())
+        .map_or(false, |t| t > racy_after);
+
+    // (full name, path, length, mtime)
+    let mut found: Vec<(String, PathBuf, u64, Option<u128>)> = Vec::new();
+    let mut dirs = vec!["refs/heads".to_string(), "refs/remotes".to_string()];
+    while let Some(dir) = dirs.pop() {
+        let entries = match fs::read_dir(common_dir.join(&dir)) {
+            Ok(entries) => entries,
+            Err(_) => continue,
+        };
+        for entry in entries {
+            let entry = entry?;
+            let name = format!("{}/{}", dir, entry.file_name().to_string_lossy());
+            let meta = entry.metadata()?;
+            if meta.is_dir() {
+                dirs.push(name);
+                continue;
+            }
+            // Lock files of updates in progress
+            if name.ends_with(".lock") {
+                continue;
+            }
+
+            let modified = meta.modified().ok();
+            racy |= modified.map_or(true, |t| t > racy_after);
+            let modified = modified.and_then(|t| t.duration_since(UNIX_EPOCH).ok()).map(|d| d.as_nanos());
+            found.push((name, entry.path(), meta.len(), modified));
+        }
+    }
+    // Directory order varies; the key must not
+    found.sort();
+
+    let mut hasher = Fnv64::new();
+    fs::read(git_dir.join("HEAD")).unwrap_or_default().hash(&mut hasher);
+    fingerprint::hash_stat(&common_dir.join("config"), &mut hasher);
+    fingerprint::hash_stat(&common_dir.join("packed-refs"), &mut hasher);
+    for (name, _, len, modified) in &found {
+        (name, len, modified).hash(&mut hasher);
+    }
+
+    Ok(RefFiles {
+        loose: found.into_iter().map(|(name, path, _, _)| (name, path)).collect(),
+        key: hasher.finish(),
+        racy,
+    })
+}
+
+/// Read the refs and decode their tips
+fn load(repo: &git2::Repository, common_dir: &Path, files: &RefFiles) -> Result<Vec<BranchTip>> {
+    let mut refs: BTreeMap<String, Oid> = BTreeMap::new();
+
+    if let Ok(packed) = fs::read_to_string(common_dir.join("packed-refs")) {
+        for line in packed.lines() {
+            // Header and peeled-tag lines
+            if line.starts_with('#') || line.starts_with('^') {
+                continue;
+            }
+            if let Some((oid, name)) = line.split_once(' ') {
+                if is_branch_ref(name) {
+                    refs.insert(name.to_string(), Oid::from_str(oid).context("Invalid packed-refs entry")?);
+                }
+            }
+        }
+    }
+
+    // Loose refs take precedence over packed ones
+    for (name, path) in &files.loose {
+        let content = match fs::read_to_string(path) {
+            Ok(content) => content,
+            // Deleted since the scan
+            Err(_) => continue,
+        };
+        let content = content.trim();
+        // Symbolic refs (e.g. refs/remotes/origin/HEAD) aren't branches of their own
+        if content.starts_with("ref:") {
+            refs.remove(name);
+            continue;
+        }
+        match Oid::from_str(content) {
+            Ok(oid) => {
+                refs.insert(name.clone(), oid);
+            }
+            Err(e) => tracing::debug!("skipping unreadable ref {}: {}", name, e),
+        }
+    }
+
+    let head = fs::read_to_string(repo.path().join("HEAD")).unwrap_or_default();
+    let head = head.trim().strip_prefix("ref: ").map(str::to_string);
+
+    let mut tips: Vec<Oid> = refs.values().copied().collect();
+    tips.sort();
+    tips.dedup();
+    let git_dir = repo.path();
+    let metadata: Vec<Option<(Oid, (i64, String, String))>> = tips.par_iter()
+        .map_init(|| history_scan::WorkerRepo::new(git_dir), |worker, oid| {
+            let meta = worker.with(|repo| {
+                let commit = repo.find_commit(*oid)?;
+                Ok((
+                    commit.committer().when().seconds(),
+                    commit.author().name().unwrap_or("").to_string(),
+                    commit.summary().unwrap_or("").to_string(),
+                ))
+            });
+            match meta {
+                Ok(meta) => Some((*oid, meta)),
+                Err(e) => {
+                    tracing::debug!("branch tip {} is not a readable commit: {}", oid, e);
+                    None
+                }
+            }
+        })
+        .collect();
+    let metadata: HashMap<Oid, (i64, String, String)> = metadata.into_iter().flatten().collect();
+
+    let config = repo.config()?;
+    let mut branches: Vec<BranchTip> = refs.into_iter()
+        .map(|(name, oid)| {
+            let is_remote = name.starts_with("refs/remotes/");
+            let short = name.trim_start_matches("refs/heads/").trim_start_matches("refs/remotes/").to_string();
+            let upstream = if is_remote { None } else { upstream(&config, &short) };
+            let (timestamp, author_name, summary) = metadata.get(&oid).cloned().unwrap_or_default();
+
+            BranchTip {
+                branch: Branch {
+                    is_head: head.as_deref() == Some(name.as_str()),
+                    name: short,
+                    is_remote,
+                    upstream,
+                    target_oid: Some(oid.to_string()),
+                },
+                timestamp,
+                author_name,
+                summary,
+            }
+        })
+        .collect();
+
+    branches.sort_by(|a, b| b.timestamp.cmp(&a.timestamp).then_with(|| a.branch.name.cmp(&b.branch.name)));
+    Ok(branches)
+}
+
+fn is_branch_ref(name: &str) -> bool {
+    name.starts_with("refs/heads/") || name.starts_with("refs/remotes/")
+}
+
+/// Upstream of a local branch from its config, as a branch name ("origin/main")
+fn upstream(config: &git2::Config, branch: &str) -> Option<String> {
+    let remote = config.get_string(&format!("branch.{}.remote", branch)).ok()?;
+    let merge = config.get_string(&format!("branch.{}.merge", branch)).ok()?;
+    let merge = merge.strip_prefix("refs/heads/").unwrap_or(&merge);
+    if remote == "." {
+        Some(merge.to_string())
+    } else {
+        Some(format!("{}/{}", remote, merge))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_packed_and_loose_refs_sorted_by_date() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        let tree = repo.find_tree(repo.index().unwrap().write_tree().unwrap()).unwrap();
+        let commit = |time: i64| {
+            let sig = git2::Signature::new("Test", "test@example.com", &git2::Time::new(time, 0)).unwrap();
+            repo.commit(None, &sig, &sig, &format!("at {}", time), &tree, &[]).unwrap()
+        };
+        let (old, new, newest) = (commit(1000), commit(2000), commit(3000));
+
+        // `stale` is overridden by its loose ref; `origin/old` only exists packed
+        fs::write(
+            repo.path().join("packed-refs"),
+            format!("# pack-refs with: peeled fully-peeled sorted \n{} refs/heads/stale\n{} refs/remotes/origin/old\n", old, old),
+        ).unwrap();
+        repo.reference("refs/heads/stale", newest, true, "test").unwrap();
+        repo.reference("refs/heads/main", new, true, "test").unwrap();
+        repo.reference_symbolic("refs/remotes/origin/HEAD", "refs/remotes/origin/old", true, "test").unwrap();
+        repo.set_head("refs/heads/main").unwrap();
+
+        let names = |branches: &[BranchTip]| -> Vec<String> {
+            branches.iter().map(|b| b.branch.name.clone()).collect()
+        };
+        let branches = list(&repo).unwrap();
+        assert_eq!(names(&branches), ["stale", "main", "origin/old"]);
+        assert_eq!(branches[0].timestamp, 3000);
+        assert!(branches[1].branch.is_head);
+        assert!(branches[2].branch.is_remote);
+
+        // A ref update changes the key even within the racy window
+        repo.reference("refs/heads/main", old, true, "test").unwrap();
+        assert_eq!(names(&list(&repo).unwrap()), ["stale", "main", "origin/old"]);
+        assert_eq!(list(&repo).unwrap()[1].timestamp, 1000);
+
+        // Once every ref file is older than the racy window, the listing is
+        // cached and served again without reloading
+        backdate_refs(repo.path());
+        let first = list(&repo).unwrap();
+        let second = list(&repo).unwrap();
+        assert!(Arc::ptr_eq(&first, &second));
+        assert_eq!(names(&second), ["stale", "main", "origin/old"]);
+
+        // and an update still invalidates the cached listing
+        repo.reference("refs/heads/main", newest, true, "test").unwrap();
+        backdate_refs(repo.path());
+        let updated = list(&repo).unwrap();
+        assert!(!Arc::ptr_eq(&first, &updated));
+        assert_eq!(names(&updated), ["main", "stale", "origin/old"]);
+        assert!(Arc::ptr_eq(&updated, &list(&repo).unwrap()));
+    }
+
+    /// Move the mtime of `packed-refs` and every loose ref out of the racy window
+    fn backdate_refs(git_dir: &Path) {
+        let past = SystemTime::now() - RACY_WINDOW * 10;
+        let mut paths = vec![git_dir.join("packed-refs"), git_dir.join("refs")];
+        while let Some(path) = paths.pop() {
+            if path.is_dir() {
+                paths.extend(fs::read_dir(&path).unwrap().map(|entry| entry.unwrap().path()));
+            } else if path.is_file() {
+                fs::File::options().write(true).open(&path).unwrap().set_modified(past).unwrap();
+            }
+        }
+    }
+}
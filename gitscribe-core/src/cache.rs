@@ -1,17 +1,52 @@
 //! SQLite-based status caching for fast overlay icon queries
 
 use anyhow::{Context, Result};
-use rusqlite::{Connection, params};
-use std::path::Path;
-use std::time::{SystemTime, UNIX_EPOCH};
+use rusqlite::{Connection, ToSql, params};
+use std::collections::{BTreeSet, HashMap};
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
 use serde::{Deserialize, Serialize};
 
+use crate::scanner::ScanOptions;
 use crate::status::FileStatus;
-use crate::{Repository, FileStatusEntry};
+use crate::status_log::StatusLog;
+use crate::{Repository, FileStatusEntry, RepoFingerprint};
 
 /// Shared SQLite cache version - coordinate changes across all components
 const CACHE_VERSION: &str = "1.0.0";
 
+/// Rows per multi-row INSERT when staging a status refresh (3 parameters each)
+const STAGE_BATCH_ROWS: usize = 256;
+
+/// Changed paths above which a full scan is cheaper than per-file status
+const MAX_INCREMENTAL_PATHS: usize = 512;
+
+/// Status queries made on behalf of a caller, across all caches in the process
+static FOREGROUND_QUERIES: AtomicU64 = AtomicU64::new(0);
+
+/// Priority of a queued operation (higher runs first)
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Serialize, Deserialize)]
+pub enum OperationPriority {
+    /// Background refreshes such as periodic fetches
+    Low = -1,
+    Normal = 0,
+    /// Operations the user is waiting on
+    High = 1,
+}
+
+/// An operation claimed from the queue for execution
+#[derive(Debug, Clone)]
+pub struct QueuedOperation {
+    pub id: i64,
+    pub repo_path: String,
+    pub operation_type: String,
+    pub operation_data: String,
+    /// Attempts so far, including the one just claimed
+    pub attempts: u32,
+}
+
 /// Operation status in queue
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
 pub enum OperationStatus {
@@ -21,6 +56,18 @@ pub enum OperationStatus {
     Failed = 3,
 }
 
+/// Where a StatusCache keeps file status rows
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum CacheBackend {
+    /// `file_status` rows in the shared SQLite schema
+    #[default]
+    Sqlite,
+    /// Memory-mapped status log files in `<database>.status/` (see `status_log`)
+    ///
+    /// Repositories and the operation queue stay in SQLite.
+    Log,
+}
+
 /// Cache for file status queries
 ///
 /// Uses SQLite to store file status and avoid repeated Git queries.
@@ -28,23 +75,71 @@ pub enum OperationStatus {
 pub struct StatusCache {
     conn: Connection,
     ttl_seconds: i64,
+    log: Option<StatusLog>,
+    /// Database file (None for in-memory caches)
+    db_path: Option<PathBuf>,
+}
+
+/// Size statistics of a status cache
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct CacheStats {
+    /// Bytes in database pages holding data
+    pub used_bytes: u64,
+    /// Bytes in free pages awaiting incremental vacuum
+    pub free_bytes: u64,
+    /// Size of the write-ahead log
+    pub wal_bytes: u64,
+    /// Size of status log files (log backend only)
+    pub log_bytes: u64,
+    pub repositories: u64,
+    pub file_status_rows: u64,
+    pub queued_operations: u64,
+}
+
+impl CacheStats {
+    /// Bytes on disk across the database, its WAL and status logs
+    pub fn total_bytes(&self) -> u64 {
+        self.used_bytes + self.free_bytes + self.wal_bytes + self.log_bytes
+    }
 }
 
 impl StatusCache {
     /// Create or open a status cache database with shared schema v1.0.0
     pub fn new<P: AsRef<Path>>(path: P) -> Result<Self> {
+        Self::with_backend(path, CacheBackend::Sqlite)
+    }
+
+    /// Create or open a status cache database, storing file status in `backend`
+    pub fn with_backend<P: AsRef<Path>>(path: P, backend: CacheBackend) -> Result<Self> {
+        let path = path.as_ref();
+        let log = match backend {
+            CacheBackend::Sqlite => None,
+            CacheBackend::Log => {
+                let mut dir = path.as_os_str().to_owned();
+                dir.push(".status");
+                Some(StatusLog::open(dir)?)
+            }
+        };
+
         let conn = Connection::open(path)
             .context("Failed to open cache database")?;
 
+        // Free pages are returned by scheduled maintenance (only takes effect on new databases)
+        conn.pragma_update(None, "auto_vacuum", "INCREMENTAL")?;
+
         // Enable WAL mode for better concurrency
-        conn.execute("PRAGMA journal_mode=WAL", [])?;
-        conn.execute("PRAGMA synchronous=NORMAL", [])?;
+        conn.pragma_update(None, "journal_mode", "WAL")?;
+        conn.pragma_update(None, "synchronous", "NORMAL")?;
+        conn.busy_timeout(Duration::from_secs(5))?;
+        conn.set_prepared_statement_cache_capacity(32);
 
         Self::create_schema(&conn)?;
 
         Ok(StatusCache {
             conn,
             ttl_seconds: 1, // 1 second default for UI responsiveness
+            log,
+            db_path: (path != Path::new(":memory:")).then(|| path.to_path_buf()),
         })
     }
 
@@ -92,6 +187,17 @@ impl StatusCache {
             [],
         )?;
 
+        // Repository fingerprint table (state the cached rows were computed from)
+        conn.execute(
+            "CREATE TABLE IF NOT EXISTS repo_fingerprint (
+                repo_id INTEGER PRIMARY KEY,
+                fingerprint INTEGER NOT NULL,
+                cache_time INTEGER NOT NULL,
+                FOREIGN KEY (repo_id) REFERENCES repositories(id) ON DELETE CASCADE
+            )",
+            [],
+        )?;
+
         // Operation queue table
         conn.execute(
             "CREATE TABLE IF NOT EXISTS operation_queue (
@@ -109,6 +215,30 @@ impl StatusCache {
             [],
         )?;
 
+        // Per-connection staging table for status refreshes
+        conn.execute(
+            "CREATE TEMP TABLE IF NOT EXISTS refresh_status (
+                file_path TEXT PRIMARY KEY,
+                work_tree_status INTEGER NOT NULL,
+                file_mtime INTEGER NOT NULL
+            )",
+            [],
+        )?;
+
+        // Scheduling columns added after v1.0.0 (older databases are migrated in place)
+        Self::add_column_if_missing(conn, "operation_queue", "priority", "INTEGER NOT NULL DEFAULT 0")?;
+        Self::add_column_if_missing(conn, "operation_queue", "attempts", "INTEGER NOT NULL DEFAULT 0")?;
+        Self::add_column_if_missing(conn, "operation_queue", "not_before_ms", "INTEGER NOT NULL DEFAULT 0")?;
+
+        // Running rows belong to the scheduler that claimed them until their lease runs out
+        Self::add_column_if_missing(conn, "operation_queue", "owner", "TEXT")?;
+        Self::add_column_if_missing(conn, "operation_queue", "lease_until_ms", "INTEGER NOT NULL DEFAULT 0")?;
+
+        // Incremental refresh state: fingerprint without the working tree, and
+        // the watcher token the rows were computed at (NULL when unwatched)
+        Self::add_column_if_missing(conn, "repo_fingerprint", "state", "INTEGER NOT NULL DEFAULT 0")?;
+        Self::add_column_if_missing(conn, "repo_fingerprint", "token", "INTEGER")?;
+
         // Performance indexes
         conn.execute(
             "CREATE INDEX IF NOT EXISTS idx_file_status_cache ON file_status(cache_time)",
@@ -128,6 +258,17 @@ impl StatusCache {
         Ok(())
     }
 
+    fn add_column_if_missing(conn: &Connection, table: &str, column: &str, definition: &str) -> Result<()> {
+        let exists = conn
+            .prepare(&format!("SELECT 1 FROM pragma_table_info('{}') WHERE name = ?", table))?
+            .exists(params![column])?;
+
+        if !exists {
+            conn.execute(&format!("ALTER TABLE {} ADD COLUMN {} {}", table, column, definition), [])?;
+        }
+        Ok(())
+    }
+
     /// Get or create repository ID
     fn get_repo_id(&self, repo_path: &str) -> Result<i64> {
         let now = Self::now_timestamp();
@@ -155,21 +296,236 @@ impl StatusCache {
         Ok(self.conn.last_insert_rowid())
     }
 
-    /// Get cached status from repository with TTL check
+    /// Get cached status from repository, validated by fingerprint
+    ///
+    /// Cached rows are served while the repository fingerprint is unchanged.
+    /// `ttl_ms` only applies when no working-tree watcher backs the
+    /// fingerprint, since in-place file edits are then undetectable.
     pub fn get_cached_status(&self, repo: &Repository, ttl_ms: u64) -> Result<Vec<FileStatusEntry>> {
+        FOREGROUND_QUERIES.fetch_add(1, Ordering::Relaxed);
         let repo_path = repo.path().to_string_lossy().to_string();
         let repo_id = self.get_repo_id(&repo_path)?;
+        self.validated_status(repo, &repo_path, repo_id, ttl_ms, &ScanOptions::default())
+    }
+
+    /// Refresh a repository's cached status ahead of its first query
+    ///
+    /// Unlike `get_cached_status`, this doesn't count as an access (the
+    /// repository keeps its place in eviction order) or as foreground work.
+    /// Returns the number of cached entries.
+    pub(crate) fn warm(&self, repo: &Repository, options: &ScanOptions) -> Result<usize> {
+        let repo_path = repo.path().to_string_lossy().to_string();
+        let repo_id = self.conn.prepare_cached(
+            "SELECT id FROM repositories WHERE path = ?"
+        )?.query_row(params![repo_path], |row| row.get::<_, i64>(0))?;
+
+        Ok(self.validated_status(repo, &repo_path, repo_id, 0, options)?.len())
+    }
+
+    /// Number of foreground status queries made so far in this process
+    pub(crate) fn foreground_queries() -> u64 {
+        FOREGROUND_QUERIES.load(Ordering::Relaxed)
+    }
+
+    /// Repository paths, most recently accessed first
+    pub fn recent_repositories(&self, limit: usize) -> Result<Vec<String>> {
+        let mut stmt = self.conn.prepare_cached(
+            "SELECT path FROM repositories WHERE is_valid = 1
+             ORDER BY last_accessed DESC, id DESC LIMIT ?"
+        )?;
+        let paths = stmt.query_map(params![limit as i64], |row| row.get::<_, String>(0))?
+            .collect::<rusqlite::Result<Vec<_>>>()?;
+        Ok(paths)
+    }
+
+    /// How long to wait for other connections' locks before failing
+    pub fn set_busy_timeout(&self, timeout: Duration) -> Result<()> {
+        self.conn.busy_timeout(timeout)?;
+        Ok(())
+    }
+
+    fn validated_status(
+        &self,
+        repo: &Repository,
+        repo_path: &str,
+        repo_id: i64,
+        ttl_ms: u64,
+        options: &ScanOptions,
+    ) -> Result<Vec<FileStatusEntry>> {
+        let fingerprint = repo.fingerprint();
 
         let now = Self::now_timestamp();
         let ttl_seconds = (ttl_ms / 1000) as i64;
-        let min_time = now - ttl_seconds;
 
+        let stored = match &self.log {
+            Some(log) => log.state(repo_path)?,
+            None => self.conn.prepare_cached(
+                "SELECT fingerprint, cache_time FROM repo_fingerprint WHERE repo_id = ?"
+            )?.query_row(params![repo_id], |row| Ok((row.get::<_, i64>(0)? as u64, row.get::<_, i64>(1)?))).ok(),
+        };
+
+        let valid = match stored {
+            Some((stored, cache_time)) => {
+                fingerprint.validates(stored)
+                    || (stored == fingerprint.value && cache_time > now - ttl_seconds)
+            }
+            None => false,
+        };
+
+        // If the repository changed (or was never cached), get fresh status and cache it
+        if !valid {
+            if self.log.is_none() {
+                if let Some(entries) = self.refresh_changed(repo, repo_id, fingerprint)? {
+                    return Ok(entries);
+                }
+            }
+
+            let scan_started = SystemTime::now();
+            let fresh = repo.status_with_options(options)?;
+            match &self.log {
+                Some(log) => log.write(repo_path, &fresh, fingerprint.value, now)?,
+                None => self.cache_status(repo_id, &fresh, fingerprint, Some((repo.path(), scan_started)))?,
+            }
+            return Ok(fresh);
+        }
+
+        if let Some(log) = &self.log {
+            return log.entries(repo_path);
+        }
+
+        self.cached_entries(repo_id)
+    }
+
+    /// Re-evaluate only the files that changed since the last refresh
+    ///
+    /// Candidates are the paths the working-tree watcher reported since the
+    /// stored token, plus cached rows whose file mtime no longer matches.
+    /// Returns None when a full scan is needed instead: HEAD, index or refs
+    /// moved, the tree isn't watched, the watcher journal can't account for
+    /// every change, a directory appeared or vanished, a `.gitignore` or
+    /// `.gitattributes` changed (which can change other paths' status), or
+    /// too much changed.
+    fn refresh_changed(&self, repo: &Repository, repo_id: i64, fingerprint: RepoFingerprint) -> Result<Option<Vec<FileStatusEntry>>> {
+        let workdir = match repo.inner().workdir() {
+            Some(workdir) if fingerprint.watched => workdir,
+            _ => return Ok(None),
+        };
+
+        let stored = self.conn.prepare_cached(
+            "SELECT state, token FROM repo_fingerprint WHERE repo_id = ?"
+        )?.query_row(params![repo_id], |row| Ok((row.get::<_, i64>(0)? as u64, row.get::<_, Option<i64>>(1)?)));
+
+        let since = match stored {
+            Ok((state, Some(token))) if state == fingerprint.state => token as u64,
+            Ok(_) | Err(rusqlite::Error::QueryReturnedNoRows) => return Ok(None),
+            Err(e) => return Err(e.into()),
+        };
+        let changed = match crate::fingerprint::changed_paths(workdir, since) {
+            Some(changed) => changed,
+            None => return Ok(None),
+        };
+
+        let mut cached = HashMap::new();
+        {
+            let mut stmt = self.conn.prepare_cached(
+                "SELECT file_path, file_mtime FROM file_status WHERE repo_id = ?"
+            )?;
+            let mut rows = stmt.query(params![repo_id])?;
+            while let Some(row) = rows.next()? {
+                cached.insert(row.get::<_, String>(0)?, row.get::<_, i64>(1)?);
+            }
+        }
+
+        let mut candidates = BTreeSet::new();
+        for path in &changed {
+            match path.strip_prefix(workdir) {
+                Ok(relative) if !relative.as_os_str().is_empty() => {
+                    candidates.insert(Self::relative_key(relative));
+                }
+                _ => return Ok(None),
+            }
+        }
+        for (path, mtime) in &cached {
+            if *mtime == 0 || Self::file_mtime(&workdir.join(path), None) != *mtime {
+                candidates.insert(path.clone());
+            }
+        }
+        if candidates.len() > MAX_INCREMENTAL_PATHS {
+            return Ok(None);
+        }
+        let rules_changed = candidates.iter().any(|path| {
+            let name = path.rsplit('/').next().unwrap_or(path);
+            name == ".gitignore" || name == ".gitattributes"
+        });
+        if rules_changed {
+            return Ok(None);
+        }
+
+        let index = repo.inner().index()?;
+        let evaluated = SystemTime::now();
+        let mut updates = Vec::with_capacity(candidates.len());
+
+        for path in candidates {
+            match fs::symlink_metadata(workdir.join(&path)) {
+                Ok(meta) if meta.is_dir() => return Ok(None),
+                Ok(_) => {}
+                Err(_) => {
+                    // A removed or renamed directory is reported by its own path only
+                    let prefix = format!("{}/", path);
+                    if index.find_prefix(prefix.as_str()).is_ok()
+                        || cached.keys().any(|cached| cached.starts_with(&prefix))
+                    {
+                        return Ok(None);
+                    }
+                }
+            }
+
+            let status = match repo.inner().status_file(Path::new(&path)) {
+                Ok(status) => Repository::convert_status(status),
+                Err(e) if e.code() == git2::ErrorCode::NotFound => FileStatus::Clean,
+                Err(e) => return Err(e.into()),
+            };
+            updates.push((path, status));
+        }
+
+        let now = Self::now_timestamp();
+        let tx = self.conn.unchecked_transaction()
+            .context("Failed to begin status refresh")?;
+
+        for (path, status) in &updates {
+            if matches!(status, FileStatus::Clean | FileStatus::Ignored) {
+                tx.prepare_cached(
+                    "DELETE FROM file_status WHERE repo_id = ? AND file_path = ?"
+                )?.execute(params![repo_id, path])?;
+            } else {
+                let mtime = Self::file_mtime(&workdir.join(path), Some(evaluated));
+                tx.prepare_cached(
+                    "INSERT INTO file_status
+                     (repo_id, file_path, work_tree_status, index_status, cache_time, file_mtime)
+                     VALUES (?1, ?2, ?3, 0, ?4, ?5)
+                     ON CONFLICT (repo_id, file_path) DO UPDATE SET
+                         work_tree_status = excluded.work_tree_status,
+                         cache_time = excluded.cache_time,
+                         file_mtime = excluded.file_mtime
+                     WHERE work_tree_status <> excluded.work_tree_status
+                        OR file_mtime <> excluded.file_mtime"
+                )?.execute(params![repo_id, path, *status as i32, now, mtime])?;
+            }
+        }
+
+        Self::store_fingerprint(&tx, repo_id, fingerprint, now)?;
+        tx.commit().context("Failed to commit status refresh")?;
+
+        self.cached_entries(repo_id).map(Some)
+    }
+
+    /// All cached rows for a repository
+    fn cached_entries(&self, repo_id: i64) -> Result<Vec<FileStatusEntry>> {
         let mut stmt = self.conn.prepare_cached(
-            "SELECT file_path, work_tree_status FROM file_status
-             WHERE repo_id = ? AND cache_time > ?"
+            "SELECT file_path, work_tree_status FROM file_status WHERE repo_id = ?"
         )?;
 
-        let mut rows = stmt.query(params![repo_id, min_time])?;
+        let mut rows = stmt.query(params![repo_id])?;
         let mut entries = Vec::new();
 
         while let Some(row) = rows.next()? {
@@ -184,33 +540,180 @@ impl StatusCache {
             }
         }
 
-        // If cache is empty or expired, get fresh status and cache it
-        if entries.is_empty() {
-            let fresh = repo.status()?;
-            self.cache_status(repo_id, &fresh)?;
-            return Ok(fresh);
+        Ok(entries)
+    }
+
+    /// Replace a repository's cached status with a fresh scan
+    ///
+    /// Runs as a single transaction: unchanged rows are left untouched, changed
+    /// and new rows are upserted, and rows for files that became clean are
+    /// deleted.
+    pub fn refresh_status(&self, repo_path: &str, entries: &[FileStatusEntry], fingerprint: RepoFingerprint) -> Result<()> {
+        let repo_id = self.get_repo_id(repo_path)?;
+        match &self.log {
+            Some(log) => log.write(repo_path, entries, fingerprint.value, Self::now_timestamp()),
+            None => self.cache_status(repo_id, entries, fingerprint, None),
         }
+    }
 
-        Ok(entries)
+    /// Cached status of a single file, without validating or refreshing
+    ///
+    /// Point lookup for overlay queries. Returns None if the file has no row,
+    /// which for a cached repository means it is clean.
+    pub fn cached_file_status(&self, repo_path: &str, file_path: &str) -> Result<Option<FileStatus>> {
+        if let Some(log) = &self.log {
+            return log.lookup(repo_path, file_path);
+        }
+
+        let status = self.conn.prepare_cached(
+            "SELECT work_tree_status FROM file_status
+             WHERE repo_id = (SELECT id FROM repositories WHERE path = ?) AND file_path = ?"
+        )?.query_row(params![repo_path, file_path], |row| row.get::<_, i32>(0));
+
+        match status {
+            Ok(status) => Ok(Self::int_to_status(status)),
+            Err(rusqlite::Error::QueryReturnedNoRows) => Ok(None),
+            Err(e) => Err(e.into()),
+        }
     }
 
-    /// Cache repository status
-    fn cache_status(&self, repo_id: i64, entries: &[FileStatusEntry]) -> Result<()> {
+    /// Cache repository status, replacing any previous rows
+    ///
+    /// With `scanned`, the working tree and the time the scan started, each
+    /// row records its file's mtime so later refreshes can skip files whose
+    /// stat data is unchanged. Without it rows are re-evaluated next time.
+    fn cache_status(
+        &self,
+        repo_id: i64,
+        entries: &[FileStatusEntry],
+        fingerprint: RepoFingerprint,
+        scanned: Option<(&Path, SystemTime)>,
+    ) -> Result<()> {
         let now = Self::now_timestamp();
+        let tx = self.conn.unchecked_transaction()
+            .context("Failed to begin status refresh")?;
+
+        // Stage the fresh rows in the connection's temp table (no WAL traffic)
+        tx.prepare_cached("DELETE FROM temp.refresh_status")?.execute([])?;
+
+        let chunks = entries.chunks_exact(STAGE_BATCH_ROWS);
+        let remainder = chunks.remainder();
+        if entries.len() >= STAGE_BATCH_ROWS {
+            let mut stmt = tx.prepare_cached(&Self::stage_sql(STAGE_BATCH_ROWS))?;
+            for chunk in chunks {
+                Self::stage_rows(&mut stmt, chunk, scanned)?;
+            }
+        }
+        if !remainder.is_empty() {
+            let mut stmt = tx.prepare_cached(&Self::stage_sql(remainder.len()))?;
+            Self::stage_rows(&mut stmt, remainder, scanned)?;
+        }
 
-        for entry in entries {
-            let path = entry.path.to_string_lossy();
-            self.conn.execute(
-                "INSERT OR REPLACE INTO file_status
-                 (repo_id, file_path, work_tree_status, index_status, cache_time, file_mtime)
-                 VALUES (?, ?, ?, ?, ?, ?)",
-                params![repo_id, path.as_ref(), entry.status as i32, 0, now, now],
-            )?;
+        // Upsert only rows whose status or stat data actually changed
+        tx.prepare_cached(
+            "INSERT INTO file_status
+             (repo_id, file_path, work_tree_status, index_status, cache_time, file_mtime)
+             SELECT ?1, file_path, work_tree_status, 0, ?2, file_mtime FROM temp.refresh_status WHERE true
+             ON CONFLICT (repo_id, file_path) DO UPDATE SET
+                 work_tree_status = excluded.work_tree_status,
+                 cache_time = excluded.cache_time,
+                 file_mtime = excluded.file_mtime
+             WHERE work_tree_status <> excluded.work_tree_status
+                OR file_mtime <> excluded.file_mtime"
+        )?.execute(params![repo_id, now])?;
+
+        // Files that became clean must not linger now that rows don't expire
+        tx.prepare_cached(
+            "DELETE FROM file_status WHERE repo_id = ?
+             AND file_path NOT IN (SELECT file_path FROM temp.refresh_status)"
+        )?.execute(params![repo_id])?;
+
+        Self::store_fingerprint(&tx, repo_id, fingerprint, now)?;
+
+        tx.prepare_cached("DELETE FROM temp.refresh_status")?.execute([])?;
+
+        tx.commit().context("Failed to commit status refresh")?;
+        Ok(())
+    }
+
+    fn store_fingerprint(conn: &Connection, repo_id: i64, fingerprint: RepoFingerprint, now: i64) -> Result<()> {
+        conn.prepare_cached(
+            "INSERT OR REPLACE INTO repo_fingerprint (repo_id, fingerprint, cache_time, state, token)
+             VALUES (?, ?, ?, ?, ?)"
+        )?.execute(params![
+            repo_id,
+            fingerprint.value as i64,
+            now,
+            fingerprint.state as i64,
+            fingerprint.watched.then_some(fingerprint.token as i64),
+        ])?;
+        Ok(())
+    }
+
+    /// Multi-row insert into the staging table
+    fn stage_sql(rows: usize) -> String {
+        let mut sql = String::from(
+            "INSERT OR REPLACE INTO temp.refresh_status (file_path, work_tree_status, file_mtime) VALUES "
+        );
+        for i in 0..rows {
+            sql.push_str(if i == 0 { "(?, ?, ?)" } else { ", (?, ?, ?)" });
+        }
+        sql
+    }
+
+    fn stage_rows(
+        stmt: &mut rusqlite::Statement<'_>,
+        entries: &[FileStatusEntry],
+        scanned: Option<(&Path, SystemTime)>,
+    ) -> Result<()> {
+        let paths: Vec<_> = entries.iter().map(|e| e.path.to_string_lossy()).collect();
+        let statuses: Vec<i32> = entries.iter().map(|e| e.status as i32).collect();
+        let mtimes: Vec<i64> = match scanned {
+            Some((workdir, started)) => entries.iter()
+                .map(|e| Self::file_mtime(&workdir.join(&e.path), Some(started)))
+                .collect(),
+            None => vec![0; entries.len()],
+        };
+
+        let mut values: Vec<&dyn ToSql> = Vec::with_capacity(entries.len() * 3);
+        for ((path, status), mtime) in paths.iter().zip(&statuses).zip(&mtimes) {
+            values.push(path);
+            values.push(status);
+            values.push(mtime);
         }
 
+        stmt.execute(values.as_slice())?;
         Ok(())
     }
 
+    /// File mtime in nanoseconds, or 0 if unknown
+    ///
+    /// With `racy_after`, mtimes at or after that instant also give 0: the
+    /// file may have changed again within the same timestamp after its status
+    /// was read, so its row must not be trusted on stat data alone.
+    fn file_mtime(path: &Path, racy_after: Option<SystemTime>) -> i64 {
+        let mtime = match fs::symlink_metadata(path).and_then(|meta| meta.modified()) {
+            Ok(mtime) => mtime,
+            Err(_) => return 0,
+        };
+        if racy_after.map_or(false, |after| mtime >= after) {
+            return 0;
+        }
+        mtime.duration_since(UNIX_EPOCH)
+            .map(|d| d.as_nanos() as i64)
+            .unwrap_or(0)
+    }
+
+    /// Cache key for a path relative to the working tree
+    fn relative_key(path: &Path) -> String {
+        let key = path.to_string_lossy();
+        if cfg!(windows) {
+            key.replace('\\', "/")
+        } else {
+            key.into_owned()
+        }
+    }
+
     /// Create an in-memory cache (for testing)
     pub fn in_memory() -> Result<Self> {
         Self::new(":memory:")
@@ -222,20 +725,161 @@ impl StatusCache {
         repo_path: &str,
         operation_type: &str,
         operation_data: &str,
+    ) -> Result<i64> {
+        self.queue_operation_with_priority(repo_path, operation_type, operation_data, OperationPriority::Normal)
+    }
+
+    /// Queue an operation with an explicit priority
+    pub fn queue_operation_with_priority(
+        &self,
+        repo_path: &str,
+        operation_type: &str,
+        operation_data: &str,
+        priority: OperationPriority,
     ) -> Result<i64> {
         let repo_id = self.get_repo_id(repo_path)?;
         let now = Self::now_timestamp();
 
         self.conn.execute(
             "INSERT INTO operation_queue
-             (repo_id, operation_type, operation_data, status, created_at)
-             VALUES (?, ?, ?, ?, ?)",
-            params![repo_id, operation_type, operation_data, OperationStatus::Pending as i32, now],
+             (repo_id, operation_type, operation_data, status, created_at, priority)
+             VALUES (?, ?, ?, ?, ?, ?)",
+            params![repo_id, operation_type, operation_data, OperationStatus::Pending as i32, now, priority as i32],
         )?;
 
         Ok(self.conn.last_insert_rowid())
     }
 
+    /// Claim the next runnable operation and mark it Running
+    ///
+    /// Picks the highest priority, oldest pending operation whose retry delay
+    /// has passed, skipping repositories that already have a running
+    /// operation so work on one repository is serialized. The claim is held by
+    /// `owner` for `lease`, renewed with `renew_leases` while it runs.
+    pub fn claim_next_operation(&self, owner: &str, lease: Duration) -> Result<Option<QueuedOperation>> {
+        let now_ms = Self::now_millis();
+
+        loop {
+            let candidate = self.conn.prepare_cached(
+                "SELECT q.id, r.path, q.operation_type, q.operation_data, q.attempts
+                 FROM operation_queue q JOIN repositories r ON r.id = q.repo_id
+                 WHERE q.status = ?1 AND q.not_before_ms <= ?3
+                   AND q.repo_id NOT IN (SELECT repo_id FROM operation_queue WHERE status = ?2)
+                 ORDER BY q.priority DESC, q.created_at ASC, q.id ASC
+                 LIMIT 1"
+            )?.query_row(
+                params![OperationStatus::Pending as i32, OperationStatus::Running as i32, now_ms],
+                |row| Ok(QueuedOperation {
+                    id: row.get(0)?,
+                    repo_path: row.get(1)?,
+                    operation_type: row.get(2)?,
+                    operation_data: row.get(3)?,
+                    attempts: row.get::<_, i64>(4)? as u32 + 1,
+                }),
+            );
+
+            let operation = match candidate {
+                Ok(operation) => operation,
+                Err(rusqlite::Error::QueryReturnedNoRows) => return Ok(None),
+                Err(e) => return Err(e.into()),
+            };
+
+            // Another connection may have claimed it, or another operation on
+            // the same repository, since the SELECT; one statement re-checks both
+            let claimed = self.conn.prepare_cached(
+                "UPDATE operation_queue
+                 SET status = ?1, started_at = ?3, attempts = attempts + 1, owner = ?4, lease_until_ms = ?5
+                 WHERE id = ?6 AND status = ?2
+                   AND NOT EXISTS (
+                       SELECT 1 FROM operation_queue r
+                       WHERE r.repo_id = operation_queue.repo_id AND r.status = ?1
+                   )"
+            )?.execute(params![
+                OperationStatus::Running as i32,
+                OperationStatus::Pending as i32,
+                Self::now_timestamp(),
+                owner,
+                Self::now_millis() + lease.as_millis() as i64,
+                operation.id
+            ])?;
+
+            if claimed == 1 {
+                return Ok(Some(operation));
+            }
+        }
+    }
+
+    /// Put a failed operation back in the queue to run again after `delay`
+    pub fn retry_operation(&self, operation_id: i64, error_message: &str, delay: Duration) -> Result<()> {
+        self.conn.execute(
+            "UPDATE operation_queue
+             SET status = ?, started_at = NULL, error_message = ?, not_before_ms = ?,
+                 owner = NULL, lease_until_ms = 0
+             WHERE id = ?",
+            params![
+                OperationStatus::Pending as i32,
+                error_message,
+                Self::now_millis() + delay.as_millis() as i64,
+                operation_id
+            ],
+        )?;
+        Ok(())
+    }
+
+    /// Extend the lease on every operation `owner` is running
+    pub fn renew_leases(&self, owner: &str, lease: Duration) -> Result<usize> {
+        let renewed = self.conn.prepare_cached(
+            "UPDATE operation_queue SET lease_until_ms = ? WHERE status = ? AND owner = ?"
+        )?.execute(params![
+            Self::now_millis() + lease.as_millis() as i64,
+            OperationStatus::Running as i32,
+            owner
+        ])?;
+        Ok(renewed)
+    }
+
+    /// Requeue operations left Running by a process that exited mid-operation
+    ///
+    /// Only rows whose lease has run out are requeued; a live owner keeps
+    /// renewing its leases, so its operations are never run twice.
+    ///
+    /// # Returns
+    /// Number of operations requeued
+    pub fn recover_running_operations(&self) -> Result<usize> {
+        let recovered = self.conn.prepare_cached(
+            "UPDATE operation_queue SET status = ?, started_at = NULL, owner = NULL, lease_until_ms = 0
+             WHERE status = ? AND lease_until_ms < ?"
+        )?.execute(params![
+            OperationStatus::Pending as i32,
+            OperationStatus::Running as i32,
+            Self::now_millis()
+        ])?;
+        Ok(recovered)
+    }
+
+    /// Status, attempts and last error of an operation
+    pub fn get_operation_status(&self, operation_id: i64) -> Result<Option<(OperationStatus, u32, Option<String>)>> {
+        let row = self.conn.prepare_cached(
+            "SELECT status, attempts, error_message FROM operation_queue WHERE id = ?"
+        )?.query_row(params![operation_id], |row| {
+            Ok((row.get::<_, i32>(0)?, row.get::<_, i64>(1)?, row.get::<_, Option<String>>(2)?))
+        });
+
+        match row {
+            Ok((status, attempts, error)) => {
+                let status = match status {
+                    0 => OperationStatus::Pending,
+                    1 => OperationStatus::Running,
+                    2 => OperationStatus::Complete,
+                    _ => OperationStatus::Failed,
+                };
+                Ok(Some((status, attempts as u32, error)))
+            }
+            Err(rusqlite::Error::QueryReturnedNoRows) => Ok(None),
+            Err(e) => Err(e.into()),
+        }
+    }
+
     /// Get pending operations for a repository
     pub fn get_pending_operations(&self, repo_path: &str) -> Result<Vec<(i64, String, String)>> {
         let repo_id = self.get_repo_id(repo_path)?;
@@ -304,6 +948,15 @@ impl StatusCache {
             params![repo_id],
         )?;
 
+        self.conn.execute(
+            "DELETE FROM repo_fingerprint WHERE repo_id = ?",
+            params![repo_id],
+        )?;
+
+        if let Some(log) = &self.log {
+            log.invalidate(repo_path)?;
+        }
+
         Ok(())
     }
 
@@ -321,6 +974,142 @@ impl StatusCache {
         Ok(deleted)
     }
 
+    /// Current size statistics
+    pub fn stats(&self) -> Result<CacheStats> {
+        let (used_bytes, free_bytes) = self.page_bytes()?;
+        let count = |sql: &str| -> Result<u64> {
+            Ok(self.conn.prepare_cached(sql)?.query_row([], |row| row.get::<_, i64>(0))? as u64)
+        };
+
+        Ok(CacheStats {
+            used_bytes,
+            free_bytes,
+            wal_bytes: self.wal_bytes(),
+            log_bytes: self.log.as_ref().map_or(0, |log| log.total_bytes()),
+            repositories: count("SELECT COUNT(*) FROM repositories")?,
+            file_status_rows: count("SELECT COUNT(*) FROM file_status")?,
+            queued_operations: count("SELECT COUNT(*) FROM operation_queue WHERE status IN (0, 1)")?,
+        })
+    }
+
+    /// Evict least recently accessed repositories until the cache fits `budget_bytes`
+    ///
+    /// Counts live database pages plus status logs; free pages and the WAL are
+    /// reclaimed separately by `vacuum` and `checkpoint`. Repositories with
+    /// pending or running operations are never evicted.
+    ///
+    /// # Returns
+    /// Paths of the evicted repositories, least recently accessed first
+    pub fn evict_to_budget(&self, budget_bytes: u64) -> Result<Vec<String>> {
+        let mut evicted = Vec::new();
+
+        loop {
+            let (used_bytes, _) = self.page_bytes()?;
+            let log_bytes = self.log.as_ref().map_or(0, |log| log.total_bytes());
+            if used_bytes + log_bytes <= budget_bytes {
+                break;
+            }
+
+            let candidate = self.conn.prepare_cached(
+                "SELECT id, path FROM repositories r
+                 WHERE NOT EXISTS (
+                     SELECT 1 FROM operation_queue q WHERE q.repo_id = r.id AND q.status IN (?, ?)
+                 )
+                 ORDER BY last_accessed ASC, id ASC
+                 LIMIT 1"
+            )?.query_row(
+                params![OperationStatus::Pending as i32, OperationStatus::Running as i32],
+                |row| Ok((row.get::<_, i64>(0)?, row.get::<_, String>(1)?)),
+            );
+
+            match candidate {
+                Ok((repo_id, path)) => {
+                    self.delete_repo(repo_id, &path)?;
+                    evicted.push(path);
+                }
+                Err(rusqlite::Error::QueryReturnedNoRows) => break,
+                Err(e) => return Err(e.into()),
+            }
+        }
+
+        Ok(evicted)
+    }
+
+    /// Remove a repository and everything cached for it
+    fn delete_repo(&self, repo_id: i64, repo_path: &str) -> Result<()> {
+        // Foreign keys aren't enforced on this connection, so cascade by hand
+        let tx = self.conn.unchecked_transaction()?;
+        for sql in [
+            "DELETE FROM file_status WHERE repo_id = ?",
+            "DELETE FROM repo_status WHERE repo_id = ?",
+            "DELETE FROM repo_fingerprint WHERE repo_id = ?",
+            "DELETE FROM operation_queue WHERE repo_id = ?",
+            "DELETE FROM repositories WHERE id = ?",
+        ] {
+            tx.prepare_cached(sql)?.execute(params![repo_id])?;
+        }
+        tx.commit()?;
+
+        if let Some(log) = &self.log {
+            log.remove(repo_path)?;
+        }
+        Ok(())
+    }
+
+    /// Return up to `max_pages` free pages to the filesystem
+    ///
+    /// Databases created before incremental vacuum was enabled are converted
+    /// with a one-time full VACUUM.
+    pub fn vacuum(&self, max_pages: u32) -> Result<()> {
+        let mode: i64 = self.conn.pragma_query_value(None, "auto_vacuum", |row| row.get(0))?;
+        if mode != 2 {
+            self.conn.pragma_update(None, "auto_vacuum", "INCREMENTAL")?;
+            self.conn.execute_batch("VACUUM")?;
+            return Ok(());
+        }
+
+        self.conn.execute_batch(&format!("PRAGMA incremental_vacuum({})", max_pages))?;
+        Ok(())
+    }
+
+    /// Checkpoint the WAL into the database and truncate it
+    ///
+    /// # Returns
+    /// True if the checkpoint completed (false if readers kept it from finishing)
+    pub fn checkpoint(&self) -> Result<bool> {
+        let busy: i64 = self.conn.query_row("PRAGMA wal_checkpoint(TRUNCATE)", [], |row| row.get(0))?;
+        Ok(busy == 0)
+    }
+
+    /// (used, free) bytes of the database pages
+    fn page_bytes(&self) -> Result<(u64, u64)> {
+        let pragma = |name: &str| -> Result<u64> {
+            Ok(self.conn.pragma_query_value(None, name, |row| row.get::<_, i64>(0))? as u64)
+        };
+        let page_size = pragma("page_size")?;
+        let pages = pragma("page_count")?;
+        let free = pragma("freelist_count")?;
+
+        Ok(((pages - free) * page_size, free * page_size))
+    }
+
+    fn wal_bytes(&self) -> u64 {
+        let db_path = match &self.db_path {
+            Some(path) => path,
+            None => return 0,
+        };
+        let mut wal = db_path.as_os_str().to_owned();
+        wal.push("-wal");
+        std::fs::metadata(wal).map_or(0, |m| m.len())
+    }
+
+    fn now_millis() -> i64 {
+        SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .unwrap()
+            .as_millis() as i64
+    }
+
     fn now_timestamp() -> i64 {
         SystemTime::now()
             .duration_since(UNIX_EPOCH)
@@ -328,7 +1117,7 @@ impl StatusCache {
             .as_secs() as i64
     }
 
-    fn int_to_status(i: i32) -> Option<FileStatus> {
+    pub(crate) fn int_to_status(i: i32) -> Option<FileStatus> {
         match i {
             0 => Some(FileStatus::Clean),
             1 => Some(FileStatus::Modified),
@@ -390,6 +1179,176 @@ mod tests {
         assert_eq!(pending.len(), 1);
     }
 
+    #[test]
+    fn test_fingerprint_invalidates_status() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        git2::Repository::init(temp_dir.path()).unwrap();
+        std::fs::write(temp_dir.path().join("a.txt"), "a").unwrap();
+
+        let cache = StatusCache::in_memory().unwrap();
+        let repo = Repository::open(temp_dir.path()).unwrap();
+        assert_eq!(cache.get_cached_status(&repo, 60_000).unwrap().len(), 1);
+
+        // Staging rewrites the index, so the next query must rescan
+        repo.stage(["a.txt"]).unwrap();
+        let entries = cache.get_cached_status(&repo, 60_000).unwrap();
+        assert_eq!(entries.len(), 1);
+        assert_eq!(entries[0].status, FileStatus::Added);
+    }
+
+    #[test]
+    fn test_refresh_reevaluates_changed_paths_only() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        git2::Repository::init(temp_dir.path()).unwrap();
+        std::fs::write(temp_dir.path().join("a.txt"), "a").unwrap();
+
+        let cache = StatusCache::in_memory().unwrap();
+        let repo = Repository::open(temp_dir.path()).unwrap();
+        assert_eq!(cache.get_cached_status(&repo, 0).unwrap().len(), 1);
+
+        let before = repo.fingerprint();
+        if !before.watched {
+            return; // No watcher on this filesystem, so every refresh is a full scan
+        }
+
+        std::fs::write(temp_dir.path().join("b.txt"), "b").unwrap();
+        std::fs::remove_file(temp_dir.path().join("a.txt")).unwrap();
+
+        let workdir = repo.inner().workdir().unwrap().to_path_buf();
+        let deadline = std::time::Instant::now() + Duration::from_secs(10);
+        loop {
+            let seen = crate::fingerprint::changed_paths(&workdir, before.token).unwrap_or_default();
+            if seen.contains(&workdir.join("a.txt")) && seen.contains(&workdir.join("b.txt")) {
+                break;
+            }
+            assert!(std::time::Instant::now() < deadline, "watcher did not report the changes");
+            std::thread::sleep(Duration::from_millis(10));
+        }
+
+        let repo_id = cache.get_repo_id(&repo.path().to_string_lossy()).unwrap();
+        let entries = cache.refresh_changed(&repo, repo_id, repo.fingerprint())
+            .unwrap()
+            .expect("journal should cover the changes");
+        assert_eq!(entries.len(), 1);
+        assert_eq!(entries[0].path, PathBuf::from("b.txt"));
+        assert_eq!(entries[0].status, FileStatus::Untracked);
+
+        // An ignore file edit can change any path's status
+        let before = repo.fingerprint();
+        std::fs::write(temp_dir.path().join(".gitignore"), "b.txt\n").unwrap();
+        while !crate::fingerprint::changed_paths(&workdir, before.token).unwrap_or_default().contains(&workdir.join(".gitignore")) {
+            assert!(std::time::Instant::now() < deadline, "watcher did not report .gitignore");
+            std::thread::sleep(Duration::from_millis(10));
+        }
+        assert!(cache.refresh_changed(&repo, repo_id, repo.fingerprint()).unwrap().is_none());
+    }
+
+    #[test]
+    fn test_refresh_removes_stale_rows() {
+        let cache = StatusCache::in_memory().unwrap();
+        let entry = |path: &str, status| FileStatusEntry { path: path.into(), status };
+        let fingerprint = RepoFingerprint { value: 1, watched: false, ..Default::default() };
+
+        let first: Vec<_> = (0..600).map(|i| entry(&format!("f{}", i), FileStatus::Modified)).collect();
+        cache.refresh_status("/test/repo", &first, fingerprint).unwrap();
+
+        let second = vec![entry("f1", FileStatus::Modified), entry("f2", FileStatus::Added), entry("new", FileStatus::Untracked)];
+        cache.refresh_status("/test/repo", &second, fingerprint).unwrap();
+
+        let repo_id = cache.get_repo_id("/test/repo").unwrap();
+        let mut stmt = cache.conn.prepare(
+            "SELECT file_path, work_tree_status FROM file_status WHERE repo_id = ? ORDER BY file_path"
+        ).unwrap();
+        let rows: Vec<(String, i32)> = stmt.query_map(params![repo_id], |row| Ok((row.get(0)?, row.get(1)?)))
+            .unwrap()
+            .collect::<Result<_, _>>()
+            .unwrap();
+
+        assert_eq!(rows, vec![
+            ("f1".to_string(), FileStatus::Modified as i32),
+            ("f2".to_string(), FileStatus::Added as i32),
+            ("new".to_string(), FileStatus::Untracked as i32),
+        ]);
+    }
+
+    #[test]
+    fn test_log_backend_point_lookup() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let db = temp_dir.path().join("cache.db");
+        let fingerprint = RepoFingerprint { value: 7, watched: true, ..Default::default() };
+        let entries = vec![
+            FileStatusEntry { path: "a.txt".into(), status: FileStatus::Modified },
+            FileStatusEntry { path: "b/c.txt".into(), status: FileStatus::Untracked },
+        ];
+
+        for backend in [CacheBackend::Sqlite, CacheBackend::Log] {
+            let cache = StatusCache::with_backend(&db, backend).unwrap();
+            cache.refresh_status("/test/repo", &entries, fingerprint).unwrap();
+
+            assert_eq!(cache.cached_file_status("/test/repo", "b/c.txt").unwrap(), Some(FileStatus::Untracked));
+            assert_eq!(cache.cached_file_status("/test/repo", "clean.txt").unwrap(), None);
+
+            cache.invalidate_repo("/test/repo").unwrap();
+            assert_eq!(cache.cached_file_status("/test/repo", "a.txt").unwrap(), None);
+        }
+    }
+
+    #[test]
+    fn test_evict_to_budget() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let cache = StatusCache::new(temp_dir.path().join("cache.db")).unwrap();
+        let fingerprint = RepoFingerprint { value: 1, watched: true, ..Default::default() };
+        let entries: Vec<_> = (0..2000)
+            .map(|i| FileStatusEntry { path: format!("some/fairly/long/path/file{}.txt", i).into(), status: FileStatus::Modified })
+            .collect();
+
+        for repo in ["/repo/a", "/repo/b", "/repo/c"] {
+            cache.refresh_status(repo, &entries, fingerprint).unwrap();
+        }
+        cache.conn.execute("UPDATE repositories SET last_accessed = 100 WHERE path = '/repo/b'", []).unwrap();
+        cache.conn.execute("UPDATE repositories SET last_accessed = 200 WHERE path = '/repo/a'", []).unwrap();
+        cache.queue_operation("/repo/b", "fetch", "{}").unwrap();
+
+        // Budget for roughly one repository: /repo/b is oldest but has queued work
+        let one_repo = cache.stats().unwrap().used_bytes / 2;
+        let evicted = cache.evict_to_budget(one_repo).unwrap();
+        assert_eq!(evicted, vec!["/repo/a".to_string(), "/repo/c".to_string()]);
+
+        let stats = cache.stats().unwrap();
+        assert_eq!(stats.repositories, 1);
+        assert_eq!(stats.file_status_rows, 2000);
+        assert!(stats.free_bytes > 0);
+
+        cache.vacuum(u32::MAX).unwrap();
+        assert!(cache.checkpoint().unwrap());
+        assert_eq!(cache.stats().unwrap().free_bytes, 0);
+    }
+
+    #[test]
+    fn test_claim_serializes_repo_and_respects_leases() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let db_path = temp_dir.path().join("cache.db");
+        let first = StatusCache::new(&db_path).unwrap();
+        let second = StatusCache::new(&db_path).unwrap();
+
+        first.queue_operation("/test/repo", "push", "").unwrap();
+        first.queue_operation("/test/repo", "fetch", "").unwrap();
+
+        // One repository: the second connection can't claim while the first runs
+        let lease = Duration::from_secs(60);
+        let claimed = first.claim_next_operation("a", lease).unwrap().unwrap();
+        assert!(second.claim_next_operation("b", lease).unwrap().is_none());
+
+        // A live lease survives recovery; an expired one is requeued
+        assert_eq!(second.recover_running_operations().unwrap(), 0);
+        assert_eq!(first.renew_leases("a", Duration::ZERO).unwrap(), 1);
+        std::thread::sleep(Duration::from_millis(5));
+        assert_eq!(second.recover_running_operations().unwrap(), 1);
+        let reclaimed = second.claim_next_operation("b", lease).unwrap().unwrap();
+        assert_eq!(reclaimed.id, claimed.id);
+        assert_eq!(reclaimed.attempts, 2);
+    }
+
     #[test]
     fn test_cleanup_operations() {
         let cache = StatusCache::in_memory().unwrap();
@@ -0,0 +1,618 @@
+//! Changed-Path Bloom Filters
+//!
+//! File history normally diffs every commit's tree against its parent. A
+//! changed-path Bloom filter records, per commit, which paths differ from the
+//! first parent, so commits that cannot have touched a path are skipped
+//! without loading any trees. Filters come from git's commit-graph when it was
+//! written with `--changed-paths`; commits it doesn't cover get filters built
+//! by GitScribe and stored in `.git/gitscribe/changed-paths`. Queries use
+//! whatever filters exist; missing ones are built in the background.
+//!
+//! Each update appends a segment holding only the filters it built
+//! (`changed-paths.<sequence>`), so moving HEAD never rewrites the whole
+//! store; segments are folded back into the base file once enough pile up.
+//!
+//! Filters use git's format (murmur3, double hashing, leading directories
+//! added as their own entries), so the same lookup serves both sources.
+
+use anyhow::{bail, Context, Result};
+use git2::Oid;
+use rayon::prelude::*;
+use std::collections::HashSet;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::sync::{Mutex, OnceLock};
+use std::thread;
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use crate::commit_graph::{self, BloomSettings, CommitGraph};
+use crate::history_scan;
+
+const STORE_SIGNATURE: &[u8; 4] = b"GSCP";
+const STORE_VERSION: u8 = 1;
+const STORE_HEADER_LEN: usize = 12;
+const HASH_LEN: usize = 20;
+
+/// git's defaults for `commit-graph write --changed-paths`
+const DEFAULT_SETTINGS: BloomSettings = BloomSettings {
+    hash_version: 2,
+    num_hashes: 7,
+    bits_per_entry: 10,
+};
+/// Commits changing more paths get a filter that matches everything
+const MAX_CHANGED_PATHS: usize = 512;
+/// Segments beyond this many are folded into the base store
+const MAX_SEGMENTS: usize = 16;
+/// Tips remembered; forgetting one only makes the next update walk further
+const MAX_TIPS: usize = 32;
+
+const SEED_0: u32 = 0x293a_e76f;
+const SEED_1: u32 = 0x7e64_6e2c;
+
+/// Filters built by GitScribe for commits the commit-graph doesn't cover
+#[derive(Default)]
+struct FilterStore {
+    /// Sorted oids
+    oids: Vec<Oid>,
+    /// End offset of each oid's filter in `data`
+    ends: Vec<u32>,
+    data: Vec<u8>,
+    /// Commits whose whole ancestry has filters
+    tips: Vec<Oid>,
+}
+
+/// Changed-path filters for a repository, from every available source
+pub struct ChangedPaths {
+    graph: Option<CommitGraph>,
+    store: FilterStore,
+    store_path: PathBuf,
+    /// Segment files merged into `store`
+    segments: Vec<PathBuf>,
+}
+
+/// Bloom keys for one path (and its leading directories) under one setting
+struct BloomKey {
+    settings: BloomSettings,
+    hashes: Vec<Vec<u32>>,
+}
+
+/// Precomputed lookup keys for `ChangedPaths::maybe_changed`
+pub struct PathQuery {
+    keys: Vec<BloomKey>,
+}
+
+impl ChangedPaths {
+    /// Load the commit-graph filters and GitScribe's stored filters
+    pub fn open(repo: &git2::Repository) -> Result<Self> {
+        let graph = match CommitGraph::open(&commit_graph::objects_dir(repo.path())) {
+            Ok(graph) => graph.filter(|g| !g.bloom_settings().is_empty()),
+            Err(e) => {
+                tracing::debug!("ignoring unreadable commit-graph in {:?}: {}", repo.path(), e);
+                None
+            }
+        };
+
+        let store_path = crate::repository::common_dir(repo.path()).join("gitscribe").join("changed-paths");
+        let (store, segments) = FilterStore::load(&store_path);
+        Ok(Self { graph, store, store_path, segments })
+    }
+
+    /// True if filters are known to exist for everything reachable from `tip`
+    pub fn covers(&self, tip: Oid) -> bool {
+        if self.store.tips.contains(&tip) {
+            return true;
+        }
+        // The commit-graph is closed under ancestry
+        self.graph.as_ref().map_or(false, |graph| {
+            graph.find(&tip).and_then(|pos| graph.changed_paths_filter(pos)).is_some()
+        })
+    }
+
+    /// Build filters for commits reachable from `tip` that have none yet
+    ///
+    /// Filters are computed in parallel and persisted. Returns the number of
+    /// filters added.
+    pub fn update(&mut self, repo: &git2::Repository, tip: Oid) -> Result<usize> {
+        if self.covers(tip) {
+            return Ok(0);
+        }
+
+        let mut revwalk = repo.revwalk()?;
+        revwalk.push(tip)?;
+        let mut gone = Vec::new();
+        for known in &self.store.tips {
+            if revwalk.hide(*known).is_err() {
+                gone.push(*known);
+            }
+        }
+
+        let mut missing = Vec::new();
+        for oid in revwalk {
+            let oid = oid?;
+            if self.filter(&oid).is_none() {
+                missing.push(oid);
+            }
+        }
+
+        let git_dir = repo.path();
+        let built: Vec<(Oid, Vec<u8>)> = missing.par_iter()
+            .map_init(|| history_scan::WorkerRepo::new(git_dir), |worker, oid| worker.with(|repo| Ok((*oid, build_filter(repo, *oid)?))))
+            .collect::<Result<_>>()?;
+
+        let mut tips: Vec<Oid> = self.store.tips.iter()
+            .filter(|known| !gone.contains(known) && !repo.graph_descendant_of(tip, **known).unwrap_or(false))
+            .copied()
+            .collect();
+        tips.push(tip);
+
+        let added = built.len();
+        let segment = FilterStore::from_filters(built, vec![tip]);
+        // Only the new filters are written; earlier files keep the rest
+        let sequence = SystemTime::now().duration_since(UNIX_EPOCH)?.as_nanos();
+        let segment_path = self.store_path.with_extension(format!("{:020}", sequence));
+        write_atomic(&segment_path, &segment.serialize())?;
+        self.segments.push(segment_path);
+        self.store.merge(segment);
+        self.store.tips = tips;
+        self.store.trim_tips();
+
+        if self.segments.len() > MAX_SEGMENTS {
+            self.compact()?;
+        }
+        Ok(added)
+    }
+
+    /// Run `update` for `tip` on a background thread
+    ///
+    /// Does nothing if an update for this repository is already running.
+    pub fn update_in_background(git_dir: &Path, tip: Oid) {
+        static RUNNING: OnceLock<Mutex<HashSet<PathBuf>>> = OnceLock::new();
+        let running = RUNNING.get_or_init(|| Mutex::new(HashSet::new()));
+
+        let git_dir = git_dir.to_path_buf();
+        if !running.lock().unwrap().insert(git_dir.clone()) {
+            return;
+        }
+
+        let worker_dir = git_dir.clone();
+        let spawned = thread::Builder::new()
+            .name("gitscribe-changed-paths".to_string())
+            .spawn(move || {
+                crate::scanner::enter_background_priority();
+                let updated = git2::Repository::open(&worker_dir)
+                    .context("Failed to open repository")
+                    .and_then(|repo| ChangedPaths::open(&repo)?.update(&repo, tip));
+                if let Err(e) = updated {
+                    tracing::debug!("changed-path filter update failed for {:?}: {:#}", worker_dir, e);
+                }
+                running.lock().unwrap().remove(&worker_dir);
+            });
+        if spawned.is_err() {
+            running.lock().unwrap().remove(&git_dir);
+        }
+    }
+
+    /// Keys for looking up `path` (relative to the repository root)
+    pub fn query(&self, path: &Path) -> PathQuery {
+        let path = path.to_string_lossy().replace('\\', "/");
+        let path = path.trim_matches('/');
+
+        // git adds every leading directory of a changed path to the filter
+        let mut entries = vec![path];
+        entries.extend(path.match_indices('/').map(|(i, _)| &path[..i]));
+
+        let mut settings = vec![DEFAULT_SETTINGS];
+        if let Some(graph) = &self.graph {
+            for s in graph.bloom_settings() {
+                if !settings.contains(&s) {
+                    settings.push(s);
+                }
+            }
+        }
+
+        let keys = settings.into_iter()
+            .map(|settings| BloomKey {
+                settings,
+                hashes: entries.iter().map(|entry| bloom_hashes(entry.as_bytes(), settings)).collect(),
+            })
+            .collect();
+        PathQuery { keys }
+    }
+
+    /// False only if `oid` certainly left the path unchanged relative to its
+    /// first parent
+    pub fn maybe_changed(&self, query: &PathQuery, oid: &Oid) -> bool {
+        let (filter, settings) = match self.filter(oid) {
+            Some(found) => found,
+            None => return true,
+        };
+        match query.keys.iter().find(|key| key.settings == settings) {
+            Some(key) => key.hashes.iter().all(|hashes| filter_contains(filter, hashes)),
+            None => true,
+        }
+    }
+
+    fn filter(&self, oid: &Oid) -> Option<(&[u8], BloomSettings)> {
+        if let Some(graph) = &self.graph {
+            if let Some(found) = graph.find(oid).and_then(|pos| graph.changed_paths_filter(pos)) {
+                return Some(found);
+            }
+        }
+        self.store.find(oid).map(|filter| (filter, DEFAULT_SETTINGS))
+    }
+
+    /// Rewrite the base store with everything loaded and drop the segments
+    ///
+    /// Segments another process added since `open` are left alone. Losing a
+    /// race here only loses filters, which are rebuilt by a later update.
+    fn compact(&mut self) -> Result<()> {
+        write_atomic(&self.store_path, &self.store.serialize())?;
+        for segment in self.segments.drain(..) {
+            if let Err(e) = fs::remove_file(&segment) {
+                tracing::debug!("failed to remove filter segment {:?}: {}", segment, e);
+            }
+        }
+        Ok(())
+    }
+}
+
+/// Segment files next to the base store at `store_path`, oldest first
+fn segment_paths(store_path: &Path) -> Vec<PathBuf> {
+    let (dir, name) = match (store_path.parent(), store_path.file_name()) {
+        (Some(dir), Some(name)) => (dir, format!("{}.", name.to_string_lossy())),
+        _ => return Vec::new(),
+    };
+    let mut segments: Vec<PathBuf> = match fs::read_dir(dir) {
+        Ok(entries) => entries.filter_map(|entry| entry.ok())
+            .filter(|entry| {
+                let file_name = entry.file_name();
+                let file_name = file_name.to_string_lossy();
+                file_name.strip_prefix(&name).map_or(false, |seq| !seq.is_empty() && seq.bytes().all(|b| b.is_ascii_digit()))
+            })
+            .map(|entry| entry.path())
+            .collect(),
+        Err(_) => Vec::new(),
+    };
+    segments.sort();
+    segments
+}
+
+/// Write `data` to `path` through a temporary file only this call uses, so
+/// readers never see a partial file and concurrent writers can't collide
+fn write_atomic(path: &Path, data: &[u8]) -> Result<()> {
+    let dir = path.parent().context("Invalid filter store path")?;
+    fs::create_dir_all(dir).context("Failed to create filter directory")?;
+
+    let nanos = SystemTime::now().duration_since(UNIX_EPOCH)?.as_nanos();
+    let temp_path = path.with_extension(format!("{}-{}.tmp", std::process::id(), nanos));
+    fs::write(&temp_path, data).context("Failed to write changed-path filters")?;
+    fs::rename(&temp_path, path).map_err(|e| {
+        let _ = fs::remove_file(&temp_path);
+        e
+    }).context("Failed to replace changed-path filters")?;
+    Ok(())
+}
+
+impl FilterStore {
+    /// Load the store at `path`, or None if it's missing or unreadable
+    fn read(path: &Path) -> Option<Self> {
+        let data = fs::read(path).ok()?;
+        match Self::parse(&data) {
+            Ok(store) => Some(store),
+            Err(e) => {
+                tracing::debug!("ignoring changed-path filters {:?}: {}", path, e);
+                None
+            }
+        }
+    }
+
+    /// The base store at `store_path` with its segments merged in, and the
+    /// segment paths
+    fn load(store_path: &Path) -> (Self, Vec<PathBuf>) {
+        let mut store = Self::read(store_path).unwrap_or_default();
+        let segments = segment_paths(store_path);
+        for segment in &segments {
+            if let Some(segment) = Self::read(segment) {
+                store.merge(segment);
+            }
+        }
+        (store, segments)
+    }
+
+    fn from_filters(mut filters: Vec<(Oid, Vec<u8>)>, tips: Vec<Oid>) -> Self {
+        filters.sort_by(|a, b| a.0.cmp(&b.0));
+        let mut store = Self::default();
+        for (oid, filter) in filters {
+            store.push(oid, &filter);
+        }
+        store.tips = tips;
+        store
+    }
+
+    fn parse(data: &[u8]) -> Result<Self> {
+        if data.len() < STORE_HEADER_LEN + 4 || &data[0..4] != STORE_SIGNATURE {
+            bail!("Bad filter store signature");
+        }
+        if data[4] != STORE_VERSION
+            || [data[5] as u32, data[6] as u32, data[7] as u32]
+                != [DEFAULT_SETTINGS.hash_version, DEFAULT_SETTINGS.num_hashes, DEFAULT_SETTINGS.bits_per_entry]
+        {
+            bail!("Unsupported filter store version");
+        }
+
+        let count = be_u32(data, 8) as usize;
+        let num_tips = be_u32(data, STORE_HEADER_LEN) as usize;
+        let tips_start = STORE_HEADER_LEN + 4;
+        let oids_start = tips_start + num_tips * HASH_LEN;
+        let ends_start = oids_start + count * HASH_LEN;
+        let data_start = ends_start + count * 4;
+        if data.len() < data_start {
+            bail!("Truncated filter store");
+        }
+
+        let oid_at = |start: usize, i: usize| Oid::from_bytes(&data[start + i * HASH_LEN..start + (i + 1) * HASH_LEN]);
+        let tips = (0..num_tips).map(|i| oid_at(tips_start, i)).collect::<Result<_, _>>()?;
+        let oids = (0..count).map(|i| oid_at(oids_start, i)).collect::<Result<_, _>>()?;
+        let ends: Vec<u32> = (0..count).map(|i| be_u32(data, ends_start + i * 4)).collect();
+
+        let filters = data[data_start..].to_vec();
+        if ends.last().map_or(false, |end| *end as usize > filters.len()) {
+            bail!("Truncated filter store");
+        }
+
+        Ok(Self { oids, ends, data: filters, tips })
+    }
+
+    fn serialize(&self) -> Vec<u8> {
+        let mut out = Vec::with_capacity(STORE_HEADER_LEN + 4 + (self.tips.len() + self.oids.len()) * HASH_LEN + self.ends.len() * 4 + self.data.len());
+        out.extend_from_slice(STORE_SIGNATURE);
+        out.extend_from_slice(&[
+            STORE_VERSION,
+            DEFAULT_SETTINGS.hash_version as u8,
+            DEFAULT_SETTINGS.num_hashes as u8,
+            DEFAULT_SETTINGS.bits_per_entry as u8,
+        ]);
+        out.extend_from_slice(&(self.oids.len() as u32).to_be_bytes());
+        out.extend_from_slice(&(self.tips.len() as u32).to_be_bytes());
+        for tip in &self.tips {
+            out.extend_from_slice(tip.as_bytes());
+        }
+        for oid in &self.oids {
+            out.extend_from_slice(oid.as_bytes());
+        }
+        for end in &self.ends {
+            out.extend_from_slice(&end.to_be_bytes());
+        }
+        out.extend_from_slice(&self.data);
+        out
+    }
+
+    fn find(&self, oid: &Oid) -> Option<&[u8]> {
+        let i = self.oids.binary_search(oid).ok()?;
+        let start = if i == 0 { 0 } else { self.ends[i - 1] as usize };
+        Some(&self.data[start..self.ends[i] as usize])
+    }
+
+    /// Add `newer`'s filters (keeping the oid table sorted) and its tips
+    fn merge(&mut self, newer: FilterStore) {
+        let old = std::mem::take(self);
+        let entry = |store: &FilterStore, i: usize| {
+            let start = if i == 0 { 0 } else { store.ends[i - 1] as usize };
+            (store.oids[i], start..store.ends[i] as usize)
+        };
+
+        let (mut i, mut j) = (0, 0);
+        while i < old.oids.len() || j < newer.oids.len() {
+            let take_old = j == newer.oids.len() || (i < old.oids.len() && old.oids[i] <= newer.oids[j]);
+            if take_old {
+                let (oid, range) = entry(&old, i);
+                self.push(oid, &old.data[range]);
+                if j < newer.oids.len() && newer.oids[j] == oid {
+                    j += 1;
+                }
+                i += 1;
+            } else {
+                let (oid, range) = entry(&newer, j);
+                self.push(oid, &newer.data[range]);
+                j += 1;
+            }
+        }
+
+        self.tips = old.tips;
+        self.tips.retain(|tip| !newer.tips.contains(tip));
+        self.tips.extend(newer.tips);
+        self.trim_tips();
+    }
+
+    /// Keep only the newest `MAX_TIPS` tips
+    fn trim_tips(&mut self) {
+        let excess = self.tips.len().saturating_sub(MAX_TIPS);
+        self.tips.drain(..excess);
+    }
+
+    fn push(&mut self, oid: Oid, filter: &[u8]) {
+        self.data.extend_from_slice(filter);
+        self.oids.push(oid);
+        self.ends.push(self.data.len() as u32);
+    }
+}
+
+/// Build the filter of paths `oid` changed relative to its first parent
+fn build_filter(repo: &git2::Repository, oid: Oid) -> Result<Vec<u8>> {
+    let commit = repo.find_commit(oid)?;
+    let tree = commit.tree()?;
+    let parent_tree = match commit.parents().next() {
+        Some(parent) => Some(parent.tree()?),
+        None => None,
+    };
+
+    let mut opts = git2::DiffOptions::new();
+    opts.skip_binary_check(true);
+    let diff = repo.diff_tree_to_tree(parent_tree.as_ref(), Some(&tree), Some(&mut opts))?;
+
+    let mut entries: HashSet<&[u8]> = HashSet::new();
+    for delta in diff.deltas() {
+        let path = match delta.new_file().path_bytes().or_else(|| delta.old_file().path_bytes()) {
+            Some(path) => path,
+            None => continue,
+        };
+        entries.insert(path);
+        for (i, byte) in path.iter().enumerate() {
+            if *byte == b'/' {
+                entries.insert(&path[..i]);
+            }
+        }
+        if entries.len() > MAX_CHANGED_PATHS {
+            return Ok(vec![0xff]);
+        }
+    }
+
+    let bits = entries.len() * DEFAULT_SETTINGS.bits_per_entry as usize;
+    let mut filter = vec![0u8; ((bits + 7) / 8).max(1)];
+    for entry in entries {
+        for hash in bloom_hashes(entry, DEFAULT_SETTINGS) {
+            let bit = (hash as u64 % (filter.len() as u64 * 8)) as usize;
+            filter[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+    Ok(filter)
+}
+
+/// git's `fill_bloom_key`: double hashing over two murmur3 seeds
+fn bloom_hashes(entry: &[u8], settings: BloomSettings) -> Vec<u32> {
+    let signed = settings.hash_version == 1;
+    let h0 = murmur3(SEED_0, entry, signed);
+    let h1 = murmur3(SEED_1, entry, signed);
+    (0..settings.num_hashes).map(|i| h0.wrapping_add(i.wrapping_mul(h1))).collect()
+}
+
+fn filter_contains(filter: &[u8], hashes: &[u32]) -> bool {
+    // An empty filter says nothing
+    if filter.is_empty() {
+        return true;
+    }
+    let bits = filter.len() as u64 * 8;
+    hashes.iter().all(|hash| {
+        let bit = (*hash as u64 % bits) as usize;
+        filter[bit / 8] & (1 << (bit % 8)) != 0
+    })
+}
+
+/// 32-bit murmur3; `signed` reproduces version 1 filters, which sign-extend
+/// bytes above 0x7f
+fn murmur3(seed: u32, data: &[u8], signed: bool) -> u32 {
+    const C1: u32 = 0xcc9e_2d51;
+    const C2: u32 = 0x1b87_3593;
+
+    let byte = |b: u8| if signed { b as i8 as i32 as u32 } else { b as u32 };
+    let mut h = seed;
+
+    let mut blocks = data.chunks_exact(4);
+    for block in &mut blocks {
+        let mut k = byte(block[0]) | byte(block[1]) << 8 | byte(block[2]) << 16 | byte(block[3]) << 24;
+        k = k.wrapping_mul(C1).rotate_left(15).wrapping_mul(C2);
+        h ^= k;
+        h = h.rotate_left(13).wrapping_mul(5).wrapping_add(0xe654_6b64);
+    }
+
+    let tail = blocks.remainder();
+    if !tail.is_empty() {
+        let mut k = 0u32;
+        for (i, b) in tail.iter().enumerate().rev() {
+            k ^= byte(*b) << (8 * i);
+        }
+        k = k.wrapping_mul(C1).rotate_left(15).wrapping_mul(C2);
+        h ^= k;
+    }
+
+    h ^= data.len() as u32;
+    h ^= h >> 16;
+    h = h.wrapping_mul(0x85eb_ca6b);
+    h ^= h >> 13;
+    h = h.wrapping_mul(0xc2b2_ae35);
+    h ^= h >> 16;
+    h
+}
+
+fn be_u32(data: &[u8], offset: usize) -> u32 {
+    u32::from_be_bytes([data[offset], data[offset + 1], data[offset + 2], data[offset + 3]])
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_murmur3_matches_git() {
+        // Vectors from git's t0095-bloom.sh
+        assert_eq!(murmur3(0, b"", false), 0x0000_0000);
+        assert_eq!(murmur3(0, b"Hello world!", false), 0x627b_0c2c);
+        assert_eq!(murmur3(0, b"The quick brown fox jumps over the lazy dog", false), 0x2e4f_f723);
+    }
+
+    #[test]
+    fn test_filters_skip_untouched_commits() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        let sig = git2::Signature::now("Test", "test@example.com").unwrap();
+        fs::create_dir_all(temp_dir.path().join("src")).unwrap();
+
+        let mut commits = Vec::new();
+        for (i, name) in ["src/lib.rs", "README.md", "src/lib.rs", "src/main.rs"].iter().enumerate() {
+            fs::write(temp_dir.path().join(name), format!("{}", i)).unwrap();
+            let mut index = repo.index().unwrap();
+            index.add_path(Path::new(name)).unwrap();
+            let tree = repo.find_tree(index.write_tree().unwrap()).unwrap();
+            let parent = commits.last().map(|oid| repo.find_commit(*oid).unwrap());
+            let parents: Vec<_> = parent.iter().collect();
+            commits.push(repo.commit(Some("HEAD"), &sig, &sig, name, &tree, &parents).unwrap());
+        }
+
+        let head = *commits.last().unwrap();
+        let mut filters = ChangedPaths::open(&repo).unwrap();
+        assert!(!filters.covers(head));
+        assert_eq!(filters.update(&repo, head).unwrap(), 4);
+
+        // Reopen to read back the persisted store
+        let mut filters = ChangedPaths::open(&repo).unwrap();
+        assert!(filters.covers(head));
+        assert_eq!(filters.update(&repo, head).unwrap(), 0);
+        let lib = filters.query(Path::new("src/lib.rs"));
+        let src = filters.query(Path::new("src"));
+        assert!(filters.maybe_changed(&lib, &commits[0]));
+        assert!(filters.maybe_changed(&lib, &commits[2]));
+        assert!(filters.maybe_changed(&src, &commits[3]));
+        // README.md's filter has 7 of 16 bits set and none of lib.rs's keys
+        assert!(!filters.maybe_changed(&lib, &commits[1]));
+    }
+
+    #[test]
+    fn test_segments_merge_and_compact() {
+        let temp_dir = TempDir::new().unwrap();
+        let store_path = temp_dir.path().join("changed-paths");
+        let oid = |i: u8| Oid::from_bytes(&[i; HASH_LEN]).unwrap();
+
+        // Segments written out of oid order, one overlapping an earlier one
+        for (seq, oids) in [(1, [5, 1]), (2, [3, 9]), (3, [9, 7])] {
+            let filters = oids.iter().map(|i| (oid(*i), vec![*i])).collect();
+            let segment = FilterStore::from_filters(filters, vec![oid(oids[0])]);
+            write_atomic(&store_path.with_extension(format!("{:020}", seq)), &segment.serialize()).unwrap();
+        }
+        fs::write(temp_dir.path().join("changed-paths.1-2.tmp"), b"partial").unwrap();
+
+        let (store, segments) = FilterStore::load(&store_path);
+        assert_eq!(segments.len(), 3);
+        assert_eq!(store.oids, [1, 3, 5, 7, 9].map(oid));
+        assert_eq!(store.find(&oid(7)), Some(&[7u8][..]));
+        assert_eq!(store.tips, [oid(5), oid(3), oid(9)]);
+
+        let mut paths = ChangedPaths { graph: None, store, store_path: store_path.clone(), segments };
+        paths.compact().unwrap();
+        assert!(segment_paths(&store_path).is_empty());
+        let (compacted, _) = FilterStore::load(&store_path);
+        assert_eq!(compacted.oids, paths.store.oids);
+        assert_eq!(compacted.data, paths.store.data);
+        assert_eq!(compacted.tips, paths.store.tips);
+    }
+}
@@ -0,0 +1,447 @@
+//! Commit-Graph Reader
+//!
+//! Reads git's serialized commit-graph (`objects/info/commit-graph` or a split
+//! `commit-graphs/commit-graph-chain`) so reachability queries can walk parents
+//! and generation numbers without decoding commit objects, and file history
+//! can use the changed-path Bloom filters written by
+//! `git commit-graph write --changed-paths`.
+
+use anyhow::{bail, Context, Result};
+use git2::Oid;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::time::SystemTime;
+
+const SIGNATURE: &[u8; 4] = b"CGPH";
+const CHUNK_OID_FANOUT: u32 = 0x4f49_4446; // "OIDF"
+const CHUNK_OID_LOOKUP: u32 = 0x4f49_444c; // "OIDL"
+const CHUNK_COMMIT_DATA: u32 = 0x4344_4154; // "CDAT"
+const CHUNK_EXTRA_EDGES: u32 = 0x4544_4745; // "EDGE"
+const CHUNK_BLOOM_INDEXES: u32 = 0x4249_4458; // "BIDX"
+const CHUNK_BLOOM_DATA: u32 = 0x4244_4154; // "BDAT"
+
+/// BDAT starts with hash version, hash count and bits per entry
+const BLOOM_HEADER_LEN: usize = 12;
+
+const PARENT_NONE: u32 = 0x7000_0000;
+const PARENT_OCTOPUS: u32 = 0x8000_0000;
+const EDGE_LAST: u32 = 0x8000_0000;
+
+/// Only SHA-1 graphs are supported (git2 cannot open SHA-256 repositories)
+const HASH_LEN: usize = 20;
+const COMMIT_DATA_LEN: usize = HASH_LEN + 16;
+
+/// One file of a (possibly split) commit-graph
+struct GraphLayer {
+    data: Vec<u8>,
+    num_commits: u32,
+    /// Global position of this layer's first commit
+    base: u32,
+    fanout: usize,
+    oid_lookup: usize,
+    commit_data: usize,
+    extra_edges: Option<(usize, usize)>,
+    /// BIDX start, BDAT filter bytes and settings, if the layer has filters
+    bloom: Option<(usize, (usize, usize), BloomSettings)>,
+}
+
+/// A parsed commit-graph, including every layer of a split chain
+pub struct CommitGraph {
+    layers: Vec<GraphLayer>,
+    files: Vec<(PathBuf, Option<SystemTime>)>,
+}
+
+/// Parameters of a changed-path Bloom filter
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct BloomSettings {
+    /// 1 hashes bytes as signed chars (git's original bug), 2 as unsigned
+    pub hash_version: u32,
+    pub num_hashes: u32,
+    pub bits_per_entry: u32,
+}
+
+/// Per-commit data stored in the graph
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct GraphCommit {
+    /// Topological level (1 for root commits); 0 means the writer did not compute it
+    pub generation: u32,
+    pub commit_time: u64,
+}
+
+impl CommitGraph {
+    /// Load the commit-graph for an objects directory
+    ///
+    /// Returns `Ok(None)` when the repository has no commit-graph.
+    pub fn open(objects_dir: &Path) -> Result<Option<Self>> {
+        let info_dir = objects_dir.join("info");
+        let single = info_dir.join("commit-graph");
+        let chain = info_dir.join("commit-graphs").join("commit-graph-chain");
+
+        let paths: Vec<PathBuf> = if chain.exists() {
+            fs::read_to_string(&chain)
+                .context("Failed to read commit-graph chain")?
+                .lines()
+                .map(str::trim)
+                .filter(|l| !l.is_empty())
+                .map(|hash| info_dir.join("commit-graphs").join(format!("graph-{}.graph", hash)))
+                .collect()
+        } else if single.exists() {
+            vec![single]
+        } else {
+            return Ok(None);
+        };
+
+        let mut layers = Vec::with_capacity(paths.len());
+        let mut files = Vec::with_capacity(paths.len() + 1);
+        let mut base = 0u32;
+
+        for path in paths {
+            let data = fs::read(&path)
+                .with_context(|| format!("Failed to read commit-graph {:?}", path))?;
+            let layer = GraphLayer::parse(data, base)
+                .with_context(|| format!("Invalid commit-graph {:?}", path))?;
+            base += layer.num_commits;
+            files.push((path.clone(), modified_time(&path)));
+            layers.push(layer);
+        }
+
+        if chain.exists() {
+            files.push((chain.clone(), modified_time(&chain)));
+        }
+
+        Ok(Some(CommitGraph { layers, files }))
+    }
+
+    /// Whether any file backing this graph changed since it was loaded
+    pub fn is_stale(&self) -> bool {
+        self.files.iter().any(|(path, mtime)| modified_time(path) != *mtime)
+    }
+
+    /// Total number of commits across all layers
+    pub fn num_commits(&self) -> u32 {
+        self.layers.iter().map(|l| l.num_commits).sum()
+    }
+
+    /// Find the global graph position of a commit
+    pub fn find(&self, oid: &Oid) -> Option<u32> {
+        // Later layers hold newer commits, so search them first
+        self.layers.iter().rev()
+            .find_map(|layer| layer.find(oid.as_bytes()).map(|local| layer.base + local))
+    }
+
+    /// Get the object id stored at a graph position
+    pub fn oid_at(&self, pos: u32) -> Option<Oid> {
+        let (layer, local) = self.locate(pos)?;
+        Oid::from_bytes(layer.oid_bytes(local)).ok()
+    }
+
+    /// Get generation and commit time for a graph position
+    pub fn commit(&self, pos: u32) -> Option<GraphCommit> {
+        let (layer, local) = self.locate(pos)?;
+        let entry = layer.commit_entry(local);
+        let word = be_u32(entry, HASH_LEN + 8);
+        let low = be_u32(entry, HASH_LEN + 12);
+
+        Some(GraphCommit {
+            generation: word >> 2,
+            commit_time: (((word & 0x3) as u64) << 32) | low as u64,
+        })
+    }
+
+    /// Get the parent positions of a graph position
+    pub fn parents(&self, pos: u32) -> Result<Vec<u32>> {
+        let (layer, local) = self.locate(pos).context("Graph position out of range")?;
+        let entry = layer.commit_entry(local);
+        let first = be_u32(entry, HASH_LEN);
+        let second = be_u32(entry, HASH_LEN + 4);
+
+        let mut parents = Vec::with_capacity(2);
+        if first == PARENT_NONE {
+            return Ok(parents);
+        }
+        parents.push(first);
+
+        if second == PARENT_NONE {
+            return Ok(parents);
+        }
+
+        if second & PARENT_OCTOPUS == 0 {
+            parents.push(second);
+            return Ok(parents);
+        }
+
+        // Octopus merge: remaining parents live in the extra edge list
+        let (start, end) = layer.extra_edges.context("Octopus commit without EDGE chunk")?;
+        let mut index = (second & !PARENT_OCTOPUS) as usize;
+        loop {
+            let offset = start + index * 4;
+            if offset + 4 > end {
+                bail!("Extra edge index out of range");
+            }
+            let edge = be_u32(&layer.data, offset);
+            parents.push(edge & !EDGE_LAST);
+            if edge & EDGE_LAST != 0 {
+                break;
+            }
+            index += 1;
+        }
+
+        Ok(parents)
+    }
+
+    /// Get the changed-path Bloom filter for a graph position
+    ///
+    /// Returns None when the layer holding the commit was written without
+    /// `--changed-paths`.
+    pub fn changed_paths_filter(&self, pos: u32) -> Option<(&[u8], BloomSettings)> {
+        let (layer, local) = self.locate(pos)?;
+        let (index, (start, end), settings) = layer.bloom?;
+
+        let filter_start = if local == 0 { 0 } else { be_u32(&layer.data, index + (local as usize - 1) * 4) as usize };
+        let filter_end = be_u32(&layer.data, index + local as usize * 4) as usize;
+        if filter_start > filter_end || start + filter_end > end {
+            return None;
+        }
+        Some((&layer.data[start + filter_start..start + filter_end], settings))
+    }
+
+    /// Distinct Bloom filter settings across layers
+    pub fn bloom_settings(&self) -> Vec<BloomSettings> {
+        let mut settings: Vec<BloomSettings> = Vec::new();
+        for (_, _, s) in self.layers.iter().filter_map(|l| l.bloom) {
+            if !settings.contains(&s) {
+                settings.push(s);
+            }
+        }
+        settings
+    }
+
+    fn locate(&self, pos: u32) -> Option<(&GraphLayer, u32)> {
+        self.layers.iter()
+            .find(|l| pos >= l.base && pos < l.base + l.num_commits)
+            .map(|l| (l, pos - l.base))
+    }
+}
+
+impl GraphLayer {
+    fn parse(data: Vec<u8>, base: u32) -> Result<Self> {
+        if data.len() < 8 || &data[0..4] != SIGNATURE {
+            bail!("Bad commit-graph signature");
+        }
+        if data[4] != 1 {
+            bail!("Unsupported commit-graph version {}", data[4]);
+        }
+        if data[5] != 1 {
+            bail!("Unsupported commit-graph hash version {}", data[5]);
+        }
+
+        let num_chunks = data[6] as usize;
+        let toc_end = 8 + (num_chunks + 1) * 12;
+        if data.len() < toc_end {
+            bail!("Truncated chunk table");
+        }
+
+        let mut fanout = None;
+        let mut oid_lookup = None;
+        let mut commit_data = None;
+        let mut extra_edges = None;
+        let mut bloom_indexes = None;
+        let mut bloom_data = None;
+
+        for i in 0..num_chunks {
+            let entry = 8 + i * 12;
+            let id = be_u32(&data, entry);
+            let start = be_u64(&data, entry + 4) as usize;
+            let end = be_u64(&data, entry + 16) as usize;
+            if start > end || end > data.len() {
+                bail!("Chunk {:08x} out of bounds", id);
+            }
+
+            match id {
+                CHUNK_OID_FANOUT => fanout = Some(start),
+                CHUNK_OID_LOOKUP => oid_lookup = Some(start),
+                CHUNK_COMMIT_DATA => commit_data = Some(start),
+                CHUNK_EXTRA_EDGES => extra_edges = Some((start, end)),
+                CHUNK_BLOOM_INDEXES => bloom_indexes = Some((start, end)),
+                CHUNK_BLOOM_DATA => bloom_data = Some((start, end)),
+                _ => {}
+            }
+        }
+
+        let fanout = fanout.context("Missing OIDF chunk")?;
+        let oid_lookup = oid_lookup.context("Missing OIDL chunk")?;
+        let commit_data = commit_data.context("Missing CDAT chunk")?;
+
+        if fanout + 256 * 4 > data.len() {
+            bail!("Truncated OIDF chunk");
+        }
+        let num_commits = be_u32(&data, fanout + 255 * 4);
+
+        if oid_lookup + num_commits as usize * HASH_LEN > data.len()
+            || commit_data + num_commits as usize * COMMIT_DATA_LEN > data.len()
+        {
+            bail!("Truncated commit-graph");
+        }
+
+        // Filters are optional; a malformed pair is ignored rather than fatal
+        let bloom = match (bloom_indexes, bloom_data) {
+            (Some((index, index_end)), Some((start, end)))
+                if index_end - index >= num_commits as usize * 4 && end - start >= BLOOM_HEADER_LEN =>
+            {
+                let settings = BloomSettings {
+                    hash_version: be_u32(&data, start),
+                    num_hashes: be_u32(&data, start + 4),
+                    bits_per_entry: be_u32(&data, start + 8),
+                };
+                match settings.hash_version {
+                    1 | 2 if settings.num_hashes > 0 => Some((index, (start + BLOOM_HEADER_LEN, end), settings)),
+                    _ => None,
+                }
+            }
+            _ => None,
+        };
+
+        Ok(GraphLayer {
+            data,
+            num_commits,
+            base,
+            fanout,
+            oid_lookup,
+            commit_data,
+            extra_edges,
+            bloom,
+        })
+    }
+
+    fn find(&self, oid: &[u8]) -> Option<u32> {
+        let first = oid[0] as usize;
+        let lo = if first == 0 { 0 } else { be_u32(&self.data, self.fanout + (first - 1) * 4) };
+        let hi = be_u32(&self.data, self.fanout + first * 4);
+
+        let (mut lo, mut hi) = (lo, hi);
+        while lo < hi {
+            let mid = lo + (hi - lo) / 2;
+            match self.oid_bytes(mid).cmp(oid) {
+                std::cmp::Ordering::Less => lo = mid + 1,
+                std::cmp::Ordering::Greater => hi = mid,
+                std::cmp::Ordering::Equal => return Some(mid),
+            }
+        }
+        None
+    }
+
+    fn oid_bytes(&self, local: u32) -> &[u8] {
+        let start = self.oid_lookup + local as usize * HASH_LEN;
+        &self.data[start..start + HASH_LEN]
+    }
+
+    fn commit_entry(&self, local: u32) -> &[u8] {
+        let start = self.commit_data + local as usize * COMMIT_DATA_LEN;
+        &self.data[start..start + COMMIT_DATA_LEN]
+    }
+}
+
+/// Resolve the shared objects directory for a git directory (handles linked worktrees)
+pub fn objects_dir(git_dir: &Path) -> PathBuf {
+    crate::repository::common_dir(git_dir).join("objects")
+}
+
+fn modified_time(path: &Path) -> Option<SystemTime> {
+    fs::metadata(path).and_then(|m| m.modified()).ok()
+}
+
+fn be_u32(data: &[u8], offset: usize) -> u32 {
+    u32::from_be_bytes([data[offset], data[offset + 1], data[offset + 2], data[offset + 3]])
+}
+
+fn be_u64(data: &[u8], offset: usize) -> u64 {
+    let mut bytes = [0u8; 8];
+    bytes.copy_from_slice(&data[offset..offset + 8]);
+    u64::from_be_bytes(bytes)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    /// Build a minimal single-layer graph: root <- child
+    fn write_test_graph(objects_dir: &Path, root: Oid, child: Oid) {
+        let mut oids = vec![root, child];
+        oids.sort();
+        let root_pos = oids.iter().position(|o| *o == root).unwrap() as u32;
+
+        let mut fanout = vec![0u32; 256];
+        for oid in &oids {
+            for slot in fanout.iter_mut().skip(oid.as_bytes()[0] as usize) {
+                *slot += 1;
+            }
+        }
+
+        let mut oidl = Vec::new();
+        let mut cdat = Vec::new();
+        for oid in &oids {
+            oidl.extend_from_slice(oid.as_bytes());
+            cdat.extend_from_slice(&[0u8; HASH_LEN]);
+            let (parent, generation, time) = if *oid == root {
+                (PARENT_NONE, 1u32, 100u32)
+            } else {
+                (root_pos, 2u32, 200u32)
+            };
+            cdat.extend_from_slice(&parent.to_be_bytes());
+            cdat.extend_from_slice(&PARENT_NONE.to_be_bytes());
+            cdat.extend_from_slice(&(generation << 2).to_be_bytes());
+            cdat.extend_from_slice(&time.to_be_bytes());
+        }
+
+        let chunks: Vec<(u32, Vec<u8>)> = vec![
+            (CHUNK_OID_FANOUT, fanout.iter().flat_map(|c| c.to_be_bytes()).collect()),
+            (CHUNK_OID_LOOKUP, oidl),
+            (CHUNK_COMMIT_DATA, cdat),
+        ];
+
+        let mut file = Vec::new();
+        file.extend_from_slice(SIGNATURE);
+        file.extend_from_slice(&[1, 1, chunks.len() as u8, 0]);
+        let mut offset = (8 + (chunks.len() + 1) * 12) as u64;
+        for (id, body) in &chunks {
+            file.extend_from_slice(&id.to_be_bytes());
+            file.extend_from_slice(&offset.to_be_bytes());
+            offset += body.len() as u64;
+        }
+        file.extend_from_slice(&0u32.to_be_bytes());
+        file.extend_from_slice(&offset.to_be_bytes());
+        for (_, body) in &chunks {
+            file.extend_from_slice(body);
+        }
+
+        fs::create_dir_all(objects_dir.join("info")).unwrap();
+        fs::write(objects_dir.join("info").join("commit-graph"), file).unwrap();
+    }
+
+    #[test]
+    fn test_missing_graph() {
+        let temp_dir = TempDir::new().unwrap();
+        assert!(CommitGraph::open(temp_dir.path()).unwrap().is_none());
+    }
+
+    #[test]
+    fn test_parse_graph() {
+        let temp_dir = TempDir::new().unwrap();
+        let root = Oid::from_str("1111111111111111111111111111111111111111").unwrap();
+        let child = Oid::from_str("0222222222222222222222222222222222222222").unwrap();
+        write_test_graph(temp_dir.path(), root, child);
+
+        let graph = CommitGraph::open(temp_dir.path()).unwrap().unwrap();
+        assert_eq!(graph.num_commits(), 2);
+
+        let child_pos = graph.find(&child).unwrap();
+        let root_pos = graph.find(&root).unwrap();
+        assert_eq!(graph.oid_at(child_pos), Some(child));
+        assert_eq!(graph.parents(child_pos).unwrap(), vec![root_pos]);
+        assert!(graph.parents(root_pos).unwrap().is_empty());
+        assert_eq!(graph.commit(child_pos).unwrap().generation, 2);
+        assert_eq!(graph.commit(root_pos).unwrap().commit_time, 100);
+        assert!(!graph.is_stale());
+    }
+}
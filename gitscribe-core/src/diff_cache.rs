@@ -0,0 +1,387 @@
+//! Commit Diff Cache
+//!
+//! A commit's diff against its first parent never changes, so it is computed
+//! once per (oid, options) and kept in two tiers: a process-wide LRU for the
+//! commits being browsed, and a SQLite table under `.git/gitscribe/diffs.db`
+//! that survives restarts. Both tiers have a byte budget and drop their least
+//! recently used diffs to stay within it. A background worker fills both for
+//! the commits the history view is about to show.
+
+use anyhow::{Context, Result};
+use git2::Oid;
+use rusqlite::{params, Connection, OptionalExtension};
+use std::collections::{HashMap, VecDeque};
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::sync::{mpsc, Mutex, OnceLock};
+use std::thread;
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+
+use crate::history::{self, CommitDiffOptions, DiffStats, FileChange};
+
+/// Diffs kept in memory
+const MAX_ENTRIES: usize = 512;
+/// Approximate bytes of diffs kept in memory
+const MAX_MEMORY_BYTES: u64 = 16 * 1024 * 1024;
+/// Serialized diffs kept in each repository's `diffs.db`
+const MAX_STORE_BYTES: u64 = 64 * 1024 * 1024;
+/// Bump when the `diffs.db` schema changes; older stores are cleared
+const STORE_VERSION: i64 = 2;
+
+type CommitDiff = (DiffStats, Vec<FileChange>);
+type Key = (Oid, CommitDiffOptions);
+
+struct MemoryTier {
+    entries: HashMap<Key, (CommitDiff, u64)>,
+    /// Keys by last use; an item is stale if the entry's tick moved on
+    order: VecDeque<(Key, u64)>,
+    tick: u64,
+    /// `diff_bytes` of every entry
+    bytes: u64,
+}
+
+struct Job {
+    git_dir: PathBuf,
+    oids: Vec<Oid>,
+    options: CommitDiffOptions,
+}
+
+struct Cache {
+    memory: Mutex<MemoryTier>,
+    jobs: Option<Mutex<mpsc::Sender<Job>>>,
+}
+
+fn cache() -> &'static Cache {
+    static CACHE: OnceLock<Cache> = OnceLock::new();
+
+    CACHE.get_or_init(|| {
+        let (tx, rx) = mpsc::channel();
+        let worker = thread::Builder::new()
+            .name("gitscribe-diff-prefetch".to_string())
+            .spawn(move || worker_loop(rx));
+
+        Cache {
+            memory: Mutex::new(MemoryTier::new()),
+            jobs: worker.ok().map(|_| Mutex::new(tx)),
+        }
+    })
+}
+
+/// Get a commit's diff from the cache, computing and storing it on a miss
+pub fn get(repo: &git2::Repository, oid: Oid, options: &CommitDiffOptions) -> Result<CommitDiff> {
+    let key = (oid, *options);
+    if let Some(diff) = cache().memory.lock().unwrap().get(&key) {
+        return Ok(diff);
+    }
+
+    let store = DiffStore::open(repo.path())
+        .map_err(|e| tracing::debug!("diff store unavailable for {:?}: {}", repo.path(), e))
+        .ok();
+    let diff = load_or_compute(repo, store.as_ref(), &key)?;
+
+    cache().memory.lock().unwrap().insert(key, diff.clone());
+    Ok(diff)
+}
+
+/// Queue commits whose diffs should be ready before they are selected
+///
+/// Replaces any earlier request for the same repository that hasn't been
+/// processed, so rapid scrolling only computes what is on screen now.
+pub fn prefetch(git_dir: &Path, oids: Vec<Oid>, options: CommitDiffOptions) {
+    let job = Job { git_dir: git_dir.to_path_buf(), oids, options };
+    match &cache().jobs {
+        Some(jobs) => {
+            let _ = jobs.lock().unwrap().send(job);
+        }
+        None => tracing::debug!("no diff prefetch worker; skipping {} commits", job.oids.len()),
+    }
+}
+
+fn load_or_compute(repo: &git2::Repository, store: Option<&DiffStore>, key: &Key) -> Result<CommitDiff> {
+    if let Some(store) = store {
+        match store.get(key) {
+            Ok(Some(diff)) => return Ok(diff),
+            Ok(None) => {}
+            Err(e) => tracing::debug!("unreadable cached diff {}: {}", key.0, e),
+        }
+    }
+
+    let diff = history::compute_commit_diff(repo, key.0, &key.1)?;
+    if let Some(store) = store {
+        if let Err(e) = store.put(key, &diff) {
+            tracing::debug!("failed to store diff {}: {}", key.0, e);
+        }
+    }
+    Ok(diff)
+}
+
+impl MemoryTier {
+    fn new() -> Self {
+        Self { entries: HashMap::new(), order: VecDeque::new(), tick: 0, bytes: 0 }
+    }
+
+    fn get(&mut self, key: &Key) -> Option<CommitDiff> {
+        self.tick += 1;
+        let tick = self.tick;
+        let (diff, last_used) = self.entries.get_mut(key)?;
+        *last_used = tick;
+        let diff = diff.clone();
+        self.touch(*key, tick);
+        Some(diff)
+    }
+
+    fn insert(&mut self, key: Key, diff: CommitDiff) {
+        self.tick += 1;
+        self.bytes += diff_bytes(&diff);
+        if let Some((old, _)) = self.entries.insert(key, (diff, self.tick)) {
+            self.bytes -= diff_bytes(&old);
+        }
+        self.touch(key, self.tick);
+
+        // The newest entry stays even if it alone is over budget
+        while self.entries.len() > MAX_ENTRIES || (self.bytes > MAX_MEMORY_BYTES && self.entries.len() > 1) {
+            match self.order.pop_front() {
+                Some((oldest, tick)) => {
+                    if self.entries.get(&oldest).map_or(false, |(_, last_used)| *last_used == tick) {
+                        let (diff, _) = self.entries.remove(&oldest).unwrap();
+                        self.bytes -= diff_bytes(&diff);
+                    }
+                }
+                None => break,
+            }
+        }
+    }
+
+    fn touch(&mut self, key: Key, tick: u64) {
+        self.order.push_back((key, tick));
+
+        // Drop stale order items once they outnumber live entries
+        if self.order.len() > MAX_ENTRIES * 4 {
+            let entries = &self.entries;
+            self.order.retain(|(key, tick)| entries.get(key).map_or(false, |(_, last_used)| last_used == tick));
+        }
+    }
+
+    fn contains(&self, key: &Key) -> bool {
+        self.entries.contains_key(key)
+    }
+}
+
+/// On-disk tier, one database per repository
+struct DiffStore {
+    conn: Connection,
+}
+
+impl DiffStore {
+    fn open(git_dir: &Path) -> Result<Self> {
+        let dir = crate::repository::common_dir(git_dir).join("gitscribe");
+        fs::create_dir_all(&dir).context("Failed to create diff cache directory")?;
+
+        let conn = Connection::open(dir.join("diffs.db"))
+            .context("Failed to open diff cache")?;
+        conn.pragma_update(None, "journal_mode", "WAL")?;
+        conn.pragma_update(None, "synchronous", "NORMAL")?;
+        conn.busy_timeout(Duration::from_secs(5))?;
+
+        let version: i64 = conn.query_row("PRAGMA user_version", [], |row| row.get(0))?;
+        if version != STORE_VERSION {
+            conn.execute_batch(
+                "DROP TABLE IF EXISTS commit_diffs;
+                 CREATE TABLE commit_diffs (
+                     oid TEXT NOT NULL,
+                     options INTEGER NOT NULL,
+                     diff TEXT NOT NULL,
+                     size INTEGER NOT NULL,
+                     last_used INTEGER NOT NULL,
+                     PRIMARY KEY (oid, options)
+                 ) WITHOUT ROWID;
+                 CREATE INDEX commit_diffs_last_used ON commit_diffs (last_used);"
+            )?;
+            conn.pragma_update(None, "user_version", STORE_VERSION)?;
+        }
+        Ok(Self { conn })
+    }
+
+    fn get(&self, key: &Key) -> Result<Option<CommitDiff>> {
+        let json: Option<String> = self.conn
+            .prepare_cached("SELECT diff FROM commit_diffs WHERE oid = ? AND options = ?")?
+            .query_row(params![key.0.to_string(), options_key(&key.1)], |row| row.get(0))
+            .optional()?;
+
+        match json {
+            Some(json) => {
+                self.conn
+                    .prepare_cached("UPDATE commit_diffs SET last_used = ? WHERE oid = ? AND options = ?")?
+                    .execute(params![now_ms(), key.0.to_string(), options_key(&key.1)])?;
+                Ok(Some(serde_json::from_str(&json)?))
+            }
+            None => Ok(None),
+        }
+    }
+
+    fn contains(&self, key: &Key) -> Result<bool> {
+        let found = self.conn
+            .prepare_cached("SELECT 1 FROM commit_diffs WHERE oid = ? AND options = ?")?
+            .exists(params![key.0.to_string(), options_key(&key.1)])?;
+        Ok(found)
+    }
+
+    fn put(&self, key: &Key, diff: &CommitDiff) -> Result<()> {
+        let json = serde_json::to_string(diff)?;
+        self.conn
+            .prepare_cached(
+                "INSERT OR REPLACE INTO commit_diffs (oid, options, diff, size, last_used) VALUES (?, ?, ?, ?, ?)"
+            )?
+            .execute(params![key.0.to_string(), options_key(&key.1), json, json.len() as i64, now_ms()])?;
+        self.evict_to_budget(MAX_STORE_BYTES)
+    }
+
+    /// Drop least recently used diffs until the store is within `budget_bytes`
+    ///
+    /// Evicts down to three quarters of the budget so that a full store isn't
+    /// trimmed again on every insert.
+    fn evict_to_budget(&self, budget_bytes: u64) -> Result<()> {
+        let total: i64 = self.conn
+            .prepare_cached("SELECT COALESCE(SUM(size), 0) FROM commit_diffs")?
+            .query_row([], |row| row.get(0))?;
+        if total as u64 <= budget_bytes {
+            return Ok(());
+        }
+
+        let mut excess = total - (budget_bytes / 4 * 3) as i64;
+        let tx = self.conn.unchecked_transaction()?;
+        {
+            let mut oldest = tx.prepare("SELECT oid, options, size FROM commit_diffs ORDER BY last_used ASC")?;
+            let mut rows = oldest.query([])?;
+            let mut delete = tx.prepare_cached("DELETE FROM commit_diffs WHERE oid = ? AND options = ?")?;
+            while excess > 0 {
+                let row = match rows.next()? {
+                    Some(row) => row,
+                    None => break,
+                };
+                let (oid, options, size): (String, i64, i64) = (row.get(0)?, row.get(1)?, row.get(2)?);
+                delete.execute(params![oid, options])?;
+                excess -= size;
+            }
+        }
+        tx.commit()?;
+        Ok(())
+    }
+}
+
+/// Rough heap and inline size of a diff, for the memory tier's budget
+fn diff_bytes(diff: &CommitDiff) -> u64 {
+    let files: usize = diff.1.iter()
+        .map(|file| std::mem::size_of::<FileChange>() + file.path.len() + file.old_path.as_ref().map_or(0, String::len) + file.status.len())
+        .sum();
+    (std::mem::size_of::<CommitDiff>() + files) as u64
+}
+
+fn now_ms() -> i64 {
+    SystemTime::now().duration_since(UNIX_EPOCH).map_or(0, |d| d.as_millis() as i64)
+}
+
+fn options_key(options: &CommitDiffOptions) -> i64 {
+    options.detect_renames as i64 | (options.ignore_whitespace as i64) << 1
+}
+
+fn worker_loop(rx: mpsc::Receiver<Job>) {
+    crate::scanner::enter_background_priority();
+
+    while let Ok(job) = rx.recv() {
+        // Only the newest request per repository still matters
+        let mut latest: Vec<Job> = vec![job];
+        while let Ok(job) = rx.try_recv() {
+            latest.retain(|j| j.git_dir != job.git_dir);
+            latest.push(job);
+        }
+
+        for job in latest {
+            if let Err(e) = run_job(&job) {
+                tracing::debug!("diff prefetch failed for {:?}: {}", job.git_dir, e);
+            }
+        }
+    }
+}
+
+fn run_job(job: &Job) -> Result<()> {
+    let repo = git2::Repository::open(&job.git_dir)?;
+    let store = DiffStore::open(&job.git_dir)?;
+
+    for oid in &job.oids {
+        let key = (*oid, job.options);
+        if cache().memory.lock().unwrap().contains(&key) || store.contains(&key)? {
+            continue;
+        }
+
+        let diff = load_or_compute(&repo, Some(&store), &key)?;
+        cache().memory.lock().unwrap().insert(key, diff);
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_memory_tier_evicts_least_recently_used() {
+        let mut memory = MemoryTier::new();
+        let diff = (DiffStats { files_changed: 1, insertions: 2, deletions: 3 }, Vec::new());
+        let key = |i: usize| {
+            let mut bytes = [0u8; 20];
+            bytes[..8].copy_from_slice(&(i as u64).to_be_bytes());
+            (Oid::from_bytes(&bytes).unwrap(), CommitDiffOptions::default())
+        };
+
+        for i in 0..MAX_ENTRIES {
+            memory.insert(key(i), diff.clone());
+        }
+        // Touch the oldest so the second oldest is evicted instead
+        for _ in 0..MAX_ENTRIES * 4 {
+            assert!(memory.get(&key(0)).is_some());
+        }
+        memory.insert(key(MAX_ENTRIES), diff.clone());
+
+        assert!(memory.contains(&key(0)));
+        assert!(!memory.contains(&key(1)));
+        assert_eq!(memory.entries.len(), MAX_ENTRIES);
+        assert_eq!(memory.bytes, MAX_ENTRIES as u64 * diff_bytes(&diff));
+
+        // Large diffs are limited by bytes long before the entry count
+        let file = FileChange { path: "x".repeat(1024 * 1024), old_path: None, status: "added".to_string(), insertions: 1, deletions: 0 };
+        let large = (DiffStats { files_changed: 1, insertions: 1, deletions: 0 }, vec![file]);
+        for i in 0..64 {
+            memory.insert(key(MAX_ENTRIES + 1 + i), large.clone());
+        }
+        assert!(memory.bytes <= MAX_MEMORY_BYTES);
+        assert!(memory.contains(&key(MAX_ENTRIES + 64)));
+    }
+
+    #[test]
+    fn test_second_get_served_from_disk() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        let sig = git2::Signature::now("Test", "test@example.com").unwrap();
+        fs::write(temp_dir.path().join("a.txt"), "a\n").unwrap();
+        let mut index = repo.index().unwrap();
+        index.add_path(Path::new("a.txt")).unwrap();
+        let tree = repo.find_tree(index.write_tree().unwrap()).unwrap();
+        let oid = repo.commit(Some("HEAD"), &sig, &sig, "add a", &tree, &[]).unwrap();
+
+        let options = CommitDiffOptions::default();
+        let first = get(&repo, oid, &options).unwrap();
+
+        // With the objects gone and memory cleared, only diffs.db can answer
+        *cache().memory.lock().unwrap() = MemoryTier::new();
+        let objects = repo.path().join("objects");
+        fs::remove_dir_all(&objects).unwrap();
+        fs::create_dir(&objects).unwrap();
+        let repo = git2::Repository::open(temp_dir.path()).unwrap();
+
+        let second = get(&repo, oid, &options).unwrap();
+        assert_eq!(second.0.insertions, first.0.insertions);
+        assert_eq!(second.1.len(), 1);
+        assert_eq!(second.1[0].path, "a.txt");
+    }
+}
@@ -14,6 +14,24 @@ pub struct GSRepository {
     _private: [u8; 0],
 }
 
+/// Opaque pointer to a background cache warm-up (for C code)
+#[repr(C)]
+pub struct GSWarmup {
+    _private: [u8; 0],
+}
+
+/// Opaque pointer to a background cache maintenance worker (for C code)
+#[repr(C)]
+pub struct GSMaintenance {
+    _private: [u8; 0],
+}
+
+/// Opaque pointer to an operation scheduler (for C code)
+#[repr(C)]
+pub struct GSScheduler {
+    _private: [u8; 0],
+}
+
 /// Repository context information (C-compatible struct)
 #[repr(C)]
 pub struct GSRepoInfo {
@@ -23,6 +41,7 @@ pub struct GSRepoInfo {
     pub conflicted_count: c_uint,
     pub ahead_count: c_uint,
     pub behind_count: c_uint,
+    pub remote_pending: c_int, // 1 if ahead/behind were cut short and may be stale
 }
 
 impl Default for GSRepoInfo {
@@ -34,6 +53,7 @@ impl Default for GSRepoInfo {
             conflicted_count: 0,
             ahead_count: 0,
             behind_count: 0,
+            remote_pending: 0,
         }
     }
 }
@@ -139,9 +159,11 @@ pub unsafe extern "C" fn gs_repository_info(
     if let Ok(Some(remote)) = repo.remote_status() {
         info.ahead_count = remote.ahead as c_uint;
         info.behind_count = remote.behind as c_uint;
+        info.remote_pending = if remote.pending { 1 } else { 0 };
     } else {
         info.ahead_count = 0;
         info.behind_count = 0;
+        info.remote_pending = 0;
     }
 
     0
@@ -285,6 +307,253 @@ pub unsafe extern "C" fn gs_status_list_free(list: *mut GSStatusList) {
     }
 }
 
+/// Get the fingerprint of the repository containing `path`
+///
+/// Cheap enough to call before every cache lookup: reads HEAD and stats a few
+/// files in .git, without opening the repository through libgit2. Cached data
+/// stored alongside an equal fingerprint is still valid.
+///
+/// # Safety
+/// `path` must be a valid null-terminated C string
+/// `fingerprint` must be a valid pointer to a uint64_t
+/// Returns 1 if a working-tree watcher backs the fingerprint (no TTL needed),
+/// 0 if only HEAD/index/ref changes are detected (keep a TTL), -1 on error
+#[no_mangle]
+pub unsafe extern "C" fn gs_path_fingerprint(
+    path: *const c_char,
+    fingerprint: *mut u64
+) -> c_int {
+    if path.is_null() || fingerprint.is_null() {
+        return -1;
+    }
+
+    let c_str = match CStr::from_ptr(path).to_str() {
+        Ok(s) => s,
+        Err(_) => return -1,
+    };
+
+    match crate::fingerprint::for_path(std::path::Path::new(c_str)) {
+        Some(fp) => {
+            *fingerprint = fp.value;
+            fp.watched as c_int
+        }
+        None => -1,
+    }
+}
+
+/// Start warming the status cache database at `db_path` in the background
+///
+/// Opt-in: call once when the host loads. Re-scans the most recently used
+/// repositories at low priority and backs off under foreground queries.
+///
+/// # Safety
+/// `db_path` must be a valid null-terminated C string
+/// Returns NULL on error. Stop with gs_cache_warmup_free()
+#[no_mangle]
+pub unsafe extern "C" fn gs_cache_warmup_start(db_path: *const c_char) -> *mut GSWarmup {
+    if db_path.is_null() {
+        return ptr::null_mut();
+    }
+
+    let c_str = match CStr::from_ptr(db_path).to_str() {
+        Ok(s) => s,
+        Err(_) => return ptr::null_mut(),
+    };
+
+    match crate::Warmup::spawn(c_str.into(), crate::CacheBackend::default(), crate::WarmupPolicy::default()) {
+        Ok(warmup) => Box::into_raw(Box::new(warmup)) as *mut GSWarmup,
+        Err(_) => ptr::null_mut(),
+    }
+}
+
+/// Cancel a warm-up and wait for it to stop (at most one repository scan)
+///
+/// # Safety
+/// `warmup` must be a valid pointer from gs_cache_warmup_start
+/// Can be called with NULL (no-op)
+#[no_mangle]
+pub unsafe extern "C" fn gs_cache_warmup_free(warmup: *mut GSWarmup) {
+    if !warmup.is_null() {
+        drop(Box::from_raw(warmup as *mut crate::Warmup));
+    }
+}
+
+/// Start periodic maintenance of the status cache database at `db_path`
+///
+/// Opt-in: call once when the host loads. Each pass evicts repositories
+/// until the cache fits in `budget_bytes` (0 for the default), then
+/// checkpoints and vacuums. The first pass runs after one interval.
+///
+/// # Safety
+/// `db_path` must be a valid null-terminated C string
+/// Returns NULL on error. Stop with gs_cache_maintenance_free()
+#[no_mangle]
+pub unsafe extern "C" fn gs_cache_maintenance_start(db_path: *const c_char, budget_bytes: u64) -> *mut GSMaintenance {
+    if db_path.is_null() {
+        return ptr::null_mut();
+    }
+
+    let c_str = match CStr::from_ptr(db_path).to_str() {
+        Ok(s) => s,
+        Err(_) => return ptr::null_mut(),
+    };
+
+    let mut policy = crate::MaintenancePolicy::default();
+    if budget_bytes > 0 {
+        policy.budget_bytes = budget_bytes;
+    }
+    match crate::MaintenanceWorker::spawn(c_str.into(), crate::CacheBackend::default(), policy) {
+        Ok(worker) => Box::into_raw(Box::new(worker)) as *mut GSMaintenance,
+        Err(_) => ptr::null_mut(),
+    }
+}
+
+/// Request a maintenance pass now instead of waiting for the next interval
+///
+/// # Safety
+/// `worker` must be a valid pointer from gs_cache_maintenance_start
+#[no_mangle]
+pub unsafe extern "C" fn gs_cache_maintenance_run_now(worker: *mut GSMaintenance) {
+    if !worker.is_null() {
+        (*(worker as *mut crate::MaintenanceWorker)).run_now();
+    }
+}
+
+/// Stop a maintenance worker, waiting for a running pass to finish
+///
+/// # Safety
+/// `worker` must be a valid pointer from gs_cache_maintenance_start
+/// Can be called with NULL (no-op)
+#[no_mangle]
+pub unsafe extern "C" fn gs_cache_maintenance_free(worker: *mut GSMaintenance) {
+    if !worker.is_null() {
+        drop(Box::from_raw(worker as *mut crate::MaintenanceWorker));
+    }
+}
+
+/// Start running queued operations (fetch, push, pull) from the status
+/// cache database at `db_path` on background threads
+///
+/// Opt-in: start one scheduler per database when the host loads.
+///
+/// # Safety
+/// `db_path` must be a valid null-terminated C string
+/// `workers` is the number of worker threads (0 for the default)
+/// Returns NULL on error. Stop with gs_scheduler_free()
+#[no_mangle]
+pub unsafe extern "C" fn gs_scheduler_start(db_path: *const c_char, workers: c_uint) -> *mut GSScheduler {
+    if db_path.is_null() {
+        return ptr::null_mut();
+    }
+
+    let c_str = match CStr::from_ptr(db_path).to_str() {
+        Ok(s) => s,
+        Err(_) => return ptr::null_mut(),
+    };
+
+    let mut config = crate::SchedulerConfig::default();
+    if workers > 0 {
+        config.workers = workers as usize;
+    }
+    match crate::Scheduler::start(c_str, config) {
+        Ok(scheduler) => Box::into_raw(Box::new(scheduler)) as *mut GSScheduler,
+        Err(_) => ptr::null_mut(),
+    }
+}
+
+/// Queue an operation ("fetch", "push" or "pull") and return at once
+///
+/// # Safety
+/// `scheduler` must be a valid pointer from gs_scheduler_start
+/// `repo_path` and `operation_type` must be valid null-terminated C strings
+/// `operation_data` is a null-terminated JSON string, or NULL for none
+/// `priority` is -1 (low), 0 (normal) or 1 (high)
+/// Returns the operation id, or -1 on error
+#[no_mangle]
+pub unsafe extern "C" fn gs_scheduler_enqueue(
+    scheduler: *mut GSScheduler,
+    repo_path: *const c_char,
+    operation_type: *const c_char,
+    operation_data: *const c_char,
+    priority: c_int
+) -> i64 {
+    if scheduler.is_null() || repo_path.is_null() || operation_type.is_null() {
+        return -1;
+    }
+
+    let scheduler = &*(scheduler as *mut crate::Scheduler);
+    let (repo_path, operation_type) = match (CStr::from_ptr(repo_path).to_str(), CStr::from_ptr(operation_type).to_str()) {
+        (Ok(repo_path), Ok(operation_type)) => (repo_path, operation_type),
+        _ => return -1,
+    };
+    let operation_data = if operation_data.is_null() {
+        ""
+    } else {
+        match CStr::from_ptr(operation_data).to_str() {
+            Ok(s) => s,
+            Err(_) => return -1,
+        }
+    };
+    let priority = match priority {
+        p if p < 0 => crate::OperationPriority::Low,
+        0 => crate::OperationPriority::Normal,
+        _ => crate::OperationPriority::High,
+    };
+
+    scheduler.enqueue(repo_path, operation_type, operation_data, priority).unwrap_or(-1)
+}
+
+/// Get the status of a queued operation
+///
+/// # Safety
+/// `scheduler` must be a valid pointer from gs_scheduler_start
+/// `attempts` may be NULL; otherwise receives the attempts made so far
+/// `error` may be NULL; otherwise receives the last error message or NULL.
+/// Caller MUST free a non-NULL message with gs_string_free()
+/// Returns 0 (pending), 1 (running), 2 (complete), 3 (failed), or -1 if the
+/// operation is unknown or on error
+#[no_mangle]
+pub unsafe extern "C" fn gs_scheduler_status(
+    scheduler: *mut GSScheduler,
+    operation_id: i64,
+    attempts: *mut c_uint,
+    error: *mut *mut c_char
+) -> c_int {
+    if scheduler.is_null() {
+        return -1;
+    }
+
+    let scheduler = &*(scheduler as *mut crate::Scheduler);
+    match scheduler.operation_status(operation_id) {
+        Ok(Some((status, tries, message))) => {
+            if !attempts.is_null() {
+                *attempts = tries as c_uint;
+            }
+            if !error.is_null() {
+                *error = message
+                    .and_then(|message| CString::new(message).ok())
+                    .map_or(ptr::null_mut(), CString::into_raw);
+            }
+            status as c_int
+        }
+        _ => -1,
+    }
+}
+
+/// Stop a scheduler, waiting for running operations to finish
+///
+/// Queued operations stay in the database for the next scheduler.
+///
+/// # Safety
+/// `scheduler` must be a valid pointer from gs_scheduler_start
+/// Can be called with NULL (no-op)
+#[no_mangle]
+pub unsafe extern "C" fn gs_scheduler_free(scheduler: *mut GSScheduler) {
+    if !scheduler.is_null() {
+        drop(Box::from_raw(scheduler as *mut crate::Scheduler));
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -314,6 +583,52 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_ffi_path_fingerprint() {
+        let temp_dir = TempDir::new().unwrap();
+        git2::Repository::init(temp_dir.path()).unwrap();
+
+        let c_path = CString::new(temp_dir.path().to_str().unwrap()).unwrap();
+        let mut first = 0u64;
+        let mut second = 0u64;
+
+        unsafe {
+            assert!(gs_path_fingerprint(c_path.as_ptr(), &mut first) >= 0);
+            assert!(gs_path_fingerprint(c_path.as_ptr(), &mut second) >= 0);
+            assert_eq!(gs_path_fingerprint(ptr::null(), &mut first), -1);
+        }
+        assert_eq!(first, second);
+    }
+
+    #[test]
+    fn test_ffi_cache_background_workers() {
+        let temp_dir = TempDir::new().unwrap();
+        let c_path = CString::new(temp_dir.path().join("cache.db").to_str().unwrap()).unwrap();
+
+        unsafe {
+            assert!(gs_cache_warmup_start(ptr::null()).is_null());
+            let warmup = gs_cache_warmup_start(c_path.as_ptr());
+            assert!(!warmup.is_null());
+            gs_cache_warmup_free(warmup);
+            gs_cache_warmup_free(ptr::null_mut());
+
+            let worker = gs_cache_maintenance_start(c_path.as_ptr(), 0);
+            assert!(!worker.is_null());
+            gs_cache_maintenance_run_now(worker);
+            gs_cache_maintenance_free(worker);
+
+            let scheduler = gs_scheduler_start(c_path.as_ptr(), 1);
+            assert!(!scheduler.is_null());
+            let repo = CString::new(temp_dir.path().to_str().unwrap()).unwrap();
+            let kind = CString::new("unknown").unwrap();
+            let id = gs_scheduler_enqueue(scheduler, repo.as_ptr(), kind.as_ptr(), ptr::null(), 0);
+            assert!(id >= 0);
+            assert!(gs_scheduler_status(scheduler, id, ptr::null_mut(), ptr::null_mut()) >= 0);
+            assert_eq!(gs_scheduler_status(scheduler, id + 1000, ptr::null_mut(), ptr::null_mut()), -1);
+            gs_scheduler_free(scheduler);
+        }
+    }
+
     #[test]
     fn test_ffi_version() {
         let version = gs_version();
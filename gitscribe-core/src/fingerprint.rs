@@ -0,0 +1,424 @@
+//! Repository Fingerprints
+//!
+//! A cheap summary of everything that can change what GitScribe shows for a
+//! repository: the HEAD target, stat data of the index and ref files, and a
+//! change token bumped by a filesystem watcher on the working tree. Caches
+//! compare fingerprints instead of expiring on a timer.
+
+use notify::{EventKind, RecommendedWatcher, RecursiveMode, Watcher};
+use std::collections::{HashMap, HashSet, VecDeque};
+use std::fs;
+use std::hash::{Hash, Hasher};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::time::{Duration, Instant, UNIX_EPOCH};
+
+/// Maximum number of working trees watched at once
+const MAX_WATCHERS: usize = 32;
+
+/// Watcher events remembered per working tree for `changed_paths`
+const MAX_JOURNAL_EVENTS: usize = 4096;
+
+/// How long a tree that couldn't be watched is left unwatched before retrying
+const WATCH_RETRY: Duration = Duration::from_secs(60);
+
+/// Fingerprint of a repository's observable state
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+pub struct RepoFingerprint {
+    pub value: u64,
+    /// True if a working-tree watcher backs the fingerprint. Otherwise only
+    /// HEAD, index and ref changes are detected and callers should keep a TTL.
+    pub watched: bool,
+    /// Hash of HEAD, index and ref state alone (`value` minus the working tree)
+    pub state: u64,
+    /// Working tree change token (see `changed_paths`); 0 when unwatched
+    pub token: u64,
+}
+
+impl RepoFingerprint {
+    /// Whether data cached under `stored` is still valid without any TTL
+    pub fn validates(&self, stored: u64) -> bool {
+        self.watched && self.value == stored
+    }
+}
+
+/// Compute the fingerprint for a repository
+///
+/// # Arguments
+/// * `git_dir` - The repository's `.git` directory
+/// * `workdir` - The working tree root (None for bare repositories)
+pub fn compute(git_dir: &Path, workdir: Option<&Path>) -> RepoFingerprint {
+    let common_dir = crate::repository::common_dir(git_dir);
+    let mut hasher = Fnv64::new();
+
+    // HEAD, the ref it points at, and that branch's upstream (a push only
+    // rewrites the remote-tracking ref, which the watcher doesn't see)
+    let head = fs::read(git_dir.join("HEAD")).unwrap_or_default();
+    head.hash(&mut hasher);
+    if let Some(target) = head.strip_prefix(b"ref: ") {
+        let name = String::from_utf8_lossy(target).trim().to_string();
+        fs::read(common_dir.join(&name)).unwrap_or_default().hash(&mut hasher);
+
+        let config = fs::read_to_string(common_dir.join("config")).unwrap_or_default();
+        config.hash(&mut hasher);
+        if let Some(upstream) = name.strip_prefix("refs/heads/").and_then(|branch| upstream_ref(&config, branch)) {
+            fs::read(common_dir.join(upstream)).unwrap_or_default().hash(&mut hasher);
+        }
+    }
+
+    // Files whose stat data changes on staging, commits, fetches and ignore edits
+    hash_stat(&git_dir.join("index"), &mut hasher);
+    hash_stat(&common_dir.join("packed-refs"), &mut hasher);
+    hash_stat(&git_dir.join("FETCH_HEAD"), &mut hasher);
+    hash_stat(&common_dir.join("info").join("exclude"), &mut hasher);
+
+    let state = hasher.finish();
+    let token = workdir.and_then(|w| change_token(w, git_dir));
+    token.hash(&mut hasher);
+
+    RepoFingerprint {
+        value: hasher.finish(),
+        watched: token.is_some(),
+        state,
+        token: token.unwrap_or(0),
+    }
+}
+
+/// Working tree paths the watcher saw change after `since` (a fingerprint's `token`)
+///
+/// Returns None if the tree isn't watched or the journal no longer reaches
+/// back that far (overflow, or an event that lost path information).
+pub fn changed_paths(workdir: &Path, since: u64) -> Option<Vec<PathBuf>> {
+    let journal = watchers().lock().unwrap().trees.get(workdir)?.journal.clone();
+    let journal = journal.lock().unwrap();
+
+    if since < journal.complete_after || since > journal.latest {
+        return None;
+    }
+
+    let mut paths: Vec<PathBuf> = journal.events.iter()
+        .filter(|(token, _)| *token > since)
+        .flat_map(|(_, paths)| paths.iter().cloned())
+        .collect();
+    paths.sort();
+    paths.dedup();
+    Some(paths)
+}
+
+/// Compute the fingerprint for the repository containing `path`, without libgit2
+///
+/// Walks up from `path` looking for `.git` (a directory, or a `gitdir:` file
+/// for linked worktrees). Returns None if no repository is found.
+pub fn for_path(path: &Path) -> Option<RepoFingerprint> {
+    let mut current = if path.is_file() { path.parent()? } else { path };
+
+    loop {
+        let dot_git = current.join(".git");
+        if dot_git.is_dir() {
+            return Some(compute(&dot_git, Some(current)));
+        }
+        if dot_git.is_file() {
+            let contents = fs::read_to_string(&dot_git).ok()?;
+            let target = contents.strip_prefix("gitdir:")?.trim();
+            let git_dir = current.join(target);
+            return Some(compute(&git_dir, Some(current)));
+        }
+        current = current.parent()?;
+    }
+}
+
+/// Full name of a branch's upstream ref, from `branch.<name>.remote` and
+/// `branch.<name>.merge` in a config file's text
+fn upstream_ref(config: &str, branch: &str) -> Option<String> {
+    let section = format!("[branch \"{}\"]", branch);
+    let (mut remote, mut merge) = (None, None);
+    let mut in_section = false;
+    for line in config.lines().map(str::trim) {
+        if line.starts_with('[') {
+            in_section = line == section;
+            continue;
+        }
+        if !in_section {
+            continue;
+        }
+        if let Some((key, value)) = line.split_once('=') {
+            let value = value.trim().trim_matches('"').to_string();
+            match key.trim().to_ascii_lowercase().as_str() {
+                "remote" => remote = Some(value),
+                "merge" => merge = Some(value),
+                _ => {}
+            }
+        }
+    }
+
+    let (remote, merge) = (remote?, merge?);
+    if remote == "." {
+        return Some(merge);
+    }
+    let merge = merge.strip_prefix("refs/heads/").unwrap_or(&merge);
+    Some(format!("refs/remotes/{}/{}", remote, merge))
+}
+
+pub(crate) fn hash_stat(path: &Path, hasher: &mut Fnv64) {
+    match fs::metadata(path) {
+        Ok(meta) => {
+            meta.len().hash(hasher);
+            meta.modified()
+                .ok()
+                .and_then(|t| t.duration_since(UNIX_EPOCH).ok())
+                .map(|d| d.as_nanos())
+                .hash(hasher);
+        }
+        Err(_) => 0u8.hash(hasher),
+    }
+}
+
+/// A working tree watched for changes
+struct WatchedTree {
+    token: Arc<AtomicU64>,
+    journal: Arc<Mutex<Journal>>,
+    last_used: Instant,
+    _watcher: RecommendedWatcher,
+}
+
+/// Recent watcher events, by the token value each one produced
+#[derive(Default)]
+struct Journal {
+    events: VecDeque<(u64, Vec<PathBuf>)>,
+    /// Events with tokens above this are all present with their paths
+    complete_after: u64,
+    latest: u64,
+}
+
+/// First token for a new watcher
+///
+/// Tokens from an earlier watcher on the same tree, in this process or a
+/// previous one, must never look like tokens from this one. Watchers start
+/// 2^20 events apart on a millisecond clock so stale tokens fall below the
+/// new journal's floor.
+fn first_token() -> u64 {
+    static LAST: AtomicU64 = AtomicU64::new(0);
+    let now = std::time::SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .map(|d| (d.as_millis() as u64) << 20)
+        .unwrap_or(0);
+    let mut last = LAST.load(Ordering::Relaxed);
+    loop {
+        let next = now.max(last + (1 << 20));
+        match LAST.compare_exchange_weak(last, next, Ordering::Relaxed, Ordering::Relaxed) {
+            Ok(_) => return next,
+            Err(current) => last = current,
+        }
+    }
+}
+
+#[derive(Default)]
+struct Watchers {
+    trees: HashMap<PathBuf, WatchedTree>,
+    /// Trees whose watch failed, with when to try again
+    failed: HashMap<PathBuf, Instant>,
+    /// Trees a caller is setting up a watcher for right now
+    starting: HashSet<PathBuf>,
+}
+
+fn watchers() -> &'static Mutex<Watchers> {
+    static WATCHERS: OnceLock<Mutex<Watchers>> = OnceLock::new();
+    WATCHERS.get_or_init(|| Mutex::new(Watchers::default()))
+}
+
+/// Current change token for a working tree, starting a watcher on first use
+///
+/// Returns None if the tree cannot be watched (e.g. unsupported filesystem),
+/// in which case it isn't tried again for `WATCH_RETRY`, or while another
+/// caller is still setting its watcher up. The recursive watch is set up
+/// without holding the watcher table, so other trees aren't held up.
+fn change_token(workdir: &Path, git_dir: &Path) -> Option<u64> {
+    {
+        let mut watchers = watchers().lock().unwrap();
+        if let Some(tree) = watchers.trees.get_mut(workdir) {
+            tree.last_used = Instant::now();
+            return Some(tree.token.load(Ordering::Acquire));
+        }
+        let now = Instant::now();
+        if watchers.failed.get(workdir).map_or(false, |retry_at| *retry_at > now) {
+            return None;
+        }
+        if !watchers.starting.insert(workdir.to_path_buf()) {
+            return None;
+        }
+    }
+
+    let tree = watch(workdir, git_dir);
+
+    let mut watchers = watchers().lock().unwrap();
+    watchers.starting.remove(workdir);
+    let tree = match tree {
+        Some(tree) => tree,
+        None => {
+            let now = Instant::now();
+            watchers.failed.retain(|_, retry_at| *retry_at > now);
+            watchers.failed.insert(workdir.to_path_buf(), now + WATCH_RETRY);
+            return None;
+        }
+    };
+    watchers.failed.remove(workdir);
+
+    if watchers.trees.len() >= MAX_WATCHERS {
+        let oldest = watchers.trees.iter()
+            .min_by_key(|(_, tree)| tree.last_used)
+            .map(|(path, _)| path.clone());
+        if let Some(oldest) = oldest {
+            watchers.trees.remove(&oldest);
+        }
+    }
+
+    let first = tree.token.load(Ordering::Acquire);
+    watchers.trees.insert(workdir.to_path_buf(), tree);
+    Some(first)
+}
+
+/// Start a recursive watcher on `workdir`
+fn watch(workdir: &Path, git_dir: &Path) -> Option<WatchedTree> {
+    let first = first_token();
+    let token = Arc::new(AtomicU64::new(first));
+    let journal = Arc::new(Mutex::new(Journal { complete_after: first, latest: first, ..Default::default() }));
+    let handler_token = token.clone();
+    let handler_journal = journal.clone();
+    let git_dir = git_dir.to_path_buf();
+
+    let mut watcher = notify::recommended_watcher(move |res: notify::Result<notify::Event>| {
+        // HEAD and index changes are covered by stat data; skip .git churn
+        let (relevant, paths) = match res {
+            Ok(event) if matches!(event.kind, EventKind::Access(_)) => (false, None),
+            Ok(event) if event.need_rescan() || event.paths.is_empty() => (true, None),
+            Ok(event) => {
+                let paths: Vec<PathBuf> = event.paths.into_iter()
+                    .filter(|p| !p.starts_with(&git_dir))
+                    .collect();
+                (!paths.is_empty(), Some(paths))
+            }
+            Err(_) => (true, None),
+        };
+        if !relevant {
+            return;
+        }
+
+        // Bump the token under the journal lock so readers never see a token
+        // whose paths aren't recorded yet
+        let mut journal = handler_journal.lock().unwrap();
+        let token = handler_token.fetch_add(1, Ordering::Release) + 1;
+        journal.latest = token;
+        match paths {
+            Some(paths) => journal.events.push_back((token, paths)),
+            None => {
+                journal.events.clear();
+                journal.complete_after = token;
+            }
+        }
+        if journal.events.len() > MAX_JOURNAL_EVENTS {
+            if let Some((dropped, _)) = journal.events.pop_front() {
+                journal.complete_after = dropped;
+            }
+        }
+    }).ok()?;
+
+    if let Err(e) = watcher.watch(workdir, RecursiveMode::Recursive) {
+        tracing::debug!("cannot watch {:?}, retrying in {:?}: {}", workdir, WATCH_RETRY, e);
+        return None;
+    }
+
+    Some(WatchedTree {
+        token,
+        journal,
+        last_used: Instant::now(),
+        _watcher: watcher,
+    })
+}
+
+/// FNV-1a, so fingerprints stored on disk stay stable across builds
+pub(crate) struct Fnv64(u64);
+
+impl Fnv64 {
+    pub(crate) fn new() -> Self {
+        Fnv64(0xcbf2_9ce4_8422_2325)
+    }
+}
+
+impl Hasher for Fnv64 {
+    fn write(&mut self, bytes: &[u8]) {
+        for byte in bytes {
+            self.0 ^= *byte as u64;
+            self.0 = self.0.wrapping_mul(0x0100_0000_01b3);
+        }
+    }
+
+    fn finish(&self) -> u64 {
+        self.0
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Write;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_unwatchable_tree_backs_off() {
+        let temp_dir = TempDir::new().unwrap();
+        let missing = temp_dir.path().join("missing");
+
+        assert_eq!(change_token(&missing, &missing.join(".git")), None);
+        let retry_at = *watchers().lock().unwrap().failed.get(&missing).unwrap();
+        assert!(retry_at > Instant::now());
+
+        // Not retried (even once it exists) until the backoff expires
+        fs::create_dir(&missing).unwrap();
+        assert_eq!(change_token(&missing, &missing.join(".git")), None);
+        watchers().lock().unwrap().failed.insert(missing.clone(), Instant::now());
+        assert!(change_token(&missing, &missing.join(".git")).is_some());
+        assert!(!watchers().lock().unwrap().failed.contains_key(&missing));
+    }
+
+    #[test]
+    fn test_head_change_invalidates() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+
+        let before = compute(repo.path(), None);
+        assert_eq!(before, compute(repo.path(), None));
+        assert!(!before.watched);
+
+        fs::write(repo.path().join("HEAD"), "ref: refs/heads/other\n").unwrap();
+        assert_ne!(before, compute(repo.path(), None));
+    }
+
+    #[test]
+    fn test_upstream_push_invalidates() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        fs::write(repo.path().join("HEAD"), "ref: refs/heads/main\n").unwrap();
+        let mut config = fs::OpenOptions::new().append(true).open(repo.path().join("config")).unwrap();
+        write!(config, "[branch \"main\"]\n\tremote = origin\n\tmerge = refs/heads/main\n").unwrap();
+        drop(config);
+        let upstream = repo.path().join("refs/remotes/origin");
+        fs::create_dir_all(&upstream).unwrap();
+        fs::write(upstream.join("main"), "1111111111111111111111111111111111111111\n").unwrap();
+
+        let before = compute(repo.path(), None);
+        fs::write(upstream.join("main"), "2222222222222222222222222222222222222222\n").unwrap();
+        assert_ne!(before, compute(repo.path(), None));
+    }
+
+    #[test]
+    fn test_for_path_discovers_repo() {
+        let temp_dir = TempDir::new().unwrap();
+        git2::Repository::init(temp_dir.path()).unwrap();
+        let subdir = temp_dir.path().join("a").join("b");
+        fs::create_dir_all(&subdir).unwrap();
+
+        assert!(for_path(&subdir).is_some());
+        assert!(for_path(&TempDir::new().unwrap().path().join("x")).is_none());
+    }
+}
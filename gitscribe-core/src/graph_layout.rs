@@ -0,0 +1,284 @@
+//! Commit Graph Lanes
+//!
+//! Assigns each commit of the history view a column and describes the lines
+//! between rows, one page at a time. Laying out the next row only needs the
+//! lanes still open (each waiting for a parent further down), so that state
+//! travels with the page cursor and a page costs the same however deep it is.
+//!
+//! Lines are attached to the row they lead into: row i's edges run from
+//! columns of row i - 1 down to columns of row i. Colors are handed out per
+//! lane as it opens and follow first parents, so a branch keeps its color.
+
+use anyhow::{Context, Result};
+use git2::Oid;
+use serde::{Deserialize, Serialize};
+
+/// A column waiting for a commit further down
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+struct Lane {
+    expects: Oid,
+    /// Column the lane's line leaves the previous row from
+    from: u32,
+    color: u32,
+}
+
+/// Lane layout carried from one page to the next
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct GraphLayout {
+    lanes: Vec<Option<Lane>>,
+    /// Lines from the last row into lanes that were already open, as
+    /// (from column, lane, color)
+    joins: Vec<(u32, usize, u32)>,
+    next_color: u32,
+}
+
+/// Layout of consecutive rows, as flat arrays for the UI
+#[derive(Debug, Clone, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub struct GraphRows {
+    /// Column of each commit
+    pub columns: Vec<u32>,
+    /// Color of each commit
+    pub colors: Vec<u32>,
+    /// Row i's edges are `edge_offsets[i]..edge_offsets[i + 1]`; one more
+    /// entry than there are rows
+    pub edge_offsets: Vec<u32>,
+    /// Edges as (from column, to column, color) triples
+    pub edges: Vec<u32>,
+}
+
+impl GraphLayout {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Restore a layout saved with `state`
+    pub fn resume(state: &str) -> Result<Self> {
+        let mut sections = state.split(';');
+        let mut next = || sections.next().context("Invalid graph layout state");
+        let number = |s: &str| s.parse::<u32>().context("Invalid graph layout state");
+
+        let next_color = number(next()?)?;
+        let lanes = next()?
+            .split(',')
+            .filter(|s| !s.is_empty())
+            .map(|lane| -> Result<Option<Lane>> {
+                if lane == "-" {
+                    return Ok(None);
+                }
+                let mut fields = lane.split(':');
+                let mut field = || fields.next().context("Invalid graph layout state");
+                Ok(Some(Lane {
+                    expects: Oid::from_str(field()?).context("Invalid graph layout state")?,
+                    from: number(field()?)?,
+                    color: number(field()?)?,
+                }))
+            })
+            .collect::<Result<_>>()?;
+        let joins = next()?
+            .split(',')
+            .filter(|s| !s.is_empty())
+            .map(|join| -> Result<(u32, usize, u32)> {
+                let mut fields = join.split(':');
+                let mut field = || fields.next().context("Invalid graph layout state");
+                Ok((number(field()?)?, number(field()?)? as usize, number(field()?)?))
+            })
+            .collect::<Result<_>>()?;
+
+        Ok(Self { lanes, joins, next_color })
+    }
+
+    /// Compact text form of the layout, for `resume`
+    pub fn state(&self) -> String {
+        let lanes: Vec<String> = self.lanes.iter()
+            .map(|lane| match lane {
+                Some(lane) => format!("{}:{}:{}", lane.expects, lane.from, lane.color),
+                None => "-".to_string(),
+            })
+            .collect();
+        let joins: Vec<String> = self.joins.iter()
+            .map(|(from, lane, color)| format!("{}:{}:{}", from, lane, color))
+            .collect();
+        format!("{};{};{}", self.next_color, lanes.join(","), joins.join(","))
+    }
+
+    /// True before the first commit is laid out
+    pub fn is_new(&self) -> bool {
+        self.next_color == 0 && self.lanes.is_empty() && self.joins.is_empty()
+    }
+
+    /// True if an open lane is waiting for `oid`
+    pub fn is_expected(&self, oid: Oid) -> bool {
+        self.lane_expecting(oid).is_some()
+    }
+
+    /// Lay out the next commit in display order, appending its row to `rows`
+    ///
+    /// `parents` must leave out commits already laid out: a lane opened
+    /// towards one would wait for it forever.
+    pub fn push(&mut self, oid: Oid, parents: &[Oid], rows: &mut GraphRows) {
+        if rows.edge_offsets.is_empty() {
+            rows.edge_offsets.push(0);
+        }
+
+        let (column, color) = match self.lane_expecting(oid) {
+            Some(column) => (column, self.lanes[column].unwrap().color),
+            None => (self.free_lane(None), self.new_color()),
+        };
+
+        // Lines into this row: open lanes, and merges from the last row
+        let mut edges = 0;
+        for (c, lane) in self.lanes.iter().enumerate() {
+            if let Some(lane) = lane {
+                let to = if lane.expects == oid { column } else { c };
+                rows.edges.extend([lane.from, to as u32, lane.color]);
+                edges += 1;
+            }
+        }
+        for (from, lane, color) in self.joins.drain(..) {
+            let to = match self.lanes.get(lane).copied().flatten() {
+                Some(open) if open.expects == oid => column,
+                Some(_) => lane,
+                None => continue,
+            };
+            rows.edges.extend([from, to as u32, color]);
+            edges += 1;
+        }
+        let last = *rows.edge_offsets.last().unwrap();
+        rows.edge_offsets.push(last + edges);
+        rows.columns.push(column as u32);
+        rows.colors.push(color);
+
+        // Every lane that was waiting for this commit ends here
+        for (c, slot) in self.lanes.iter_mut().enumerate() {
+            match slot {
+                Some(lane) if lane.expects == oid => *slot = None,
+                Some(lane) => lane.from = c as u32,
+                None => {}
+            }
+        }
+
+        if let Some((first, rest)) = parents.split_first() {
+            match self.lane_expecting(*first) {
+                Some(open) => self.joins.push((column as u32, open, color)),
+                None => self.lanes[column] = Some(Lane { expects: *first, from: column as u32, color }),
+            }
+            for parent in rest {
+                match self.lane_expecting(*parent) {
+                    Some(open) => {
+                        let open_color = self.lanes[open].unwrap().color;
+                        self.joins.push((column as u32, open, open_color));
+                    }
+                    None => {
+                        let lane = self.free_lane(Some(column));
+                        let color = self.new_color();
+                        self.lanes[lane] = Some(Lane { expects: *parent, from: column as u32, color });
+                    }
+                }
+            }
+        }
+
+        while let Some(None) = self.lanes.last() {
+            self.lanes.pop();
+        }
+    }
+
+    fn lane_expecting(&self, oid: Oid) -> Option<usize> {
+        self.lanes.iter().position(|lane| lane.map_or(false, |lane| lane.expects == oid))
+    }
+
+    /// First unused column other than `except`, growing the lanes if needed
+    fn free_lane(&mut self, except: Option<usize>) -> usize {
+        let found = self.lanes.iter()
+            .enumerate()
+            .position(|(c, lane)| lane.is_none() && Some(c) != except);
+        match found {
+            Some(c) => c,
+            None => {
+                self.lanes.push(None);
+                self.lanes.len() - 1
+            }
+        }
+    }
+
+    fn new_color(&mut self) -> u32 {
+        self.next_color += 1;
+        self.next_color - 1
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn oid(i: usize) -> Oid {
+        Oid::from_str(&format!("{:040x}", i + 1)).unwrap()
+    }
+
+    #[test]
+    fn test_merge_layout() {
+        // 0 merges 1 and 2, which both come from 3
+        let history = [(0, vec![1, 2]), (1, vec![3]), (2, vec![3]), (3, vec![])];
+        let mut layout = GraphLayout::new();
+        let mut rows = GraphRows::default();
+        for (commit, parents) in &history {
+            let parents: Vec<Oid> = parents.iter().map(|p| oid(*p)).collect();
+            layout.push(oid(*commit), &parents, &mut rows);
+        }
+
+        assert_eq!(rows.columns, [0, 0, 1, 0]);
+        assert_eq!(rows.colors, [0, 0, 1, 0]);
+        assert_eq!(rows.edge_offsets, [0, 0, 2, 4, 6]);
+        assert_eq!(rows.edges, [
+            0, 0, 0, 0, 1, 1,
+            0, 0, 0, 1, 1, 1,
+            0, 0, 0, 1, 0, 1,
+        ]);
+        assert!(layout.lanes.is_empty() && layout.joins.is_empty());
+    }
+
+    #[test]
+    fn test_resumed_pages_match_single_pass() {
+        // Deterministic history with branches and merges (xorshift)
+        let mut state = 0x9e37_79b9_7f4a_7c15u64;
+        let mut next = move |bound: u64| {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            state % bound
+        };
+        let history: Vec<(Oid, Vec<Oid>)> = (0..500)
+            .map(|i| {
+                let parents = match (i, next(10)) {
+                    (499, _) => vec![],
+                    (_, 0) => vec![oid(i + 1), oid((i + 2 + next(20) as usize).min(499))],
+                    (_, 1) if i < 490 => vec![oid(i + 2 + next(8) as usize)],
+                    _ => vec![oid(i + 1)],
+                };
+                (oid(i), parents)
+            })
+            .collect();
+
+        let mut whole = GraphRows::default();
+        let mut layout = GraphLayout::new();
+        for (commit, parents) in &history {
+            layout.push(*commit, parents, &mut whole);
+        }
+
+        let mut columns = Vec::new();
+        let mut edges = Vec::new();
+        let mut saved = GraphLayout::new().state();
+        for page in history.chunks(37) {
+            let mut layout = GraphLayout::resume(&saved).unwrap();
+            let mut rows = GraphRows::default();
+            for (commit, parents) in page {
+                layout.push(*commit, parents, &mut rows);
+            }
+            columns.extend(rows.columns);
+            edges.extend(rows.edges);
+            saved = layout.state();
+        }
+
+        assert_eq!(columns, whole.columns);
+        assert_eq!(edges, whole.edges);
+    }
+}
@@ -3,10 +3,23 @@
 //! Provides commit log, branch listing, and search functionality using git2.
 
 use anyhow::{Result, Context};
-use git2::{Repository as Git2Repo, BranchType, Oid, DiffOptions};
+use git2::{Repository as Git2Repo, BranchType, Oid, DiffOptions, DiffFindOptions};
 use serde::{Deserialize, Serialize};
+use std::collections::{BinaryHeap, HashSet};
 use std::path::Path;
 
+use crate::blame::BlameStream;
+use crate::branch_list::{self, BranchTip};
+use crate::changed_paths::{ChangedPaths, PathQuery};
+use crate::diff_cache;
+use crate::diff_stream::{DiffStream, DiffStreamOptions};
+use crate::graph_layout::{GraphLayout, GraphRows};
+use crate::history_scan;
+use crate::search_index::SearchIndex;
+
+/// Emitted commits remembered in a cursor to suppress repeats
+const MAX_CURSOR_SEEN: usize = 4096;
+
 /// A single commit in the history
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct Commit {
@@ -23,7 +36,7 @@ pub struct Commit {
 }
 
 /// A Git branch
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
 pub struct Branch {
     pub name: String,
     pub is_head: bool,
@@ -40,6 +53,14 @@ pub struct DiffStats {
     pub deletions: usize,
 }
 
+/// Options that change a commit's diff (and so are part of its cache key)
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash, Serialize, Deserialize)]
+pub struct CommitDiffOptions {
+    /// Report renames instead of a delete and an add
+    pub detect_renames: bool,
+    pub ignore_whitespace: bool,
+}
+
 /// A file change in a commit
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct FileChange {
@@ -50,6 +71,134 @@ pub struct FileChange {
     pub deletions: usize,
 }
 
+/// Criteria for `GitHistory::filter_commits`; unset fields match everything
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct CommitFilter {
+    /// Case-insensitive substring of the message
+    pub message: Option<String>,
+    /// Case-insensitive substring of the author name or email
+    pub author: Option<String>,
+    /// Only commits that changed this file or directory (relative to the root)
+    pub path: Option<String>,
+}
+
+/// One page of commits from `GitHistory::get_commits_page`
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct CommitPage {
+    pub commits: Vec<Commit>,
+    /// Opaque cursor for the next page; None at the end of history
+    pub next_cursor: Option<String>,
+}
+
+/// One page of commits with their graph rows, from `GitHistory::get_graph_page`
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct GraphPage {
+    pub commits: Vec<Commit>,
+    pub rows: GraphRows,
+    /// Opaque cursor for the next page, including the lane layout; None at
+    /// the end of history
+    pub next_cursor: Option<String>,
+}
+
+/// Commit-time ordered walk whose frontier can be saved between pages
+///
+/// Follows the same order as a revwalk with `Sort::TIME` (newest committer
+/// time first); equal times are broken by oid, where libgit2 makes no
+/// promise. The frontier (commits queued but not yet
+/// emitted) is what a cursor carries, so resuming costs O(frontier), not
+/// O(commits already shown).
+struct CommitWalk<'r> {
+    repo: &'r Git2Repo,
+    queue: BinaryHeap<(i64, Oid)>,
+    /// Queued or emitted commits
+    seen: HashSet<Oid>,
+    /// Emitted commits that could still be reached from the frontier
+    emitted: Vec<(i64, Oid)>,
+    /// Commits emitted by this walk or listed in the cursor it resumed from
+    done: HashSet<Oid>,
+}
+
+impl<'r> CommitWalk<'r> {
+    fn new(repo: &'r Git2Repo) -> Self {
+        Self {
+            repo,
+            queue: BinaryHeap::new(),
+            seen: HashSet::new(),
+            emitted: Vec::new(),
+            done: HashSet::new(),
+        }
+    }
+
+    fn push(&mut self, oid: Oid) -> Result<()> {
+        if self.seen.insert(oid) {
+            let time = self.repo.find_commit(oid)?.time().seconds();
+            self.queue.push((time, oid));
+        }
+        Ok(())
+    }
+
+    /// Resume from a string produced by `cursor`
+    fn resume(repo: &'r Git2Repo, cursor: &str) -> Result<Self> {
+        let mut walk = Self::new(repo);
+        let (frontier, emitted) = cursor.split_once('~').context("Invalid history cursor")?;
+
+        for oid in emitted.split(',').filter(|s| !s.is_empty()) {
+            let oid = Oid::from_str(oid).context("Invalid history cursor")?;
+            let time = repo.find_commit(oid)?.time().seconds();
+            walk.seen.insert(oid);
+            walk.done.insert(oid);
+            walk.emitted.push((time, oid));
+        }
+        for oid in frontier.split(',').filter(|s| !s.is_empty()) {
+            walk.push(Oid::from_str(oid).context("Invalid history cursor")?)?;
+        }
+        Ok(walk)
+    }
+
+    fn next(&mut self) -> Result<Option<git2::Commit<'r>>> {
+        let (time, oid) = match self.queue.pop() {
+            Some(next) => next,
+            None => return Ok(None),
+        };
+
+        let commit = self.repo.find_commit(oid)?;
+        for parent in commit.parent_ids() {
+            self.push(parent)?;
+        }
+        self.emitted.push((time, oid));
+        self.done.insert(oid);
+        Ok(Some(commit))
+    }
+
+    /// True if `oid` was already emitted (as far as this walk knows)
+    fn is_done(&self, oid: &Oid) -> bool {
+        self.done.contains(oid)
+    }
+
+    /// Cursor for the rest of the walk, or None if it is finished
+    ///
+    /// Only emitted commits no newer than the newest queued one are kept
+    /// (at most `MAX_CURSOR_SEEN`, newest first): newer ones can be reached
+    /// again only where commit dates run backwards along history (clock
+    /// skew), where repeats are possible.
+    fn cursor(&self) -> Option<String> {
+        let newest = self.queue.peek()?.0;
+
+        let mut frontier: Vec<String> = self.queue.iter().map(|(_, oid)| oid.to_string()).collect();
+        frontier.sort();
+
+        let mut emitted: Vec<&(i64, Oid)> = self.emitted.iter().filter(|(time, _)| *time <= newest).collect();
+        emitted.sort();
+        let emitted: Vec<String> = emitted.iter()
+            .rev()
+            .take(MAX_CURSOR_SEEN)
+            .map(|(_, oid)| oid.to_string())
+            .collect();
+
+        Some(format!("{}~{}", frontier.join(","), emitted.join(",")))
+    }
+}
+
 /// Manages Git history operations
 pub struct GitHistory {
     repo: Git2Repo,
@@ -65,6 +214,9 @@ impl GitHistory {
     }
 
     /// Get commit log with optional branch filter
+    ///
+    /// Walks and discards `skip` commits on every call; page through long
+    /// histories with `get_commits_page` instead.
     pub fn get_commits(&self, branch_name: Option<&str>, limit: usize, skip: usize) -> Result<Vec<Commit>> {
         let mut revwalk = self.repo.revwalk()?;
 
@@ -98,8 +250,110 @@ impl GitHistory {
         Ok(commits)
     }
 
-    /// Get all branches
+    /// Get one page of the commit log
+    ///
+    /// Starts at `branch_name` (or HEAD) when `cursor` is None; otherwise
+    /// continues from the `next_cursor` of the previous page and ignores
+    /// `branch_name`. Each page costs O(`limit`) regardless of how deep it is.
+    pub fn get_commits_page(&self, branch_name: Option<&str>, cursor: Option<&str>, limit: usize) -> Result<CommitPage> {
+        let mut walk = match cursor {
+            Some(cursor) => CommitWalk::resume(&self.repo, cursor)?,
+            None => self.start_walk(branch_name)?,
+        };
+
+        let mut commits = Vec::with_capacity(limit);
+        while commits.len() < limit {
+            match walk.next()? {
+                Some(commit) => commits.push(self.commit_to_struct(&commit)?),
+                None => break,
+            }
+        }
+
+        Ok(CommitPage {
+            commits,
+            next_cursor: walk.cursor(),
+        })
+    }
+
+    /// Walk starting at `branch_name`, or HEAD
+    fn start_walk(&self, branch_name: Option<&str>) -> Result<CommitWalk<'_>> {
+        let mut walk = CommitWalk::new(&self.repo);
+        let start = match branch_name {
+            Some(branch) => self.repo.find_reference(&format!("refs/heads/{}", branch))?
+                .target()
+                .context("Branch has no target")?,
+            None => self.repo.head()?.peel_to_commit()?.id(),
+        };
+        walk.push(start)?;
+        Ok(walk)
+    }
+
+    /// Get one page of the commit log with graph lanes laid out
+    ///
+    /// Like `get_commits_page`, but the cursor also carries the lanes open at
+    /// the page boundary (see `graph_layout`), so rows continue seamlessly.
+    ///
+    /// The walk is ordered by commit time, so with clock skew a parent can
+    /// come out before one of its children. No lane is opened towards a
+    /// commit that is already drawn, and a commit no lane is waiting for
+    /// (one the walk repeats) is left out, so such edges are dropped rather
+    /// than leaving a column open for the rest of the history.
+    pub fn get_graph_page(&self, branch_name: Option<&str>, cursor: Option<&str>, limit: usize) -> Result<GraphPage> {
+        let (mut walk, mut layout) = match cursor {
+            Some(cursor) => {
+                let (walk, layout) = cursor.split_once('|').context("Invalid history cursor")?;
+                (CommitWalk::resume(&self.repo, walk)?, GraphLayout::resume(layout)?)
+            }
+            None => (self.start_walk(branch_name)?, GraphLayout::new()),
+        };
+
+        let mut commits = Vec::with_capacity(limit);
+        let mut rows = GraphRows::default();
+        while commits.len() < limit {
+            let commit = match walk.next()? {
+                Some(commit) => commit,
+                None => break,
+            };
+            if !layout.is_new() && !layout.is_expected(commit.id()) {
+                continue;
+            }
+            let parents: Vec<Oid> = commit.parent_ids().filter(|parent| !walk.is_done(parent)).collect();
+            layout.push(commit.id(), &parents, &mut rows);
+            commits.push(self.commit_to_struct(&commit)?);
+        }
+
+        Ok(GraphPage {
+            next_cursor: walk.cursor().map(|walk| format!("{}|{}", walk, layout.state())),
+            commits,
+            rows,
+        })
+    }
+
+    /// Get all branches, local ones first, each group by name
+    ///
+    /// Read in one batched pass over the ref files (see `branch_list`),
+    /// falling back to libgit2's branch iterator if that fails.
     pub fn get_branches(&self) -> Result<Vec<Branch>> {
+        match branch_list::list(&self.repo) {
+            Ok(tips) => {
+                let mut branches: Vec<Branch> = tips.iter().map(|tip| tip.branch.clone()).collect();
+                branches.sort_by(|a, b| (a.is_remote, &a.name).cmp(&(b.is_remote, &b.name)));
+                Ok(branches)
+            }
+            Err(e) => {
+                tracing::debug!("batched branch listing failed for {:?}: {}", self.repo.path(), e);
+                self.get_branches_iter()
+            }
+        }
+    }
+
+    /// Get the `limit` branches with the newest tip commits, newest first
+    pub fn get_recent_branches(&self, limit: usize) -> Result<Vec<BranchTip>> {
+        let tips = branch_list::list(&self.repo)?;
+        Ok(tips.iter().take(limit).cloned().collect())
+    }
+
+    fn get_branches_iter(&self) -> Result<Vec<Branch>> {
         let mut branches = Vec::new();
 
         // Get local branches
@@ -118,106 +372,184 @@ impl GitHistory {
     }
 
     /// Search commits by message, author, or hash
+    ///
+    /// Answered from the persistent search index (see `search_index`) once
+    /// it has caught up with HEAD; until then (or if the index can't be
+    /// used) a parallel linear walk answers while the index updates in the
+    /// background. Results are newest first.
     pub fn search_commits(&self, query: &str, limit: usize) -> Result<Vec<Commit>> {
+        match self.search_indexed(query, limit) {
+            Ok(Some(oids)) => return self.oids_to_commits(&oids),
+            Ok(None) => {}
+            Err(e) => tracing::debug!("commit search index unavailable for {:?}: {}", self.repo.path(), e),
+        }
+
+        self.search_commits_linear(query, limit)
+    }
+
+    fn search_indexed(&self, query: &str, limit: usize) -> Result<Option<Vec<Oid>>> {
+        let index = SearchIndex::open(&self.repo)?;
+        if !index.is_current(&self.repo)? {
+            SearchIndex::update_in_background(self.repo.path());
+            return Ok(None);
+        }
+        index.search(query, limit)
+    }
+
+    /// Search commits by walking and decoding the whole history
+    ///
+    /// Commits are decoded and matched in parallel (see `history_scan`).
+    pub fn search_commits_linear(&self, query: &str, limit: usize) -> Result<Vec<Commit>> {
         let mut revwalk = self.repo.revwalk()?;
         revwalk.push_head()?;
         revwalk.set_sorting(git2::Sort::TIME)?;
 
         let query_lower = query.to_lowercase();
-        let mut matches = Vec::new();
-
-        for oid_result in revwalk {
-            if matches.len() >= limit {
-                break;
-            }
-
-            let oid = oid_result?;
-            let commit = self.repo.find_commit(oid)?;
-
-            // Check if query matches
-            let oid_str = oid.to_string();
-            let message = commit.message().unwrap_or("").to_string();
+        let oids = history_scan::scan(self.repo.path(), revwalk, limit, |commit| {
+            let oid_str = commit.id().to_string();
+            let message = String::from_utf8_lossy(commit.message_bytes());
             let author_sig = commit.author();
-            let author = author_sig.name().unwrap_or("").to_string();
+            let author = String::from_utf8_lossy(author_sig.name_bytes());
 
-            if oid_str.starts_with(&query_lower)
+            Ok(oid_str.starts_with(&query_lower)
                 || message.to_lowercase().contains(&query_lower)
-                || author.to_lowercase().contains(&query_lower)
-            {
-                matches.push(self.commit_to_struct(&commit)?);
-            }
-        }
+                || author.to_lowercase().contains(&query_lower))
+        })?;
 
-        Ok(matches)
+        self.oids_to_commits(&oids)
     }
 
-    /// Get diff for a specific commit
-    pub fn get_commit_diff(&self, oid_str: &str) -> Result<(DiffStats, Vec<FileChange>)> {
-        let oid = Oid::from_str(oid_str)?;
-        let commit = self.repo.find_commit(oid)?;
+    /// Get commits that changed a file or directory, newest first
+    ///
+    /// Starts at `branch_name` (or HEAD). `path` is relative to the
+    /// repository root.
+    pub fn file_history(&self, branch_name: Option<&str>, path: &str, limit: usize) -> Result<Vec<Commit>> {
+        let filter = CommitFilter {
+            path: Some(path.to_string()),
+            ..Default::default()
+        };
+        self.filter_commits(branch_name, &filter, limit)
+    }
 
-        let tree = commit.tree()?;
-        let parent_tree = if commit.parent_count() > 0 {
-            Some(commit.parent(0)?.tree()?)
-        } else {
-            None
+    /// Blame a file, yielding hunks as their lines are resolved
+    ///
+    /// `oid_str` defaults to HEAD. Results are cached per commit, so blaming
+    /// again after HEAD moves forward only walks the new commits (see `blame`).
+    pub fn blame(&self, path: &str, oid_str: Option<&str>) -> Result<BlameStream<'_>> {
+        let oid = match oid_str {
+            Some(oid) => Oid::from_str(oid)?,
+            None => self.repo.head()?.peel_to_commit()?.id(),
         };
+        BlameStream::new(&self.repo, Path::new(path), oid)
+    }
 
-        let mut diff_opts = DiffOptions::new();
-        let diff = self.repo.diff_tree_to_tree(
-            parent_tree.as_ref(),
-            Some(&tree),
-            Some(&mut diff_opts),
-        )?;
-
-        let stats = diff.stats()?;
-        let diff_stats = DiffStats {
-            files_changed: stats.files_changed(),
-            insertions: stats.insertions(),
-            deletions: stats.deletions(),
+    /// Get commits matching every set field of `filter`, newest first
+    ///
+    /// Starts at `branch_name` (or HEAD). Commits are decoded and matched in
+    /// parallel, so unindexed filters scale with the number of cores. With a
+    /// path, changed-path Bloom filters (see `changed_paths`) skip most
+    /// commits that didn't touch it before their trees are loaded; commits
+    /// without a filter yet are diffed as usual.
+    pub fn filter_commits(&self, branch_name: Option<&str>, filter: &CommitFilter, limit: usize) -> Result<Vec<Commit>> {
+        let tip = match branch_name {
+            Some(branch) => {
+                let reference = self.repo.find_reference(&format!("refs/heads/{}", branch))?;
+                reference.target().context("Branch has no target")?
+            }
+            None => self.repo.head()?.peel_to_commit()?.id(),
         };
+        let mut revwalk = self.repo.revwalk()?;
+        revwalk.push(tip)?;
+        revwalk.set_sorting(git2::Sort::TIME)?;
 
-        let mut file_changes = Vec::new();
+        let message = filter.message.as_ref().map(|m| m.to_lowercase());
+        let author = filter.author.as_ref().map(|a| a.to_lowercase());
+        let path = filter.path.as_ref().map(Path::new);
+        let bloom = path.and_then(|path| self.changed_paths(path, tip));
+        let candidates = revwalk.filter(|oid| match (&bloom, oid) {
+            (Some((filters, query)), Ok(oid)) => filters.maybe_changed(query, oid),
+            _ => true,
+        });
+
+        let oids = history_scan::scan(self.repo.path(), candidates, limit, |commit| {
+            if let Some(message) = &message {
+                if !String::from_utf8_lossy(commit.message_bytes()).to_lowercase().contains(message) {
+                    return Ok(false);
+                }
+            }
+            if let Some(author) = &author {
+                let sig = commit.author();
+                let name = String::from_utf8_lossy(sig.name_bytes()).to_lowercase();
+                let email = String::from_utf8_lossy(sig.email_bytes()).to_lowercase();
+                if !name.contains(author) && !email.contains(author) {
+                    return Ok(false);
+                }
+            }
+            match path {
+                Some(path) => history_scan::touches_path(commit, path),
+                None => Ok(true),
+            }
+        })?;
 
-        diff.foreach(
-            &mut |delta, _progress| {
-                let status = match delta.status() {
-                    git2::Delta::Added => "added",
-                    git2::Delta::Deleted => "deleted",
-                    git2::Delta::Modified => "modified",
-                    git2::Delta::Renamed => "renamed",
-                    _ => "unknown",
-                };
+        self.oids_to_commits(&oids)
+    }
 
-                let path = delta.new_file().path()
-                    .and_then(|p| p.to_str())
-                    .unwrap_or("")
-                    .to_string();
+    /// The Bloom filters built so far and the keys for `path`
+    ///
+    /// Filters missing for commits reachable from `tip` are built in the
+    /// background, so a first query never waits for the whole history.
+    fn changed_paths(&self, path: &Path, tip: Oid) -> Option<(ChangedPaths, PathQuery)> {
+        match ChangedPaths::open(&self.repo) {
+            Ok(filters) => {
+                if !filters.covers(tip) {
+                    ChangedPaths::update_in_background(self.repo.path(), tip);
+                }
+                let query = filters.query(path);
+                Some((filters, query))
+            }
+            Err(e) => {
+                tracing::debug!("changed-path filters unavailable for {:?}: {}", self.repo.path(), e);
+                None
+            }
+        }
+    }
 
-                let old_path = if status == "renamed" {
-                    delta.old_file().path()
-                        .and_then(|p| p.to_str())
-                        .map(|s| s.to_string())
-                } else {
-                    None
-                };
+    fn oids_to_commits(&self, oids: &[Oid]) -> Result<Vec<Commit>> {
+        oids.iter()
+            .map(|oid| self.commit_to_struct(&self.repo.find_commit(*oid)?))
+            .collect()
+    }
+
+    /// Get diff for a specific commit
+    ///
+    /// Served from the diff cache (see `diff_cache`) when possible.
+    pub fn get_commit_diff(&self, oid_str: &str) -> Result<(DiffStats, Vec<FileChange>)> {
+        self.get_commit_diff_with_options(oid_str, &CommitDiffOptions::default())
+    }
 
-                file_changes.push(FileChange {
-                    path,
-                    old_path,
-                    status: status.to_string(),
-                    insertions: 0, // Will be filled by line callback
-                    deletions: 0,
-                });
+    /// Get diff for a specific commit with non-default diff options
+    pub fn get_commit_diff_with_options(&self, oid_str: &str, options: &CommitDiffOptions) -> Result<(DiffStats, Vec<FileChange>)> {
+        let oid = Oid::from_str(oid_str)?;
+        diff_cache::get(&self.repo, oid, options)
+    }
 
-                true
-            },
-            None,
-            None,
-            None,
-        )?;
+    /// Stream a commit's changed files without building the whole diff
+    ///
+    /// # Arguments
+    /// * `oid_str` - Commit to diff against its first parent
+    /// * `options` - Per-file and total limits on content loaded for hunks
+    /// * `after` - Resume after this path (the last entry already seen)
+    pub fn diff_stream(&self, oid_str: &str, options: DiffStreamOptions, after: Option<&str>) -> Result<DiffStream<'_>> {
+        DiffStream::new(&self.repo, Oid::from_str(oid_str)?, options, after)
+    }
 
-        Ok((diff_stats, file_changes))
+    /// Warm the diff cache for commits about to be shown, off the caller's thread
+    pub fn prefetch_commit_diffs(&self, oids: &[String], options: &CommitDiffOptions) -> Result<()> {
+        let oids = oids.iter()
+            .map(|oid| Oid::from_str(oid))
+            .collect::<Result<Vec<_>, _>>()?;
+        diff_cache::prefetch(self.repo.path(), oids, *options);
+        Ok(())
     }
 
     /// Get the current branch name
@@ -291,11 +623,170 @@ impl GitHistory {
     }
 }
 
+/// Diff a commit against its first parent
+pub(crate) fn compute_commit_diff(repo: &Git2Repo, oid: Oid, options: &CommitDiffOptions) -> Result<(DiffStats, Vec<FileChange>)> {
+    let commit = repo.find_commit(oid)?;
+
+    let tree = commit.tree()?;
+    let parent_tree = if commit.parent_count() > 0 {
+        Some(commit.parent(0)?.tree()?)
+    } else {
+        None
+    };
+
+    let mut diff_opts = DiffOptions::new();
+    diff_opts.ignore_whitespace(options.ignore_whitespace);
+    let mut diff = repo.diff_tree_to_tree(
+        parent_tree.as_ref(),
+        Some(&tree),
+        Some(&mut diff_opts),
+    )?;
+    if options.detect_renames {
+        diff.find_similar(Some(DiffFindOptions::new().renames(true)))?;
+    }
+
+    let stats = diff.stats()?;
+    let diff_stats = DiffStats {
+        files_changed: stats.files_changed(),
+        insertions: stats.insertions(),
+        deletions: stats.deletions(),
+    };
+
+    let mut file_changes = Vec::new();
+
+    diff.foreach(
+        &mut |delta, _progress| {
+            let status = match delta.status() {
+                git2::Delta::Added => "added",
+                git2::Delta::Deleted => "deleted",
+                git2::Delta::Modified => "modified",
+                git2::Delta::Renamed => "renamed",
+                _ => "unknown",
+            };
+
+            let path = delta.new_file().path()
+                .and_then(|p| p.to_str())
+                .unwrap_or("")
+                .to_string();
+
+            let old_path = if status == "renamed" {
+                delta.old_file().path()
+                    .and_then(|p| p.to_str())
+                    .map(|s| s.to_string())
+            } else {
+                None
+            };
+
+            file_changes.push(FileChange {
+                path,
+                old_path,
+                status: status.to_string(),
+                insertions: 0, // Will be filled by line callback
+                deletions: 0,
+            });
+
+            true
+        },
+        None,
+        None,
+        None,
+    )?;
+
+    Ok((diff_stats, file_changes))
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
     use std::env;
 
+    #[test]
+    fn test_pages_match_full_walk() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let repo = Git2Repo::init(temp_dir.path()).unwrap();
+        let tree = repo.find_tree(repo.index().unwrap().write_tree().unwrap()).unwrap();
+
+        // Two branches merged back together, with some equal commit times
+        let commit = |parents: &[Oid], time: i64| {
+            let sig = git2::Signature::new("Test", "test@example.com", &git2::Time::new(time, 0)).unwrap();
+            let parents: Vec<_> = parents.iter().map(|oid| repo.find_commit(*oid).unwrap()).collect();
+            let parents: Vec<_> = parents.iter().collect();
+            repo.commit(None, &sig, &sig, &format!("at {}", time), &tree, &parents).unwrap()
+        };
+        let mut main = commit(&[], 1000);
+        let mut side = main;
+        for i in 0..20 {
+            main = commit(&[main], 2000 + i * 10);
+            side = commit(&[side], 2000 + i * 10 + (i % 3) * 5);
+        }
+        let merge = commit(&[main, side], 3000);
+        repo.reference("refs/heads/main", merge, true, "test").unwrap();
+        repo.set_head("refs/heads/main").unwrap();
+
+        let history = GitHistory::open(temp_dir.path()).unwrap();
+        let all: Vec<String> = history.get_commits(None, 1000, 0).unwrap().into_iter().map(|c| c.oid).collect();
+
+        let mut paged = Vec::new();
+        let mut cursor = None;
+        loop {
+            let page = history.get_commits_page(None, cursor.as_deref(), 4).unwrap();
+            paged.extend(page.commits.into_iter().map(|c| c.oid));
+            match page.next_cursor {
+                Some(next) => cursor = Some(next),
+                None => break,
+            }
+        }
+
+        // Paging must not change the order of one unpaged walk
+        let unpaged: Vec<String> = history.get_commits_page(None, None, 1000).unwrap()
+            .commits.into_iter().map(|c| c.oid).collect();
+        assert_eq!(all.len(), 42);
+        assert_eq!(paged, unpaged);
+
+        // and matches the revwalk, up to the order of commits with equal times
+        let time = |oid: &String| repo.find_commit(Oid::from_str(oid).unwrap()).unwrap().time().seconds();
+        assert_eq!(paged.iter().map(time).collect::<Vec<_>>(), all.iter().map(time).collect::<Vec<_>>());
+        let mut sorted_all = all.clone();
+        sorted_all.sort();
+        let mut sorted_paged = paged.clone();
+        sorted_paged.sort();
+        assert_eq!(sorted_paged, sorted_all);
+    }
+
+    #[test]
+    fn test_graph_page_with_clock_skew() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let repo = Git2Repo::init(temp_dir.path()).unwrap();
+        let tree = repo.find_tree(repo.index().unwrap().write_tree().unwrap()).unwrap();
+        let commit = |parents: &[Oid], time: i64| {
+            let sig = git2::Signature::new("Test", "test@example.com", &git2::Time::new(time, 0)).unwrap();
+            let parents: Vec<_> = parents.iter().map(|oid| repo.find_commit(*oid).unwrap()).collect();
+            let parents: Vec<_> = parents.iter().collect();
+            repo.commit(None, &sig, &sig, &format!("at {}", time), &tree, &parents).unwrap()
+        };
+
+        // `skewed` is dated after its child `late`, so the time-ordered walk
+        // reaches it (through `early`) before `late`
+        let root = commit(&[], 50);
+        let skewed = commit(&[root], 2000);
+        let early = commit(&[skewed], 2900);
+        let late = commit(&[skewed], 100);
+        let tip = commit(&[early, late], 3000);
+        repo.reference("refs/heads/main", tip, true, "test").unwrap();
+        repo.set_head("refs/heads/main").unwrap();
+
+        let history = GitHistory::open(temp_dir.path()).unwrap();
+        let page = history.get_graph_page(None, None, 100).unwrap();
+        let oids: Vec<String> = page.commits.iter().map(|c| c.oid.clone()).collect();
+        let expected: Vec<String> = [tip, early, skewed, late, root].iter().map(|oid| oid.to_string()).collect();
+        assert_eq!(oids, expected);
+        assert!(page.next_cursor.is_none());
+
+        // No lane is left waiting for `skewed`: the root row has one line into it
+        let offsets = &page.rows.edge_offsets;
+        assert_eq!(offsets[5] - offsets[4], 1);
+    }
+
     #[test]
     fn test_get_commits() {
         // This test assumes you're running it in a git repository
@@ -0,0 +1,150 @@
+//! Parallel History Scan
+//!
+//! Without an index, searching or filtering history decodes every commit on
+//! one thread. This engine takes oids from a revwalk in batches, matches them
+//! across the rayon pool with one repository handle per worker (so each
+//! worker has its own ODB and object cache), and keeps matches in walk
+//! order. Handles are dropped when the scan returns. Batches grow
+//! geometrically so a query with a small limit stops after decoding little
+//! more than it needs.
+
+use anyhow::Result;
+use git2::Oid;
+use rayon::prelude::*;
+use std::path::Path;
+
+/// Commits decoded in the first batch
+const FIRST_BATCH: usize = 1024;
+/// Largest batch, bounding wasted work past the last needed match
+const MAX_BATCH: usize = 64 * 1024;
+
+/// A rayon worker's handle on a repository, for `map_init` and friends
+///
+/// Opened on first use and dropped with the parallel call that created it,
+/// so no handle outlives the scan.
+pub(crate) struct WorkerRepo<'a> {
+    git_dir: &'a Path,
+    repo: Option<git2::Repository>,
+}
+
+impl<'a> WorkerRepo<'a> {
+    pub(crate) fn new(git_dir: &'a Path) -> Self {
+        Self { git_dir, repo: None }
+    }
+
+    /// Run `f` with this worker's handle, opening it if needed
+    pub(crate) fn with<R>(&mut self, f: impl FnOnce(&git2::Repository) -> Result<R>) -> Result<R> {
+        if self.repo.is_none() {
+            self.repo = Some(git2::Repository::open(self.git_dir)?);
+        }
+        f(self.repo.as_ref().unwrap())
+    }
+}
+
+/// Decode the commits from `oids` in parallel and keep those `matches` accepts
+///
+/// # Arguments
+/// * `git_dir` - The repository's `.git` directory, opened once per worker
+/// * `oids` - Commits in the order results should come back (e.g. a revwalk)
+/// * `limit` - Stop after this many matches
+/// * `matches` - Predicate, called on worker threads
+///
+/// # Returns
+/// Matching oids in `oids` order
+pub fn scan<I, F>(git_dir: &Path, oids: I, limit: usize, matches: F) -> Result<Vec<Oid>>
+where
+    I: IntoIterator<Item = std::result::Result<Oid, git2::Error>>,
+    F: Fn(&git2::Commit<'_>) -> Result<bool> + Sync,
+{
+    let mut oids = oids.into_iter();
+    let mut found = Vec::new();
+    let mut batch_size = FIRST_BATCH;
+    let mut batch = Vec::with_capacity(batch_size);
+
+    while found.len() < limit {
+        batch.clear();
+        for oid in oids.by_ref().take(batch_size) {
+            batch.push(oid?);
+        }
+        if batch.is_empty() {
+            break;
+        }
+
+        let results: Vec<Result<bool>> = batch.par_iter()
+            .map_init(|| WorkerRepo::new(git_dir), |worker, oid| worker.with(|repo| matches(&repo.find_commit(*oid)?)))
+            .collect();
+
+        for (oid, result) in batch.iter().zip(results) {
+            if result? {
+                found.push(*oid);
+                if found.len() == limit {
+                    break;
+                }
+            }
+        }
+
+        batch_size = (batch_size * 2).min(MAX_BATCH);
+    }
+
+    Ok(found)
+}
+
+/// True if `commit` changed `path` (a file or directory)
+///
+/// Like git's TREESAME check: a merge counts only if the path differs from
+/// every parent, and a root commit counts if the path exists.
+pub fn touches_path(commit: &git2::Commit<'_>, path: &Path) -> Result<bool> {
+    let entry_id = |tree: &git2::Tree<'_>| tree.get_path(path).ok().map(|entry| entry.id());
+
+    let current = entry_id(&commit.tree()?);
+    if commit.parent_count() == 0 {
+        return Ok(current.is_some());
+    }
+
+    for parent in commit.parents() {
+        if entry_id(&parent.tree()?) == current {
+            return Ok(false);
+        }
+    }
+    Ok(true)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_scan_keeps_walk_order() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        let sig = git2::Signature::now("Test", "test@example.com").unwrap();
+
+        let mut parent: Option<Oid> = None;
+        for i in 0..3000 {
+            let name = if i % 7 == 0 { "seven.txt" } else { "other.txt" };
+            std::fs::write(temp_dir.path().join(name), format!("{}", i)).unwrap();
+            let mut index = repo.index().unwrap();
+            index.add_path(Path::new(name)).unwrap();
+            let tree = repo.find_tree(index.write_tree().unwrap()).unwrap();
+            let parents: Vec<_> = parent.iter().map(|p| repo.find_commit(*p).unwrap()).collect();
+            let parents: Vec<_> = parents.iter().collect();
+            parent = Some(repo.commit(Some("HEAD"), &sig, &sig, &format!("commit {}", i), &tree, &parents).unwrap());
+        }
+
+        let sequential: Vec<Oid> = {
+            let mut revwalk = repo.revwalk().unwrap();
+            revwalk.push_head().unwrap();
+            revwalk.map(|oid| oid.unwrap())
+                .filter(|oid| touches_path(&repo.find_commit(*oid).unwrap(), Path::new("seven.txt")).unwrap())
+                .collect()
+        };
+
+        let mut revwalk = repo.revwalk().unwrap();
+        revwalk.push_head().unwrap();
+        let parallel = scan(repo.path(), revwalk, usize::MAX, |commit| touches_path(commit, Path::new("seven.txt"))).unwrap();
+
+        assert_eq!(sequential.len(), 3000 / 7 + 1);
+        assert_eq!(parallel, sequential);
+    }
+}
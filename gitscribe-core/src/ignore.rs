@@ -0,0 +1,780 @@
+//! Gitignore Matching
+//!
+//! Compiles ignore rule files (.gitignore, info/exclude, core.excludesFile)
+//! into rule lists with hashed fast paths for the common pattern shapes:
+//! literal names (`node_modules`), extensions (`*.log`) and anchored literal
+//! paths (`/build`). Everything else goes through a port of git's wildmatch,
+//! so results follow git's semantics exactly, including last-match-wins,
+//! negation, directory-only rules and excluded parent directories.
+//!
+//! Compiled rule files are cached process-wide and recompiled when the file's
+//! size or mtime changes.
+
+use anyhow::Result;
+use memchr::{memchr, memrchr};
+use std::collections::HashMap;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::time::SystemTime;
+
+/// Maximum number of compiled rule files kept in the process-wide cache
+const MAX_CACHED_FILES: usize = 4096;
+
+const FLAG_NEGATIVE: u8 = 1;
+const FLAG_MUST_BE_DIR: u8 = 2;
+const FLAG_NO_DIR: u8 = 4;
+const FLAG_ENDS_WITH: u8 = 8;
+
+/// A parsed ignore pattern (see git's `parse_path_pattern`)
+#[derive(Debug)]
+struct Pattern {
+    /// Pattern text without the `!` prefix and trailing `/`
+    text: Box<[u8]>,
+    /// Length of the leading part without glob characters
+    literal_len: usize,
+    flags: u8,
+}
+
+impl Pattern {
+    fn parse(line: &[u8]) -> Self {
+        let mut flags = 0;
+        let mut p = line;
+
+        if p.first() == Some(&b'!') {
+            flags |= FLAG_NEGATIVE;
+            p = &p[1..];
+        }
+
+        let mut len = p.len();
+        if len > 0 && p[len - 1] == b'/' {
+            len -= 1;
+            flags |= FLAG_MUST_BE_DIR;
+        }
+        if memchr(b'/', &p[..len]).is_none() {
+            flags |= FLAG_NO_DIR;
+        }
+        // git checks the suffix including any trailing slash
+        if p.first() == Some(&b'*') && simple_length(&p[1..]) == p.len() - 1 {
+            flags |= FLAG_ENDS_WITH;
+        }
+
+        Pattern {
+            text: p[..len].into(),
+            literal_len: simple_length(p).min(len),
+            flags,
+        }
+    }
+
+    fn has(&self, flag: u8) -> bool {
+        self.flags & flag != 0
+    }
+
+    fn is_literal(&self) -> bool {
+        self.literal_len == self.text.len()
+    }
+}
+
+fn is_glob_special(c: u8) -> bool {
+    matches!(c, b'*' | b'?' | b'[' | b'\\')
+}
+
+fn simple_length(s: &[u8]) -> usize {
+    s.iter().position(|&c| is_glob_special(c)).unwrap_or(s.len())
+}
+
+/// Compiled rules from one ignore file
+#[derive(Debug)]
+pub struct RuleList {
+    /// Directory containing the rule file, relative to the root ("" or "dir/")
+    base: String,
+    patterns: Vec<Pattern>,
+    ignore_case: bool,
+    /// Literal basename patterns (`node_modules`)
+    names: HashMap<Box<[u8]>, Vec<u32>>,
+    /// Extension patterns (`*.log`), keyed by the text after the last dot
+    extensions: HashMap<Box<[u8]>, Vec<u32>>,
+    /// Anchored literal patterns (`/build`), keyed by full path
+    paths: HashMap<Box<[u8]>, Vec<u32>>,
+    /// Everything else, checked with wildmatch
+    general: Vec<u32>,
+}
+
+impl RuleList {
+    /// Compile the contents of an ignore file
+    ///
+    /// # Arguments
+    /// * `contents` - Raw file contents
+    /// * `base` - Directory of the file relative to the root ("" or "dir/")
+    /// * `ignore_case` - Match case-insensitively (core.ignorecase)
+    pub fn parse(contents: &[u8], base: &str, ignore_case: bool) -> Self {
+        let mut list = RuleList {
+            base: base.to_string(),
+            patterns: Vec::new(),
+            ignore_case,
+            names: HashMap::new(),
+            extensions: HashMap::new(),
+            paths: HashMap::new(),
+            general: Vec::new(),
+        };
+
+        let contents = contents.strip_prefix(b"\xef\xbb\xbf").unwrap_or(contents);
+
+        for line in contents.split(|&c| c == b'\n') {
+            let line = line.strip_suffix(b"\r").unwrap_or(line);
+            if line.is_empty() || line[0] == b'#' {
+                continue;
+            }
+
+            let pattern = Pattern::parse(trim_trailing_spaces(line));
+            let idx = list.patterns.len() as u32;
+            let text = &pattern.text;
+
+            if pattern.has(FLAG_NO_DIR) && pattern.is_literal() {
+                list.names.entry(list.key(text)).or_default().push(idx);
+            } else if pattern.has(FLAG_NO_DIR)
+                && pattern.has(FLAG_ENDS_WITH)
+                && text.get(1) == Some(&b'.')
+                && memchr(b'.', &text[2..]).is_none()
+            {
+                list.extensions.entry(list.key(&text[2..])).or_default().push(idx);
+            } else if !pattern.has(FLAG_NO_DIR) && pattern.is_literal() {
+                let relative = text.strip_prefix(b"/").unwrap_or(text);
+                let full = [base.as_bytes(), relative].concat();
+                list.paths.entry(list.key(&full)).or_default().push(idx);
+            } else {
+                list.general.push(idx);
+            }
+
+            list.patterns.push(pattern);
+        }
+
+        list
+    }
+
+    fn key(&self, bytes: &[u8]) -> Box<[u8]> {
+        if self.ignore_case {
+            bytes.to_ascii_lowercase().into()
+        } else {
+            bytes.into()
+        }
+    }
+
+    /// Whether the list has no patterns
+    pub fn is_empty(&self) -> bool {
+        self.patterns.is_empty()
+    }
+
+    /// Find the last pattern matching `path` (relative to the root)
+    ///
+    /// Returns Some(true) if that pattern ignores the path, Some(false) if it
+    /// re-includes it with `!`, or None if no pattern matches.
+    pub fn matches(&self, path: &str, is_dir: bool) -> Option<bool> {
+        let path = path.as_bytes();
+        let basename = match memrchr(b'/', path) {
+            Some(i) => &path[i + 1..],
+            None => path,
+        };
+
+        let dir_ok = |idx: u32| is_dir || !self.patterns[idx as usize].has(FLAG_MUST_BE_DIR);
+        let last_in = |ids: Option<&Vec<u32>>| ids.and_then(|ids| ids.iter().rev().copied().find(|&i| dir_ok(i)));
+
+        // Hashed buckets only contain patterns that match by construction
+        let mut best = last_in(self.names.get(&*self.key(basename)));
+
+        if let Some(dot) = memrchr(b'.', basename) {
+            best = best.max(last_in(self.extensions.get(&*self.key(&basename[dot + 1..]))));
+        }
+
+        best = best.max(last_in(self.paths.get(&*self.key(path))));
+
+        for &idx in self.general.iter().rev() {
+            if best.map_or(false, |b| b > idx) {
+                break;
+            }
+            if dir_ok(idx) && self.pattern_matches(&self.patterns[idx as usize], path, basename) {
+                best = Some(idx);
+                break;
+            }
+        }
+
+        best.map(|idx| !self.patterns[idx as usize].has(FLAG_NEGATIVE))
+    }
+
+    fn pattern_matches(&self, pattern: &Pattern, path: &[u8], basename: &[u8]) -> bool {
+        if pattern.has(FLAG_NO_DIR) {
+            self.match_basename(pattern, basename)
+        } else {
+            let base = self.base.as_bytes();
+            self.match_pathname(pattern, path, &base[..base.len().saturating_sub(1)])
+        }
+    }
+
+    /// See git's `match_basename`
+    fn match_basename(&self, pattern: &Pattern, basename: &[u8]) -> bool {
+        let text = &pattern.text[..];
+
+        if pattern.is_literal() {
+            text.len() == basename.len() && self.eq(text, basename)
+        } else if pattern.has(FLAG_ENDS_WITH) {
+            let suffix = &text[1..];
+            suffix.len() <= basename.len() && self.eq(suffix, &basename[basename.len() - suffix.len()..])
+        } else {
+            wildmatch(text, basename, false, self.ignore_case)
+        }
+    }
+
+    /// See git's `match_pathname`; `base` has no trailing slash
+    fn match_pathname(&self, pattern: &Pattern, path: &[u8], base: &[u8]) -> bool {
+        let mut text = &pattern.text[..];
+        let mut literal_len = pattern.literal_len;
+
+        if text.first() == Some(&b'/') {
+            text = &text[1..];
+            literal_len = literal_len.saturating_sub(1);
+        }
+
+        if path.len() < base.len() + 1
+            || (!base.is_empty() && path[base.len()] != b'/')
+            || !self.eq(&path[..base.len()], base)
+        {
+            return false;
+        }
+
+        let mut name = if base.is_empty() { path } else { &path[base.len() + 1..] };
+
+        if literal_len > 0 {
+            if literal_len > name.len() || !self.eq(&text[..literal_len], &name[..literal_len]) {
+                return false;
+            }
+            text = &text[literal_len..];
+            name = &name[literal_len..];
+            if text.is_empty() && name.is_empty() {
+                return true;
+            }
+        }
+
+        wildmatch(text, name, true, self.ignore_case)
+    }
+
+    fn eq(&self, a: &[u8], b: &[u8]) -> bool {
+        if self.ignore_case { a.eq_ignore_ascii_case(b) } else { a == b }
+    }
+}
+
+/// Remove unescaped trailing spaces (see git's `trim_trailing_spaces`)
+fn trim_trailing_spaces(line: &[u8]) -> &[u8] {
+    let mut last_space = None;
+    let mut i = 0;
+
+    while i < line.len() {
+        match line[i] {
+            b' ' => {
+                last_space.get_or_insert(i);
+            }
+            b'\\' => {
+                i += 1;
+                if i == line.len() {
+                    return line;
+                }
+                last_space = None;
+            }
+            _ => last_space = None,
+        }
+        i += 1;
+    }
+
+    &line[..last_space.unwrap_or(line.len())]
+}
+
+const WM_MATCH: i32 = 0;
+const WM_NOMATCH: i32 = 1;
+const WM_ABORT_ALL: i32 = -1;
+const WM_ABORT_TO_STARSTAR: i32 = -2;
+
+/// Match `text` against a glob pattern (port of git's wildmatch)
+///
+/// # Arguments
+/// * `pathname` - `*` and `?` do not match `/` (WM_PATHNAME)
+/// * `casefold` - Match ASCII letters case-insensitively (WM_CASEFOLD)
+pub fn wildmatch(pattern: &[u8], text: &[u8], pathname: bool, casefold: bool) -> bool {
+    dowild(pattern, text, pathname, casefold) == WM_MATCH
+}
+
+fn dowild(pat: &[u8], text: &[u8], pathname: bool, casefold: bool) -> i32 {
+    // Out of range reads as NUL, like the C strings wildmatch was written for
+    let at = |s: &[u8], i: usize| s.get(i).copied().unwrap_or(0);
+    let fold = |c: u8| if casefold { c.to_ascii_lowercase() } else { c };
+
+    let mut p = 0;
+    let mut t = 0;
+
+    while p < pat.len() {
+        let mut p_ch = fold(pat[p]);
+        let mut t_ch = at(text, t);
+        if t_ch == 0 && p_ch != b'*' {
+            return WM_ABORT_ALL;
+        }
+        t_ch = fold(t_ch);
+
+        match p_ch {
+            b'?' => {
+                if pathname && t_ch == b'/' {
+                    return WM_NOMATCH;
+                }
+            }
+            b'*' => {
+                let match_slash;
+                p += 1;
+                if at(pat, p) == b'*' {
+                    let boundary_before = p < 2 || pat[p - 2] == b'/';
+                    while at(pat, p) == b'*' {
+                        p += 1;
+                    }
+                    let next = at(pat, p);
+                    if boundary_before && (next == 0 || next == b'/' || (next == b'\\' && at(pat, p + 1) == b'/')) {
+                        // "**/" may match no directories at all
+                        if next == b'/' && dowild(&pat[p + 1..], &text[t..], pathname, casefold) == WM_MATCH {
+                            return WM_MATCH;
+                        }
+                        match_slash = true;
+                    } else {
+                        match_slash = false;
+                    }
+                } else {
+                    match_slash = !pathname;
+                }
+
+                if p == pat.len() {
+                    // Trailing "**" matches everything, trailing "*" only within the component
+                    if !match_slash && memchr(b'/', &text[t..]).is_some() {
+                        return WM_NOMATCH;
+                    }
+                    return WM_MATCH;
+                } else if !match_slash && pat[p] == b'/' {
+                    // A single "*" followed by a slash matches the next directory
+                    match memchr(b'/', &text[t..]) {
+                        Some(i) => t += i,
+                        None => return WM_NOMATCH,
+                    }
+                    p += 1;
+                    t += 1;
+                    continue;
+                }
+
+                loop {
+                    if t_ch == 0 {
+                        break;
+                    }
+                    // Skip ahead to the next occurrence of a literal following the star
+                    if !is_glob_special(pat[p]) {
+                        let literal = fold(pat[p]);
+                        loop {
+                            t_ch = at(text, t);
+                            if t_ch == 0 || (!match_slash && t_ch == b'/') {
+                                break;
+                            }
+                            t_ch = fold(t_ch);
+                            if t_ch == literal {
+                                break;
+                            }
+                            t += 1;
+                        }
+                        if t_ch != literal {
+                            return WM_NOMATCH;
+                        }
+                    }
+
+                    let matched = dowild(&pat[p..], &text[t..], pathname, casefold);
+                    if matched != WM_NOMATCH {
+                        if !match_slash || matched != WM_ABORT_TO_STARSTAR {
+                            return matched;
+                        }
+                    } else if !match_slash && t_ch == b'/' {
+                        return WM_ABORT_TO_STARSTAR;
+                    }
+                    t += 1;
+                    t_ch = at(text, t);
+                }
+                return WM_ABORT_ALL;
+            }
+            b'[' => {
+                p += 1;
+                p_ch = at(pat, p);
+                if p_ch == b'^' {
+                    p_ch = b'!';
+                }
+                let negated = p_ch == b'!';
+                if negated {
+                    p += 1;
+                    p_ch = at(pat, p);
+                }
+
+                let mut prev_ch = 0u8;
+                let mut matched = false;
+
+                loop {
+                    if p_ch == 0 {
+                        return WM_ABORT_ALL;
+                    }
+                    if p_ch == b'\\' {
+                        p += 1;
+                        p_ch = at(pat, p);
+                        if p_ch == 0 {
+                            return WM_ABORT_ALL;
+                        }
+                        if t_ch == p_ch {
+                            matched = true;
+                        }
+                    } else if p_ch == b'-' && prev_ch != 0 && at(pat, p + 1) != 0 && at(pat, p + 1) != b']' {
+                        p += 1;
+                        p_ch = at(pat, p);
+                        if p_ch == b'\\' {
+                            p += 1;
+                            p_ch = at(pat, p);
+                            if p_ch == 0 {
+                                return WM_ABORT_ALL;
+                            }
+                        }
+                        if t_ch <= p_ch && t_ch >= prev_ch {
+                            matched = true;
+                        } else if casefold && t_ch.is_ascii_lowercase() {
+                            let upper = t_ch.to_ascii_uppercase();
+                            if upper <= p_ch && upper >= prev_ch {
+                                matched = true;
+                            }
+                        }
+                        p_ch = 0; // Resets prev_ch
+                    } else if p_ch == b'[' && at(pat, p + 1) == b':' {
+                        p += 2;
+                        let start = p;
+                        while at(pat, p) != 0 && at(pat, p) != b']' {
+                            p += 1;
+                        }
+                        p_ch = at(pat, p);
+                        if p_ch == 0 {
+                            return WM_ABORT_ALL;
+                        }
+                        if p == start || pat[p - 1] != b':' {
+                            // No ":]", so treat the "[" like a normal set member
+                            p = start - 2;
+                            p_ch = b'[';
+                            if t_ch == p_ch {
+                                matched = true;
+                            }
+                        } else {
+                            match char_class(&pat[start..p - 1], t_ch, casefold) {
+                                Some(true) => matched = true,
+                                Some(false) => {}
+                                None => return WM_ABORT_ALL,
+                            }
+                            p_ch = 0; // Resets prev_ch
+                        }
+                    } else if t_ch == p_ch {
+                        matched = true;
+                    }
+
+                    prev_ch = p_ch;
+                    p += 1;
+                    p_ch = at(pat, p);
+                    if p_ch == b']' {
+                        break;
+                    }
+                }
+
+                if matched == negated || (pathname && t_ch == b'/') {
+                    return WM_NOMATCH;
+                }
+            }
+            b'\\' => {
+                p += 1;
+                if t_ch != at(pat, p) {
+                    return WM_NOMATCH;
+                }
+            }
+            _ => {
+                if t_ch != p_ch {
+                    return WM_NOMATCH;
+                }
+            }
+        }
+
+        p += 1;
+        t += 1;
+    }
+
+    if t < text.len() { WM_NOMATCH } else { WM_MATCH }
+}
+
+/// Test a character against a POSIX class name, or None if the name is unknown
+fn char_class(name: &[u8], c: u8, casefold: bool) -> Option<bool> {
+    Some(match name {
+        b"alnum" => c.is_ascii_alphanumeric(),
+        b"alpha" => c.is_ascii_alphabetic(),
+        b"blank" => c == b' ' || c == b'\t',
+        b"cntrl" => c.is_ascii_control(),
+        b"digit" => c.is_ascii_digit(),
+        b"graph" => c.is_ascii_graphic(),
+        b"lower" => c.is_ascii_lowercase(),
+        b"print" => (0x20..=0x7e).contains(&c),
+        b"punct" => c.is_ascii_punctuation(),
+        b"space" => matches!(c, b' ' | b'\t' | b'\n' | b'\r'),
+        b"upper" => c.is_ascii_uppercase() || (casefold && c.is_ascii_lowercase()),
+        b"xdigit" => c.is_ascii_hexdigit(),
+        _ => return None,
+    })
+}
+
+type FileStamp = (u64, Option<SystemTime>);
+
+fn rule_cache() -> &'static Mutex<HashMap<(PathBuf, String, bool), (FileStamp, Arc<RuleList>)>> {
+    static CACHE: OnceLock<Mutex<HashMap<(PathBuf, String, bool), (FileStamp, Arc<RuleList>)>>> = OnceLock::new();
+    CACHE.get_or_init(|| Mutex::new(HashMap::new()))
+}
+
+/// Load a compiled rule file, reusing the cached copy while the file is unchanged
+///
+/// Returns None if the file does not exist or has no patterns.
+pub fn load_rules(path: &Path, base: &str, ignore_case: bool) -> Option<Arc<RuleList>> {
+    let meta = fs::metadata(path).ok().filter(|m| m.is_file())?;
+    let stamp = (meta.len(), meta.modified().ok());
+    let key = (path.to_path_buf(), base.to_string(), ignore_case);
+
+    if let Some((cached_stamp, list)) = rule_cache().lock().unwrap().get(&key) {
+        if *cached_stamp == stamp {
+            return Some(list.clone()).filter(|l| !l.is_empty());
+        }
+    }
+
+    let list = Arc::new(RuleList::parse(&fs::read(path).ok()?, base, ignore_case));
+
+    let mut cache = rule_cache().lock().unwrap();
+    if cache.len() >= MAX_CACHED_FILES {
+        cache.clear();
+    }
+    cache.insert(key, (stamp, list.clone()));
+
+    Some(list).filter(|l| !l.is_empty())
+}
+
+/// Ignore rules in effect for one directory of a working tree
+///
+/// Built incrementally while walking: `enter` pushes the subdirectory's
+/// .gitignore. Cloning is cheap (rule lists are shared).
+#[derive(Debug, Clone)]
+pub struct IgnoreStack {
+    /// .gitignore lists from the root down to this directory
+    dirs: Vec<Arc<RuleList>>,
+    /// info/exclude, then core.excludesFile
+    global: Arc<Vec<Arc<RuleList>>>,
+    ignore_case: bool,
+    /// This directory is ignored, so everything below it is too
+    excluded: bool,
+}
+
+impl IgnoreStack {
+    /// Create the stack for the root of a working tree
+    ///
+    /// # Arguments
+    /// * `workdir` - The working tree root
+    /// * `git_dir` - The repository's git directory (for info/exclude)
+    /// * `excludes_file` - core.excludesFile, if any
+    /// * `ignore_case` - Match case-insensitively (core.ignorecase)
+    pub fn new(workdir: &Path, git_dir: &Path, excludes_file: Option<&Path>, ignore_case: bool) -> Self {
+        let exclude = crate::repository::common_dir(git_dir).join("info").join("exclude");
+        let global = [Some(exclude.as_path()), excludes_file]
+            .into_iter()
+            .flatten()
+            .filter_map(|path| load_rules(path, "", ignore_case))
+            .collect();
+
+        IgnoreStack {
+            dirs: load_rules(&workdir.join(".gitignore"), "", ignore_case).into_iter().collect(),
+            global: Arc::new(global),
+            ignore_case,
+            excluded: false,
+        }
+    }
+
+    /// Create the root stack for a repository using its configuration
+    ///
+    /// Returns None for bare repositories.
+    pub fn for_repo(repo: &git2::Repository) -> Result<Option<Self>> {
+        let workdir = match repo.workdir() {
+            Some(dir) => dir,
+            None => return Ok(None),
+        };
+
+        let config = repo.config()?;
+        let excludes_file = config.get_path("core.excludesFile").ok().or_else(|| {
+            std::env::var_os("XDG_CONFIG_HOME")
+                .map(PathBuf::from)
+                .or_else(|| std::env::var_os("HOME").map(|home| PathBuf::from(home).join(".config")))
+                .map(|dir| dir.join("git").join("ignore"))
+        });
+        let ignore_case = config.get_bool("core.ignorecase").unwrap_or(false);
+
+        Ok(Some(Self::new(workdir, repo.path(), excludes_file.as_deref(), ignore_case)))
+    }
+
+    /// Whether this directory itself is ignored
+    pub fn is_excluded(&self) -> bool {
+        self.excluded
+    }
+
+    /// Stack for subdirectory `dir` (relative to the root, no trailing slash)
+    pub fn enter(&self, workdir: &Path, dir: &str) -> Self {
+        let mut child = self.clone();
+        child.excluded = self.is_ignored(dir, true);
+
+        // git does not read rule files inside ignored directories
+        if !child.excluded {
+            let base = format!("{}/", dir);
+            if let Some(list) = load_rules(&workdir.join(dir).join(".gitignore"), &base, self.ignore_case) {
+                child.dirs.push(list);
+            }
+        }
+
+        child
+    }
+
+    /// Whether `path` (relative to the root, inside this directory) is ignored
+    pub fn is_ignored(&self, path: &str, is_dir: bool) -> bool {
+        if self.excluded {
+            return true;
+        }
+
+        // Deeper .gitignore files win, then info/exclude, then core.excludesFile
+        self.dirs.iter().rev()
+            .chain(self.global.iter())
+            .find_map(|list| list.matches(path, is_dir))
+            .unwrap_or(false)
+    }
+}
+
+/// Checks arbitrary paths of a working tree against its ignore rules
+pub struct IgnoreMatcher {
+    workdir: PathBuf,
+    root: IgnoreStack,
+}
+
+impl IgnoreMatcher {
+    /// Create a matcher for a working tree (see `IgnoreStack::new`)
+    pub fn new(workdir: &Path, git_dir: &Path, excludes_file: Option<&Path>, ignore_case: bool) -> Self {
+        IgnoreMatcher {
+            workdir: workdir.to_path_buf(),
+            root: IgnoreStack::new(workdir, git_dir, excludes_file, ignore_case),
+        }
+    }
+
+    /// Check a path relative to the working tree root ('/' separated)
+    pub fn is_ignored(&self, path: &str, is_dir: bool) -> bool {
+        let mut stack = self.root.clone();
+        let mut end = 0;
+
+        while let Some(i) = memchr(b'/', &path.as_bytes()[end..]) {
+            stack = stack.enter(&self.workdir, &path[..end + i]);
+            if stack.is_excluded() {
+                return true;
+            }
+            end += i + 1;
+        }
+
+        stack.is_ignored(path, is_dir)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::process::Command;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_wildmatch() {
+        let cases: &[(&str, &str, bool)] = &[
+            ("foo/**/bar", "foo/bar", true),
+            ("foo/**/bar", "foo/a/b/bar", true),
+            ("**/foo", "a/b/foo", true),
+            ("foo/*", "foo/a/b", false),
+            ("foo/**", "foo/a/b", true),
+            ("a[!b]c", "abc", false),
+            ("a[^b]c", "axc", true),
+            ("[[:digit:]]*", "7up", true),
+            ("[]]", "]", true),
+            ("a\\*b", "a*b", true),
+            ("a**b", "a/xb", false),
+            ("*.[oa]", "x.o", true),
+        ];
+
+        for &(pattern, text, expected) in cases {
+            assert_eq!(wildmatch(pattern.as_bytes(), text.as_bytes(), true, false), expected,
+                "{} vs {}", pattern, text);
+        }
+    }
+
+    #[test]
+    fn test_matches_git_check_ignore() {
+        let temp_dir = TempDir::new().unwrap();
+        let root = temp_dir.path();
+
+        let initialized = Command::new("git").arg("init").arg("-q").arg(root).status();
+        if !initialized.map(|s| s.success()).unwrap_or(false) {
+            return; // git not available
+        }
+
+        fs::write(root.join(".gitignore"), concat!(
+            "# comment\n", "\\#hash\n", "*.log\n", "!keep.log\n", "/build/\n",
+            "node_modules\n", "docs/**/*.tmp\n", "**/cache\n", "foo/*/bar\n",
+            "*.[oa]\n", "[[:digit:]]*.dat\n", "space\\ \n", "trail  \n", "abc?\n",
+            "vendor/**\n", "!vendor/keep/\n", "dir_only/\n", "\\!bang\n",
+            "**/deep/**/x\n", "Mixed*\n", "*.tar.gz\n",
+        )).unwrap();
+        fs::write(root.join(".git/info/exclude"), "secret*\n").unwrap();
+
+        fs::create_dir_all(root.join("other/nested")).unwrap();
+        fs::write(root.join("other/.gitignore"), "*.txt\n!important.txt\n/local\nnested/\n").unwrap();
+
+        let files = [
+            "a.log", "keep.log", "sub/keep.log", "build/out", "src/build/out", "node_modules/x/y.js",
+            "src/node_modules", "docs/a/b/c.tmp", "docs/c.tmp", "x.tmp", "a/cache/z", "cache",
+            "foo/x/bar", "foo/x/y/bar", "lib.o", "lib.a", "lib.c", "1.dat", "a1.dat", "#hash",
+            "space ", "trail", "abcd", "abc", "vendor/a.js", "vendor/keep/b.js", "dir_only/f",
+            "src/dir_only", "!bang", "p/deep/q/r/x", "deep/x", "MixedCase", "mixed", "pkg.tar.gz",
+            "secret.key", "src/secretive", "other/a.txt", "other/important.txt", "other/local",
+            "local", "other/nested/f", "nested/f", "other/sub/a.txt", "other/sub/local", "plain.rs",
+        ];
+        for file in &files {
+            let path = root.join(file);
+            fs::create_dir_all(path.parent().unwrap()).unwrap();
+            fs::write(&path, "x").unwrap();
+        }
+
+        let mut queries: Vec<String> = files.iter().map(|f| f.to_string()).collect();
+        queries.extend(["build", "src/build", "vendor/keep", "dir_only", "other/nested", "docs/a"].map(String::from));
+
+        let output = Command::new("git")
+            .current_dir(root)
+            .args(["-c", "core.excludesFile=", "check-ignore", "--no-index", "--stdin", "-z"])
+            .stdin(std::process::Stdio::piped())
+            .stdout(std::process::Stdio::piped())
+            .spawn()
+            .and_then(|mut child| {
+                use std::io::Write;
+                child.stdin.take().unwrap().write_all((queries.join("\0") + "\0").as_bytes())?;
+                child.wait_with_output()
+            })
+            .unwrap();
+        let expected: Vec<&str> = std::str::from_utf8(&output.stdout).unwrap()
+            .split('\0')
+            .filter(|s| !s.is_empty())
+            .collect();
+        assert!(!expected.is_empty());
+
+        let matcher = IgnoreMatcher::new(root, &root.join(".git"), None, false);
+        for query in &queries {
+            let is_dir = root.join(query).is_dir();
+            assert_eq!(matcher.is_ignored(query, is_dir), expected.contains(&query.as_str()), "{}", query);
+        }
+    }
+}
@@ -5,12 +5,33 @@
 
 pub mod repository;
 pub mod status;
+pub mod scanner;
+pub mod ignore;
+pub mod blob_hash;
 pub mod cache;
+pub mod status_log;
+pub mod maintenance;
+pub mod scheduler;
+pub mod warmup;
 pub mod ffi;
 pub mod oplog;
+pub mod oplog_file;
 pub mod stash;
+pub mod stash_store;
 pub mod temp_ignore;
 pub mod history;
+pub mod branch_list;
+pub mod search_index;
+pub mod history_scan;
+pub mod changed_paths;
+pub mod diff_cache;
+pub mod diff_stream;
+pub mod line_diff;
+pub mod blame;
+pub mod commit_graph;
+pub mod graph_layout;
+pub mod ahead_behind;
+pub mod fingerprint;
 
 // N-API bindings for Node.js (optional)
 #[cfg(feature = "napi-bindings")]
@@ -19,9 +40,15 @@ pub mod napi;
 // Re-export main types
 pub use repository::{Repository, RepoState, RemoteStatus};
 pub use status::FileStatusEntry;
+pub use scanner::ScanOptions;
+pub use ignore::{IgnoreMatcher, IgnoreStack};
 // Export status FileStatus with a different name to avoid conflicts
 pub use status::FileStatus as StatusFileStatus;
-pub use cache::StatusCache;
+pub use cache::{StatusCache, CacheBackend, CacheStats};
+pub use maintenance::{MaintenancePolicy, MaintenanceReport, MaintenanceWorker};
+pub use scheduler::{Scheduler, SchedulerConfig};
+pub use warmup::{Warmup, WarmupPolicy, WarmupReport, WarmupStop};
+pub use cache::{OperationPriority, OperationStatus};
 pub use oplog::{OperationLog, Operation, OperationType};
 pub use stash::{
     VisualStashManager, VisualStash, StashedFile,
@@ -30,7 +57,16 @@ pub use stash::{
 // Export stash FileStatus separately with explicit alias
 pub use stash::FileStatus as StashFileStatus;
 pub use temp_ignore::{TempIgnoreManager, TemporaryIgnore, IncludeCondition, TempIgnoreSettings};
-pub use history::{GitHistory, Commit, Branch, DiffStats, FileChange};
+pub use history::{GitHistory, Commit, CommitDiffOptions, CommitFilter, CommitPage, GraphPage, Branch, DiffStats, FileChange};
+pub use search_index::SearchIndex;
+pub use changed_paths::ChangedPaths;
+pub use diff_stream::{DiffStream, DiffStreamOptions, DiffEntry, DiffHunk, DiffLine};
+pub use line_diff::{LineDiff, DiffAlgorithm};
+pub use blame::{BlameStream, BlameHunk};
+pub use graph_layout::{GraphLayout, GraphRows};
+pub use branch_list::BranchTip;
+pub use ahead_behind::AheadBehind;
+pub use fingerprint::RepoFingerprint;
 
 /// Library version
 pub const VERSION: &str = env!("CARGO_PKG_VERSION");
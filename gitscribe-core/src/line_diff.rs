@@ -0,0 +1,529 @@
+//! In-Process Line Diff
+//!
+//! Line diff for the diff viewer without a round trip through libgit2's
+//! xdiff. Lines are split with memchr's vectorized newline search, hashed a
+//! word at a time and interned to integers, so the diff algorithms compare
+//! `u32`s instead of byte strings.
+//!
+//! Two algorithms are offered. Myers finds a minimal edit script in linear
+//! space and gives up on minimality past a cost bound, like xdiff. Histogram
+//! (from JGit) anchors on the rarest common lines first, which reads better
+//! for moved code. Both trim the common prefix and suffix first, and Myers
+//! drops lines that only exist on one side before it starts.
+
+use memchr::memchr_iter;
+use serde::{Deserialize, Serialize};
+use std::collections::HashMap;
+use std::hash::{BuildHasherDefault, Hasher};
+
+use crate::diff_stream::{DiffHunk, DiffLine};
+
+/// Lower bound on the Myers edit cost before it settles for a non-minimal split
+const MIN_MAX_COST: usize = 256;
+/// Histogram falls back to Myers when every common line is this frequent
+const MAX_CHAIN_LENGTH: usize = 64;
+
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Serialize, Deserialize)]
+pub enum DiffAlgorithm {
+    #[default]
+    Myers,
+    Histogram,
+}
+
+/// Changed lines between two texts
+pub struct LineDiff<'a> {
+    old: Vec<&'a [u8]>,
+    new: Vec<&'a [u8]>,
+    old_changed: Vec<bool>,
+    new_changed: Vec<bool>,
+}
+
+impl<'a> LineDiff<'a> {
+    /// Diff two texts line by line
+    pub fn compute(old: &'a [u8], new: &'a [u8], algorithm: DiffAlgorithm) -> Self {
+        let old = split_lines(old);
+        let new = split_lines(new);
+        let (old_ids, new_ids, num_ids) = intern(&old, &new);
+
+        let mut old_changed = vec![false; old.len()];
+        let mut new_changed = vec![false; new.len()];
+        match algorithm {
+            DiffAlgorithm::Myers => myers_discarding(&old_ids, &new_ids, num_ids, &mut old_changed, &mut new_changed),
+            DiffAlgorithm::Histogram => histogram(&old_ids, &new_ids, num_ids, &mut old_changed, &mut new_changed),
+        }
+
+        Self { old, new, old_changed, new_changed }
+    }
+
+    /// Lines only in the new text
+    pub fn insertions(&self) -> usize {
+        self.new_changed.iter().filter(|c| **c).count()
+    }
+
+    /// Lines only in the old text
+    pub fn deletions(&self) -> usize {
+        self.old_changed.iter().filter(|c| **c).count()
+    }
+
+    /// Number of lines in the new text
+    pub fn new_len(&self) -> usize {
+        self.new.len()
+    }
+
+    /// Unchanged lines as (old index, new index) pairs, in order
+    pub fn unchanged(&self) -> impl Iterator<Item = (usize, usize)> + '_ {
+        let old = self.old_changed.iter().enumerate().filter(|(_, c)| !**c).map(|(i, _)| i);
+        let new = self.new_changed.iter().enumerate().filter(|(_, c)| !**c).map(|(j, _)| j);
+        old.zip(new)
+    }
+
+    /// Group changes into hunks with `context` unchanged lines around them
+    pub fn hunks(&self, context: u32) -> Vec<DiffHunk> {
+        let context = context as usize;
+        let (n, m) = (self.old.len(), self.new.len());
+
+        // Runs of changes as (old_start, old_end, new_start, new_end)
+        let mut groups: Vec<(usize, usize, usize, usize)> = Vec::new();
+        let (mut i, mut j) = (0, 0);
+        while i < n || j < m {
+            if i < n && j < m && !self.old_changed[i] && !self.new_changed[j] {
+                i += 1;
+                j += 1;
+                continue;
+            }
+            let (i0, j0) = (i, j);
+            while i < n && self.old_changed[i] {
+                i += 1;
+            }
+            while j < m && self.new_changed[j] {
+                j += 1;
+            }
+            groups.push((i0, i, j0, j));
+        }
+
+        let mut hunks = Vec::new();
+        let mut g = 0;
+        while g < groups.len() {
+            // Merge groups whose contexts would touch
+            let mut last = g;
+            while last + 1 < groups.len() && groups[last + 1].0 - groups[last].1 <= 2 * context {
+                last += 1;
+            }
+
+            let lead = context.min(groups[g].0);
+            let (old_start, new_start) = (groups[g].0 - lead, groups[g].2 - lead);
+            let trail = context.min(n - groups[last].1);
+            let (old_end, new_end) = (groups[last].1 + trail, groups[last].3 + trail);
+            hunks.push(self.hunk(old_start, old_end, new_start, new_end));
+
+            g = last + 1;
+        }
+        hunks
+    }
+
+    fn hunk(&self, old_start: usize, old_end: usize, new_start: usize, new_end: usize) -> DiffHunk {
+        let line = |origin: char, text: &[u8], old_lineno: Option<usize>, new_lineno: Option<usize>| DiffLine {
+            origin,
+            content: String::from_utf8_lossy(text).into_owned(),
+            old_lineno: old_lineno.map(|l| l as u32 + 1),
+            new_lineno: new_lineno.map(|l| l as u32 + 1),
+        };
+
+        let mut lines = Vec::with_capacity(old_end - old_start + new_end - new_start);
+        let (mut i, mut j) = (old_start, new_start);
+        while i < old_end || j < new_end {
+            if i < old_end && j < new_end && !self.old_changed[i] && !self.new_changed[j] {
+                lines.push(line(' ', self.old[i], Some(i), Some(j)));
+                i += 1;
+                j += 1;
+                continue;
+            }
+            while i < old_end && self.old_changed[i] {
+                lines.push(line('-', self.old[i], Some(i), None));
+                i += 1;
+            }
+            while j < new_end && self.new_changed[j] {
+                lines.push(line('+', self.new[j], None, Some(j)));
+                j += 1;
+            }
+        }
+
+        // git numbers an empty side from the line before it
+        let start = |start: usize, len: usize| (if len == 0 { start } else { start + 1 }) as u32;
+        let (old_lines, new_lines) = (old_end - old_start, new_end - new_start);
+        DiffHunk {
+            header: format!(
+                "@@ -{},{} +{},{} @@",
+                start(old_start, old_lines), old_lines, start(new_start, new_lines), new_lines
+            ),
+            old_start: start(old_start, old_lines),
+            old_lines: old_lines as u32,
+            new_start: start(new_start, new_lines),
+            new_lines: new_lines as u32,
+            lines,
+        }
+    }
+}
+
+/// Split into lines, each keeping its newline
+pub(crate) fn split_lines(text: &[u8]) -> Vec<&[u8]> {
+    let mut lines = Vec::with_capacity(text.len() / 32 + 1);
+    let mut start = 0;
+    for end in memchr_iter(b'\n', text) {
+        lines.push(&text[start..=end]);
+        start = end + 1;
+    }
+    if start < text.len() {
+        lines.push(&text[start..]);
+    }
+    lines
+}
+
+/// Hasher for line interning: eight bytes per multiply
+#[derive(Default)]
+struct LineHasher(u64);
+
+impl Hasher for LineHasher {
+    fn write(&mut self, bytes: &[u8]) {
+        const K: u64 = 0x517c_c1b7_2722_0a95;
+        let mut h = self.0;
+        let mut words = bytes.chunks_exact(8);
+        for word in &mut words {
+            h = (h.rotate_left(5) ^ u64::from_le_bytes(word.try_into().unwrap())).wrapping_mul(K);
+        }
+        let tail = words.remainder();
+        if !tail.is_empty() {
+            let mut last = [0u8; 8];
+            last[..tail.len()].copy_from_slice(tail);
+            h = (h.rotate_left(5) ^ u64::from_le_bytes(last)).wrapping_mul(K);
+        }
+        self.0 = h;
+    }
+
+    fn write_usize(&mut self, n: usize) {
+        self.0 = (self.0.rotate_left(5) ^ n as u64).wrapping_mul(0x517c_c1b7_2722_0a95);
+    }
+
+    fn finish(&self) -> u64 {
+        // Fold the high bits down; hashbrown takes its bucket from the low bits
+        self.0 ^ (self.0 >> 32)
+    }
+}
+
+/// Map equal lines on either side to the same id
+fn intern<'a>(old: &[&'a [u8]], new: &[&'a [u8]]) -> (Vec<u32>, Vec<u32>, usize) {
+    let mut ids: HashMap<&'a [u8], u32, BuildHasherDefault<LineHasher>> =
+        HashMap::with_capacity_and_hasher(old.len() + new.len(), Default::default());
+
+    let mut intern_side = |lines: &[&'a [u8]]| -> Vec<u32> {
+        lines.iter()
+            .map(|line| {
+                let next = ids.len() as u32;
+                *ids.entry(*line).or_insert(next)
+            })
+            .collect()
+    };
+    let old_ids = intern_side(old);
+    let new_ids = intern_side(new);
+    (old_ids, new_ids, ids.len())
+}
+
+/// Myers on the lines both sides share; the rest are changes outright
+fn myers_discarding(a: &[u32], b: &[u32], num_ids: usize, a_changed: &mut [bool], b_changed: &mut [bool]) {
+    let mut in_a = vec![false; num_ids];
+    let mut in_b = vec![false; num_ids];
+    a.iter().for_each(|id| in_a[*id as usize] = true);
+    b.iter().for_each(|id| in_b[*id as usize] = true);
+
+    let a_kept: Vec<usize> = (0..a.len()).filter(|i| in_b[a[*i] as usize]).collect();
+    let b_kept: Vec<usize> = (0..b.len()).filter(|j| in_a[b[*j] as usize]).collect();
+    if a_kept.len() == a.len() && b_kept.len() == b.len() {
+        myers(a, b, a_changed, b_changed);
+        return;
+    }
+
+    let a_sub: Vec<u32> = a_kept.iter().map(|i| a[*i]).collect();
+    let b_sub: Vec<u32> = b_kept.iter().map(|j| b[*j]).collect();
+    let mut a_sub_changed = vec![false; a_sub.len()];
+    let mut b_sub_changed = vec![false; b_sub.len()];
+    myers(&a_sub, &b_sub, &mut a_sub_changed, &mut b_sub_changed);
+
+    a_changed.iter_mut().for_each(|c| *c = true);
+    b_changed.iter_mut().for_each(|c| *c = true);
+    for (k, i) in a_kept.iter().enumerate() {
+        a_changed[*i] = a_sub_changed[k];
+    }
+    for (k, j) in b_kept.iter().enumerate() {
+        b_changed[*j] = b_sub_changed[k];
+    }
+}
+
+/// Linear-space Myers: split at the middle snake until ranges are trivial
+fn myers(a: &[u32], b: &[u32], a_changed: &mut [bool], b_changed: &mut [bool]) {
+    let total = a.len() + b.len();
+    let max_cost = isqrt(total + 3).max(MIN_MAX_COST);
+    let mut vf = vec![0isize; 2 * total + 3];
+    let mut vb = vec![0isize; 2 * total + 3];
+
+    // Explicit stack: recursion depth would follow the edit count
+    let mut stack = vec![(0, a.len(), 0, b.len())];
+    while let Some((mut a_lo, mut a_hi, mut b_lo, mut b_hi)) = stack.pop() {
+        while a_lo < a_hi && b_lo < b_hi && a[a_lo] == b[b_lo] {
+            a_lo += 1;
+            b_lo += 1;
+        }
+        while a_lo < a_hi && b_lo < b_hi && a[a_hi - 1] == b[b_hi - 1] {
+            a_hi -= 1;
+            b_hi -= 1;
+        }
+
+        if a_lo == a_hi {
+            b_changed[b_lo..b_hi].iter_mut().for_each(|c| *c = true);
+            continue;
+        }
+        if b_lo == b_hi {
+            a_changed[a_lo..a_hi].iter_mut().for_each(|c| *c = true);
+            continue;
+        }
+
+        let (x, y, u, v) = middle_snake(&a[a_lo..a_hi], &b[b_lo..b_hi], &mut vf, &mut vb, max_cost);
+        stack.push((a_lo + u, a_hi, b_lo + v, b_hi));
+        stack.push((a_lo, a_lo + x, b_lo, b_lo + y));
+    }
+}
+
+/// Find a snake on an optimal path through the middle of the edit graph
+///
+/// Returns its start and end points `(x, y, u, v)`. Past `max_cost` it
+/// returns the furthest point the forward search reached instead, which
+/// splits the problem without guaranteeing a minimal result. `a` and `b`
+/// must be non-empty and differ in their first and last lines.
+fn middle_snake(a: &[u32], b: &[u32], vf: &mut [isize], vb: &mut [isize], max_cost: usize) -> (usize, usize, usize, usize) {
+    let (n, m) = (a.len() as isize, b.len() as isize);
+    let delta = n - m;
+    let odd = delta & 1 != 0;
+    let off = n + m + 1;
+    let at = |k: isize| (off + k) as usize;
+
+    vf[at(1)] = 0;
+    vb[at(1)] = 0;
+
+    let max_d = (n + m + 1) / 2;
+    for d in 0..=max_d {
+        let mut k = -d;
+        while k <= d {
+            let mut x = if k == -d || (k != d && vf[at(k - 1)] < vf[at(k + 1)]) { vf[at(k + 1)] } else { vf[at(k - 1)] + 1 };
+            let mut y = x - k;
+            let (x0, y0) = (x, y);
+            while x < n && y < m && a[x as usize] == b[y as usize] {
+                x += 1;
+                y += 1;
+            }
+            vf[at(k)] = x;
+
+            if odd && (delta - k).abs() < d && x <= n && y <= m && x + vb[at(delta - k)] >= n {
+                return (x0 as usize, y0 as usize, x as usize, y as usize);
+            }
+            k += 2;
+        }
+
+        k = -d;
+        while k <= d {
+            let mut x = if k == -d || (k != d && vb[at(k - 1)] < vb[at(k + 1)]) { vb[at(k + 1)] } else { vb[at(k - 1)] + 1 };
+            let mut y = x - k;
+            let (x0, y0) = (x, y);
+            while x < n && y < m && a[(n - 1 - x) as usize] == b[(m - 1 - y) as usize] {
+                x += 1;
+                y += 1;
+            }
+            vb[at(k)] = x;
+
+            if !odd && (delta - k).abs() <= d && x <= n && y <= m && x + vf[at(delta - k)] >= n {
+                return ((n - x) as usize, (m - y) as usize, (n - x0) as usize, (m - y0) as usize);
+            }
+            k += 2;
+        }
+
+        if d as usize >= max_cost {
+            let mut best = None;
+            let mut k = -d;
+            while k <= d {
+                let x = vf[at(k)];
+                let y = x - k;
+                if x <= n && y >= 0 && y <= m && best.map_or(true, |(bx, by)| x + y > bx + by) {
+                    best = Some((x, y));
+                }
+                k += 2;
+            }
+            if let Some((x, y)) = best {
+                return (x as usize, y as usize, x as usize, y as usize);
+            }
+        }
+    }
+
+    unreachable!("edit graph searched without finding the middle snake")
+}
+
+/// Histogram diff: anchor on the longest run around the rarest common line
+fn histogram(a: &[u32], b: &[u32], num_ids: usize, a_changed: &mut [bool], b_changed: &mut [bool]) {
+    // Occurrences of each line in the current `a` region, as dense arrays so
+    // a region costs two passes over its lines rather than a map rebuild:
+    // `head[id]` is the first position + 1 and `next[i]` chains to the next one
+    let mut count = vec![0u32; num_ids];
+    let mut head = vec![0u32; num_ids];
+    let mut next = vec![0u32; a.len()];
+
+    let mut stack = vec![(0, a.len(), 0, b.len())];
+    while let Some((mut a_lo, mut a_hi, mut b_lo, mut b_hi)) = stack.pop() {
+        while a_lo < a_hi && b_lo < b_hi && a[a_lo] == b[b_lo] {
+            a_lo += 1;
+            b_lo += 1;
+        }
+        while a_lo < a_hi && b_lo < b_hi && a[a_hi - 1] == b[b_hi - 1] {
+            a_hi -= 1;
+            b_hi -= 1;
+        }
+
+        if a_lo == a_hi || b_lo == b_hi {
+            a_changed[a_lo..a_hi].iter_mut().for_each(|c| *c = true);
+            b_changed[b_lo..b_hi].iter_mut().for_each(|c| *c = true);
+            continue;
+        }
+
+        for i in (a_lo..a_hi).rev() {
+            let id = a[i] as usize;
+            next[i] = head[id];
+            head[id] = i as u32 + 1;
+            count[id] += 1;
+        }
+
+        // Best region (a_start, a_end, b_start, b_end) and its rarest line's count
+        let mut best: Option<(usize, usize, usize, usize)> = None;
+        let mut best_count = MAX_CHAIN_LENGTH as u32 + 1;
+        let mut has_common = false;
+
+        let mut j = b_lo;
+        while j < b_hi {
+            let mut next_j = j + 1;
+            let occurrences = count[b[j] as usize];
+            if occurrences > 0 {
+                has_common = true;
+            }
+            if occurrences > 0 && occurrences <= best_count {
+                let mut p = head[b[j] as usize];
+                while p != 0 {
+                    let i = p as usize - 1;
+                    let (mut a_start, mut b_start) = (i, j);
+                    let (mut a_end, mut b_end) = (i + 1, j + 1);
+                    let mut rarest = occurrences;
+
+                    while a_start > a_lo && b_start > b_lo && a[a_start - 1] == b[b_start - 1] {
+                        a_start -= 1;
+                        b_start -= 1;
+                        rarest = rarest.min(count[a[a_start] as usize]);
+                    }
+                    while a_end < a_hi && b_end < b_hi && a[a_end] == b[b_end] {
+                        rarest = rarest.min(count[a[a_end] as usize]);
+                        a_end += 1;
+                        b_end += 1;
+                    }
+                    next_j = next_j.max(b_end);
+
+                    let longer = best.map_or(true, |(s, e, _, _)| a_end - a_start > e - s);
+                    if rarest < best_count || (rarest == best_count && longer) {
+                        best = Some((a_start, a_end, b_start, b_end));
+                        best_count = rarest;
+                    }
+
+                    // Skip occurrences already inside this match
+                    p = next[i];
+                    while p != 0 && (p as usize - 1) < a_end {
+                        p = next[p as usize - 1];
+                    }
+                }
+            }
+            j = next_j;
+        }
+
+        for &id in &a[a_lo..a_hi] {
+            count[id as usize] = 0;
+            head[id as usize] = 0;
+        }
+
+        match best {
+            Some((a_start, a_end, b_start, b_end)) => {
+                stack.push((a_end, a_hi, b_end, b_hi));
+                stack.push((a_lo, a_start, b_lo, b_start));
+            }
+            // Only very frequent lines in common: let Myers sort them out
+            None if has_common => myers(&a[a_lo..a_hi], &b[b_lo..b_hi], &mut a_changed[a_lo..a_hi], &mut b_changed[b_lo..b_hi]),
+            None => {
+                a_changed[a_lo..a_hi].iter_mut().for_each(|c| *c = true);
+                b_changed[b_lo..b_hi].iter_mut().for_each(|c| *c = true);
+            }
+        }
+    }
+}
+
+fn isqrt(n: usize) -> usize {
+    (n as f64).sqrt() as usize
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_hunks_follow_git_format() {
+        let old = b"a\nb\nc\nd\ne\nf\ng\nh\ni\nj\n";
+        let new = b"a\nb\nC\nd\ne\nf\ng\nh\ni\nj\nk\n";
+
+        for algorithm in [DiffAlgorithm::Myers, DiffAlgorithm::Histogram] {
+            let diff = LineDiff::compute(old, new, algorithm);
+            assert_eq!((diff.insertions(), diff.deletions()), (2, 1));
+
+            let hunks = diff.hunks(3);
+            let headers: Vec<&str> = hunks.iter().map(|h| h.header.as_str()).collect();
+            assert_eq!(headers, ["@@ -1,6 +1,6 @@", "@@ -8,3 +8,4 @@"]);
+            let origins: String = hunks[0].lines.iter().map(|l| l.origin).collect();
+            assert_eq!(origins, "  -+   ");
+        }
+    }
+
+    #[test]
+    fn test_edit_scripts_are_valid_and_myers_is_minimal() {
+        // Deterministic pseudo-random texts over a small alphabet (xorshift)
+        let mut state = 0x2545_f491_4f6c_dd1du64;
+        let mut next = move |bound: u64| {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            state % bound
+        };
+
+        for _ in 0..300 {
+            let old: Vec<u8> = (0..next(40)).flat_map(|_| [b'a' + next(5) as u8, b'\n']).collect();
+            let new: Vec<u8> = (0..next(40)).flat_map(|_| [b'a' + next(5) as u8, b'\n']).collect();
+            let (old_lines, new_lines) = (split_lines(&old), split_lines(&new));
+
+            // Longest common subsequence by dynamic programming
+            let mut lcs = vec![vec![0usize; new_lines.len() + 1]; old_lines.len() + 1];
+            for i in (0..old_lines.len()).rev() {
+                for j in (0..new_lines.len()).rev() {
+                    lcs[i][j] = if old_lines[i] == new_lines[j] { lcs[i + 1][j + 1] + 1 } else { lcs[i + 1][j].max(lcs[i][j + 1]) };
+                }
+            }
+
+            for algorithm in [DiffAlgorithm::Myers, DiffAlgorithm::Histogram] {
+                let diff = LineDiff::compute(&old, &new, algorithm);
+                let kept_old: Vec<&[u8]> = old_lines.iter().zip(&diff.old_changed).filter(|(_, c)| !**c).map(|(l, _)| *l).collect();
+                let kept_new: Vec<&[u8]> = new_lines.iter().zip(&diff.new_changed).filter(|(_, c)| !**c).map(|(l, _)| *l).collect();
+                assert_eq!(kept_old, kept_new, "{:?}", algorithm);
+
+                if algorithm == DiffAlgorithm::Myers {
+                    assert_eq!(kept_old.len(), lcs[0][0]);
+                }
+            }
+        }
+    }
+}
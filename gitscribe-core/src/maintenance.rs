@@ -0,0 +1,170 @@
+//! Status Cache Maintenance
+//!
+//! Without pruning, the status cache grows with every repository the shell
+//! has ever shown. A background worker periodically evicts the least recently
+//! accessed repositories to fit a byte budget, returns freed pages with an
+//! incremental vacuum, truncates the WAL and prunes finished operations.
+
+use anyhow::Result;
+use serde::{Deserialize, Serialize};
+use std::path::PathBuf;
+use std::sync::mpsc::{self, RecvTimeoutError};
+use std::sync::{Arc, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+
+use crate::cache::{CacheBackend, CacheStats, StatusCache};
+
+/// Limits and schedule for cache maintenance
+#[derive(Debug, Clone)]
+pub struct MaintenancePolicy {
+    /// Live bytes (database pages plus status logs) to evict down to
+    pub budget_bytes: u64,
+    /// Time between maintenance passes
+    pub interval: Duration,
+    /// Free pages returned per pass
+    pub vacuum_pages: u32,
+    /// Finished operations older than this are deleted
+    pub operation_max_age: Duration,
+}
+
+impl Default for MaintenancePolicy {
+    fn default() -> Self {
+        Self {
+            budget_bytes: 64 * 1024 * 1024,
+            interval: Duration::from_secs(10 * 60),
+            vacuum_pages: 1024,
+            operation_max_age: Duration::from_secs(7 * 24 * 60 * 60),
+        }
+    }
+}
+
+/// Outcome of one maintenance pass
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct MaintenanceReport {
+    pub before: CacheStats,
+    pub after: CacheStats,
+    /// Repositories evicted, least recently accessed first
+    pub evicted: Vec<String>,
+    pub operations_removed: usize,
+    /// False if readers kept the WAL checkpoint from completing
+    pub checkpointed: bool,
+    pub duration_ms: u64,
+}
+
+/// Run one maintenance pass
+pub fn run(cache: &StatusCache, policy: &MaintenancePolicy) -> Result<MaintenanceReport> {
+    let start = Instant::now();
+    let before = cache.stats()?;
+
+    let evicted = cache.evict_to_budget(policy.budget_bytes)?;
+    let operations_removed = cache.cleanup_operations(policy.operation_max_age.as_secs() as i64)?;
+    cache.vacuum(policy.vacuum_pages)?;
+    let checkpointed = cache.checkpoint()?;
+
+    Ok(MaintenanceReport {
+        before,
+        after: cache.stats()?,
+        evicted,
+        operations_removed,
+        checkpointed,
+        duration_ms: start.elapsed().as_millis() as u64,
+    })
+}
+
+enum Command {
+    RunNow,
+    Stop,
+}
+
+/// Background thread running maintenance on its own cache connection
+///
+/// Stops when dropped.
+pub struct MaintenanceWorker {
+    commands: mpsc::Sender<Command>,
+    last_report: Arc<Mutex<Option<MaintenanceReport>>>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl MaintenanceWorker {
+    /// Start maintaining the cache database at `db_path`
+    ///
+    /// The first pass runs after one `policy.interval`.
+    pub fn spawn(db_path: PathBuf, backend: CacheBackend, policy: MaintenancePolicy) -> Result<Self> {
+        let (commands, rx) = mpsc::channel();
+        let last_report = Arc::new(Mutex::new(None));
+        let reports = last_report.clone();
+
+        // Open on the caller's thread so configuration errors surface here
+        let cache = StatusCache::with_backend(&db_path, backend)?;
+
+        let thread = thread::Builder::new()
+            .name("gitscribe-cache-maintenance".to_string())
+            .spawn(move || loop {
+                match rx.recv_timeout(policy.interval) {
+                    Ok(Command::Stop) | Err(RecvTimeoutError::Disconnected) => break,
+                    Ok(Command::RunNow) | Err(RecvTimeoutError::Timeout) => {}
+                }
+
+                match run(&cache, &policy) {
+                    Ok(report) => *reports.lock().unwrap() = Some(report),
+                    Err(e) => tracing::debug!("cache maintenance failed for {:?}: {}", db_path, e),
+                }
+            })?;
+
+        Ok(MaintenanceWorker {
+            commands,
+            last_report,
+            thread: Some(thread),
+        })
+    }
+
+    /// Request a pass now instead of waiting for the next interval
+    pub fn run_now(&self) {
+        let _ = self.commands.send(Command::RunNow);
+    }
+
+    /// Report of the most recent completed pass
+    pub fn last_report(&self) -> Option<MaintenanceReport> {
+        self.last_report.lock().unwrap().clone()
+    }
+}
+
+impl Drop for MaintenanceWorker {
+    fn drop(&mut self) {
+        let _ = self.commands.send(Command::Stop);
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{FileStatusEntry, RepoFingerprint};
+    use crate::status::FileStatus;
+
+    #[test]
+    fn test_worker_reports_pass() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let db_path = temp_dir.path().join("cache.db");
+
+        let cache = StatusCache::new(&db_path).unwrap();
+        let entries = vec![FileStatusEntry { path: "a.txt".into(), status: FileStatus::Modified }];
+        cache.refresh_status("/repo/a", &entries, RepoFingerprint { value: 1, watched: true, ..Default::default() }).unwrap();
+
+        let policy = MaintenancePolicy { budget_bytes: 0, interval: Duration::from_secs(3600), ..Default::default() };
+        let worker = MaintenanceWorker::spawn(db_path, CacheBackend::Sqlite, policy).unwrap();
+        worker.run_now();
+
+        let deadline = Instant::now() + Duration::from_secs(10);
+        while worker.last_report().is_none() && Instant::now() < deadline {
+            thread::sleep(Duration::from_millis(10));
+        }
+
+        let report = worker.last_report().expect("maintenance pass did not run");
+        assert_eq!(report.evicted, vec!["/repo/a".to_string()]);
+        assert_eq!(report.after.repositories, 0);
+    }
+}
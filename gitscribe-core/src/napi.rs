@@ -7,8 +7,13 @@
 
 use napi::bindgen_prelude::*;
 use napi_derive::napi;
+use std::path::Path;
+use std::sync::Arc;
+use tokio::sync::Mutex;
 
 use crate::{Repository as CoreRepository, FileStatus as CoreFileStatus, FileStatusEntry, RepoState, StatusCache as CoreStatusCache};
+use crate::{Commit as CoreCommit, GitHistory};
+use crate::{BlameHunk, BranchTip, DiffEntry, DiffHunk, DiffStreamOptions};
 
 /// File status information for JavaScript
 #[napi(object)]
@@ -27,6 +32,8 @@ pub struct RepoStatusJS {
     pub current_branch: String,
     pub ahead_count: i32,
     pub behind_count: i32,
+    /// Ahead/behind were cut short and may be stale; ask again shortly
+    pub remote_pending: bool,
     pub state: i32, // 0=Clean, 1=Merging, 2=Rebasing, etc.
     pub modified_count: i32,
     pub conflicted_count: i32,
@@ -38,10 +45,160 @@ pub struct RepoStatusJS {
 pub struct RemoteStatusJS {
     pub ahead: i32,
     pub behind: i32,
+    /// The counts were cut short and may be stale; ask again shortly
+    pub pending: bool,
     pub remote_name: String,
     pub remote_branch: String,
 }
 
+/// Commit information for JavaScript
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct CommitJS {
+    pub oid: String,
+    pub short_oid: String,
+    pub summary: String,
+    pub message: String,
+    pub author_name: String,
+    pub author_email: String,
+    pub timestamp: i64,
+    pub parent_oids: Vec<String>,
+}
+
+/// One page of commits plus the cursor for the next page
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct CommitPageJS {
+    pub commits: Vec<CommitJS>,
+    /// Pass back to `getCommitsPage` for the next page; undefined at the end
+    pub next_cursor: Option<String>,
+}
+
+/// A branch with its tip commit, for the branch picker
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct BranchTipJS {
+    pub name: String,
+    pub is_head: bool,
+    pub is_remote: bool,
+    pub upstream: Option<String>,
+    pub target_oid: Option<String>,
+    /// Committer time of the tip
+    pub timestamp: i64,
+    pub author_name: String,
+    pub summary: String,
+}
+
+/// One page of commits with graph rows, as typed arrays for the renderer
+#[napi(object)]
+pub struct GraphPageJS {
+    pub commits: Vec<CommitJS>,
+    /// Column of each commit
+    pub columns: Uint32Array,
+    /// Color index of each commit
+    pub colors: Uint32Array,
+    /// Row i's edges are `edgeOffsets[i]..edgeOffsets[i + 1]` (rows + 1 entries)
+    pub edge_offsets: Uint32Array,
+    /// Lines into each row as (from column, to column, color) triples
+    pub edges: Uint32Array,
+    /// Pass back to `getGraphPage` for the next page; undefined at the end
+    pub next_cursor: Option<String>,
+}
+
+/// A changed file from a diff stream
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct DiffEntryJS {
+    pub path: String,
+    /// "added", "deleted", "modified" or "typechange"
+    pub status: String,
+    pub old_oid: Option<String>,
+    pub new_oid: Option<String>,
+    pub old_size: i64,
+    pub new_size: i64,
+    /// Git file modes (0 when the side is absent)
+    pub old_mode: u32,
+    pub new_mode: u32,
+    pub binary: bool,
+    pub too_large: bool,
+}
+
+/// A line of a hunk
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct DiffLineJS {
+    /// "+", "-" or " "
+    pub origin: String,
+    pub content: String,
+    pub old_lineno: Option<u32>,
+    pub new_lineno: Option<u32>,
+}
+
+/// A hunk of a file's diff
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct DiffHunkJS {
+    pub header: String,
+    pub old_start: u32,
+    pub old_lines: u32,
+    pub new_start: u32,
+    pub new_lines: u32,
+    pub lines: Vec<DiffLineJS>,
+}
+
+/// Lines of a blamed file that came from one commit
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct BlameHunkJS {
+    pub oid: String,
+    pub author_name: String,
+    pub author_email: String,
+    pub timestamp: i64,
+    pub summary: String,
+    /// First line in the blamed file (1-based)
+    pub final_start: u32,
+    /// First line in the file as of `oid` (1-based)
+    pub orig_start: u32,
+    pub lines: u32,
+}
+
+/// Outcome of a cache warm-up pass for JavaScript
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct WarmupReportJS {
+    /// Paths of the repositories scanned
+    pub warmed: Vec<String>,
+    pub skipped: Vec<String>,
+    /// Why the pass stopped early ("Foreground", "Load", ...), if it did
+    pub stopped: Option<String>,
+    pub duration_ms: i64,
+}
+
+/// Outcome of a cache maintenance pass for JavaScript
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct MaintenanceReportJS {
+    /// Database pages plus status logs, before and after the pass
+    pub bytes_before: i64,
+    pub bytes_after: i64,
+    /// Repositories evicted, least recently accessed first
+    pub evicted: Vec<String>,
+    pub operations_removed: u32,
+    pub checkpointed: bool,
+    pub duration_ms: i64,
+}
+
+/// Status of a queued operation for JavaScript
+#[napi(object)]
+#[derive(Debug, Clone)]
+pub struct OperationStatusJS {
+    /// "pending", "running", "complete" or "failed"
+    pub status: String,
+    pub attempts: u32,
+    /// Message from the most recent failed attempt
+    pub error: Option<String>,
+}
+
 /// Repository handle for JavaScript
 #[napi]
 pub struct Repository {
@@ -73,6 +230,244 @@ impl From<FileStatusEntry> for FileStatusJS {
     }
 }
 
+impl From<CoreCommit> for CommitJS {
+    fn from(commit: CoreCommit) -> Self {
+        CommitJS {
+            oid: commit.oid,
+            short_oid: commit.short_oid,
+            summary: commit.summary,
+            message: commit.message,
+            author_name: commit.author_name,
+            author_email: commit.author_email,
+            timestamp: commit.timestamp,
+            parent_oids: commit.parent_oids,
+        }
+    }
+}
+
+/// Fetch one page of history on the blocking pool
+async fn commits_page(repo_path: String, branch: Option<String>, cursor: Option<String>, limit: usize) -> Result<CommitPageJS> {
+    tokio::task::spawn_blocking(move || {
+        let history = GitHistory::open(Path::new(&repo_path))
+            .map_err(|e| Error::from_reason(format!("Failed to open repository: {}", e)))?;
+
+        let page = history.get_commits_page(branch.as_deref(), cursor.as_deref(), limit)
+            .map_err(|e| Error::from_reason(format!("Failed to get commits: {}", e)))?;
+
+        Ok(CommitPageJS {
+            commits: page.commits.into_iter().map(|c| c.into()).collect(),
+            next_cursor: page.next_cursor,
+        })
+    })
+    .await
+    .map_err(|e| Error::from_reason(format!("Task failed: {}", e)))?
+}
+
+/// Streaming commit history
+///
+/// Each `next()` resolves to the next page of commits, or null once history
+/// is exhausted. Wrap it in an async generator for `for await` loops.
+#[napi]
+pub struct CommitStream {
+    repo_path: String,
+    page_size: usize,
+    /// None before the first page; Some(None) once exhausted
+    cursor: Arc<Mutex<Option<Option<String>>>>,
+    branch: Option<String>,
+}
+
+#[napi]
+impl CommitStream {
+    /// Fetch the next page of commits
+    #[napi]
+    pub async fn next(&self) -> Result<Option<Vec<CommitJS>>> {
+        // Held across the fetch so concurrent calls can't read the same page twice
+        let mut cursor = self.cursor.lock().await;
+        let (branch, start) = match &*cursor {
+            Some(None) => return Ok(None),
+            Some(Some(next)) => (None, Some(next.clone())),
+            None => (self.branch.clone(), None),
+        };
+
+        let page = commits_page(self.repo_path.clone(), branch, start, self.page_size).await?;
+        *cursor = Some(page.next_cursor);
+
+        if page.commits.is_empty() {
+            return Ok(None);
+        }
+        Ok(Some(page.commits))
+    }
+}
+
+impl From<DiffEntry> for DiffEntryJS {
+    fn from(entry: DiffEntry) -> Self {
+        DiffEntryJS {
+            path: entry.path,
+            status: entry.status,
+            old_oid: entry.old_oid,
+            new_oid: entry.new_oid,
+            old_size: entry.old_size as i64,
+            new_size: entry.new_size as i64,
+            old_mode: entry.old_mode,
+            new_mode: entry.new_mode,
+            binary: entry.binary,
+            too_large: entry.too_large,
+        }
+    }
+}
+
+impl From<DiffEntryJS> for DiffEntry {
+    fn from(entry: DiffEntryJS) -> Self {
+        DiffEntry {
+            path: entry.path,
+            status: entry.status,
+            old_oid: entry.old_oid,
+            new_oid: entry.new_oid,
+            old_size: entry.old_size.max(0) as u64,
+            new_size: entry.new_size.max(0) as u64,
+            old_mode: entry.old_mode,
+            new_mode: entry.new_mode,
+            binary: entry.binary,
+            too_large: entry.too_large,
+        }
+    }
+}
+
+impl From<DiffHunk> for DiffHunkJS {
+    fn from(hunk: DiffHunk) -> Self {
+        DiffHunkJS {
+            header: hunk.header,
+            old_start: hunk.old_start,
+            old_lines: hunk.old_lines,
+            new_start: hunk.new_start,
+            new_lines: hunk.new_lines,
+            lines: hunk.lines.into_iter()
+                .map(|line| DiffLineJS {
+                    origin: line.origin.to_string(),
+                    content: line.content,
+                    old_lineno: line.old_lineno,
+                    new_lineno: line.new_lineno,
+                })
+                .collect(),
+        }
+    }
+}
+
+impl From<BranchTip> for BranchTipJS {
+    fn from(tip: BranchTip) -> Self {
+        BranchTipJS {
+            name: tip.branch.name,
+            is_head: tip.branch.is_head,
+            is_remote: tip.branch.is_remote,
+            upstream: tip.branch.upstream,
+            target_oid: tip.branch.target_oid,
+            timestamp: tip.timestamp,
+            author_name: tip.author_name,
+            summary: tip.summary,
+        }
+    }
+}
+
+impl From<BlameHunk> for BlameHunkJS {
+    fn from(hunk: BlameHunk) -> Self {
+        BlameHunkJS {
+            oid: hunk.oid,
+            author_name: hunk.author_name,
+            author_email: hunk.author_email,
+            timestamp: hunk.timestamp,
+            summary: hunk.summary,
+            final_start: hunk.final_start,
+            orig_start: hunk.orig_start,
+            lines: hunk.lines,
+        }
+    }
+}
+
+/// Position of a diff stream between calls
+#[derive(Default)]
+struct DiffStreamState {
+    /// Last path returned
+    after: Option<String>,
+    done: bool,
+    /// Content bytes loaded by `hunks` so far
+    loaded: u64,
+}
+
+/// Streaming diff of one commit
+///
+/// `next()` resolves to the next batch of changed files, or null at the end.
+/// File content is only read by `hunks()`, within the stream's byte limits.
+#[napi]
+pub struct CommitDiffStream {
+    repo_path: String,
+    oid: String,
+    batch_size: usize,
+    options: DiffStreamOptions,
+    state: Arc<Mutex<DiffStreamState>>,
+}
+
+#[napi]
+impl CommitDiffStream {
+    /// Fetch the next batch of changed files
+    #[napi]
+    pub async fn next(&self) -> Result<Option<Vec<DiffEntryJS>>> {
+        let mut state = self.state.lock().await;
+        if state.done {
+            return Ok(None);
+        }
+
+        let repo_path = self.repo_path.clone();
+        let oid = self.oid.clone();
+        let options = self.options;
+        let batch_size = self.batch_size;
+        let after = state.after.clone();
+
+        let entries = tokio::task::spawn_blocking(move || {
+            let history = GitHistory::open(Path::new(&repo_path))
+                .map_err(|e| Error::from_reason(format!("Failed to open repository: {}", e)))?;
+
+            history.diff_stream(&oid, options, after.as_deref())
+                .and_then(|stream| stream.take(batch_size).collect::<anyhow::Result<Vec<_>>>())
+                .map_err(|e| Error::from_reason(format!("Failed to diff commit: {}", e)))
+        })
+        .await
+        .map_err(|e| Error::from_reason(format!("Task failed: {}", e)))??;
+
+        state.done = entries.len() < batch_size;
+        state.after = entries.last().map(|e| e.path.clone()).or(state.after.take());
+        if entries.is_empty() {
+            return Ok(None);
+        }
+        Ok(Some(entries.into_iter().map(|e| e.into()).collect()))
+    }
+
+    /// Load the hunks of an entry returned by `next()`
+    ///
+    /// Resolves to null for binary or too-large files, and once the stream's
+    /// byte limit is used up.
+    #[napi]
+    pub async fn hunks(&self, entry: DiffEntryJS) -> Result<Option<Vec<DiffHunkJS>>> {
+        let mut state = self.state.lock().await;
+        let repo_path = self.repo_path.clone();
+        let options = self.options;
+        let mut loaded = state.loaded;
+
+        let (hunks, loaded) = tokio::task::spawn_blocking(move || {
+            let repo = git2::Repository::open(&repo_path)
+                .map_err(|e| Error::from_reason(format!("Failed to open repository: {}", e)))?;
+
+            let hunks = crate::diff_stream::load_hunks(&repo, &entry.into(), &options, &mut loaded)
+                .map_err(|e| Error::from_reason(format!("Failed to load hunks: {}", e)))?;
+            Ok::<_, Error>((hunks, loaded))
+        })
+        .await
+        .map_err(|e| Error::from_reason(format!("Task failed: {}", e)))??;
+
+        state.loaded = loaded;
+        Ok(hunks.map(|hunks| hunks.into_iter().map(|h| h.into()).collect()))
+    }
+}
+
 impl From<RepoState> for i32 {
     fn from(state: RepoState) -> Self {
         match state {
@@ -173,9 +568,9 @@ impl Repository {
 
             // Get remote status
             let remote_status = repo.remote_status().ok().flatten();
-            let (ahead_count, behind_count) = remote_status
-                .map(|r| (r.ahead as i32, r.behind as i32))
-                .unwrap_or((0, 0));
+            let (ahead_count, behind_count, remote_pending) = remote_status
+                .map(|r| (r.ahead as i32, r.behind as i32, r.pending))
+                .unwrap_or((0, 0, false));
 
             // Get state
             let state: i32 = repo.state().into();
@@ -189,6 +584,7 @@ impl Repository {
                 current_branch,
                 ahead_count,
                 behind_count,
+                remote_pending,
                 state,
                 modified_count,
                 conflicted_count,
@@ -211,6 +607,7 @@ impl Repository {
                 Ok(Some(status)) => Ok(Some(RemoteStatusJS {
                     ahead: status.ahead as i32,
                     behind: status.behind as i32,
+                    pending: status.pending,
                     remote_name: status.remote_name,
                     remote_branch: status.remote_branch,
                 })),
@@ -222,6 +619,138 @@ impl Repository {
         .map_err(|e| Error::from_reason(format!("Task failed: {}", e)))?
     }
 
+    /// Get one page of the commit log
+    ///
+    /// # Arguments
+    /// * `branch` - Local branch to start from (HEAD if omitted); ignored with a cursor
+    /// * `cursor` - `nextCursor` from the previous page, omitted for the first page
+    /// * `limit` - Commits per page
+    #[napi]
+    pub async fn get_commits_page(&self, branch: Option<String>, cursor: Option<String>, limit: Option<u32>) -> Result<CommitPageJS> {
+        commits_page(self.repo_path.clone(), branch, cursor, limit.unwrap_or(100) as usize).await
+    }
+
+    /// Get one page of the commit log with graph lanes
+    ///
+    /// Lanes continue across pages through the cursor, so rows can be
+    /// appended as they load.
+    ///
+    /// # Arguments
+    /// * `branch` - Local branch to start from (HEAD if omitted); ignored with a cursor
+    /// * `cursor` - `nextCursor` from the previous page, omitted for the first page
+    /// * `limit` - Commits per page
+    #[napi]
+    pub async fn get_graph_page(&self, branch: Option<String>, cursor: Option<String>, limit: Option<u32>) -> Result<GraphPageJS> {
+        let repo_path = self.repo_path.clone();
+        let limit = limit.unwrap_or(100) as usize;
+
+        let page = tokio::task::spawn_blocking(move || {
+            let history = GitHistory::open(Path::new(&repo_path))
+                .map_err(|e| Error::from_reason(format!("Failed to open repository: {}", e)))?;
+
+            history.get_graph_page(branch.as_deref(), cursor.as_deref(), limit)
+                .map_err(|e| Error::from_reason(format!("Failed to get commits: {}", e)))
+        })
+        .await
+        .map_err(|e| Error::from_reason(format!("Task failed: {}", e)))??;
+
+        Ok(GraphPageJS {
+            commits: page.commits.into_iter().map(|c| c.into()).collect(),
+            columns: Uint32Array::new(page.rows.columns),
+            colors: Uint32Array::new(page.rows.colors),
+            edge_offsets: Uint32Array::new(page.rows.edge_offsets),
+            edges: Uint32Array::new(page.rows.edges),
+            next_cursor: page.next_cursor,
+        })
+    }
+
+    /// Get the branches with the newest tip commits, newest first
+    ///
+    /// # Arguments
+    /// * `limit` - Most branches to return (all if omitted)
+    #[napi]
+    pub async fn get_recent_branches(&self, limit: Option<u32>) -> Result<Vec<BranchTipJS>> {
+        let repo_path = self.repo_path.clone();
+
+        tokio::task::spawn_blocking(move || {
+            let history = GitHistory::open(Path::new(&repo_path))
+                .map_err(|e| Error::from_reason(format!("Failed to open repository: {}", e)))?;
+
+            let branches = history.get_recent_branches(limit.map_or(usize::MAX, |l| l as usize))
+                .map_err(|e| Error::from_reason(format!("Failed to list branches: {}", e)))?;
+            Ok(branches.into_iter().map(|b| b.into()).collect())
+        })
+        .await
+        .map_err(|e| Error::from_reason(format!("Task failed: {}", e)))?
+    }
+
+    /// Stream the commit log page by page
+    ///
+    /// # Arguments
+    /// * `branch` - Local branch to start from (HEAD if omitted)
+    /// * `page_size` - Commits per `next()` call
+    #[napi]
+    pub fn commits(&self, branch: Option<String>, page_size: Option<u32>) -> CommitStream {
+        CommitStream {
+            repo_path: self.repo_path.clone(),
+            page_size: page_size.unwrap_or(100).max(1) as usize,
+            cursor: Arc::new(Mutex::new(None)),
+            branch,
+        }
+    }
+
+    /// Stream the changed files of a commit
+    ///
+    /// # Arguments
+    /// * `oid` - Commit to diff against its first parent
+    /// * `batch_size` - Files per `next()` call
+    /// * `max_file_bytes` - Files larger than this never load hunks
+    /// * `max_total_bytes` - Content loaded by `hunks()` across the stream
+    #[napi]
+    pub fn diff_stream(&self, oid: String, batch_size: Option<u32>, max_file_bytes: Option<i64>, max_total_bytes: Option<i64>) -> CommitDiffStream {
+        let defaults = DiffStreamOptions::default();
+        CommitDiffStream {
+            repo_path: self.repo_path.clone(),
+            oid,
+            batch_size: batch_size.unwrap_or(500).max(1) as usize,
+            options: DiffStreamOptions {
+                max_file_bytes: max_file_bytes.map_or(defaults.max_file_bytes, |b| b.max(0) as u64),
+                max_total_bytes: max_total_bytes.map_or(defaults.max_total_bytes, |b| b.max(0) as u64),
+                ..defaults
+            },
+            state: Arc::new(Mutex::new(DiffStreamState::default())),
+        }
+    }
+
+    /// Blame a file, streaming hunks as they are resolved
+    ///
+    /// # Arguments
+    /// * `path` - File relative to the repository root
+    /// * `oid` - Commit to blame at (defaults to HEAD)
+    /// * `batch_size` - Most hunks per `next()` call
+    #[napi]
+    pub fn blame(&self, path: String, oid: Option<String>, batch_size: Option<u32>) -> FileBlame {
+        FileBlame {
+            repo_path: self.repo_path.clone(),
+            path,
+            oid,
+            batch_size: batch_size.unwrap_or(500).max(1) as usize,
+            state: Arc::new(Mutex::new(FileBlameState::default())),
+        }
+    }
+
+    /// Compute diffs for commits the history view is showing, in the background
+    ///
+    /// Returns immediately; a later call replaces a request still waiting.
+    #[napi]
+    pub fn prefetch_commit_diffs(&self, oids: Vec<String>) -> Result<()> {
+        let history = GitHistory::open(Path::new(&self.repo_path))
+            .map_err(|e| Error::from_reason(format!("Failed to open repository: {}", e)))?;
+
+        history.prefetch_commit_diffs(&oids, &Default::default())
+            .map_err(|e| Error::from_reason(format!("Failed to prefetch diffs: {}", e)))
+    }
+
     /// Check if working tree is clean
     #[napi]
     pub async fn is_clean(&self) -> Result<bool> {
@@ -239,6 +768,263 @@ impl Repository {
     }
 }
 
+/// Hunks a blame thread has produced and not yet handed out
+#[derive(Default)]
+struct FileBlameState {
+    hunks: Option<std::sync::mpsc::Receiver<anyhow::Result<BlameHunk>>>,
+    done: bool,
+}
+
+/// Streaming blame of one file
+///
+/// The blame runs on its own thread from the first `next()`; each call
+/// resolves to the hunks found since the last one (waiting for at least
+/// one), or null at the end. Hunks arrive newest commit first, not in file
+/// order.
+#[napi]
+pub struct FileBlame {
+    repo_path: String,
+    path: String,
+    oid: Option<String>,
+    batch_size: usize,
+    state: Arc<Mutex<FileBlameState>>,
+}
+
+#[napi]
+impl FileBlame {
+    /// Fetch the next batch of resolved hunks
+    #[napi]
+    pub async fn next(&self) -> Result<Option<Vec<BlameHunkJS>>> {
+        let mut state = self.state.lock().await;
+        if state.done {
+            return Ok(None);
+        }
+
+        let receiver = match state.hunks.take() {
+            Some(receiver) => receiver,
+            None => {
+                let (tx, rx) = std::sync::mpsc::channel();
+                let repo_path = self.repo_path.clone();
+                let path = self.path.clone();
+                let oid = self.oid.clone();
+                std::thread::Builder::new()
+                    .name("gitscribe-blame".to_string())
+                    .spawn(move || {
+                        let history = match GitHistory::open(Path::new(&repo_path)) {
+                            Ok(history) => history,
+                            Err(e) => {
+                                let _ = tx.send(Err(e));
+                                return;
+                            }
+                        };
+                        match history.blame(&path, oid.as_deref()) {
+                            // Stops early once the receiver is dropped
+                            Ok(stream) => {
+                                for hunk in stream {
+                                    if tx.send(hunk).is_err() {
+                                        break;
+                                    }
+                                }
+                            }
+                            Err(e) => {
+                                let _ = tx.send(Err(e));
+                            }
+                        }
+                    })
+                    .map_err(|e| Error::from_reason(format!("Failed to start blame: {}", e)))?;
+                rx
+            }
+        };
+
+        let batch_size = self.batch_size;
+        let (receiver, hunks, finished) = tokio::task::spawn_blocking(move || {
+            let mut hunks = Vec::new();
+            let mut finished = false;
+            match receiver.recv() {
+                Ok(hunk) => hunks.push(hunk),
+                Err(_) => finished = true,
+            }
+            while !finished && hunks.len() < batch_size {
+                match receiver.try_recv() {
+                    Ok(hunk) => hunks.push(hunk),
+                    Err(std::sync::mpsc::TryRecvError::Empty) => break,
+                    Err(std::sync::mpsc::TryRecvError::Disconnected) => finished = true,
+                }
+            }
+            (receiver, hunks, finished)
+        })
+        .await
+        .map_err(|e| Error::from_reason(format!("Task failed: {}", e)))?;
+
+        let hunks = hunks.into_iter()
+            .collect::<anyhow::Result<Vec<_>>>()
+            .map_err(|e| {
+                state.done = true;
+                Error::from_reason(format!("Failed to blame file: {}", e))
+            })?;
+        state.done = finished;
+        state.hunks = Some(receiver);
+
+        if hunks.is_empty() {
+            return Ok(None);
+        }
+        Ok(Some(hunks.into_iter().map(|h| h.into()).collect()))
+    }
+}
+
+/// Background status cache warm-up for JavaScript
+///
+/// Opt-in: construct once at startup. Stops when `cancel` is called or the
+/// object is garbage collected.
+#[napi]
+pub struct CacheWarmup {
+    inner: crate::Warmup,
+}
+
+#[napi]
+impl CacheWarmup {
+    /// Start warming the cache database at `cache_path`
+    #[napi(constructor)]
+    pub fn new(cache_path: String) -> Result<Self> {
+        let inner = crate::Warmup::spawn(cache_path.into(), crate::CacheBackend::default(), crate::WarmupPolicy::default())
+            .map_err(|e| Error::from_reason(format!("Cache error: {}", e)))?;
+        Ok(CacheWarmup { inner })
+    }
+
+    /// Stop before the next repository
+    #[napi]
+    pub fn cancel(&self) {
+        self.inner.cancel();
+    }
+
+    /// Report of the finished pass, or null while it is still running
+    #[napi]
+    pub fn report(&self) -> Option<WarmupReportJS> {
+        self.inner.report().map(|report| WarmupReportJS {
+            warmed: report.warmed.into_iter().map(|repo| repo.path).collect(),
+            skipped: report.skipped,
+            stopped: report.stopped.map(|stop| format!("{:?}", stop)),
+            duration_ms: report.duration_ms as i64,
+        })
+    }
+}
+
+/// Background status cache maintenance for JavaScript
+///
+/// Opt-in: construct once at startup. Stops when the object is garbage
+/// collected.
+#[napi]
+pub struct CacheMaintenance {
+    inner: crate::MaintenanceWorker,
+}
+
+#[napi]
+impl CacheMaintenance {
+    /// Start maintaining the cache database at `cache_path`
+    ///
+    /// # Arguments
+    /// * `budget_bytes` - Size to evict down to (default 64 MB)
+    #[napi(constructor)]
+    pub fn new(cache_path: String, budget_bytes: Option<i64>) -> Result<Self> {
+        let mut policy = crate::MaintenancePolicy::default();
+        if let Some(budget) = budget_bytes.filter(|budget| *budget > 0) {
+            policy.budget_bytes = budget as u64;
+        }
+        let inner = crate::MaintenanceWorker::spawn(cache_path.into(), crate::CacheBackend::default(), policy)
+            .map_err(|e| Error::from_reason(format!("Cache error: {}", e)))?;
+        Ok(CacheMaintenance { inner })
+    }
+
+    /// Request a pass now instead of waiting for the next interval
+    #[napi]
+    pub fn run_now(&self) {
+        self.inner.run_now();
+    }
+
+    /// Report of the most recent completed pass
+    #[napi]
+    pub fn last_report(&self) -> Option<MaintenanceReportJS> {
+        self.inner.last_report().map(|report| MaintenanceReportJS {
+            bytes_before: (report.before.used_bytes + report.before.log_bytes) as i64,
+            bytes_after: (report.after.used_bytes + report.after.log_bytes) as i64,
+            evicted: report.evicted,
+            operations_removed: report.operations_removed as u32,
+            checkpointed: report.checkpointed,
+            duration_ms: report.duration_ms as i64,
+        })
+    }
+}
+
+/// Background operation scheduler for JavaScript
+///
+/// Opt-in: construct once per cache database at startup. Stops when the
+/// object is garbage collected; queued operations stay in the database.
+#[napi]
+pub struct OperationScheduler {
+    inner: crate::Scheduler,
+}
+
+#[napi]
+impl OperationScheduler {
+    /// Start running operations queued in the cache database at `cache_path`
+    ///
+    /// # Arguments
+    /// * `workers` - Operations running at once (default 4)
+    #[napi(constructor)]
+    pub fn new(cache_path: String, workers: Option<u32>) -> Result<Self> {
+        let mut config = crate::SchedulerConfig::default();
+        if let Some(workers) = workers.filter(|workers| *workers > 0) {
+            config.workers = workers as usize;
+        }
+        let inner = crate::Scheduler::start(cache_path, config)
+            .map_err(|e| Error::from_reason(format!("Scheduler error: {}", e)))?;
+        Ok(OperationScheduler { inner })
+    }
+
+    /// Queue a "fetch", "push" or "pull" and return its id at once
+    ///
+    /// # Arguments
+    /// * `operation_data` - JSON such as `{"remote": "origin"}`
+    /// * `priority` - -1 (low), 0 (normal, default) or 1 (high)
+    #[napi]
+    pub fn enqueue(
+        &self,
+        repo_path: String,
+        operation_type: String,
+        operation_data: Option<String>,
+        priority: Option<i32>,
+    ) -> Result<i64> {
+        let priority = match priority.unwrap_or(0) {
+            p if p < 0 => crate::OperationPriority::Low,
+            0 => crate::OperationPriority::Normal,
+            _ => crate::OperationPriority::High,
+        };
+        self.inner
+            .enqueue(&repo_path, &operation_type, operation_data.as_deref().unwrap_or(""), priority)
+            .map_err(|e| Error::from_reason(format!("Scheduler error: {}", e)))
+    }
+
+    /// Status of a queued operation, or null if it is unknown
+    #[napi]
+    pub fn operation_status(&self, id: i64) -> Result<Option<OperationStatusJS>> {
+        let status = self
+            .inner
+            .operation_status(id)
+            .map_err(|e| Error::from_reason(format!("Scheduler error: {}", e)))?;
+        Ok(status.map(|(status, attempts, error)| OperationStatusJS {
+            status: match status {
+                crate::OperationStatus::Pending => "pending",
+                crate::OperationStatus::Running => "running",
+                crate::OperationStatus::Complete => "complete",
+                crate::OperationStatus::Failed => "failed",
+            }
+            .to_string(),
+            attempts,
+            error,
+        }))
+    }
+}
+
 /// Initialize the N-API module
 #[napi]
 pub fn init_gitscribe() -> String {
@@ -2,11 +2,65 @@
 //!
 //! Tracks all Git operations for undo/redo functionality
 //! Inspired by GitButler's operation timeline
+//!
+//! Operations live in a ring buffer, so dropping the oldest is O(1). Their
+//! snapshots are stored compactly: paths are interned to ids, and each path
+//! list is cut into content-defined chunks of ids that are shared with every
+//! other list containing the same run. A list identical to the previous
+//! snapshot's is shared whole, and an edit only replaces the chunks around
+//! it, so memory follows what changed rather than repository size times
+//! history length. Operations are rebuilt in full when read.
+//!
+//! A log opened with `OperationLog::open` is persisted to an append-only
+//! file (see `oplog_file`): each push appends the new paths, chunks and the
+//! operation in one write, and undo/redo append the new position. Writes
+//! hold the file's lock and first reload the log if another process wrote
+//! to it, since path and chunk ids are only meaningful in file order.
+//! Opening maps the file and only walks record headers; operations are
+//! decoded when read. Time and type queries go through a small index instead
+//! of decoding every operation. Once superseded operations outnumber the
+//! live ones, the file is rewritten with just the live window and the paths
+//! and chunks it refers to.
+//!
+//! Operation record body (little-endian):
+//! ```text
+//! seq u64 | timestamp u64 | kind u8 | success u8 | has_after u8 | has_error u8
+//! id str | error str? | operation_type (JSON) str | before snapshot | after snapshot?
+//! snapshot  head str | branch str | staged ids | modified ids | untracked ids | stashes
+//! str = len u32 + UTF-8; ids = count u32 + u32 chunk ids; stashes = count u32 + strs
+//! ```
 
+use anyhow::{bail, Context, Result};
 use serde::{Deserialize, Serialize};
-use std::path::PathBuf;
+use std::borrow::Cow;
+use std::collections::hash_map::DefaultHasher;
+use std::collections::{HashMap, VecDeque};
+use std::hash::{Hash, Hasher};
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
 use std::time::{SystemTime, UNIX_EPOCH};
 
+use crate::oplog_file::{read_u32, read_u64, OpLogFile};
+use crate::status_log::LockFile;
+
+/// Average path ids per chunk (a power of two)
+const CHUNK_TARGET: u32 = 32;
+/// Longest chunk, for runs that never hit a boundary
+const MAX_CHUNK: usize = 256;
+/// Evictions between rebuilds of a memory-only log's path store
+const PRUNE_INTERVAL: usize = 64;
+
+const RECORD_PATH: u8 = 1;
+const RECORD_CHUNK: u8 = 2;
+const RECORD_OP: u8 = 3;
+const RECORD_CURSOR: u8 = 4;
+
+/// Names accepted by `find_by_type`, indexed by `OperationType::tag`
+const KIND_NAMES: [&str; 16] = [
+    "commit", "stage", "unstage", "discard", "create_branch", "switch_branch", "merge", "pull",
+    "push", "stash", "stash_pop", "rebase", "cherry_pick", "revert", "reset", "amend_commit",
+];
+
 /// Type of Git operation
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub enum OperationType {
@@ -28,6 +82,34 @@ pub enum OperationType {
     AmendCommit { message: String },
 }
 
+impl OperationType {
+    /// Short name of the operation's kind, as used by `find_by_type`
+    pub fn kind(&self) -> &'static str {
+        KIND_NAMES[self.tag() as usize]
+    }
+
+    fn tag(&self) -> u8 {
+        match self {
+            OperationType::Commit { .. } => 0,
+            OperationType::Stage { .. } => 1,
+            OperationType::Unstage { .. } => 2,
+            OperationType::Discard { .. } => 3,
+            OperationType::CreateBranch { .. } => 4,
+            OperationType::SwitchBranch { .. } => 5,
+            OperationType::Merge { .. } => 6,
+            OperationType::Pull { .. } => 7,
+            OperationType::Push { .. } => 8,
+            OperationType::Stash { .. } => 9,
+            OperationType::StashPop { .. } => 10,
+            OperationType::Rebase { .. } => 11,
+            OperationType::CherryPick { .. } => 12,
+            OperationType::Revert { .. } => 13,
+            OperationType::Reset { .. } => 14,
+            OperationType::AmendCommit { .. } => 15,
+        }
+    }
+}
+
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub enum ResetMode {
     Soft,
@@ -89,49 +171,465 @@ impl Operation {
     }
 }
 
+/// A path list as ids of shared chunks of interned path ids
+#[derive(Debug, Clone, Default)]
+struct PathList {
+    chunks: Arc<[u32]>,
+}
+
+impl PathList {
+    fn same_as(&self, other: &PathList) -> bool {
+        self.chunks == other.chunks
+    }
+}
+
+/// `RepositorySnapshot` as stored in the log
+#[derive(Debug, Clone)]
+struct StoredSnapshot {
+    head: String,
+    branch: String,
+    staged_files: PathList,
+    modified_files: PathList,
+    untracked_files: PathList,
+    stashes: Vec<String>,
+}
+
+impl StoredSnapshot {
+    fn lists(&self) -> [&PathList; 3] {
+        [&self.staged_files, &self.modified_files, &self.untracked_files]
+    }
+
+    fn lists_mut(&mut self) -> [&mut PathList; 3] {
+        [&mut self.staged_files, &mut self.modified_files, &mut self.untracked_files]
+    }
+}
+
+/// `Operation` as stored in the log
+#[derive(Debug, Clone)]
+struct StoredOperation {
+    id: String,
+    timestamp: u64,
+    operation_type: OperationType,
+    snapshot_before: StoredSnapshot,
+    snapshot_after: Option<StoredSnapshot>,
+    success: bool,
+    error_message: Option<String>,
+}
+
+/// A ring entry: decoded, or an operation record in the mapped log file
+#[derive(Debug)]
+enum Slot {
+    Memory(StoredOperation),
+    Disk(u64),
+}
+
+/// Interned paths and the chunk pool shared by every snapshot in a log
+#[derive(Debug, Default)]
+struct PathStore {
+    ids: HashMap<Arc<str>, u32>,
+    paths: Vec<Arc<str>>,
+    /// Path ids of each chunk, by chunk id
+    chunks: Vec<Box<[u32]>>,
+    /// Chunk ids by content hash, for sharing equal runs
+    pool: HashMap<u64, Vec<u32>>,
+    /// Paths and chunks already written to the log file
+    saved_paths: usize,
+    saved_chunks: usize,
+}
+
+impl PathStore {
+    /// Store `paths`, reusing `previous` whole if nothing changed
+    fn store(&mut self, paths: &[String], previous: Option<&PathList>) -> PathList {
+        let mut chunks = Vec::with_capacity(paths.len() / CHUNK_TARGET as usize + 1);
+        let mut chunk = Vec::new();
+        for path in paths {
+            let id = self.intern(path);
+            chunk.push(id);
+            // Boundaries depend only on the ids, so an insertion or removal
+            // re-cuts just the chunk around it
+            if id.wrapping_mul(0x9e37_79b1) >> 27 == 0 || chunk.len() >= MAX_CHUNK {
+                chunks.push(self.share(&chunk));
+                chunk.clear();
+            }
+        }
+        if !chunk.is_empty() {
+            chunks.push(self.share(&chunk));
+        }
+
+        let list = PathList { chunks: chunks.into() };
+        match previous {
+            Some(previous) if previous.same_as(&list) => previous.clone(),
+            _ => list,
+        }
+    }
+
+    fn intern(&mut self, path: &str) -> u32 {
+        if let Some(&id) = self.ids.get(path) {
+            return id;
+        }
+        let id = self.paths.len() as u32;
+        let path: Arc<str> = Arc::from(path);
+        self.paths.push(path.clone());
+        self.ids.insert(path, id);
+        id
+    }
+
+    fn share(&mut self, ids: &[u32]) -> u32 {
+        let mut hasher = DefaultHasher::new();
+        ids.hash(&mut hasher);
+        let bucket = self.pool.entry(hasher.finish()).or_default();
+        match bucket.iter().find(|&&chunk| *self.chunks[chunk as usize] == *ids) {
+            Some(&chunk) => chunk,
+            None => {
+                let chunk = self.chunks.len() as u32;
+                self.chunks.push(ids.into());
+                bucket.push(chunk);
+                chunk
+            }
+        }
+    }
+
+    /// Re-add a chunk read from the log file, keeping its id
+    fn restore_chunk(&mut self, ids: Vec<u32>) -> Result<()> {
+        if ids.iter().any(|&id| id as usize >= self.paths.len()) {
+            bail!("Operation log chunk refers to an unknown path");
+        }
+        let mut hasher = DefaultHasher::new();
+        ids.hash(&mut hasher);
+        self.pool.entry(hasher.finish()).or_default().push(self.chunks.len() as u32);
+        self.chunks.push(ids.into());
+        Ok(())
+    }
+
+    /// Copy a list from another store, renumbering its chunks (`chunk_ids`
+    /// maps `from`'s chunk ids to ours, so shared chunks stay shared)
+    fn copy_list(&mut self, from: &PathStore, list: &PathList, chunk_ids: &mut HashMap<u32, u32>) -> PathList {
+        let chunks: Vec<u32> = list.chunks.iter()
+            .map(|&chunk| match chunk_ids.get(&chunk) {
+                Some(&copied) => copied,
+                None => {
+                    let ids: Vec<u32> = from.chunks[chunk as usize].iter()
+                        .map(|&id| self.intern(&from.paths[id as usize]))
+                        .collect();
+                    let copied = self.share(&ids);
+                    chunk_ids.insert(chunk, copied);
+                    copied
+                }
+            })
+            .collect();
+        PathList { chunks: chunks.into() }
+    }
+
+    fn load(&self, list: &PathList) -> Vec<String> {
+        list.chunks.iter()
+            .flat_map(|&chunk| self.chunks[chunk as usize].iter())
+            .map(|&id| self.paths[id as usize].to_string())
+            .collect()
+    }
+
+}
+
+/// Sequence numbers of operations by time and by kind
+#[derive(Debug, Default)]
+struct OpIndex {
+    /// (timestamp, seq), sorted
+    by_time: Vec<(u64, u64)>,
+    /// Ascending seqs per `OperationType::tag`
+    by_kind: HashMap<u8, Vec<u64>>,
+}
+
+impl OpIndex {
+    fn insert(&mut self, seq: u64, timestamp: u64, tag: u8) {
+        // Timestamps are nearly always non-decreasing
+        let at = self.by_time.partition_point(|&entry| entry <= (timestamp, seq));
+        self.by_time.insert(at, (timestamp, seq));
+        self.by_kind.entry(tag).or_default().push(seq);
+    }
+
+    /// Drop operations numbered `from` and later
+    fn truncate(&mut self, from: u64) {
+        self.retain(|seq| seq < from);
+    }
+
+    fn retain(&mut self, keep: impl Fn(u64) -> bool) {
+        self.by_time.retain(|&(_, seq)| keep(seq));
+        for seqs in self.by_kind.values_mut() {
+            seqs.retain(|&seq| keep(seq));
+        }
+    }
+}
+
 /// Operation log for tracking and undo/redo
 #[derive(Debug)]
 pub struct OperationLog {
-    operations: Vec<Operation>,
+    /// Ring buffer, oldest first
+    operations: VecDeque<Slot>,
+    /// Sequence number of `operations[0]`
+    first_seq: u64,
     current_index: Option<usize>,
     repo_path: PathBuf,
     max_operations: usize,
+    paths: PathStore,
+    evicted: usize,
+    index: OpIndex,
+    /// Backing file, for logs opened with `open`
+    file: Option<OpLogFile>,
+    /// Cleared after a failed append, so the file never has gaps
+    appending: bool,
+    /// Operation records in the file, live or not
+    op_records: usize,
+}
+
+/// What a walk over the log file found
+struct Scan {
+    /// Live operations as (seq, offset), oldest first
+    live: Vec<(u64, u64)>,
+    cursor: Option<u64>,
+    op_records: usize,
 }
 
 impl OperationLog {
     pub fn new(repo_path: PathBuf) -> Self {
         Self {
-            operations: Vec::new(),
+            operations: VecDeque::new(),
+            first_seq: 0,
             current_index: None,
             repo_path,
             max_operations: 1000, // Keep last 1000 operations
+            paths: PathStore::default(),
+            evicted: 0,
+            index: OpIndex::default(),
+            file: None,
+            appending: false,
+            op_records: 0,
+        }
+    }
+
+    /// Open the persisted log of the repository at `repo_path`, creating it
+    /// if there is none
+    pub fn open(repo_path: PathBuf) -> Result<Self> {
+        let git_dir = git2::Repository::open(&repo_path)
+            .context("Failed to open repository")?
+            .path()
+            .to_path_buf();
+        // Undo history belongs to a worktree, so this isn't in the common dir
+        Self::open_file(repo_path, &git_dir.join("gitscribe").join("oplog"))
+    }
+
+    fn open_file(repo_path: PathBuf, path: &Path) -> Result<Self> {
+        let mut log = Self::new(repo_path);
+        let _lock = OpLogFile::lock(path)?;
+        log.load_file(OpLogFile::open(path)?)?;
+        log.compact_if_needed();
+        log.appending = true;
+        Ok(log)
+    }
+
+    /// Replace the in-memory log with the contents of `file`
+    fn load_file(&mut self, file: OpLogFile) -> Result<()> {
+        self.operations.clear();
+        self.current_index = None;
+        self.paths = PathStore::default();
+        self.index = OpIndex::default();
+        self.evicted = 0;
+        let scan = self.scan(&file)?;
+
+        let window = &scan.live[scan.live.len().saturating_sub(self.max_operations)..];
+        self.first_seq = window.first().map_or(0, |&(seq, _)| seq);
+        for &(seq, offset) in window {
+            let body = file.body(offset).context("Operation log record out of range")?;
+            self.index.insert(seq, read_u64(body, 8), body[16]);
+            self.operations.push_back(Slot::Disk(offset));
+        }
+        self.current_index = match (scan.cursor, self.operations.len()) {
+            (_, 0) | (None, _) => None,
+            (Some(cursor), len) => Some((cursor.saturating_sub(self.first_seq) as usize).min(len - 1)),
+        };
+        self.paths.saved_paths = self.paths.paths.len();
+        self.paths.saved_chunks = self.paths.chunks.len();
+        self.op_records = scan.op_records;
+        self.file = Some(file);
+        Ok(())
+    }
+
+    /// Take the file's lock before a write, reloading first if another
+    /// process wrote to the file since we last did
+    ///
+    /// Returns None (and stops persisting) if the file can't be used.
+    fn begin_write(&mut self) -> Option<LockFile> {
+        let base = match &self.file {
+            Some(file) if self.appending => file.base().to_path_buf(),
+            _ => return None,
+        };
+        let result = OpLogFile::lock(&base).and_then(|lock| {
+            let file = self.file.as_mut().context("Operation log is not open")?;
+            if !file.is_current()? {
+                self.load_file(OpLogFile::open(&base)?)?;
+            }
+            Ok(lock)
+        });
+        match result {
+            Ok(lock) => Some(lock),
+            Err(e) => {
+                tracing::debug!("operation log is no longer persisted: {:#}", e);
+                self.appending = false;
+                None
+            }
+        }
+    }
+
+    /// Walk the file's records, restoring paths and chunks and noting where
+    /// the live operations are
+    fn scan(&mut self, file: &OpLogFile) -> Result<Scan> {
+        let mut scan = Scan { live: Vec::new(), cursor: None, op_records: 0 };
+        for record in file.records() {
+            match record.kind {
+                RECORD_PATH => {
+                    let path = std::str::from_utf8(record.body).context("Invalid path in operation log")?;
+                    let id = self.paths.paths.len() as u32;
+                    let path: Arc<str> = Arc::from(path);
+                    self.paths.paths.push(path.clone());
+                    self.paths.ids.insert(path, id);
+                }
+                RECORD_CHUNK => {
+                    let mut reader = Reader { bytes: record.body, at: 0 };
+                    self.paths.restore_chunk(reader.ids()?)?;
+                }
+                RECORD_OP => {
+                    if record.body.len() < 20 {
+                        bail!("Truncated operation in operation log");
+                    }
+                    // A new operation replaces everything that was undone
+                    let seq = read_u64(record.body, 0);
+                    while scan.live.last().map_or(false, |&(last, _)| last >= seq) {
+                        scan.live.pop();
+                    }
+                    scan.live.push((seq, record.offset));
+                    scan.cursor = Some(seq);
+                    scan.op_records += 1;
+                }
+                RECORD_CURSOR if record.body.len() >= 8 => scan.cursor = Some(read_u64(record.body, 0)),
+                kind => tracing::debug!("skipping unknown operation log record kind {}", kind),
+            }
         }
+        Ok(scan)
+    }
+
+    /// Superseded operations only cost disk space, but don't let them
+    /// outgrow the live ones. Call with the lock held.
+    fn compact_if_needed(&mut self) {
+        if self.file.is_some() && self.op_records > 2 * self.max_operations {
+            if let Err(e) = self.compact() {
+                tracing::debug!("failed to compact operation log: {:#}", e);
+            }
+        }
+    }
+
+    /// Rewrite the file with only the live operations and the paths and
+    /// chunks they use, renumbered from zero, then reload it
+    fn compact(&mut self) -> Result<()> {
+        let mut paths = PathStore::default();
+        let mut chunk_ids = HashMap::new();
+        let mut ops = Vec::with_capacity(self.operations.len());
+        for (i, slot) in self.operations.iter().enumerate() {
+            let mut op = self.stored(slot).context("Unreadable operation in operation log")?.into_owned();
+            for snapshot in std::iter::once(&mut op.snapshot_before).chain(op.snapshot_after.as_mut()) {
+                for list in snapshot.lists_mut() {
+                    *list = paths.copy_list(&self.paths, list, &mut chunk_ids);
+                }
+            }
+            ops.push(encode_operation(self.first_seq + i as u64, &op));
+        }
+
+        let mut records: Vec<(u8, Vec<u8>)> = Vec::new();
+        records.extend(paths.paths.iter().map(|path| (RECORD_PATH, path.as_bytes().to_vec())));
+        records.extend(paths.chunks.iter().map(|chunk| {
+            let mut body = Vec::with_capacity(4 + chunk.len() * 4);
+            put_ids(&mut body, chunk);
+            (RECORD_CHUNK, body)
+        }));
+        records.extend(ops.into_iter().map(|op| (RECORD_OP, op)));
+        if let Some(index) = self.current_index {
+            records.push((RECORD_CURSOR, (self.first_seq + index as u64).to_le_bytes().to_vec()));
+        }
+
+        let mut file = self.file.take().context("Operation log is not open")?;
+        let rewritten = file.rewrite(records.iter().map(|(kind, body)| (*kind, body.as_slice())));
+        self.file = Some(file);
+        rewritten?;
+        let file = self.file.take().context("Operation log is not open")?;
+        self.load_file(file)
+    }
+
+    /// Rebuild a memory-only log's path store with just the paths and
+    /// chunks its operations still use, renumbering their lists
+    fn compact_memory(&mut self) {
+        let mut paths = PathStore::default();
+        let mut chunk_ids = HashMap::new();
+        // Lists shared whole between snapshots stay shared
+        let mut copied: HashMap<*const [u32], PathList> = HashMap::new();
+
+        for slot in self.operations.iter_mut() {
+            let op = match slot {
+                Slot::Memory(op) => op,
+                Slot::Disk(_) => continue,
+            };
+            for snapshot in std::iter::once(&mut op.snapshot_before).chain(op.snapshot_after.as_mut()) {
+                for list in snapshot.lists_mut() {
+                    *list = copied.entry(Arc::as_ptr(&list.chunks))
+                        .or_insert_with(|| paths.copy_list(&self.paths, list, &mut chunk_ids))
+                        .clone();
+                }
+            }
+        }
+        self.paths = paths;
     }
 
     /// Add a new operation to the log
     pub fn push(&mut self, operation: Operation) {
+        let _lock = self.begin_write();
+
         // If we're not at the end of the log, truncate future operations
         if let Some(index) = self.current_index {
             self.operations.truncate(index + 1);
         }
+        let seq = self.first_seq + self.operations.len() as u64;
+        self.index.truncate(seq);
 
-        self.operations.push(operation);
+        let stored = self.store(operation);
+        self.index.insert(seq, stored.timestamp, stored.operation_type.tag());
+        self.persist(seq, &stored);
+        self.operations.push_back(Slot::Memory(stored));
         self.current_index = Some(self.operations.len() - 1);
 
         // Enforce max operations limit
-        if self.operations.len() > self.max_operations {
-            let to_remove = self.operations.len() - self.max_operations;
-            self.operations.drain(0..to_remove);
+        while self.operations.len() > self.max_operations {
+            self.operations.pop_front();
+            self.first_seq += 1;
             if let Some(ref mut index) = self.current_index {
-                *index = index.saturating_sub(to_remove);
+                *index = index.saturating_sub(1);
+            }
+            self.evicted += 1;
+            if self.evicted % PRUNE_INTERVAL == 0 {
+                let first_seq = self.first_seq;
+                self.index.retain(|seq| seq >= first_seq);
+                // Operations in the file refer to chunks by id, so a
+                // persisted log lets them go when it compacts instead
+                if self.file.is_none() {
+                    self.compact_memory();
+                }
             }
         }
+
+        if self.appending {
+            self.compact_if_needed();
+        }
     }
 
     /// Get the current operation
-    pub fn current(&self) -> Option<&Operation> {
+    pub fn current(&self) -> Option<Operation> {
         self.current_index
-            .and_then(|idx| self.operations.get(idx))
+            .and_then(|idx| self.get(idx))
     }
 
     /// Can we undo?
@@ -149,87 +647,348 @@ impl OperationLog {
     }
 
     /// Undo the last operation
-    pub fn undo(&mut self) -> Option<&Operation> {
+    pub fn undo(&mut self) -> Option<Operation> {
+        let _lock = self.begin_write();
         if self.can_undo() {
             if let Some(ref mut index) = self.current_index {
                 *index -= 1;
-                return self.operations.get(*index);
+                let index = *index;
+                self.persist_cursor(index);
+                return self.get(index);
             }
         }
         None
     }
 
     /// Redo the next operation
-    pub fn redo(&mut self) -> Option<&Operation> {
+    pub fn redo(&mut self) -> Option<Operation> {
+        let _lock = self.begin_write();
         if self.can_redo() {
-            match self.current_index {
-                Some(ref mut index) => {
-                    *index += 1;
-                    self.operations.get(*index)
-                }
-                None => {
-                    self.current_index = Some(0);
-                    self.operations.get(0)
-                }
-            }
+            let index = self.current_index.map_or(0, |index| index + 1);
+            self.current_index = Some(index);
+            self.persist_cursor(index);
+            self.get(index)
         } else {
             None
         }
     }
 
-    /// Get all operations
-    pub fn all_operations(&self) -> &[Operation] {
-        &self.operations
+    /// Get all operations, oldest first
+    pub fn all_operations(&self) -> Vec<Operation> {
+        self.operations
+            .iter()
+            .filter_map(|slot| self.load(slot))
+            .collect()
     }
 
     /// Get operations in reverse chronological order
-    pub fn recent_operations(&self, count: usize) -> Vec<&Operation> {
+    pub fn recent_operations(&self, count: usize) -> Vec<Operation> {
         self.operations
             .iter()
             .rev()
             .take(count)
+            .filter_map(|slot| self.load(slot))
             .collect()
     }
 
-    /// Search operations by type
-    pub fn find_by_type(&self, operation_type: &str) -> Vec<&Operation> {
-        self.operations
-            .iter()
-            .filter(|op| {
-                match &op.operation_type {
-                    OperationType::Commit { .. } => operation_type == "commit",
-                    OperationType::Stage { .. } => operation_type == "stage",
-                    OperationType::Push { .. } => operation_type == "push",
-                    OperationType::Pull { .. } => operation_type == "pull",
-                    _ => false,
-                }
-            })
-            .collect()
+    /// Search operations by type (see `OperationType::kind`)
+    pub fn find_by_type(&self, operation_type: &str) -> Vec<Operation> {
+        let seqs = KIND_NAMES.iter()
+            .position(|name| *name == operation_type)
+            .and_then(|tag| self.index.by_kind.get(&(tag as u8)));
+        match seqs {
+            Some(seqs) => self.get_seqs(seqs.iter().copied()),
+            None => Vec::new(),
+        }
     }
 
     /// Get operations within a time range
-    pub fn operations_in_range(&self, start: u64, end: u64) -> Vec<&Operation> {
-        self.operations
-            .iter()
-            .filter(|op| op.timestamp >= start && op.timestamp <= end)
-            .collect()
+    pub fn operations_in_range(&self, start: u64, end: u64) -> Vec<Operation> {
+        if start > end {
+            return Vec::new();
+        }
+        let by_time = &self.index.by_time;
+        let from = by_time.partition_point(|&(timestamp, _)| timestamp < start);
+        let to = by_time.partition_point(|&(timestamp, _)| timestamp <= end);
+        let mut seqs: Vec<u64> = by_time[from..to].iter().map(|&(_, seq)| seq).collect();
+        seqs.sort_unstable();
+        self.get_seqs(seqs.into_iter())
     }
 
     /// Clear the entire log
     pub fn clear(&mut self) {
+        let _lock = self.begin_write();
         self.operations.clear();
+        self.first_seq = 0;
         self.current_index = None;
+        self.paths = PathStore::default();
+        self.index = OpIndex::default();
+        self.op_records = 0;
+        if let Some(file) = &mut self.file {
+            match file.clear() {
+                Ok(()) => self.appending = true,
+                Err(e) => {
+                    tracing::debug!("failed to clear operation log file: {:#}", e);
+                    self.appending = false;
+                }
+            }
+        }
     }
 
     /// Export log to JSON
     pub fn to_json(&self) -> Result<String, serde_json::Error> {
-        serde_json::to_string_pretty(&self.operations)
+        serde_json::to_string_pretty(&self.all_operations())
     }
 
     /// Import log from JSON
     pub fn from_json(json: &str) -> Result<Vec<Operation>, serde_json::Error> {
         serde_json::from_str(json)
     }
+
+    fn get(&self, index: usize) -> Option<Operation> {
+        self.operations.get(index).and_then(|slot| self.load(slot))
+    }
+
+    /// Operations by ascending seq, skipping any no longer in the ring
+    fn get_seqs(&self, seqs: impl Iterator<Item = u64>) -> Vec<Operation> {
+        seqs.filter(|&seq| seq >= self.first_seq)
+            .filter_map(|seq| self.get((seq - self.first_seq) as usize))
+            .collect()
+    }
+
+    /// Append the new paths, chunks and the operation in one write
+    fn persist(&mut self, seq: u64, operation: &StoredOperation) {
+        let file = match &mut self.file {
+            Some(file) if self.appending => file,
+            _ => return,
+        };
+        let paths = &self.paths;
+        let mut records: Vec<(u8, Vec<u8>)> = Vec::new();
+        for path in &paths.paths[paths.saved_paths..] {
+            records.push((RECORD_PATH, path.as_bytes().to_vec()));
+        }
+        for chunk in &paths.chunks[paths.saved_chunks..] {
+            let mut body = Vec::with_capacity(4 + chunk.len() * 4);
+            put_ids(&mut body, chunk);
+            records.push((RECORD_CHUNK, body));
+        }
+        records.push((RECORD_OP, encode_operation(seq, operation)));
+
+        match file.append(&records) {
+            Ok(_) => {
+                self.paths.saved_paths = self.paths.paths.len();
+                self.paths.saved_chunks = self.paths.chunks.len();
+                self.op_records += 1;
+            }
+            Err(e) => {
+                // A missing operation would be replaced by the next one on
+                // reload, so stop appending instead of leaving a gap
+                tracing::debug!("operation log is no longer persisted: {:#}", e);
+                self.appending = false;
+            }
+        }
+    }
+
+    fn persist_cursor(&mut self, index: usize) {
+        if let Some(file) = self.file.as_mut().filter(|_| self.appending) {
+            let cursor = self.first_seq + index as u64;
+            if let Err(e) = file.append(&[(RECORD_CURSOR, cursor.to_le_bytes().to_vec())]) {
+                tracing::debug!("operation log is no longer persisted: {:#}", e);
+                self.appending = false;
+            }
+        }
+    }
+
+    /// A ring entry, decoding it from the file if needed
+    fn stored<'a>(&'a self, slot: &'a Slot) -> Option<Cow<'a, StoredOperation>> {
+        match slot {
+            Slot::Memory(op) => Some(Cow::Borrowed(op)),
+            Slot::Disk(offset) => {
+                let decoded = self.file.as_ref()
+                    .and_then(|file| file.body(*offset))
+                    .context("Operation log record out of range")
+                    .and_then(|body| decode_operation(body, &self.paths));
+                match decoded {
+                    Ok(op) => Some(Cow::Owned(op)),
+                    Err(e) => {
+                        tracing::debug!("skipping unreadable operation at {}: {:#}", offset, e);
+                        None
+                    }
+                }
+            }
+        }
+    }
+
+    fn store(&mut self, operation: Operation) -> StoredOperation {
+        // Consecutive snapshots usually differ in a few paths at most
+        let last = self.operations.back()
+            .and_then(|slot| self.stored(slot))
+            .map(|op| op.snapshot_after.as_ref().unwrap_or(&op.snapshot_before).clone());
+        let snapshot_before = self.store_snapshot(&operation.snapshot_before, last.as_ref());
+        let snapshot_after = operation.snapshot_after
+            .as_ref()
+            .map(|after| self.store_snapshot(after, Some(&snapshot_before)));
+
+        StoredOperation {
+            id: operation.id,
+            timestamp: operation.timestamp,
+            operation_type: operation.operation_type,
+            snapshot_before,
+            snapshot_after,
+            success: operation.success,
+            error_message: operation.error_message,
+        }
+    }
+
+    fn store_snapshot(&mut self, snapshot: &RepositorySnapshot, previous: Option<&StoredSnapshot>) -> StoredSnapshot {
+        StoredSnapshot {
+            head: snapshot.head.clone(),
+            branch: snapshot.branch.clone(),
+            staged_files: self.paths.store(&snapshot.staged_files, previous.map(|p| &p.staged_files)),
+            modified_files: self.paths.store(&snapshot.modified_files, previous.map(|p| &p.modified_files)),
+            untracked_files: self.paths.store(&snapshot.untracked_files, previous.map(|p| &p.untracked_files)),
+            stashes: snapshot.stashes.clone(),
+        }
+    }
+
+    fn load(&self, slot: &Slot) -> Option<Operation> {
+        let operation = self.stored(slot)?;
+        Some(Operation {
+            id: operation.id.clone(),
+            timestamp: operation.timestamp,
+            operation_type: operation.operation_type.clone(),
+            snapshot_before: self.load_snapshot(&operation.snapshot_before),
+            snapshot_after: operation.snapshot_after.as_ref().map(|s| self.load_snapshot(s)),
+            success: operation.success,
+            error_message: operation.error_message.clone(),
+        })
+    }
+
+    fn load_snapshot(&self, snapshot: &StoredSnapshot) -> RepositorySnapshot {
+        RepositorySnapshot {
+            head: snapshot.head.clone(),
+            branch: snapshot.branch.clone(),
+            staged_files: self.paths.load(&snapshot.staged_files),
+            modified_files: self.paths.load(&snapshot.modified_files),
+            untracked_files: self.paths.load(&snapshot.untracked_files),
+            stashes: snapshot.stashes.clone(),
+        }
+    }
+}
+
+fn encode_operation(seq: u64, operation: &StoredOperation) -> Vec<u8> {
+    let mut out = Vec::with_capacity(256);
+    out.extend_from_slice(&seq.to_le_bytes());
+    out.extend_from_slice(&operation.timestamp.to_le_bytes());
+    out.extend_from_slice(&[
+        operation.operation_type.tag(),
+        operation.success as u8,
+        operation.snapshot_after.is_some() as u8,
+        operation.error_message.is_some() as u8,
+    ]);
+    put_str(&mut out, &operation.id);
+    if let Some(error) = &operation.error_message {
+        put_str(&mut out, error);
+    }
+    // Serializing a plain enum can't fail
+    put_str(&mut out, &serde_json::to_string(&operation.operation_type).unwrap_or_default());
+    put_snapshot(&mut out, &operation.snapshot_before);
+    if let Some(after) = &operation.snapshot_after {
+        put_snapshot(&mut out, after);
+    }
+    out
+}
+
+fn put_snapshot(out: &mut Vec<u8>, snapshot: &StoredSnapshot) {
+    put_str(out, &snapshot.head);
+    put_str(out, &snapshot.branch);
+    for list in snapshot.lists() {
+        put_ids(out, &list.chunks);
+    }
+    out.extend_from_slice(&(snapshot.stashes.len() as u32).to_le_bytes());
+    for stash in &snapshot.stashes {
+        put_str(out, stash);
+    }
+}
+
+fn put_str(out: &mut Vec<u8>, s: &str) {
+    out.extend_from_slice(&(s.len() as u32).to_le_bytes());
+    out.extend_from_slice(s.as_bytes());
+}
+
+fn put_ids(out: &mut Vec<u8>, ids: &[u32]) {
+    out.extend_from_slice(&(ids.len() as u32).to_le_bytes());
+    for id in ids {
+        out.extend_from_slice(&id.to_le_bytes());
+    }
+}
+
+fn decode_operation(body: &[u8], paths: &PathStore) -> Result<StoredOperation> {
+    let mut reader = Reader { bytes: body, at: 0 };
+    reader.take(8)?;
+    let timestamp = reader.u64()?;
+    let flags = reader.take(4)?;
+    let (success, has_after, has_error) = (flags[1] != 0, flags[2] != 0, flags[3] != 0);
+
+    let id = reader.str()?;
+    let error_message = if has_error { Some(reader.str()?) } else { None };
+    let operation_type = serde_json::from_str(&reader.str()?).context("Invalid operation type in operation log")?;
+    let snapshot_before = reader.snapshot(paths)?;
+    let snapshot_after = if has_after { Some(reader.snapshot(paths)?) } else { None };
+
+    Ok(StoredOperation { id, timestamp, operation_type, snapshot_before, snapshot_after, success, error_message })
+}
+
+/// Cursor over a record body
+struct Reader<'a> {
+    bytes: &'a [u8],
+    at: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn take(&mut self, len: usize) -> Result<&'a [u8]> {
+        let bytes = self.bytes.get(self.at..self.at.saturating_add(len)).context("Truncated operation log record")?;
+        self.at += len;
+        Ok(bytes)
+    }
+
+    fn u32(&mut self) -> Result<u32> {
+        Ok(read_u32(self.take(4)?, 0))
+    }
+
+    fn u64(&mut self) -> Result<u64> {
+        Ok(read_u64(self.take(8)?, 0))
+    }
+
+    fn str(&mut self) -> Result<String> {
+        let len = self.u32()? as usize;
+        let bytes = self.take(len)?;
+        Ok(std::str::from_utf8(bytes).context("Invalid string in operation log")?.to_string())
+    }
+
+    fn ids(&mut self) -> Result<Vec<u32>> {
+        let count = self.u32()? as usize;
+        let bytes = self.take(count.checked_mul(4).context("Truncated operation log record")?)?;
+        Ok(bytes.chunks_exact(4).map(|id| read_u32(id, 0)).collect())
+    }
+
+    fn list(&mut self, paths: &PathStore) -> Result<PathList> {
+        let chunks = self.ids()?;
+        if chunks.iter().any(|&chunk| chunk as usize >= paths.chunks.len()) {
+            bail!("Operation log snapshot refers to an unknown chunk");
+        }
+        Ok(PathList { chunks: chunks.into() })
+    }
+
+    fn snapshot(&mut self, paths: &PathStore) -> Result<StoredSnapshot> {
+        let head = self.str()?;
+        let branch = self.str()?;
+        let staged_files = self.list(paths)?;
+        let modified_files = self.list(paths)?;
+        let untracked_files = self.list(paths)?;
+        let stashes = (0..self.u32()?).map(|_| self.str()).collect::<Result<_>>()?;
+        Ok(StoredSnapshot { head, branch, staged_files, modified_files, untracked_files, stashes })
+    }
 }
 
 #[cfg(test)]
@@ -312,4 +1071,147 @@ mod tests {
 
         assert_eq!(log.operations.len(), 3);
     }
+
+    #[test]
+    fn test_eviction_frees_paths() {
+        let mut log = OperationLog::new(PathBuf::from("/test"));
+        log.max_operations = 4;
+
+        for i in 0..PRUNE_INTERVAL * 3 {
+            // Every operation sees paths no other operation has
+            let files: Vec<String> = (0..50).map(|j| format!("gen{}/{}.txt", i, j)).collect();
+            let before = RepositorySnapshot { modified_files: files.clone(), ..create_test_snapshot() };
+            let after = RepositorySnapshot { staged_files: files, ..create_test_snapshot() };
+            log.push(Operation::new(OperationType::Stage { files: vec![] }, before).with_result(after, true, None));
+        }
+
+        // Only the operations since the last rebuild keep their paths
+        assert!(log.paths.paths.len() <= (log.max_operations + PRUNE_INTERVAL) * 50 + 10, "{} paths", log.paths.paths.len());
+        let last = log.current().unwrap();
+        assert_eq!(last.snapshot_after.unwrap().staged_files[49], format!("gen{}/49.txt", PRUNE_INTERVAL * 3 - 1));
+        assert!(log.undo().is_some());
+        assert_eq!(log.current().unwrap().snapshot_before.modified_files[0], format!("gen{}/0.txt", PRUNE_INTERVAL * 3 - 2));
+    }
+
+    #[test]
+    fn test_snapshots_share_unchanged_paths() {
+        let mut log = OperationLog::new(PathBuf::from("/test"));
+        let mut untracked: Vec<String> = (0..10_000).map(|i| format!("build/out/{}.o", i)).collect();
+
+        for i in 0..100 {
+            let before = RepositorySnapshot { untracked_files: untracked.clone(), ..create_test_snapshot() };
+            // Each operation touches one path in the middle of the list
+            untracked[5_000 + i] = format!("build/out/{}.tmp", i);
+            let after = RepositorySnapshot { untracked_files: untracked.clone(), ..create_test_snapshot() };
+
+            let op = Operation::new(OperationType::Stage { files: vec![] }, before).with_result(after, true, None);
+            log.push(op);
+        }
+
+        // Rebuilt exactly
+        let last = log.current().unwrap();
+        assert_eq!(last.snapshot_after.unwrap().untracked_files, untracked);
+        assert_eq!(last.snapshot_before.untracked_files[5_099], "build/out/5099.o");
+
+        // The first operation's `after` is shared whole by the next `before`
+        let stored = |index: usize| match &log.operations[index] {
+            Slot::Memory(op) => op,
+            Slot::Disk(_) => unreachable!(),
+        };
+        let (first, second) = (stored(0), stored(1));
+        assert!(Arc::ptr_eq(
+            &first.snapshot_after.as_ref().unwrap().untracked_files.chunks,
+            &second.snapshot_before.untracked_files.chunks,
+        ));
+
+        // One list's worth of chunks plus a few per edit, not 200 copies
+        let chunks: usize = log.paths.pool.values().map(|bucket| bucket.len()).sum();
+        let one_list = first.snapshot_before.untracked_files.chunks.len();
+        assert!(chunks < one_list + 100 * 3, "{} chunks for lists of {}", chunks, one_list);
+    }
+
+    #[test]
+    fn test_persisted_log_reopens() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let path = temp_dir.path().join("oplog");
+        let operation = |i: u64, operation_type: OperationType| {
+            let before = RepositorySnapshot { modified_files: vec![format!("src/{}.rs", i)], ..create_test_snapshot() };
+            let mut op = Operation::new(operation_type, before.clone()).with_result(before, i != 2, None);
+            op.timestamp = 1000 + i * 10;
+            op
+        };
+
+        let mut log = OperationLog::open_file(PathBuf::from("/test"), &path).unwrap();
+        let mut ids = Vec::new();
+        for i in 0..6 {
+            let operation_type = if i % 2 == 0 {
+                OperationType::Stage { files: vec![format!("src/{}.rs", i)] }
+            } else {
+                OperationType::Commit { message: format!("Commit {}", i), hash: format!("{}", i) }
+            };
+            let op = operation(i, operation_type);
+            ids.push(op.id.clone());
+            log.push(op);
+        }
+        log.undo();
+        log.undo();
+        drop(log);
+
+        let mut log = OperationLog::open_file(PathBuf::from("/test"), &path).unwrap();
+        assert!(log.operations.iter().all(|slot| matches!(slot, Slot::Disk(_))));
+        let current = log.current().unwrap();
+        assert_eq!(current.id, ids[3]);
+        assert_eq!(current.snapshot_before.modified_files, ["src/3.rs"]);
+        assert!(log.can_redo());
+
+        let stages: Vec<String> = log.find_by_type("stage").into_iter().map(|op| op.id).collect();
+        assert_eq!(stages, [ids[0].clone(), ids[2].clone(), ids[4].clone()]);
+        let in_range: Vec<String> = log.operations_in_range(1010, 1030).into_iter().map(|op| op.id).collect();
+        assert_eq!(in_range, &ids[1..4]);
+        assert!(!log.all_operations()[2].success);
+
+        // Pushing after undo drops the undone operations, on disk too
+        let op = operation(9, OperationType::Push { remote: "origin".into(), branch: "main".into() });
+        let pushed = op.id.clone();
+        log.push(op);
+        drop(log);
+
+        let log = OperationLog::open_file(PathBuf::from("/test"), &path).unwrap();
+        let all: Vec<String> = log.all_operations().into_iter().map(|op| op.id).collect();
+        assert_eq!(all, [&ids[..4], &[pushed.clone()]].concat());
+        assert_eq!(log.current().unwrap().id, pushed);
+        assert!(log.find_by_type("stage").iter().all(|op| op.id != ids[4]));
+    }
+
+    #[test]
+    fn test_writers_share_file_and_compaction_drops_old_paths() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let path = temp_dir.path().join("oplog");
+        let operation = |i: usize| {
+            let before = RepositorySnapshot { untracked_files: vec![format!("tmp/{}.o", i)], ..create_test_snapshot() };
+            Operation::new(OperationType::Stage { files: vec![] }, before)
+        };
+
+        // Two processes appending in turn each see the other's operations...
+        let mut first = OperationLog::open_file(PathBuf::from("/test"), &path).unwrap();
+        let mut second = OperationLog::open_file(PathBuf::from("/test"), &path).unwrap();
+        first.max_operations = 3;
+        let ops: Vec<Operation> = (0..10).map(operation).collect();
+        for (i, op) in ops.iter().enumerate() {
+            let log = if i % 2 == 0 { &mut first } else { &mut second };
+            log.push(op.clone());
+        }
+        // ... in order, minus the oldest ones `first` compacted away
+        let ids: Vec<String> = second.all_operations().into_iter().map(|op| op.id).collect();
+        assert!(ids.len() >= 3 && ids.len() < 10, "{} operations kept", ids.len());
+        let expected: Vec<String> = ops[10 - ids.len()..].iter().map(|op| op.id.clone()).collect();
+        assert_eq!(ids, expected);
+
+        let mut log = OperationLog::open_file(PathBuf::from("/test"), &path).unwrap();
+        log.max_operations = 3;
+        let all = log.all_operations();
+        assert_eq!(all.last().unwrap().id, ops[9].id);
+        assert_eq!(all.last().unwrap().snapshot_before.untracked_files, ["tmp/9.o"]);
+        assert!(log.paths.paths.len() < 10, "{} paths kept", log.paths.paths.len());
+    }
 }
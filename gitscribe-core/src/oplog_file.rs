@@ -0,0 +1,332 @@
+//! Operation Log File
+//!
+//! Append-only record file behind a persistent `OperationLog`. Every record
+//! carries its own checksum, so a write torn by a crash is detected when the
+//! file is next opened, and every earlier record stays intact. Readers map
+//! the file and walk record headers; payloads are only decoded by the caller
+//! when it needs them.
+//!
+//! Mapped bytes are never changed: records only go past the end, and a file
+//! is never truncated or renamed over. A rewrite (compaction, clearing, or
+//! dropping a torn tail) writes the next generation (`oplog-1`, `oplog-2`,
+//! ...) and marks the old file as replaced, so other processes with it open
+//! move over on their next write. Writers serialize through `oplog.lock`.
+//!
+//! File layout (little-endian):
+//! ```text
+//! header  magic "GSOL" | version u32 | replaced_by u64 (0 while current)
+//! record  len u32 | kind u8 | pad 3 | checksum u64 | body (len bytes)
+//! ```
+
+use anyhow::{bail, Context, Result};
+use std::fs::{self, File, OpenOptions};
+use std::hash::Hasher;
+use std::io::{Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+
+use crate::fingerprint::Fnv64;
+use crate::status_log::LockFile;
+
+const FILE_MAGIC: &[u8; 4] = b"GSOL";
+const FORMAT_VERSION: u32 = 1;
+const HEADER_LEN: usize = 16;
+/// Header field holding the generation that replaced the file
+const REPLACED_FIELD: u64 = 8;
+const RECORD_HEADER_LEN: usize = 16;
+
+/// A record borrowed from the mapped file
+pub(crate) struct Record<'a> {
+    pub offset: u64,
+    pub kind: u8,
+    pub body: &'a [u8],
+}
+
+/// An open operation log file
+#[derive(Debug)]
+pub(crate) struct OpLogFile {
+    /// Path of generation 0, which later generations are named after
+    base: PathBuf,
+    generation: u64,
+    file: File,
+    /// The file as of `open`; records appended since are not mapped
+    map: Option<memmap2::Mmap>,
+    /// End of the last good record
+    len: u64,
+}
+
+impl OpLogFile {
+    /// Take the writer lock of the log at `base`; hold it across `open`,
+    /// `is_current` and writes
+    pub fn lock(base: &Path) -> Result<LockFile> {
+        if let Some(dir) = base.parent() {
+            fs::create_dir_all(dir).context("Failed to create operation log directory")?;
+        }
+        LockFile::acquire(&base.with_extension("lock"))
+    }
+
+    /// Open (creating if needed) the newest generation of a log
+    ///
+    /// A torn tail is left behind by writing the good records to a new
+    /// generation. Call with the lock held.
+    pub fn open(base: &Path) -> Result<Self> {
+        let generations = generations(base)?;
+        let generation = generations.last().map_or(0, |&(generation, _)| generation);
+        for (old, path) in &generations {
+            // Still open elsewhere on Windows; removed by a later open
+            if *old < generation && fs::remove_file(path).is_err() {
+                tracing::debug!("could not remove old operation log {:?}", path);
+            }
+        }
+
+        let path = generation_path(base, generation);
+        let mut file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(false)
+            .open(&path)
+            .with_context(|| format!("Failed to open operation log {}", path.display()))?;
+
+        if file.metadata()?.len() == 0 {
+            write_header(&mut file)?;
+        }
+
+        // SAFETY: mapped bytes are never rewritten (see the module docs)
+        let map = unsafe { memmap2::Mmap::map(&file) }.context("Failed to map operation log")?;
+        if map.len() < HEADER_LEN || &map[..4] != FILE_MAGIC {
+            bail!("{} is not an operation log", path.display());
+        }
+        if read_u32(&map, 4) != FORMAT_VERSION {
+            bail!("Unsupported operation log version in {}", path.display());
+        }
+
+        let file_len = map.len() as u64;
+        let mut log = OpLogFile { base: base.to_path_buf(), generation, file, map: Some(map), len: HEADER_LEN as u64 };
+        log.len = log.records().last().map_or(HEADER_LEN as u64, |r| r.offset + (RECORD_HEADER_LEN + r.body.len()) as u64);
+        if log.len < file_len {
+            tracing::debug!("dropping {} bytes of torn records from {:?}", file_len - log.len, path);
+            let records: Vec<(u8, Vec<u8>)> = log.records().map(|r| (r.kind, r.body.to_vec())).collect();
+            log.rewrite(records.iter().map(|(kind, body)| (*kind, body.as_slice())))?;
+        }
+        Ok(log)
+    }
+
+    /// Path of the log's first generation, which names the rest and the lock
+    pub fn base(&self) -> &Path {
+        &self.base
+    }
+
+    /// True unless another process has written to or replaced the file
+    /// since this handle last did. Call with the lock held.
+    pub fn is_current(&mut self) -> Result<bool> {
+        let mut replaced = [0u8; 8];
+        self.file.seek(SeekFrom::Start(REPLACED_FIELD))?;
+        self.file.read_exact(&mut replaced)?;
+        Ok(u64::from_le_bytes(replaced) == 0 && self.file.metadata()?.len() == self.len)
+    }
+
+    /// Records in file order, stopping at the first one that fails its checksum
+    pub fn records(&self) -> impl Iterator<Item = Record<'_>> + '_ {
+        let map: &[u8] = self.map.as_deref().unwrap_or(&[]);
+        let mut offset = HEADER_LEN;
+        std::iter::from_fn(move || {
+            let record = parse(map, offset)?;
+            offset += RECORD_HEADER_LEN + record.body.len();
+            Some(record)
+        })
+    }
+
+    /// Body of the record at `offset`, if it was in the file when it was opened
+    pub fn body(&self, offset: u64) -> Option<&[u8]> {
+        parse(self.map.as_deref()?, offset as usize).map(|r| r.body)
+    }
+
+    /// Append records (kind, body) in one write, returning their offsets.
+    /// Call with the lock held, after checking `is_current`.
+    ///
+    /// A failed write may leave a torn record, which the next `open` drops.
+    pub fn append(&mut self, records: &[(u8, Vec<u8>)]) -> Result<Vec<u64>> {
+        let start = self.len;
+        let mut offsets = Vec::with_capacity(records.len());
+        let mut batch = Vec::new();
+        for (kind, body) in records {
+            offsets.push(start + batch.len() as u64);
+            encode(&mut batch, *kind, body);
+        }
+
+        self.file.seek(SeekFrom::Start(start))
+            .and_then(|_| self.file.write_all(&batch))
+            .context("Failed to append to operation log")?;
+        self.len += batch.len() as u64;
+        Ok(offsets)
+    }
+
+    /// Drop every record
+    pub fn clear(&mut self) -> Result<()> {
+        self.rewrite(std::iter::empty())
+    }
+
+    /// Write `records` (kind, body) as the next generation and switch to it
+    pub fn rewrite<'a>(&mut self, records: impl Iterator<Item = (u8, &'a [u8])>) -> Result<()> {
+        let next = self.generation + 1;
+        let path = generation_path(&self.base, next);
+        let temp = path.with_extension("tmp");
+        let result = (|| -> Result<()> {
+            let mut file = File::create(&temp)?;
+            write_header(&mut file)?;
+            let mut batch = Vec::new();
+            for (kind, body) in records {
+                encode(&mut batch, kind, body);
+            }
+            file.write_all(&batch)?;
+            file.sync_data()?;
+            // Nobody has the new name open, so this works while the old
+            // generation is mapped
+            fs::rename(&temp, &path)?;
+            Ok(())
+        })();
+        if let Err(e) = result {
+            let _ = fs::remove_file(&temp);
+            return Err(e).context("Failed to rewrite operation log");
+        }
+
+        // Point other handles on the old file at the new one
+        self.file.seek(SeekFrom::Start(REPLACED_FIELD))
+            .and_then(|_| self.file.write_all(&next.to_le_bytes()))
+            .context("Failed to mark operation log as replaced")?;
+        *self = OpLogFile::open(&self.base)?;
+        Ok(())
+    }
+}
+
+/// Existing generations of a log, oldest first
+fn generations(base: &Path) -> Result<Vec<(u64, PathBuf)>> {
+    let (dir, name) = match (base.parent(), base.file_name().and_then(|n| n.to_str())) {
+        (Some(dir), Some(name)) => (dir, name),
+        _ => bail!("Invalid operation log path {}", base.display()),
+    };
+    let mut found = Vec::new();
+    let entries = match fs::read_dir(dir) {
+        Ok(entries) => entries,
+        Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(found),
+        Err(e) => return Err(e).context("Failed to list operation log directory"),
+    };
+    for entry in entries {
+        let entry = entry?;
+        let file_name = entry.file_name();
+        let generation = match file_name.to_str().and_then(|n| n.strip_prefix(name)) {
+            Some("") => Some(0),
+            Some(rest) => rest.strip_prefix('-').and_then(|g| g.parse::<u64>().ok()),
+            None => None,
+        };
+        if let Some(generation) = generation {
+            found.push((generation, entry.path()));
+        }
+    }
+    found.sort();
+    Ok(found)
+}
+
+fn generation_path(base: &Path, generation: u64) -> PathBuf {
+    if generation == 0 {
+        return base.to_path_buf();
+    }
+    let mut name = base.as_os_str().to_owned();
+    name.push(format!("-{}", generation));
+    PathBuf::from(name)
+}
+
+fn write_header(file: &mut File) -> Result<()> {
+    let mut header = [0u8; HEADER_LEN];
+    header[..4].copy_from_slice(FILE_MAGIC);
+    header[4..8].copy_from_slice(&FORMAT_VERSION.to_le_bytes());
+    file.write_all(&header).context("Failed to write operation log header")?;
+    Ok(())
+}
+
+fn encode(out: &mut Vec<u8>, kind: u8, body: &[u8]) {
+    out.extend_from_slice(&(body.len() as u32).to_le_bytes());
+    out.extend_from_slice(&[kind, 0, 0, 0]);
+    out.extend_from_slice(&checksum(kind, body).to_le_bytes());
+    out.extend_from_slice(body);
+}
+
+fn parse(map: &[u8], offset: usize) -> Option<Record<'_>> {
+    let header = map.get(offset..offset.checked_add(RECORD_HEADER_LEN)?)?;
+    let len = read_u32(header, 0) as usize;
+    let start = offset + RECORD_HEADER_LEN;
+    let body = map.get(start..start.checked_add(len)?)?;
+    let kind = header[4];
+    if checksum(kind, body) != read_u64(header, 8) {
+        return None;
+    }
+    Some(Record { offset: offset as u64, kind, body })
+}
+
+fn checksum(kind: u8, body: &[u8]) -> u64 {
+    let mut hasher = Fnv64::new();
+    hasher.write(&[kind]);
+    hasher.write(body);
+    hasher.finish()
+}
+
+pub(crate) fn read_u64(bytes: &[u8], at: usize) -> u64 {
+    u64::from_le_bytes(bytes[at..at + 8].try_into().unwrap())
+}
+
+pub(crate) fn read_u32(bytes: &[u8], at: usize) -> u32 {
+    u32::from_le_bytes(bytes[at..at + 4].try_into().unwrap())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_torn_tail_is_dropped() {
+        let temp_dir = TempDir::new().unwrap();
+        let path = temp_dir.path().join("oplog");
+
+        let mut log = OpLogFile::open(&path).unwrap();
+        log.append(&[(1, b"first".to_vec()), (2, b"second".to_vec())]).unwrap();
+        drop(log);
+
+        // Simulate a crash halfway through a third append
+        let mut file = OpenOptions::new().append(true).open(&path).unwrap();
+        file.write_all(&[9, 0, 0, 0, 3, 0, 0, 0, 1, 2]).unwrap();
+        drop(file);
+
+        let mut log = OpLogFile::open(&path).unwrap();
+        let bodies: Vec<(u8, Vec<u8>)> = log.records().map(|r| (r.kind, r.body.to_vec())).collect();
+        assert_eq!(bodies, [(1, b"first".to_vec()), (2, b"second".to_vec())]);
+
+        let offset = log.append(&[(3, b"third".to_vec())]).unwrap()[0];
+        drop(log);
+        let log = OpLogFile::open(&path).unwrap();
+        assert_eq!(log.records().count(), 3);
+        assert_eq!(log.body(offset), Some(&b"third"[..]));
+    }
+
+    #[test]
+    fn test_other_writers_are_detected() {
+        let temp_dir = TempDir::new().unwrap();
+        let path = temp_dir.path().join("oplog");
+
+        let mut first = OpLogFile::open(&path).unwrap();
+        let mut second = OpLogFile::open(&path).unwrap();
+        first.append(&[(1, b"first".to_vec())]).unwrap();
+        assert!(first.is_current().unwrap());
+        assert!(!second.is_current().unwrap());
+
+        // A rewrite leaves the old file in place (still mapped by `second`)
+        let mut second = OpLogFile::open(&path).unwrap();
+        first.rewrite([(2, &b"rewritten"[..])].into_iter()).unwrap();
+        assert!(!second.is_current().unwrap());
+        assert_eq!(second.records().count(), 1);
+
+        let reopened = OpLogFile::open(&path).unwrap();
+        let bodies: Vec<&[u8]> = reopened.records().map(|r| r.body).collect();
+        assert_eq!(bodies, [&b"rewritten"[..]]);
+    }
+}
@@ -2,6 +2,7 @@
 
 use anyhow::{Context, Result};
 use std::path::{Path, PathBuf};
+use crate::fingerprint::RepoFingerprint;
 
 /// Repository state (special operations in progress)
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
@@ -22,6 +23,8 @@ pub struct RemoteStatus {
     pub behind: usize,
     pub remote_name: String,
     pub remote_branch: String,
+    /// Counts are the last known values while a recount runs in the background
+    pub pending: bool,
 }
 
 /// Represents an open Git repository
@@ -94,6 +97,9 @@ impl Repository {
     }
 
     /// Get remote status (commits ahead/behind)
+    ///
+    /// Counts come from the process-wide ahead/behind cache, so this never
+    /// walks history on the calling thread. See `ahead_behind::lookup`.
     pub fn remote_status(&self) -> Result<Option<RemoteStatus>> {
         let head = self.inner.head()?;
 
@@ -102,6 +108,7 @@ impl Repository {
         }
 
         let local_oid = head.target().context("No local OID")?;
+        let branch_name = head.shorthand().unwrap_or("HEAD").to_string();
 
         let branch = git2::Branch::wrap(head);
         let upstream = match branch.upstream() {
@@ -111,7 +118,13 @@ impl Repository {
 
         let upstream_oid = upstream.get().target().context("No upstream OID")?;
 
-        let (ahead, behind) = self.inner.graph_ahead_behind(local_oid, upstream_oid)?;
+        let counts = crate::ahead_behind::lookup(
+            self.inner.path(),
+            &branch_name,
+            local_oid,
+            upstream_oid,
+            crate::ahead_behind::DEFAULT_BUDGET,
+        );
 
         let upstream_name = upstream.name()?.unwrap_or("origin");
         let parts: Vec<&str> = upstream_name.split('/').collect();
@@ -119,10 +132,11 @@ impl Repository {
         let remote_branch = parts.get(1).unwrap_or(&"main").to_string();
 
         Ok(Some(RemoteStatus {
-            ahead,
-            behind,
+            ahead: counts.ahead,
+            behind: counts.behind,
             remote_name,
             remote_branch,
+            pending: counts.pending,
         }))
     }
 
@@ -350,6 +364,24 @@ impl Repository {
         remote.fetch(&[self.current_branch()?], Some(&mut fetch_options), None)?;
         Ok(())
     }
+
+    /// Get a fingerprint of the repository's current state
+    ///
+    /// Cached data stored alongside an equal fingerprint is still valid.
+    pub fn fingerprint(&self) -> RepoFingerprint {
+        crate::fingerprint::compute(self.inner.path(), self.inner.workdir())
+    }
+}
+
+/// Resolve the common git directory (differs from `git_dir` for linked worktrees)
+pub(crate) fn common_dir(git_dir: &Path) -> PathBuf {
+    std::fs::read_to_string(git_dir.join("commondir"))
+        .ok()
+        .map(|s| {
+            let p = PathBuf::from(s.trim());
+            if p.is_absolute() { p } else { git_dir.join(p) }
+        })
+        .unwrap_or_else(|| git_dir.to_path_buf())
 }
 
 #[cfg(test)]
@@ -0,0 +1,594 @@
+//! Parallel Worktree Scanner
+//!
+//! libgit2 walks the working tree on a single thread, so on fast disks the
+//! status scan is bound by syscall latency. This scanner spreads the walk over
+//! a work-stealing pool (one task per directory) and compares stat data against
+//! the index in parallel. Index-vs-HEAD changes still come from libgit2, which
+//! does not touch the working tree for them.
+//!
+//! Files whose stat data doesn't prove them clean are queued during the walk
+//! and hashed afterwards as one parallel batch (see `blob_hash`).
+//!
+//! Results match the libgit2 status walk. Repositories using features the
+//! scanner does not model (content filters, submodules, sparse checkout,
+//! conflicts, Unicode precomposition) are reported as unsupported so callers
+//! fall back to libgit2. With `core.ignorecase` tracked paths are matched
+//! case-insensitively; with `core.symlinks=false` a plain file holding a
+//! symlink's target compares equal to the indexed link.
+
+use anyhow::{Context, Result};
+use std::borrow::Cow;
+use std::collections::{BTreeMap, HashMap};
+use std::fs::{self, FileType, Metadata};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Mutex;
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use crate::blob_hash::{self, BlobKind};
+use crate::ignore::IgnoreStack;
+use crate::status::FileStatusEntry;
+use crate::Repository;
+
+const MODE_TYPE_MASK: u32 = 0o170000;
+const MODE_SYMLINK: u32 = 0o120000;
+const MODE_GITLINK: u32 = 0o160000;
+
+/// Stage bits of an index entry (non-zero for conflict entries)
+const STAGE_MASK: u16 = 0x3000;
+
+/// Options for a parallel worktree scan
+#[derive(Debug, Clone, Default)]
+pub struct ScanOptions {
+    /// Worker threads (0 = shared pool with one thread per CPU)
+    pub threads: usize,
+    /// Run the workers at background CPU and I/O priority (needs `threads` > 0)
+    pub background: bool,
+}
+
+/// Lower the calling thread to background CPU and I/O priority
+///
+/// Best effort and permanent for the thread. On Linux the I/O scheduler
+/// derives I/O priority from the nice value; on Windows background mode
+/// lowers both. Elsewhere this does nothing.
+pub(crate) fn enter_background_priority() {
+    #[cfg(target_os = "linux")]
+    {
+        extern "C" {
+            fn setpriority(which: i32, who: u32, prio: i32) -> i32;
+        }
+        // PRIO_PROCESS with who = 0 applies to the calling thread on Linux
+        unsafe {
+            setpriority(0, 0, 19);
+        }
+    }
+
+    #[cfg(windows)]
+    {
+        extern "system" {
+            fn GetCurrentThread() -> isize;
+            fn SetThreadPriority(thread: isize, priority: i32) -> i32;
+        }
+        const THREAD_MODE_BACKGROUND_BEGIN: i32 = 0x0001_0000;
+        unsafe {
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        }
+    }
+}
+
+/// Scan the working tree in parallel
+///
+/// # Returns
+/// * `Ok(Some(entries))` - Same entries, in the same order, as the libgit2 walk
+/// * `Ok(None)` - The repository is unsupported; fall back to libgit2
+pub fn scan(repo: &Repository, options: &ScanOptions) -> Result<Option<Vec<FileStatusEntry>>> {
+    let inner = repo.inner();
+    let workdir = match inner.workdir() {
+        Some(dir) => dir.to_path_buf(),
+        None => return Ok(None),
+    };
+
+    let config = inner.config()?;
+    if !supported_config(&config) || has_extra_attributes(inner.path()) {
+        return Ok(None);
+    }
+
+    let mut index = inner.index().context("Failed to read index")?;
+    index.read(false)?;
+    let ignore_case = config.get_bool("core.ignorecase").unwrap_or(false);
+    let tracked = match Tracked::load(&index, ignore_case) {
+        Some(tracked) => tracked,
+        None => return Ok(None),
+    };
+    let ignores = match IgnoreStack::for_repo(inner)? {
+        Some(ignores) => ignores,
+        None => return Ok(None),
+    };
+
+    let ctx = ScanContext {
+        workdir: &workdir,
+        tracked: &tracked,
+        seen: (0..tracked.entries.len()).map(|_| AtomicBool::new(false)).collect(),
+        changes: Mutex::new(Vec::new()),
+        unsupported: AtomicBool::new(false),
+        index_mtime: fs::metadata(inner.path().join("index")).and_then(|m| m.modified()).ok(),
+        filemode: cfg!(unix) && config.get_bool("core.filemode").unwrap_or(true),
+        symlinks: config.get_bool("core.symlinks").unwrap_or(true),
+        to_hash: Mutex::new(Vec::new()),
+    };
+
+    let root = tracked.dirs.get("");
+    let run = || {
+        rayon::scope(|s| walk_dir(&ctx, s, String::new(), root, ignores));
+        ctx.hash_queued();
+    };
+    if options.threads == 0 {
+        run();
+    } else {
+        let mut builder = rayon::ThreadPoolBuilder::new().num_threads(options.threads);
+        if options.background {
+            builder = builder.start_handler(|_| enter_background_priority());
+        }
+        let pool = builder.build()
+            .context("Failed to create scanner thread pool")?;
+        pool.install(run);
+    }
+
+    if ctx.unsupported.load(Ordering::Relaxed) {
+        return Ok(None);
+    }
+
+    // Combine index-vs-HEAD flags with worktree flags per path, sorted like libgit2
+    let mut merged: BTreeMap<String, git2::Status> = BTreeMap::new();
+
+    let mut opts = git2::StatusOptions::new();
+    opts.show(git2::StatusShow::Index)
+        .include_untracked(false)
+        .include_ignored(false);
+
+    for entry in inner.statuses(Some(&mut opts))?.iter() {
+        if let Some(path) = entry.path() {
+            merged.entry(path.to_string()).or_insert_with(git2::Status::empty).insert(entry.status());
+        }
+    }
+
+    for (path, status) in ctx.changes.into_inner().unwrap() {
+        merged.entry(path).or_insert_with(git2::Status::empty).insert(status);
+    }
+
+    for (seen, path) in ctx.seen.iter().zip(&tracked.paths) {
+        if !seen.load(Ordering::Relaxed) {
+            merged.entry(path.clone()).or_insert_with(git2::Status::empty).insert(git2::Status::WT_DELETED);
+        }
+    }
+
+    Ok(Some(merged.into_iter()
+        .map(|(path, status)| FileStatusEntry {
+            path: PathBuf::from(path),
+            status: Repository::convert_status(status),
+        })
+        .collect()))
+}
+
+/// Config options that change how working tree files compare to the index
+fn supported_config(config: &git2::Config) -> bool {
+    let autocrlf = config.get_string("core.autocrlf")
+        .map(|v| v.eq_ignore_ascii_case("false"))
+        .unwrap_or(true);
+
+    autocrlf
+        && !config.get_bool("core.precomposeunicode").unwrap_or(false)
+        && config.get_string("core.eol").is_err()
+        && config.get_string("core.attributesFile").is_err()
+        // Ids are hashed as SHA-1
+        && config.get_string("extensions.objectformat").map_or(true, |v| v.eq_ignore_ascii_case("sha1"))
+}
+
+/// Whether attribute files outside the working tree could enable filters
+fn has_extra_attributes(git_dir: &Path) -> bool {
+    let xdg = std::env::var_os("XDG_CONFIG_HOME")
+        .map(PathBuf::from)
+        .or_else(|| std::env::var_os("HOME").map(|home| PathBuf::from(home).join(".config")));
+
+    crate::repository::common_dir(git_dir).join("info").join("attributes").exists()
+        || xdg.map_or(false, |dir| dir.join("git").join("attributes").exists())
+        || Path::new("/etc/gitattributes").exists()
+}
+
+/// Index entries grouped by directory
+struct Tracked {
+    entries: Vec<git2::IndexEntry>,
+    paths: Vec<String>,
+    /// Directory ("" for the root) -> file name -> entry index, both folded
+    /// to lower case under `core.ignorecase`
+    dirs: HashMap<String, HashMap<String, usize>>,
+    ignore_case: bool,
+}
+
+impl Tracked {
+    /// Group index entries, or None if any entry needs libgit2 semantics
+    fn load(index: &git2::Index, ignore_case: bool) -> Option<Self> {
+        let unsupported_flags = (git2::IndexEntryExtendedFlag::INTENT_TO_ADD
+            | git2::IndexEntryExtendedFlag::SKIP_WORKTREE).bits();
+
+        let mut tracked = Tracked {
+            entries: Vec::with_capacity(index.len()),
+            paths: Vec::with_capacity(index.len()),
+            dirs: HashMap::new(),
+            ignore_case,
+        };
+        tracked.dirs.insert(String::new(), HashMap::new());
+
+        for entry in index.iter() {
+            if entry.flags & STAGE_MASK != 0
+                || entry.flags_extended & unsupported_flags != 0
+                || entry.mode & MODE_TYPE_MASK == MODE_GITLINK
+            {
+                return None;
+            }
+
+            let path = String::from_utf8(entry.path.clone()).ok()?;
+            let key = tracked.key(&path).into_owned();
+            let (dir, name) = split_path(&key);
+            if name == ".gitattributes" {
+                return None;
+            }
+
+            // Paths differing only in case can't both be checked out
+            let idx = tracked.entries.len();
+            if tracked.dirs.entry(dir.to_string()).or_default().insert(name.to_string(), idx).is_some() {
+                return None;
+            }
+
+            // Register ancestors so the walk knows which directories are tracked
+            let mut child = dir;
+            while !child.is_empty() {
+                let (parent, _) = split_path(child);
+                if tracked.dirs.contains_key(parent) {
+                    break;
+                }
+                tracked.dirs.insert(parent.to_string(), HashMap::new());
+                child = parent;
+            }
+
+            tracked.paths.push(path);
+            tracked.entries.push(entry);
+        }
+
+        Some(tracked)
+    }
+
+    /// Lookup key for a working tree path or name
+    fn key<'a>(&self, path: &'a str) -> Cow<'a, str> {
+        if self.ignore_case {
+            Cow::Owned(path.to_ascii_lowercase())
+        } else {
+            Cow::Borrowed(path)
+        }
+    }
+}
+
+fn split_path(path: &str) -> (&str, &str) {
+    match path.rfind('/') {
+        Some(i) => (&path[..i], &path[i + 1..]),
+        None => ("", path),
+    }
+}
+
+/// State shared by all directory tasks of one scan
+struct ScanContext<'a> {
+    workdir: &'a Path,
+    tracked: &'a Tracked,
+    /// Index entries found in the working tree (the rest are deleted)
+    seen: Vec<AtomicBool>,
+    changes: Mutex<Vec<(String, git2::Status)>>,
+    unsupported: AtomicBool,
+    index_mtime: Option<SystemTime>,
+    filemode: bool,
+    /// core.symlinks; without it links are checked out as plain files
+    symlinks: bool,
+    /// Tracked files stat data couldn't prove clean: (index entry, path, kind)
+    to_hash: Mutex<Vec<(usize, String, BlobKind)>>,
+}
+
+/// Outcome of comparing a file's stat data against its index entry
+enum Compare {
+    Clean,
+    Changed(git2::Status),
+    /// Contents must be hashed to decide
+    Hash(BlobKind),
+}
+
+impl ScanContext<'_> {
+    fn fail(&self) {
+        self.unsupported.store(true, Ordering::Relaxed);
+    }
+
+    /// Compare a tracked working tree file against its index entry
+    fn compare(&self, idx: usize, path: &Path, file_type: FileType) -> Result<Compare> {
+        let entry = &self.tracked.entries[idx];
+        let index_link = entry.mode & MODE_TYPE_MASK == MODE_SYMLINK;
+
+        if !file_type.is_file() && !file_type.is_symlink() {
+            anyhow::bail!("Tracked path is no longer a file: {}", path.display());
+        }
+        // A plain file holding the link target stands in for the link
+        let link_as_file = index_link && !self.symlinks && file_type.is_file();
+        if file_type.is_symlink() != index_link && !link_as_file {
+            return Ok(Compare::Changed(git2::Status::WT_TYPECHANGE));
+        }
+
+        let meta = fs::symlink_metadata(path)?;
+
+        if !index_link && self.filemode && is_executable(&meta) != (entry.mode & 0o111 != 0) {
+            return Ok(Compare::Changed(git2::Status::WT_MODIFIED));
+        }
+
+        // Without filters a size change is always a content change
+        if entry.file_size != 0 && meta.len() as u32 != entry.file_size {
+            return Ok(Compare::Changed(git2::Status::WT_MODIFIED));
+        }
+
+        if self.stat_matches(entry, &meta) {
+            return Ok(Compare::Clean);
+        }
+
+        Ok(Compare::Hash(if index_link && !link_as_file { BlobKind::Symlink } else { BlobKind::File }))
+    }
+
+    /// Hash every queued file in one parallel batch and record modifications
+    fn hash_queued(&self) {
+        if self.unsupported.load(Ordering::Relaxed) {
+            return;
+        }
+
+        let queued = std::mem::take(&mut *self.to_hash.lock().unwrap());
+        if queued.is_empty() {
+            return;
+        }
+
+        let items: Vec<_> = queued.iter()
+            .map(|(_, rel, kind)| (self.workdir.join(rel), *kind))
+            .collect();
+        let hashes = blob_hash::hash_batch(&items);
+
+        let mut changes = self.changes.lock().unwrap();
+        for ((idx, rel, _), hash) in queued.into_iter().zip(hashes) {
+            match hash {
+                Ok(id) if id.as_bytes() == self.tracked.entries[idx].id.as_bytes() => {}
+                Ok(_) => changes.push((rel, git2::Status::WT_MODIFIED)),
+                Err(_) => return self.fail(),
+            }
+        }
+    }
+
+    /// Whether stat data proves the file unchanged since it was indexed
+    fn stat_matches(&self, entry: &git2::IndexEntry, meta: &Metadata) -> bool {
+        let modified = match meta.modified() {
+            Ok(time) => time,
+            Err(_) => return false,
+        };
+
+        // Racily clean: written in the same tick the index was, contents unknown
+        if self.index_mtime.map_or(true, |index| modified >= index) {
+            return false;
+        }
+
+        let mtime = match modified.duration_since(UNIX_EPOCH) {
+            Ok(d) => d,
+            Err(_) => return false,
+        };
+
+        mtime.as_secs() == entry.mtime.seconds() as u64
+            && mtime.subsec_nanos() == entry.mtime.nanoseconds()
+            && same_inode(entry, meta)
+    }
+}
+
+#[cfg(unix)]
+fn is_executable(meta: &Metadata) -> bool {
+    use std::os::unix::fs::PermissionsExt;
+    meta.permissions().mode() & 0o111 != 0
+}
+
+#[cfg(not(unix))]
+fn is_executable(_meta: &Metadata) -> bool {
+    false
+}
+
+#[cfg(unix)]
+fn same_inode(entry: &git2::IndexEntry, meta: &Metadata) -> bool {
+    use std::os::unix::fs::MetadataExt;
+    meta.ino() as u32 == entry.ino
+}
+
+#[cfg(not(unix))]
+fn same_inode(_entry: &git2::IndexEntry, _meta: &Metadata) -> bool {
+    true
+}
+
+/// Walk one directory, spawning a task per subdirectory
+fn walk_dir<'s>(
+    ctx: &'s ScanContext<'_>,
+    scope: &rayon::Scope<'s>,
+    dir: String,
+    tracked: Option<&'s HashMap<String, usize>>,
+    ignores: IgnoreStack,
+) {
+    if ctx.unsupported.load(Ordering::Relaxed) {
+        return;
+    }
+
+    let abs = ctx.workdir.join(&dir);
+    let read = match fs::read_dir(&abs) {
+        Ok(read) => read,
+        // Missing tracked directories show up as deleted entries
+        Err(e) if e.kind() == std::io::ErrorKind::NotFound => return,
+        Err(_) => return ctx.fail(),
+    };
+
+    let mut changes = Vec::new();
+    let mut to_hash = Vec::new();
+
+    for entry in read {
+        let (entry, file_type) = match entry.and_then(|e| e.file_type().map(|t| (e, t))) {
+            Ok(pair) => pair,
+            Err(_) => return ctx.fail(),
+        };
+        let name = match entry.file_name().into_string() {
+            Ok(name) => name,
+            Err(_) => return ctx.fail(),
+        };
+
+        let key = ctx.tracked.key(&name);
+        if key == ".git" {
+            continue;
+        }
+        if key == ".gitattributes" {
+            return ctx.fail();
+        }
+
+        if let Some(&idx) = tracked.and_then(|files| files.get(key.as_ref())) {
+            // Report tracked files under their indexed spelling, like libgit2
+            let rel = ctx.tracked.paths[idx].clone();
+            ctx.seen[idx].store(true, Ordering::Relaxed);
+            match ctx.compare(idx, &entry.path(), file_type) {
+                Ok(Compare::Changed(status)) => changes.push((rel, status)),
+                Ok(Compare::Hash(kind)) => to_hash.push((idx, rel, kind)),
+                Ok(Compare::Clean) => {}
+                Err(_) => return ctx.fail(),
+            }
+            continue;
+        }
+
+        let rel = if dir.is_empty() { name.clone() } else { format!("{}/{}", dir, name) };
+        let subdir = ctx.tracked.dirs.get(ctx.tracked.key(&rel).as_ref());
+
+        if file_type.is_dir() {
+            // Tracked directories are walked even when ignored, for their tracked files
+            let child = ignores.enter(ctx.workdir, &rel);
+            match subdir {
+                Some(files) => scope.spawn(move |s| walk_dir(ctx, s, rel, Some(files), child)),
+                None if child.is_excluded() => {}
+                // Nested repositories are reported as a single untracked directory
+                None if entry.path().join(".git").exists() => {
+                    changes.push((format!("{}/", rel), git2::Status::WT_NEW));
+                }
+                None => scope.spawn(move |s| walk_dir(ctx, s, rel, None, child)),
+            }
+        } else if file_type.is_file() || file_type.is_symlink() {
+            if subdir.is_some() {
+                return ctx.fail();
+            }
+            if !ignores.is_ignored(&rel, false) {
+                changes.push((rel, git2::Status::WT_NEW));
+            }
+        }
+    }
+
+    if !changes.is_empty() {
+        ctx.changes.lock().unwrap().extend(changes);
+    }
+    if !to_hash.is_empty() {
+        ctx.to_hash.lock().unwrap().extend(to_hash);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    fn commit_all(repo: &git2::Repository) {
+        let mut index = repo.index().unwrap();
+        index.add_all(["*"], git2::IndexAddOption::DEFAULT, None).unwrap();
+        index.write().unwrap();
+
+        let tree = repo.find_tree(index.write_tree().unwrap()).unwrap();
+        let sig = git2::Signature::now("Test", "test@example.com").unwrap();
+        repo.commit(Some("HEAD"), &sig, &sig, "Initial commit", &tree, &[]).unwrap();
+    }
+
+    #[test]
+    fn test_scan_matches_libgit2() {
+        let temp_dir = TempDir::new().unwrap();
+        let root = temp_dir.path();
+        let git_repo = git2::Repository::init(root).unwrap();
+
+        for dir in ["src", "src/nested", "docs", "build"] {
+            fs::create_dir_all(root.join(dir)).unwrap();
+        }
+        for file in ["README.md", "src/a.rs", "src/b.rs", "src/nested/c.rs", "docs/guide.md"] {
+            fs::write(root.join(file), file).unwrap();
+        }
+        fs::write(root.join(".gitignore"), "build/\n*.log\n").unwrap();
+        commit_all(&git_repo);
+
+        fs::write(root.join("src/a.rs"), "changed contents").unwrap();
+        fs::write(root.join("src/b.rs"), "src/b.xx").unwrap(); // Same size
+        fs::remove_file(root.join("src/nested/c.rs")).unwrap();
+        fs::remove_dir_all(root.join("docs")).unwrap();
+        fs::write(root.join("new.txt"), "new").unwrap();
+        fs::write(root.join("debug.log"), "ignored").unwrap();
+        fs::write(root.join("build/out.bin"), "ignored").unwrap();
+        fs::create_dir_all(root.join("untracked/deep")).unwrap();
+        fs::write(root.join("untracked/deep/file.txt"), "new").unwrap();
+
+        let mut index = git_repo.index().unwrap();
+        fs::write(root.join("staged.txt"), "staged").unwrap();
+        index.add_path(Path::new("staged.txt")).unwrap();
+        index.write().unwrap();
+
+        let repo = Repository::open(root).unwrap();
+        let expected = repo.status_libgit2().unwrap();
+
+        for threads in [1, 4] {
+            let scanned = scan(&repo, &ScanOptions { threads, ..Default::default() }).unwrap().unwrap();
+            let as_pairs = |entries: &[FileStatusEntry]| entries.iter()
+                .map(|e| (e.path.clone(), e.status))
+                .collect::<Vec<_>>();
+            assert_eq!(as_pairs(&scanned), as_pairs(&expected));
+        }
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_ignorecase_and_link_files_match_libgit2() {
+        let temp_dir = TempDir::new().unwrap();
+        let root = temp_dir.path();
+        let git_repo = git2::Repository::init(root).unwrap();
+
+        fs::create_dir_all(root.join("Src")).unwrap();
+        fs::write(root.join("Src/Main.rs"), "main").unwrap();
+        fs::write(root.join("README.md"), "readme").unwrap();
+        std::os::unix::fs::symlink("README.md", root.join("link")).unwrap();
+        commit_all(&git_repo);
+
+        // Windows and macOS defaults: links become files holding the target
+        let mut config = git_repo.config().unwrap();
+        config.set_bool("core.ignorecase", true).unwrap();
+        config.set_bool("core.symlinks", false).unwrap();
+        fs::remove_file(root.join("link")).unwrap();
+        fs::write(root.join("link"), "README.md").unwrap();
+        fs::write(root.join("Src/Main.rs"), "changed").unwrap();
+
+        let repo = Repository::open(root).unwrap();
+        let expected = repo.status_libgit2().unwrap();
+        let scanned = scan(&repo, &ScanOptions::default()).unwrap().unwrap();
+        let as_pairs = |entries: &[FileStatusEntry]| entries.iter()
+            .map(|e| (e.path.clone(), e.status))
+            .collect::<Vec<_>>();
+        assert_eq!(as_pairs(&scanned), as_pairs(&expected));
+        assert!(!scanned.iter().any(|e| e.path == Path::new("link")));
+    }
+
+    #[test]
+    fn test_gitattributes_falls_back() {
+        let temp_dir = TempDir::new().unwrap();
+        git2::Repository::init(temp_dir.path()).unwrap();
+        fs::write(temp_dir.path().join(".gitattributes"), "* text=auto\n").unwrap();
+
+        let repo = Repository::open(temp_dir.path()).unwrap();
+        assert!(scan(&repo, &ScanOptions::default()).unwrap().is_none());
+    }
+}
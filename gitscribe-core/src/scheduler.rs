@@ -0,0 +1,401 @@
+//! Operation Scheduler
+//!
+//! Executes operations queued in the status cache's `operation_queue` on a
+//! bounded pool of worker threads, so slow network operations never block the
+//! UI that queued them. Operations on one repository run one at a time (a
+//! repository with a Running row is skipped when claiming), higher priorities
+//! run first, failures are retried with exponential backoff, and rows left
+//! Running by a crashed process are requeued once their lease runs out.
+//! A heartbeat thread keeps renewing the leases of this scheduler's own
+//! operations, so schedulers in other processes never run them a second time.
+//!
+//! Run one scheduler per cache database.
+
+use anyhow::{Context, Result};
+use std::collections::HashMap;
+use std::panic::{self, AssertUnwindSafe};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+
+use crate::cache::{OperationPriority, OperationStatus, QueuedOperation, StatusCache};
+use crate::Repository;
+
+/// Executes one kind of operation: `(repo_path, operation_data)`
+pub type OperationHandler = Arc<dyn Fn(&str, &str) -> Result<()> + Send + Sync>;
+
+/// Scheduler limits
+#[derive(Debug, Clone)]
+pub struct SchedulerConfig {
+    /// Worker threads (operations running at once across all repositories)
+    pub workers: usize,
+    /// Attempts before an operation is marked Failed
+    pub max_attempts: u32,
+    /// Delay before the first retry, doubled for each further attempt
+    pub base_backoff: Duration,
+    pub max_backoff: Duration,
+    /// How often idle workers re-check the queue for other writers and retries
+    pub poll_interval: Duration,
+    /// How long a claimed operation stays ours without a heartbeat
+    pub lease: Duration,
+}
+
+impl Default for SchedulerConfig {
+    fn default() -> Self {
+        Self {
+            workers: 4,
+            max_attempts: 3,
+            base_backoff: Duration::from_secs(2),
+            max_backoff: Duration::from_secs(60),
+            poll_interval: Duration::from_millis(250),
+            lease: Duration::from_secs(30),
+        }
+    }
+}
+
+impl SchedulerConfig {
+    /// Delay before retrying an operation that failed on attempt `attempts`
+    fn backoff(&self, attempts: u32) -> Duration {
+        let factor = 1u32.checked_shl(attempts.saturating_sub(1)).unwrap_or(u32::MAX);
+        self.base_backoff.saturating_mul(factor).min(self.max_backoff)
+    }
+}
+
+/// Handlers for the built-in `fetch`, `push` and `pull` operations
+///
+/// Operation data is JSON: `{"remote": "origin", "refspec": "..."}`, both
+/// optional (`refspec` only applies to push).
+pub fn default_handlers() -> HashMap<String, OperationHandler> {
+    fn remote(data: &serde_json::Value) -> &str {
+        data.get("remote").and_then(|r| r.as_str()).unwrap_or("origin")
+    }
+    fn parse(data: &str) -> Result<serde_json::Value> {
+        if data.trim().is_empty() {
+            return Ok(serde_json::Value::Null);
+        }
+        serde_json::from_str(data).context("Invalid operation data")
+    }
+
+    let mut handlers: HashMap<String, OperationHandler> = HashMap::new();
+    handlers.insert("fetch".to_string(), Arc::new(|repo_path: &str, data: &str| {
+        let data = parse(data)?;
+        Repository::open(repo_path)?.fetch(remote(&data))
+    }));
+    handlers.insert("push".to_string(), Arc::new(|repo_path: &str, data: &str| {
+        let data = parse(data)?;
+        let refspec = data.get("refspec").and_then(|r| r.as_str());
+        Repository::open(repo_path)?.push(remote(&data), refspec)
+    }));
+    handlers.insert("pull".to_string(), Arc::new(|repo_path: &str, data: &str| {
+        let data = parse(data)?;
+        Repository::open(repo_path)?.pull(remote(&data))
+    }));
+    handlers
+}
+
+struct Shared {
+    db_path: PathBuf,
+    /// Lease owner recorded on claimed rows, unique to this scheduler
+    owner: String,
+    config: SchedulerConfig,
+    handlers: HashMap<String, OperationHandler>,
+    stop: AtomicBool,
+    /// Bumped on every enqueue so idle workers wake immediately
+    wake: (Mutex<u64>, Condvar),
+}
+
+/// Worker pool draining the operation queue
+///
+/// Workers stop (after finishing their current operation) when dropped.
+pub struct Scheduler {
+    shared: Arc<Shared>,
+    /// Connection used for enqueueing from the owning thread
+    cache: Mutex<StatusCache>,
+    workers: Vec<JoinHandle<()>>,
+}
+
+impl Scheduler {
+    /// Start a scheduler with the built-in handlers
+    pub fn start<P: AsRef<Path>>(db_path: P, config: SchedulerConfig) -> Result<Self> {
+        Self::start_with_handlers(db_path, config, default_handlers())
+    }
+
+    /// Start a scheduler with a custom set of handlers keyed by operation type
+    pub fn start_with_handlers<P: AsRef<Path>>(
+        db_path: P,
+        config: SchedulerConfig,
+        handlers: HashMap<String, OperationHandler>,
+    ) -> Result<Self> {
+        let db_path = db_path.as_ref().to_path_buf();
+        let cache = StatusCache::new(&db_path)?;
+
+        let recovered = cache.recover_running_operations()?;
+        if recovered > 0 {
+            tracing::debug!("requeued {} operations left running in {:?}", recovered, db_path);
+        }
+
+        let started = SystemTime::now().duration_since(UNIX_EPOCH).unwrap_or_default();
+        let shared = Arc::new(Shared {
+            db_path,
+            owner: format!("{}-{}", std::process::id(), started.as_nanos()),
+            config: config.clone(),
+            handlers,
+            stop: AtomicBool::new(false),
+            wake: (Mutex::new(0), Condvar::new()),
+        });
+
+        let mut workers = Vec::new();
+        for i in 0..config.workers.max(1) {
+            // Each worker owns a connection; SQLite connections aren't shareable
+            let worker_cache = StatusCache::new(&shared.db_path)?;
+            let worker_shared = shared.clone();
+            let handle = thread::Builder::new()
+                .name(format!("gitscribe-scheduler-{}", i))
+                .spawn(move || worker_loop(&worker_shared, &worker_cache))
+                .context("Failed to start scheduler worker")?;
+            workers.push(handle);
+        }
+
+        let heartbeat_cache = StatusCache::new(&shared.db_path)?;
+        let heartbeat_shared = shared.clone();
+        let handle = thread::Builder::new()
+            .name("gitscribe-scheduler-heartbeat".to_string())
+            .spawn(move || heartbeat_loop(&heartbeat_shared, &heartbeat_cache))
+            .context("Failed to start scheduler heartbeat")?;
+        workers.push(handle);
+
+        Ok(Scheduler {
+            shared,
+            cache: Mutex::new(cache),
+            workers,
+        })
+    }
+
+    /// Queue an operation and wake an idle worker
+    pub fn enqueue(
+        &self,
+        repo_path: &str,
+        operation_type: &str,
+        operation_data: &str,
+        priority: OperationPriority,
+    ) -> Result<i64> {
+        let id = self.cache.lock().unwrap()
+            .queue_operation_with_priority(repo_path, operation_type, operation_data, priority)?;
+        self.notify();
+        Ok(id)
+    }
+
+    /// Status, attempts and last error of an operation
+    pub fn operation_status(&self, operation_id: i64) -> Result<Option<(OperationStatus, u32, Option<String>)>> {
+        self.cache.lock().unwrap().get_operation_status(operation_id)
+    }
+
+    /// Wake idle workers (e.g. after another component queued work)
+    pub fn notify(&self) {
+        self.shared.notify();
+    }
+}
+
+impl Shared {
+    fn notify(&self) {
+        let (generation, ready) = &self.wake;
+        *generation.lock().unwrap() += 1;
+        ready.notify_all();
+    }
+}
+
+impl Drop for Scheduler {
+    fn drop(&mut self) {
+        self.shared.stop.store(true, Ordering::SeqCst);
+        self.notify();
+        for worker in self.workers.drain(..) {
+            let _ = worker.join();
+        }
+    }
+}
+
+fn worker_loop(shared: &Shared, cache: &StatusCache) {
+    while !shared.stop.load(Ordering::SeqCst) {
+        let generation = *shared.wake.0.lock().unwrap();
+
+        match cache.claim_next_operation(&shared.owner, shared.config.lease) {
+            Ok(Some(operation)) => {
+                if let Err(e) = execute(shared, cache, &operation) {
+                    tracing::debug!("failed to record result of operation {}: {}", operation.id, e);
+                }
+                continue;
+            }
+            Ok(None) => {}
+            Err(e) => tracing::debug!("failed to claim operation: {}", e),
+        }
+
+        // Sleep until an enqueue or the poll interval (for retries coming due)
+        let (lock, ready) = &shared.wake;
+        let current = lock.lock().unwrap();
+        if *current == generation && !shared.stop.load(Ordering::SeqCst) {
+            let _ = ready.wait_timeout(current, shared.config.poll_interval);
+        }
+    }
+}
+
+/// Renew our leases and requeue operations whose owner stopped renewing
+fn heartbeat_loop(shared: &Shared, cache: &StatusCache) {
+    let interval = shared.config.lease / 3;
+    while !shared.stop.load(Ordering::SeqCst) {
+        if let Err(e) = cache.renew_leases(&shared.owner, shared.config.lease) {
+            tracing::debug!("failed to renew operation leases: {}", e);
+        }
+        match cache.recover_running_operations() {
+            Ok(0) => {}
+            Ok(recovered) => {
+                tracing::debug!("requeued {} operations with expired leases", recovered);
+                shared.notify();
+            }
+            Err(e) => tracing::debug!("failed to recover operations: {}", e),
+        }
+
+        let (lock, ready) = &shared.wake;
+        let current = lock.lock().unwrap();
+        if !shared.stop.load(Ordering::SeqCst) {
+            let _ = ready.wait_timeout(current, interval);
+        }
+    }
+}
+
+/// Run a claimed operation and record the outcome
+fn execute(shared: &Shared, cache: &StatusCache, operation: &QueuedOperation) -> Result<()> {
+    let handler = match shared.handlers.get(&operation.operation_type) {
+        Some(handler) => handler,
+        None => {
+            let message = format!("Unknown operation type: {}", operation.operation_type);
+            return cache.update_operation_status(operation.id, OperationStatus::Failed, Some(&message));
+        }
+    };
+
+    let result = panic::catch_unwind(AssertUnwindSafe(|| {
+        handler(&operation.repo_path, &operation.operation_data)
+    }))
+    .unwrap_or_else(|_| Err(anyhow::anyhow!("Operation handler panicked")));
+
+    match result {
+        Ok(()) => cache.update_operation_status(operation.id, OperationStatus::Complete, None),
+        Err(e) if operation.attempts >= shared.config.max_attempts => {
+            cache.update_operation_status(operation.id, OperationStatus::Failed, Some(&format!("{:#}", e)))
+        }
+        Err(e) => {
+            let delay = shared.config.backoff(operation.attempts);
+            cache.retry_operation(operation.id, &format!("{:#}", e), delay)
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Instant;
+    use tempfile::TempDir;
+
+    fn wait_for(scheduler: &Scheduler, id: i64, status: OperationStatus) -> (u32, Option<String>) {
+        let deadline = Instant::now() + Duration::from_secs(20);
+        loop {
+            let (current, attempts, error) = scheduler.operation_status(id).unwrap().unwrap();
+            if current == status {
+                return (attempts, error);
+            }
+            assert!(Instant::now() < deadline, "operation {} stuck in {:?}", id, current);
+            thread::sleep(Duration::from_millis(10));
+        }
+    }
+
+    #[test]
+    fn test_push_and_fetch_with_bare_remote() {
+        let temp_dir = TempDir::new().unwrap();
+        let bare_path = temp_dir.path().join("remote.git");
+        let work_path = temp_dir.path().join("work");
+        let bare = git2::Repository::init_bare(&bare_path).unwrap();
+
+        let work = git2::Repository::init(&work_path).unwrap();
+        std::fs::write(work_path.join("a.txt"), "a").unwrap();
+        let mut index = work.index().unwrap();
+        index.add_path(Path::new("a.txt")).unwrap();
+        index.write().unwrap();
+        let tree = work.find_tree(index.write_tree().unwrap()).unwrap();
+        let sig = git2::Signature::now("Test", "test@example.com").unwrap();
+        let head = work.commit(Some("HEAD"), &sig, &sig, "Initial", &tree, &[]).unwrap();
+        work.remote("origin", bare_path.to_str().unwrap()).unwrap();
+        let branch = work.head().unwrap().shorthand().unwrap().to_string();
+
+        let scheduler = Scheduler::start(temp_dir.path().join("cache.db"), SchedulerConfig::default()).unwrap();
+        let repo_path = work_path.to_str().unwrap();
+
+        let push = scheduler.enqueue(repo_path, "push", r#"{"remote": "origin"}"#, OperationPriority::High).unwrap();
+        let fetch = scheduler.enqueue(repo_path, "fetch", "", OperationPriority::Low).unwrap();
+        let missing = scheduler.enqueue(repo_path, "fetch", r#"{"remote": "nope"}"#, OperationPriority::Normal).unwrap();
+
+        wait_for(&scheduler, push, OperationStatus::Complete);
+        wait_for(&scheduler, fetch, OperationStatus::Complete);
+        assert_eq!(bare.refname_to_id(&format!("refs/heads/{}", branch)).unwrap(), head);
+
+        // Unknown remote: fails every attempt, then gives up (backoff kept short by the test)
+        drop(scheduler);
+        let config = SchedulerConfig { base_backoff: Duration::from_millis(10), ..Default::default() };
+        let scheduler = Scheduler::start(temp_dir.path().join("cache.db"), config).unwrap();
+        let (attempts, error) = wait_for(&scheduler, missing, OperationStatus::Failed);
+        assert_eq!(attempts, 3);
+        assert!(error.is_some());
+    }
+
+    #[test]
+    fn test_priority_serialization_retry_and_recovery() {
+        let temp_dir = TempDir::new().unwrap();
+        let db_path = temp_dir.path().join("cache.db");
+        let log: Arc<Mutex<Vec<String>>> = Arc::new(Mutex::new(Vec::new()));
+        let running: Arc<Mutex<Vec<String>>> = Arc::new(Mutex::new(Vec::new()));
+
+        // Queue before any scheduler runs, with one row left Running by a "crash"
+        let cache = StatusCache::new(&db_path).unwrap();
+        let crashed = cache.queue_operation("/repo/a", "record", "crashed").unwrap();
+        cache.update_operation_status(crashed, OperationStatus::Running, None).unwrap();
+        let low = cache.queue_operation_with_priority("/repo/a", "record", "low", OperationPriority::Low).unwrap();
+        let high = cache.queue_operation_with_priority("/repo/a", "record", "high", OperationPriority::High).unwrap();
+        let flaky = cache.queue_operation("/repo/b", "flaky", "flaky").unwrap();
+
+        let mut handlers: HashMap<String, OperationHandler> = HashMap::new();
+        let (record_log, record_running) = (log.clone(), running.clone());
+        handlers.insert("record".to_string(), Arc::new(move |repo: &str, data: &str| {
+            {
+                let mut running = record_running.lock().unwrap();
+                assert!(!running.contains(&repo.to_string()), "two operations ran on {}", repo);
+                running.push(repo.to_string());
+            }
+            thread::sleep(Duration::from_millis(20));
+            record_log.lock().unwrap().push(data.to_string());
+            record_running.lock().unwrap().retain(|r| r != repo);
+            Ok(())
+        }));
+        let failures = Arc::new(Mutex::new(0));
+        let flaky_failures = failures.clone();
+        handlers.insert("flaky".to_string(), Arc::new(move |_: &str, _: &str| {
+            let mut failures = flaky_failures.lock().unwrap();
+            *failures += 1;
+            anyhow::ensure!(*failures > 2, "transient failure {}", failures);
+            Ok(())
+        }));
+
+        let config = SchedulerConfig { workers: 3, base_backoff: Duration::from_millis(10), ..Default::default() };
+        let scheduler = Scheduler::start_with_handlers(&db_path, config, handlers).unwrap();
+
+        for id in [crashed, low, high] {
+            wait_for(&scheduler, id, OperationStatus::Complete);
+        }
+        let (attempts, _) = wait_for(&scheduler, flaky, OperationStatus::Complete);
+        assert_eq!(attempts, 3);
+
+        // The recovered row and the high priority one both outrank the low one
+        let log = log.lock().unwrap();
+        assert_eq!(log.last().unwrap(), "low");
+        assert_eq!(log.len(), 3);
+    }
+}
@@ -0,0 +1,389 @@
+//! Commit Search Index
+//!
+//! A linear commit search decodes every commit message on each keystroke,
+//! which takes seconds on large histories. This index keeps commit text in
+//! SQLite FTS5 tables under `.git/gitscribe/search.db`: a trigram table
+//! answers substring queries, a word table answers one- and two-character
+//! prefixes, and the oid column answers hash prefixes.
+//!
+//! The index holds exactly the commits reachable from one tip. When HEAD
+//! moves, only the commits between the old tip and the merge base are
+//! removed and those from the merge base to HEAD added, so a commit, branch
+//! switch or rebase costs what changed. Updates run on a background thread;
+//! until the index has caught up with HEAD, callers use a linear search.
+
+use anyhow::{Context, Result};
+use git2::Oid;
+use rusqlite::{params, Connection, Transaction};
+use std::collections::HashSet;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::sync::{Mutex, OnceLock};
+use std::thread;
+use std::time::Duration;
+
+/// Bump when the schema or tokenization changes; older indexes are rebuilt
+const INDEX_VERSION: i64 = 2;
+
+/// Persistent full-text index of the commits reachable from a tip
+///
+/// Rows are numbered in indexing order, ancestors first, so results come
+/// back newest first without sorting the matches.
+pub struct SearchIndex {
+    conn: Connection,
+}
+
+impl SearchIndex {
+    /// Open or create the index for a repository
+    pub fn open(repo: &git2::Repository) -> Result<Self> {
+        let dir = crate::repository::common_dir(repo.path()).join("gitscribe");
+        fs::create_dir_all(&dir).context("Failed to create index directory")?;
+        Self::open_path(&dir.join("search.db"))
+    }
+
+    fn open_path(path: &Path) -> Result<Self> {
+        let conn = Connection::open(path)
+            .context("Failed to open search index")?;
+
+        conn.pragma_update(None, "journal_mode", "WAL")?;
+        conn.pragma_update(None, "synchronous", "NORMAL")?;
+        conn.busy_timeout(Duration::from_secs(5))?;
+
+        Self::create_schema(&conn)?;
+        Ok(Self { conn })
+    }
+
+    fn create_schema(conn: &Connection) -> Result<()> {
+        let version: i64 = conn.query_row("PRAGMA user_version", [], |row| row.get(0))?;
+        if version == INDEX_VERSION {
+            return Ok(());
+        }
+
+        conn.execute_batch(
+            "DROP TABLE IF EXISTS commits;
+             DROP TABLE IF EXISTS tips;
+             DROP TABLE IF EXISTS commit_trigrams;
+             DROP TABLE IF EXISTS commit_words;
+
+             CREATE TABLE commits (
+                 id INTEGER PRIMARY KEY,
+                 oid TEXT NOT NULL UNIQUE
+             );
+
+             -- The commit whose ancestry is indexed (at most one row)
+             CREATE TABLE tips (oid TEXT PRIMARY KEY);
+
+             -- Contentless: the text stays in the object database
+             CREATE VIRTUAL TABLE commit_trigrams USING fts5(
+                 message, author, content='', tokenize='trigram'
+             );
+             CREATE VIRTUAL TABLE commit_words USING fts5(
+                 message, author, content='', tokenize='unicode61', prefix='1 2', detail=none
+             );"
+        )?;
+        conn.pragma_update(None, "user_version", INDEX_VERSION)?;
+        Ok(())
+    }
+
+    fn tip(&self) -> Result<Option<Oid>> {
+        let tip = self.conn.prepare_cached("SELECT oid FROM tips")?
+            .query_map([], |row| row.get::<_, String>(0))?
+            .filter_map(|oid| oid.ok().and_then(|oid| Oid::from_str(&oid).ok()))
+            .next();
+        Ok(tip)
+    }
+
+    /// True if the index holds exactly the commits reachable from HEAD
+    pub fn is_current(&self, repo: &git2::Repository) -> Result<bool> {
+        let head = match repo.head().and_then(|head| head.peel_to_commit()) {
+            Ok(commit) => commit.id(),
+            Err(_) => return Ok(false),
+        };
+        Ok(self.tip()? == Some(head))
+    }
+
+    /// Move the index to the commits reachable from HEAD
+    ///
+    /// Returns the number of commits added.
+    pub fn update(&self, repo: &git2::Repository) -> Result<usize> {
+        let head = match repo.head().and_then(|head| head.peel_to_commit()) {
+            Ok(commit) => commit.id(),
+            Err(_) => return Ok(0), // Unborn branch
+        };
+
+        let tip = self.tip()?;
+        if tip == Some(head) {
+            return Ok(0);
+        }
+
+        let tx = self.conn.unchecked_transaction()
+            .context("Failed to begin index update")?;
+
+        // Keep what HEAD shares with the old tip; without a merge base (or
+        // with its commits gone from the object database) start over
+        let base = tip.and_then(|tip| repo.merge_base(head, tip).ok());
+        let removed = match (tip, base) {
+            (Some(tip), Some(base)) => Self::remove_range(&tx, repo, tip, base).is_ok(),
+            _ => false,
+        };
+        if !removed {
+            tx.execute_batch(
+                "DELETE FROM commits;
+                 INSERT INTO commit_trigrams (commit_trigrams) VALUES ('delete-all');
+                 INSERT INTO commit_words (commit_words) VALUES ('delete-all');"
+            )?;
+        }
+
+        let mut revwalk = repo.revwalk()?;
+        revwalk.set_sorting(git2::Sort::TOPOLOGICAL | git2::Sort::TIME)?;
+        revwalk.push(head)?;
+        if let (true, Some(base)) = (removed, base) {
+            revwalk.hide(base)?;
+        }
+        let new: Vec<Oid> = revwalk.collect::<Result<_, _>>()?;
+
+        let mut added = 0;
+        {
+            let mut insert_commit = tx.prepare_cached("INSERT OR IGNORE INTO commits (oid) VALUES (?)")?;
+            let mut insert_trigrams = tx.prepare_cached(
+                "INSERT INTO commit_trigrams (rowid, message, author) VALUES (?, ?, ?)"
+            )?;
+            let mut insert_words = tx.prepare_cached(
+                "INSERT INTO commit_words (rowid, message, author) VALUES (?, ?, ?)"
+            )?;
+
+            // Ancestors first, so rowid order follows history
+            for oid in new.iter().rev() {
+                if insert_commit.execute(params![oid.to_string()])? == 0 {
+                    continue;
+                }
+                let id = tx.last_insert_rowid();
+
+                let commit = repo.find_commit(*oid)?;
+                let (message, author) = Self::text(&commit);
+                insert_trigrams.execute(params![id, message, author])?;
+                insert_words.execute(params![id, message, author])?;
+                added += 1;
+            }
+        }
+
+        tx.execute("DELETE FROM tips", [])?;
+        tx.execute("INSERT INTO tips (oid) VALUES (?)", params![head.to_string()])?;
+        tx.commit().context("Failed to commit index update")?;
+        Ok(added)
+    }
+
+    /// Remove the commits reachable from `tip` but not from `base`
+    fn remove_range(tx: &Transaction<'_>, repo: &git2::Repository, tip: Oid, base: Oid) -> Result<()> {
+        if tip == base {
+            return Ok(());
+        }
+        let mut revwalk = repo.revwalk()?;
+        revwalk.push(tip)?;
+        revwalk.hide(base)?;
+
+        let mut find = tx.prepare_cached("SELECT id FROM commits WHERE oid = ?")?;
+        let mut delete_commit = tx.prepare_cached("DELETE FROM commits WHERE id = ?")?;
+        // Contentless tables need the indexed text to remove a row
+        let mut delete_trigrams = tx.prepare_cached(
+            "INSERT INTO commit_trigrams (commit_trigrams, rowid, message, author) VALUES ('delete', ?, ?, ?)"
+        )?;
+        let mut delete_words = tx.prepare_cached(
+            "INSERT INTO commit_words (commit_words, rowid, message, author) VALUES ('delete', ?, ?, ?)"
+        )?;
+        for oid in revwalk {
+            let oid = oid?;
+            let id: i64 = match find.query_row(params![oid.to_string()], |row| row.get(0)) {
+                Ok(id) => id,
+                Err(rusqlite::Error::QueryReturnedNoRows) => continue,
+                Err(e) => return Err(e.into()),
+            };
+            let commit = repo.find_commit(oid)?;
+            let (message, author) = Self::text(&commit);
+            delete_trigrams.execute(params![id, message, author])?;
+            delete_words.execute(params![id, message, author])?;
+            delete_commit.execute(params![id])?;
+        }
+        Ok(())
+    }
+
+    fn text(commit: &git2::Commit<'_>) -> (String, String) {
+        let message = String::from_utf8_lossy(commit.message_bytes()).into_owned();
+        let author = commit.author();
+        let author = String::from_utf8_lossy(author.name_bytes()).into_owned();
+        (message, author)
+    }
+
+    /// Commits reachable from HEAD that match `query`, newest first
+    ///
+    /// Matches like the linear search: a case-insensitive substring of the
+    /// message or author name, or an oid prefix. Queries shorter than three
+    /// characters can't use trigrams and match word prefixes instead.
+    /// Returns None for queries the index can't answer (empty, or short
+    /// punctuation).
+    ///
+    /// Results come from the last `update`; check `is_current` first.
+    pub fn search(&self, query: &str, limit: usize) -> Result<Option<Vec<Oid>>> {
+        let query = query.to_lowercase();
+        let quoted = format!("\"{}\"", query.replace('"', "\"\""));
+
+        let text = match query.chars().count() {
+            0 => None,
+            1 | 2 if !query.chars().all(char::is_alphanumeric) => None,
+            1 | 2 => Some((
+                "SELECT c.id, c.oid FROM commit_words JOIN commits c ON c.id = commit_words.rowid
+                 WHERE commit_words MATCH ? ORDER BY commit_words.rowid DESC",
+                format!("{}*", quoted),
+            )),
+            _ => Some((
+                "SELECT c.id, c.oid FROM commit_trigrams JOIN commits c ON c.id = commit_trigrams.rowid
+                 WHERE commit_trigrams MATCH ? ORDER BY commit_trigrams.rowid DESC",
+                quoted,
+            )),
+        };
+        let is_prefix = !query.is_empty() && query.len() <= 64 && query.bytes().all(|b| b.is_ascii_hexdigit());
+
+        if text.is_none() && !is_prefix {
+            return Ok(None);
+        }
+        if limit == 0 {
+            return Ok(Some(Vec::new()));
+        }
+
+        let mut text_stmt = match &text {
+            Some((sql, _)) => Some(self.conn.prepare_cached(sql)?),
+            None => None,
+        };
+        let mut text_rows = match (&mut text_stmt, &text) {
+            (Some(stmt), Some((_, pattern))) => Some(stmt.query(params![pattern])?),
+            _ => None,
+        };
+
+        // Hex digits sort below 'g', so this bounds every oid starting with the query
+        let mut prefix_stmt = if is_prefix {
+            Some(self.conn.prepare_cached(
+                "SELECT id, oid FROM commits WHERE oid >= ?1 AND oid < ?1 || 'g' ORDER BY id DESC"
+            )?)
+        } else {
+            None
+        };
+        let mut prefix_rows = match &mut prefix_stmt {
+            Some(stmt) => Some(stmt.query(params![query])?),
+            None => None,
+        };
+
+        // Merge the two id-descending streams; equal ids are the same commit
+        let mut matches = Vec::new();
+        let mut text_next = Self::next_match(&mut text_rows)?;
+        let mut prefix_next = Self::next_match(&mut prefix_rows)?;
+        while matches.len() < limit {
+            let text_id = text_next.as_ref().map(|(id, _)| *id);
+            let prefix_id = prefix_next.as_ref().map(|(id, _)| *id);
+            if text_id.is_none() && prefix_id.is_none() {
+                break;
+            }
+
+            let oid = if text_id >= prefix_id {
+                if text_id == prefix_id {
+                    prefix_next = Self::next_match(&mut prefix_rows)?;
+                }
+                let (_, oid) = text_next.take().unwrap();
+                text_next = Self::next_match(&mut text_rows)?;
+                oid
+            } else {
+                let (_, oid) = prefix_next.take().unwrap();
+                prefix_next = Self::next_match(&mut prefix_rows)?;
+                oid
+            };
+
+            matches.push(Oid::from_str(&oid)?);
+        }
+
+        Ok(Some(matches))
+    }
+
+    /// Bring the index of the repository at `git_dir` up to HEAD on a
+    /// background thread, unless an update for it is already running
+    pub fn update_in_background(git_dir: &Path) {
+        static RUNNING: OnceLock<Mutex<HashSet<PathBuf>>> = OnceLock::new();
+        let running = RUNNING.get_or_init(|| Mutex::new(HashSet::new()));
+
+        let git_dir = git_dir.to_path_buf();
+        if !running.lock().unwrap().insert(git_dir.clone()) {
+            return;
+        }
+
+        let worker_dir = git_dir.clone();
+        let spawned = thread::Builder::new()
+            .name("gitscribe-search-index".to_string())
+            .spawn(move || {
+                let updated = git2::Repository::open(&worker_dir)
+                    .context("Failed to open repository")
+                    .and_then(|repo| SearchIndex::open(&repo)?.update(&repo));
+                if let Err(e) = updated {
+                    tracing::debug!("commit search index update failed for {:?}: {:#}", worker_dir, e);
+                }
+                running.lock().unwrap().remove(&worker_dir);
+            });
+        if spawned.is_err() {
+            running.lock().unwrap().remove(&git_dir);
+        }
+    }
+
+    fn next_match(rows: &mut Option<rusqlite::Rows<'_>>) -> Result<Option<(i64, String)>> {
+        let row = match rows {
+            Some(rows) => rows.next()?,
+            None => return Ok(None),
+        };
+        match row {
+            Some(row) => Ok(Some((row.get(0)?, row.get(1)?))),
+            None => Ok(None),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_incremental_search() {
+        let temp_dir = TempDir::new().unwrap();
+        let repo = git2::Repository::init(temp_dir.path()).unwrap();
+        let tree = repo.find_tree(repo.index().unwrap().write_tree().unwrap()).unwrap();
+
+        let commit = |message: &str, author: &str| {
+            let sig = git2::Signature::now(author, "dev@example.com").unwrap();
+            let parent = repo.head().ok().and_then(|h| h.peel_to_commit().ok());
+            let parents: Vec<_> = parent.iter().collect();
+            repo.commit(Some("HEAD"), &sig, &sig, message, &tree, &parents).unwrap()
+        };
+
+        let first = commit("Fix parser crash on empty input", "Alice");
+        commit("Add overlay icons", "Bob");
+
+        let index = SearchIndex::open(&repo).unwrap();
+        assert_eq!(index.update(&repo).unwrap(), 2);
+        assert!(index.is_current(&repo).unwrap());
+        assert_eq!(index.search("PARSER", 10).unwrap(), Some(vec![first]));
+        assert_eq!(index.search("bo", 10).unwrap().unwrap().len(), 1);
+        let prefix = first.to_string()[..6].to_string();
+        assert!(index.search(&prefix, 10).unwrap().unwrap().contains(&first));
+
+        let third = commit("Parser: handle CRLF", "Alice");
+        assert!(!index.is_current(&repo).unwrap());
+        assert_eq!(index.update(&repo).unwrap(), 1);
+        assert_eq!(index.search("parser", 10).unwrap(), Some(vec![third, first]));
+        assert_eq!(index.search("alice", 1).unwrap(), Some(vec![third]));
+
+        // Switching to a branch off `first` drops the commits it can't reach
+        let first_commit = repo.find_commit(first).unwrap();
+        repo.branch("topic", &first_commit, false).unwrap();
+        repo.set_head("refs/heads/topic").unwrap();
+        let topic = commit("Parser fuzzing", "Carol");
+        assert_eq!(index.update(&repo).unwrap(), 1);
+        assert_eq!(index.search("parser", 10).unwrap(), Some(vec![topic, first]));
+        assert_eq!(index.search("alice", 10).unwrap(), Some(vec![first]));
+    }
+}
@@ -2,20 +2,33 @@
 //!
 //! Provides drag-and-drop stash functionality with named stashes,
 //! file-level granularity, and persistent storage.
-
+//!
+//! File contents and patches live in a content-addressed `StashStore`; each
+//! stash's metadata is a small JSON file of its own, so renaming or editing
+//! one stash rewrites a few hundred bytes rather than every stashed file.
+//! Content is only read from the store when a file is applied or exported,
+//! and then streamed: applying writes files in parallel straight from the
+//! store, each to a temporary file renamed into place.
+
+use rayon::prelude::*;
 use serde::{Deserialize, Serialize};
-use std::collections::HashMap;
-use std::fs;
-use std::path::{Path, PathBuf};
+use std::collections::{HashMap, HashSet};
+use std::fs::{self, File};
+use std::io::{self, BufWriter, Write};
+use std::path::{Component, Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
 use std::time::{SystemTime, UNIX_EPOCH};
 use anyhow::{Result, Context};
 
-/// A single file stashed with its content and metadata
+use crate::stash_store::{StashStore, StoreHandle};
+
+/// A single file stashed with its metadata; content is in the stash store
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct StashedFile {
     pub path: String,
-    pub patch: String,              // Git diff patch
-    pub original_content: String,   // Full file content at stash time
+    pub patch_oid: String,          // Git diff patch
+    pub content_oid: String,        // Full file content at stash time
     pub status: FileStatus,
     pub size: u64,
     pub last_modified: u64,
@@ -117,32 +130,60 @@ impl VisualStash {
     }
 }
 
+/// How `apply_stash_with` writes files
+#[derive(Debug, Clone)]
+pub struct ApplyOptions {
+    /// Files written at once (0 = shared pool with one thread per CPU)
+    pub writers: usize,
+}
+
+impl Default for ApplyOptions {
+    fn default() -> Self {
+        // Writing is I/O bound, so more files in flight than CPUs
+        Self { writers: 16 }
+    }
+}
+
 /// Manages all visual stashes for a repository
 #[derive(Debug)]
 pub struct VisualStashManager {
     stashes: HashMap<String, VisualStash>,
-    storage_path: PathBuf,
+    /// One `<id>.json` per stash
+    index_dir: PathBuf,
+    store: StashStore,
     repo_path: PathBuf,
+    /// Pool for `apply_stash_with`, kept between calls
+    writer_pool: Mutex<Option<Arc<rayon::ThreadPool>>>,
 }
 
 impl VisualStashManager {
     /// Create a new stash manager for a repository
     pub fn new(repo_path: &Path) -> Result<Self> {
-        let storage_path = repo_path.join(".git").join("gitscribe").join("stashes.json");
+        let storage_dir = repo_path.join(".git").join("gitscribe");
+        let index_dir = storage_dir.join("stashes");
 
         // Create directory if it doesn't exist
-        if let Some(parent) = storage_path.parent() {
-            fs::create_dir_all(parent)?;
-        }
+        fs::create_dir_all(&index_dir)?;
 
         let mut manager = Self {
             stashes: HashMap::new(),
-            storage_path,
+            index_dir,
+            store: StashStore::new(storage_dir.join("stash-objects")),
             repo_path: repo_path.to_path_buf(),
+            writer_pool: Mutex::new(None),
         };
 
         // Load existing stashes
         manager.load()?;
+        manager.migrate(&storage_dir.join("stashes.json"))?;
+
+        let referenced: HashSet<&str> = manager.stashes.values()
+            .flat_map(|stash| stash.files.iter())
+            .flat_map(|file| [file.patch_oid.as_str(), file.content_oid.as_str()])
+            .collect();
+        if let Err(e) = manager.store.prune(&referenced) {
+            tracing::debug!("failed to prune stash store: {:#}", e);
+        }
 
         Ok(manager)
     }
@@ -155,7 +196,7 @@ impl VisualStashManager {
 
         let id = stash.id.clone();
         self.stashes.insert(id.clone(), stash);
-        let _ = self.save();
+        let _ = self.save(&id);
 
         id
     }
@@ -169,15 +210,19 @@ impl VisualStashManager {
         patch: &str,
         status: FileStatus,
     ) -> Result<()> {
-        let stash = self.stashes.get_mut(stash_id)
-            .context("Stash not found")?;
+        if !self.stashes.contains_key(stash_id) {
+            anyhow::bail!("Stash not found");
+        }
 
         let metadata = fs::metadata(self.repo_path.join(file_path))?;
+        let (patch_oid, content_oid) = self.store.open(|store| {
+            Ok((store.put(patch.as_bytes())?, store.put(content.as_bytes())?))
+        })?;
 
         let stashed_file = StashedFile {
             path: file_path.to_string(),
-            patch: patch.to_string(),
-            original_content: content.to_string(),
+            patch_oid,
+            content_oid,
             status,
             size: metadata.len(),
             last_modified: metadata.modified()?
@@ -185,13 +230,52 @@ impl VisualStashManager {
                 .as_secs(),
         };
 
-        stash.add_file(stashed_file);
-        self.save()?;
+        self.stashes.get_mut(stash_id).context("Stash not found")?.add_file(stashed_file);
+        self.save(stash_id)?;
 
         Ok(())
     }
 
+    /// Stash a working tree file as it is on disk, streaming it into the
+    /// store (for large or binary files)
+    ///
+    /// The result can be added to a stash or passed to `stash_current_branch`.
+    pub fn store_file(&self, file_path: &str, patch: &str, status: FileStatus) -> Result<StashedFile> {
+        let path = self.repo_path.join(file_path);
+        let (content_oid, size, patch_oid) = self.store.open(|store| {
+            let (content_oid, size) = match status {
+                FileStatus::Deleted => (store.put(&[])?, 0),
+                _ => store.put_file(&path)?,
+            };
+            Ok((content_oid, size, store.put(patch.as_bytes())?))
+        })?;
+        let last_modified = fs::metadata(&path)
+            .and_then(|m| m.modified())
+            .ok()
+            .and_then(|t| t.duration_since(UNIX_EPOCH).ok())
+            .map_or(0, |d| d.as_secs());
+
+        Ok(StashedFile {
+            path: file_path.to_string(),
+            patch_oid,
+            content_oid,
+            status,
+            size,
+            last_modified,
+        })
+    }
+
+    /// Add a file made with `store_file` to a stash
+    pub fn add_stored_file(&mut self, stash_id: &str, file: StashedFile) -> Result<()> {
+        self.stashes.get_mut(stash_id)
+            .context("Stash not found")?
+            .add_file(file);
+        self.save(stash_id)
+    }
+
     /// Remove a file from a stash
+    ///
+    /// Its content stays in the store until the next time stashes are loaded.
     pub fn remove_file_from_stash(&mut self, stash_id: &str, file_path: &str) -> Result<StashedFile> {
         let stash = self.stashes.get_mut(stash_id)
             .context("Stash not found")?;
@@ -199,7 +283,7 @@ impl VisualStashManager {
         let file = stash.remove_file(file_path)
             .context("File not found in stash")?;
 
-        self.save()?;
+        self.save(stash_id)?;
         Ok(file)
     }
 
@@ -208,7 +292,7 @@ impl VisualStashManager {
         let stash = self.stashes.remove(stash_id)
             .context("Stash not found")?;
 
-        self.save()?;
+        fs::remove_file(self.index_path(stash_id))?;
         Ok(stash)
     }
 
@@ -219,7 +303,7 @@ impl VisualStashManager {
 
         stash.name = new_name;
         stash.update_modified();
-        self.save()?;
+        self.save(stash_id)?;
 
         Ok(())
     }
@@ -236,6 +320,16 @@ impl VisualStashManager {
         stashes
     }
 
+    /// Raw content of a stashed file
+    pub fn read_content(&self, file: &StashedFile) -> Result<Vec<u8>> {
+        self.store.read(&file.content_oid)
+    }
+
+    /// Patch of a stashed file
+    pub fn read_patch(&self, file: &StashedFile) -> Result<String> {
+        String::from_utf8(self.store.read(&file.patch_oid)?).context("Stashed patch is not UTF-8")
+    }
+
     /// Apply a file from stash (restore it to working directory)
     pub fn apply_file(&self, stash_id: &str, file_path: &str) -> Result<String> {
         let stash = self.stashes.get(stash_id)
@@ -246,23 +340,63 @@ impl VisualStashManager {
             .context("File not found in stash")?;
 
         // Return the original content to be written by the caller
-        Ok(file.original_content.clone())
+        String::from_utf8(self.read_content(file)?)
+            .with_context(|| format!("{} is not UTF-8; use read_content", file.path))
+    }
+
+    /// Apply entire stash (all files) to the working directory
+    ///
+    /// Returns the paths written (or removed, for deleted files).
+    pub fn apply_stash(&self, stash_id: &str) -> Result<Vec<String>> {
+        self.apply_stash_with(stash_id, &ApplyOptions::default())
     }
 
-    /// Apply entire stash (all files)
-    pub fn apply_stash(&self, stash_id: &str) -> Result<Vec<(String, String)>> {
+    /// `apply_stash` with explicit writer settings
+    ///
+    /// Every file is attempted; each one is replaced atomically, so a
+    /// failure leaves the files it didn't reach as they were.
+    pub fn apply_stash_with(&self, stash_id: &str, options: &ApplyOptions) -> Result<Vec<String>> {
         let stash = self.stashes.get(stash_id)
             .context("Stash not found")?;
 
-        let files: Vec<(String, String)> = stash.files.iter()
-            .map(|f| (f.path.clone(), f.original_content.clone()))
-            .collect();
+        let results = self.store.open(|store| {
+            let write_all = || -> Vec<Result<()>> {
+                stash.files.par_iter().map(|file| self.write_file(store, file)).collect()
+            };
+            Ok(if options.writers == 0 {
+                write_all()
+            } else {
+                self.writer_pool(options.writers)?.install(write_all)
+            })
+        })?;
+
+        let failed = results.iter().filter(|r| r.is_err()).count();
+        if let Some(first) = results.into_iter().find_map(Result::err) {
+            return Err(first.context(format!("Failed to apply {} of {} files", failed, stash.files.len())));
+        }
+        Ok(stash.files.iter().map(|f| f.path.clone()).collect())
+    }
 
-        Ok(files)
+    /// Pool with `writers` threads, built on first use and again only when a
+    /// different size is asked for
+    fn writer_pool(&self, writers: usize) -> Result<Arc<rayon::ThreadPool>> {
+        let mut pool = self.writer_pool.lock().unwrap();
+        if let Some(pool) = pool.as_ref().filter(|pool| pool.current_num_threads() == writers) {
+            return Ok(pool.clone());
+        }
+        let built = Arc::new(
+            rayon::ThreadPoolBuilder::new()
+                .num_threads(writers)
+                .thread_name(|i| format!("gitscribe-stash-writer-{}", i))
+                .build()
+                .context("Failed to create stash writer pool")?,
+        );
+        *pool = Some(built.clone());
+        Ok(built)
     }
 
     /// Pop a stash (apply and delete)
-    pub fn pop_stash(&mut self, stash_id: &str) -> Result<Vec<(String, String)>> {
+    pub fn pop_stash(&mut self, stash_id: &str) -> Result<Vec<String>> {
         let files = self.apply_stash(stash_id)?;
         self.delete_stash(stash_id)?;
         Ok(files)
@@ -290,17 +424,18 @@ impl VisualStashManager {
 
         let id = stash.id.clone();
         self.stashes.insert(id.clone(), stash);
-        let _ = self.save();
+        let _ = self.save(&id);
 
         id
     }
 
     /// Restore a branch stash
-    /// Returns (files to restore, branch to checkout, staged files)
+    /// Returns (files to restore, branch to checkout, staged files); write
+    /// the files with `apply_stash` once the branch is checked out
     pub fn restore_branch_stash(
         &self,
         stash_id: &str,
-    ) -> Result<(Vec<(String, String)>, BranchContext), String> {
+    ) -> Result<(Vec<String>, BranchContext), String> {
         let stash = self.stashes.get(stash_id)
             .ok_or("Stash not found")?;
 
@@ -312,8 +447,8 @@ impl VisualStashManager {
             .ok_or("Branch context missing")?
             .clone();
 
-        let files: Vec<(String, String)> = stash.files.iter()
-            .map(|f| (f.path.clone(), f.original_content.clone()))
+        let files: Vec<String> = stash.files.iter()
+            .map(|f| f.path.clone())
             .collect();
 
         Ok((files, branch_context))
@@ -342,38 +477,146 @@ impl VisualStashManager {
         Ok((stash_id, target_branch))
     }
 
-    /// Save stashes to disk
-    fn save(&self) -> Result<()> {
-        let json = serde_json::to_string_pretty(&self.stashes)?;
-        fs::write(&self.storage_path, json)?;
-        Ok(())
+    /// Restore one file from the store into the working directory
+    fn write_file(&self, store: &StoreHandle<'_>, file: &StashedFile) -> Result<()> {
+        // Stash metadata names paths inside the working directory only
+        if Path::new(&file.path).components().any(|c| !matches!(c, Component::Normal(_))) {
+            anyhow::bail!("Refusing to write outside the repository: {}", file.path);
+        }
+        let path = self.repo_path.join(&file.path);
+
+        if let FileStatus::Deleted = file.status {
+            return match fs::remove_file(&path) {
+                Err(e) if e.kind() != io::ErrorKind::NotFound => {
+                    Err(e).with_context(|| format!("Failed to remove {}", file.path))
+                }
+                _ => Ok(()),
+            };
+        }
+
+        let dir = path.parent().context("Invalid stashed path")?;
+        fs::create_dir_all(dir)?;
+        let name = path.file_name().context("Invalid stashed path")?.to_string_lossy();
+        let temp = dir.join(format!(".{}.{}.gitscribe-tmp", name, uuid::Uuid::new_v4().simple()));
+
+        let result = (|| -> Result<()> {
+            let mut out = File::create(&temp)?;
+            store.copy_to(&file.content_oid, &mut out)?;
+            // Keep the mode of the file being replaced (e.g. executables)
+            if let Ok(existing) = fs::metadata(&path) {
+                out.set_permissions(existing.permissions())?;
+            }
+            drop(out);
+            fs::rename(&temp, &path)?;
+            Ok(())
+        })();
+
+        if result.is_err() {
+            let _ = fs::remove_file(&temp);
+        }
+        result.with_context(|| format!("Failed to write {}", file.path))
+    }
+
+    fn index_path(&self, stash_id: &str) -> PathBuf {
+        self.index_dir.join(format!("{}.json", stash_id))
+    }
+
+    /// Save one stash's metadata to disk
+    fn save(&self, stash_id: &str) -> Result<()> {
+        let stash = self.stashes.get(stash_id).context("Stash not found")?;
+        let path = self.index_path(stash_id);
+        // Unique per writer, so concurrent saves never share a temp file
+        static NEXT: AtomicU64 = AtomicU64::new(0);
+        let temp = path.with_extension(format!(
+            "json.{}-{}.tmp",
+            std::process::id(),
+            NEXT.fetch_add(1, Ordering::Relaxed)
+        ));
+
+        let result = fs::write(&temp, serde_json::to_vec(stash)?).and_then(|_| fs::rename(&temp, &path));
+        if result.is_err() {
+            let _ = fs::remove_file(&temp);
+        }
+        result.with_context(|| format!("Failed to save stash {}", stash_id))
     }
 
     /// Load stashes from disk
     fn load(&mut self) -> Result<()> {
-        if self.storage_path.exists() {
-            let json = fs::read_to_string(&self.storage_path)?;
-            self.stashes = serde_json::from_str(&json)?;
+        for entry in fs::read_dir(&self.index_dir)? {
+            let path = entry?.path();
+            if path.extension().map_or(true, |ext| ext != "json") {
+                continue;
+            }
+            let stash = fs::read(&path)
+                .map_err(anyhow::Error::from)
+                .and_then(|json| Ok(serde_json::from_slice::<VisualStash>(&json)?));
+            match stash {
+                Ok(stash) => {
+                    self.stashes.insert(stash.id.clone(), stash);
+                }
+                Err(e) => tracing::debug!("skipping unreadable stash {:?}: {:#}", path, e),
+            }
         }
         Ok(())
     }
 
+    /// Move stashes from the old single-file format (contents inline) into
+    /// the store and index
+    fn migrate(&mut self, legacy_path: &Path) -> Result<()> {
+        let json = match fs::read_to_string(legacy_path) {
+            Ok(json) => json,
+            Err(_) => return Ok(()),
+        };
+        let legacy: HashMap<String, serde_json::Value> = serde_json::from_str(&json)
+            .context("Failed to read legacy stashes")?;
+
+        let store = self.store.clone();
+        store.open(|store| {
+            for (id, mut stash) in legacy {
+                let files = stash.get_mut("files").and_then(|f| f.as_array_mut());
+                for file in files.into_iter().flatten() {
+                    let file = file.as_object_mut().context("Invalid legacy stash")?;
+                    for (inline, oid) in [("patch", "patch_oid"), ("original_content", "content_oid")] {
+                        let content = file.remove(inline);
+                        let content = content.as_ref().and_then(|c| c.as_str()).unwrap_or("");
+                        file.insert(oid.to_string(), store.put(content.as_bytes())?.into());
+                    }
+                }
+                let stash: VisualStash = serde_json::from_value(stash).context("Invalid legacy stash")?;
+                self.stashes.insert(id.clone(), stash);
+                self.save(&id)?;
+            }
+            Ok(())
+        })?;
+
+        fs::remove_file(legacy_path)?;
+        Ok(())
+    }
+
     /// Export stash to .patch file
+    ///
+    /// Patches are streamed from the store, so the export is never held in
+    /// memory as a whole.
     pub fn export_stash(&self, stash_id: &str, output_path: &Path) -> Result<()> {
         let stash = self.stashes.get(stash_id)
             .context("Stash not found")?;
 
-        let mut patch_content = format!("# GitScribe Stash: {}\n", stash.name);
-        patch_content.push_str(&format!("# Created: {}\n", stash.created));
-        patch_content.push_str(&format!("# Files: {}\n\n", stash.files.len()));
-
-        for file in &stash.files {
-            patch_content.push_str(&format!("# File: {}\n", file.path));
-            patch_content.push_str(&file.patch);
-            patch_content.push_str("\n\n");
-        }
-
-        fs::write(output_path, patch_content)?;
+        let mut out = BufWriter::new(File::create(output_path)?);
+        writeln!(out, "# GitScribe Stash: {}", stash.name)?;
+        writeln!(out, "# Created: {}", stash.created)?;
+        writeln!(out, "# Files: {}", stash.files.len())?;
+        writeln!(out)?;
+
+        self.store.open(|store| {
+            for file in &stash.files {
+                writeln!(out, "# File: {}", file.path)?;
+                store.copy_to(&file.patch_oid, &mut out)?;
+                out.write_all(b"\n\n")?;
+            }
+            Ok(())
+        })?;
+
+        out.flush()?;
         Ok(())
     }
 }
@@ -445,4 +688,80 @@ mod tests {
 
         fs::remove_dir_all(&temp_dir).unwrap();
     }
+
+    #[test]
+    fn test_legacy_stashes_migrate_to_store() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let storage_dir = temp_dir.path().join(".git").join("gitscribe");
+        fs::create_dir_all(&storage_dir).unwrap();
+
+        let stash = VisualStash::new("Old".to_string());
+        let mut legacy = serde_json::to_value(&stash).unwrap();
+        legacy["files"] = serde_json::json!([{
+            "path": "big.txt",
+            "patch": "diff --git a/big.txt b/big.txt",
+            "original_content": "line\n".repeat(10_000),
+            "status": "Modified",
+            "size": 50_000,
+            "last_modified": 0,
+        }]);
+        fs::write(
+            storage_dir.join("stashes.json"),
+            serde_json::to_string(&serde_json::json!({ stash.id.clone(): legacy })).unwrap(),
+        ).unwrap();
+
+        let mut manager = VisualStashManager::new(temp_dir.path()).unwrap();
+        assert!(!storage_dir.join("stashes.json").exists());
+        assert_eq!(manager.apply_file(&stash.id, "big.txt").unwrap(), "line\n".repeat(10_000));
+
+        // Renaming rewrites only this stash's metadata, not its content
+        manager.rename_stash(&stash.id, "Renamed".to_string()).unwrap();
+        let index = fs::metadata(manager.index_path(&stash.id)).unwrap().len();
+        assert!(index < 1_000, "index entry is {} bytes", index);
+
+        let manager = VisualStashManager::new(temp_dir.path()).unwrap();
+        let stash = manager.get_stash(&stash.id).unwrap();
+        assert_eq!(stash.name, "Renamed");
+        assert_eq!(manager.read_patch(&stash.files[0]).unwrap(), "diff --git a/big.txt b/big.txt");
+    }
+
+    #[test]
+    fn test_apply_and_export_stream_from_store() {
+        let temp_dir = tempfile::TempDir::new().unwrap();
+        let root = temp_dir.path();
+        fs::create_dir_all(root.join("src")).unwrap();
+        for i in 0..50 {
+            fs::write(root.join("src").join(format!("{}.rs", i)), format!("fn f{}() {{}}\n", i)).unwrap();
+        }
+        fs::write(root.join("gone.txt"), "old").unwrap();
+
+        let mut manager = VisualStashManager::new(root).unwrap();
+        let stash_id = manager.create_stash("Work".to_string(), None, vec![]);
+        for i in 0..50 {
+            let path = format!("src/{}.rs", i);
+            let file = manager.store_file(&path, &format!("patch {}", i), FileStatus::Modified).unwrap();
+            manager.add_stored_file(&stash_id, file).unwrap();
+        }
+        let gone = manager.store_file("gone.txt", "patch gone", FileStatus::Deleted).unwrap();
+        manager.add_stored_file(&stash_id, gone).unwrap();
+
+        // Work moves on; applying puts the stashed content back
+        for i in 0..50 {
+            fs::write(root.join("src").join(format!("{}.rs", i)), "changed").unwrap();
+        }
+        let applied = manager.apply_stash_with(&stash_id, &ApplyOptions { writers: 4 }).unwrap();
+        assert_eq!(applied.len(), 51);
+        assert_eq!(fs::read_to_string(root.join("src/7.rs")).unwrap(), "fn f7() {}\n");
+        assert!(!root.join("gone.txt").exists());
+        let leftovers = fs::read_dir(root.join("src")).unwrap()
+            .filter(|e| e.as_ref().unwrap().file_name().to_string_lossy().ends_with(".gitscribe-tmp"))
+            .count();
+        assert_eq!(leftovers, 0);
+
+        let export = root.join("work.patch");
+        manager.export_stash(&stash_id, &export).unwrap();
+        let patch = fs::read_to_string(&export).unwrap();
+        assert!(patch.starts_with("# GitScribe Stash: Work\n"));
+        assert!(patch.contains("# File: src/49.rs\npatch 49\n\n"));
+    }
 }
@@ -0,0 +1,133 @@
+//! Stash Object Store
+//!
+//! Content of stashed files and their patches, kept as blobs in a private
+//! bare repository next to the stash index. Blobs are zlib-compressed and
+//! addressed by content, so a file stashed twice (or left unchanged between
+//! two stashes) is stored once, and stash metadata only carries object ids.
+//! The store has no refs, so `git gc` never runs on it; blobs no stash
+//! refers to are removed by `prune`.
+
+use anyhow::{Context, Result};
+use git2::Oid;
+use std::collections::HashSet;
+use std::fs::{self, File};
+use std::io::{self, Read, Write};
+use std::path::{Path, PathBuf};
+use std::time::{Duration, SystemTime};
+
+/// Unreferenced blobs younger than this are kept, since another process may
+/// have written them for a stash it hasn't saved yet
+const PRUNE_GRACE: Duration = Duration::from_secs(60 * 60);
+
+/// Content-addressed blob store for stashes
+#[derive(Debug, Clone)]
+pub struct StashStore {
+    dir: PathBuf,
+}
+
+impl StashStore {
+    /// Store in `dir`, created on first write
+    pub fn new(dir: PathBuf) -> Self {
+        Self { dir }
+    }
+
+    /// Run `f` with the store open, creating it if needed
+    ///
+    /// Open the store once per stash operation and pass the handle to every
+    /// read and write it makes, including from parallel workers. The handle is
+    /// dropped when `f` returns, so the store's files are never held open
+    /// between operations.
+    pub fn open<R>(&self, f: impl FnOnce(&StoreHandle<'_>) -> Result<R>) -> Result<R> {
+        let repo = if self.dir.join("objects").is_dir() {
+            git2::Repository::open_bare(&self.dir)
+        } else {
+            git2::Repository::init_bare(&self.dir)
+        }.context("Failed to open stash store")?;
+        let odb = repo.odb().context("Failed to open stash store")?;
+        f(&StoreHandle { odb })
+    }
+
+    /// Whole content of a blob, opening the store for this one read
+    pub fn read(&self, oid: &str) -> Result<Vec<u8>> {
+        self.open(|store| store.read(oid))
+    }
+
+    /// Remove blobs not in `referenced`, returning how many were removed
+    pub fn prune(&self, referenced: &HashSet<&str>) -> Result<usize> {
+        let objects = self.dir.join("objects");
+        let entries = match fs::read_dir(&objects) {
+            Ok(entries) => entries,
+            Err(_) => return Ok(0),
+        };
+        let expired = SystemTime::now() - PRUNE_GRACE;
+
+        let mut removed = 0;
+        for entry in entries {
+            let entry = entry?;
+            let prefix = entry.file_name().to_string_lossy().to_string();
+            // Loose object fan-out directories only (not pack/ or info/)
+            if prefix.len() != 2 || !entry.file_type()?.is_dir() {
+                continue;
+            }
+            for object in fs::read_dir(entry.path())? {
+                let object = object?;
+                let oid = format!("{}{}", prefix, object.file_name().to_string_lossy());
+                if referenced.contains(oid.as_str()) {
+                    continue;
+                }
+                let modified = object.metadata()?.modified()?;
+                if modified < expired {
+                    fs::remove_file(object.path())?;
+                    removed += 1;
+                }
+            }
+        }
+        Ok(removed)
+    }
+}
+
+/// An open stash store
+///
+/// The object database locks internally, so one handle can be shared by
+/// parallel workers.
+pub struct StoreHandle<'a> {
+    odb: git2::Odb<'a>,
+}
+
+impl StoreHandle<'_> {
+    /// Store `data`, returning its object id
+    pub fn put(&self, data: &[u8]) -> Result<String> {
+        let oid = self.odb.write(git2::ObjectType::Blob, data)
+            .context("Failed to write to stash store")?;
+        Ok(oid.to_string())
+    }
+
+    /// Store a file's content without reading it all into memory, returning
+    /// its object id and size
+    pub fn put_file(&self, path: &Path) -> Result<(String, u64)> {
+        let (oid, size) = (|| -> Result<_> {
+            let mut file = File::open(path)?;
+            let len = file.metadata()?.len();
+            let mut writer = self.odb.writer(len as usize, git2::ObjectType::Blob)?;
+            let size = io::copy(&mut file, &mut writer)?;
+            Ok((writer.finalize()?, size))
+        })().with_context(|| format!("Failed to stash {}", path.display()))?;
+        Ok((oid.to_string(), size))
+    }
+
+    /// Whole content of a blob
+    pub fn read(&self, oid: &str) -> Result<Vec<u8>> {
+        let mut data = Vec::new();
+        self.copy_to(oid, &mut data)?;
+        Ok(data)
+    }
+
+    /// Stream a blob into `out`, returning its size
+    pub fn copy_to(&self, oid: &str, out: &mut dyn Write) -> Result<u64> {
+        let oid = Oid::from_str(oid).context("Invalid stash object id")?;
+        (|| -> Result<u64> {
+            let (mut reader, _, _) = self.odb.reader(oid)?;
+            Ok(io::copy(&mut reader as &mut dyn Read, out)?)
+        })().with_context(|| format!("Failed to read stash object {}", oid))
+    }
+}
@@ -5,6 +5,7 @@ use serde::{Deserialize, Serialize};
 use std::path::PathBuf;
 
 use crate::Repository;
+use crate::scanner::ScanOptions;
 
 /// File status in Git
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Serialize, Deserialize)]
@@ -38,9 +39,25 @@ pub struct FileStatusEntry {
 impl Repository {
     /// Get status of all files in the repository
     ///
+    /// Uses the parallel worktree scanner, falling back to libgit2 for
+    /// repositories it does not support.
+    ///
     /// Note: This is relatively expensive for large repos.
     /// Consider using `status_cached()` with a StatusCache instead.
     pub fn status(&self) -> Result<Vec<FileStatusEntry>> {
+        self.status_with_options(&ScanOptions::default())
+    }
+
+    /// Get status of all files, scanning with the given options
+    pub fn status_with_options(&self, options: &ScanOptions) -> Result<Vec<FileStatusEntry>> {
+        match crate::scanner::scan(self, options)? {
+            Some(entries) => Ok(entries),
+            None => self.status_libgit2(),
+        }
+    }
+
+    /// Get status of all files using libgit2's single-threaded walk
+    pub fn status_libgit2(&self) -> Result<Vec<FileStatusEntry>> {
         let mut entries = Vec::new();
         let mut opts = git2::StatusOptions::new();
         opts.include_untracked(true)
@@ -110,7 +127,7 @@ impl Repository {
         Ok(FileStatus::Clean)
     }
 
-    fn convert_status(status: git2::Status) -> FileStatus {
+    pub(crate) fn convert_status(status: git2::Status) -> FileStatus {
         // Check in priority order
         if status.is_conflicted() {
             FileStatus::Conflicted
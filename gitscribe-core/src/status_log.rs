@@ -0,0 +1,872 @@
+//! Log-Structured Status Store
+//!
+//! Alternative `StatusCache` backend for the overlay hot path. Each
+//! repository's status rows live in one append-only file that readers memory
+//! map, so a point lookup is a few binary searches over sorted path indexes
+//! with no SQL parsing, B-tree pages or WAL in the way.
+//!
+//! A refresh appends either a full snapshot or, when few rows changed, a delta
+//! on top of the previous record. The file header holds the offset of the
+//! newest committed record and is published with one atomic store after the
+//! record is written, so readers in any process never see a partial refresh
+//! and never take a lock. Writers serialize through a lock file.
+//!
+//! A file is never truncated, rewritten or renamed over while it may be
+//! mapped (Windows refuses all three). Once dead records outweigh live ones
+//! the rows are compacted into a single snapshot in the next generation's
+//! file (`<repo hash>-<generation>.gsl`), and the old file's header records
+//! the generation that replaced it; readers still mapping it see that and
+//! move on. Old generations are deleted once nobody has them open.
+//!
+//! File layout (little-endian):
+//! ```text
+//! header  magic "GSSL" | version u32 | head u64 | replaced_by u64 | reserved
+//! record  magic "GSR1" | kind u8 | flags u8 | pad u16 | len u64 | prev u64
+//!         fingerprint u64 | cache_time i64 | count u32 | depth u32 | checksum u64
+//!         index: count x (path offset u32 | path len u32 | status u8 | pad 3)
+//!         paths: concatenated, sorted bytewise
+//! ```
+
+use anyhow::{Context, Result};
+use std::collections::{BTreeMap, HashMap};
+use std::fs::{self, File, OpenOptions};
+use std::hash::Hasher;
+use std::io::{Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, RwLock};
+use std::time::{Duration, Instant, SystemTime};
+
+use crate::cache::StatusCache;
+use crate::fingerprint::Fnv64;
+use crate::status::FileStatus;
+use crate::FileStatusEntry;
+
+const FILE_MAGIC: &[u8; 4] = b"GSSL";
+const FORMAT_VERSION: u32 = 1;
+const HEADER_LEN: usize = 64;
+/// Header field holding the offset of the newest committed record (0 = none)
+const HEAD_FIELD: usize = 8;
+/// Header field holding the generation that replaced this file (0 = current)
+const REPLACED_FIELD: usize = 16;
+
+const RECORD_MAGIC: &[u8; 4] = b"GSR1";
+const RECORD_HEADER_LEN: usize = 56;
+const INDEX_ENTRY_LEN: usize = 12;
+
+const KIND_SNAPSHOT: u8 = 0;
+const KIND_DELTA: u8 = 1;
+/// Record marks the repository as invalidated (no usable rows)
+const FLAG_INVALIDATED: u8 = 1;
+/// Status byte of a delta entry that removes a row
+const TOMBSTONE: u8 = 0xFF;
+
+/// Deltas stacked on a snapshot before the next refresh writes a new one
+const MAX_DELTA_DEPTH: u32 = 8;
+/// Files smaller than this are never compacted
+const COMPACT_MIN_BYTES: u64 = 1 << 20;
+
+/// When a lock counts as stale, and how long a writer waits for the lock file
+/// (longer, so waiters outlast a crashed writer's lock and steal it)
+const LOCK_STALE: Duration = Duration::from_secs(10);
+const LOCK_TIMEOUT: Duration = Duration::from_secs(15);
+
+/// Status files for all repositories of one cache
+pub struct StatusLog {
+    dir: PathBuf,
+    views: RwLock<HashMap<PathBuf, Arc<View>>>,
+}
+
+impl StatusLog {
+    /// Open (creating if needed) a status log directory
+    pub fn open<P: AsRef<Path>>(dir: P) -> Result<Self> {
+        let dir = dir.as_ref().to_path_buf();
+        fs::create_dir_all(&dir)
+            .with_context(|| format!("Failed to create status log directory {}", dir.display()))?;
+
+        Ok(StatusLog {
+            dir,
+            views: RwLock::new(HashMap::new()),
+        })
+    }
+
+    /// Fingerprint and cache time of the newest refresh, if the rows are usable
+    pub fn state(&self, repo_path: &str) -> Result<Option<(u64, i64)>> {
+        Ok(self.view(repo_path)?.and_then(|view| view.state()))
+    }
+
+    /// Cached status of one file (None if it has no row)
+    pub fn lookup(&self, repo_path: &str, file_path: &str) -> Result<Option<FileStatus>> {
+        Ok(self.view(repo_path)?
+            .and_then(|view| view.lookup(file_path.as_bytes()))
+            .and_then(|status| StatusCache::int_to_status(status as i32)))
+    }
+
+    /// All cached rows of a repository, sorted by path
+    pub fn entries(&self, repo_path: &str) -> Result<Vec<FileStatusEntry>> {
+        let view = match self.view(repo_path)? {
+            Some(view) => view,
+            None => return Ok(Vec::new()),
+        };
+
+        Ok(view.rows()
+            .into_iter()
+            .filter_map(|(path, status)| {
+                StatusCache::int_to_status(status as i32).map(|status| FileStatusEntry {
+                    path: String::from_utf8_lossy(&path).into_owned().into(),
+                    status,
+                })
+            })
+            .collect())
+    }
+
+    /// Replace a repository's rows with a fresh scan
+    pub fn write(&self, repo_path: &str, entries: &[FileStatusEntry], fingerprint: u64, cache_time: i64) -> Result<()> {
+        let mut rows: Vec<(Vec<u8>, u8)> = entries.iter()
+            .map(|e| (e.path.to_string_lossy().into_owned().into_bytes(), e.status as u8))
+            .collect();
+        rows.sort_unstable_by(|a, b| a.0.cmp(&b.0));
+        rows.dedup_by(|a, b| a.0 == b.0);
+
+        self.append(repo_path, Some(rows), fingerprint, cache_time)
+    }
+
+    /// Drop a repository's rows (the next query rescans)
+    pub fn invalidate(&self, repo_path: &str) -> Result<()> {
+        if self.current_file(&self.base_for(repo_path))?.is_none() {
+            return Ok(());
+        }
+        self.append(repo_path, None, 0, 0)
+    }
+
+    /// Delete a repository's status files
+    pub fn remove(&self, repo_path: &str) -> Result<()> {
+        let base = self.base_for(repo_path);
+        self.views.write().unwrap().remove(&base);
+
+        let removed = {
+            let _lock = LockFile::acquire(&base.with_extension("gsl.lock"))?;
+            let (generation, path) = match self.current_file(&base)? {
+                Some(current) => current,
+                None => return Ok(()),
+            };
+            remove_generations(&self.generations(&base)?, generation);
+
+            let file = match OpenOptions::new().read(true).write(true).open(&path) {
+                Ok(file) => file,
+                Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(()),
+                Err(e) => return Err(e).with_context(|| format!("Failed to open {}", path.display())),
+            };
+
+            // Readers still mapping the unlinked file must stop serving its
+            // rows; the generation it points them to doesn't exist
+            let removed = fs::remove_file(&path).is_ok();
+            if removed && file.metadata()?.len() >= HEADER_LEN as u64 {
+                store_header_field(&file, REPLACED_FIELD, generation + 1)?;
+            }
+            removed
+        };
+
+        // Mapped files can't be deleted on Windows; drop the rows instead
+        if !removed {
+            self.invalidate(repo_path)?;
+        }
+        Ok(())
+    }
+
+    /// Bytes used by all status files
+    pub fn total_bytes(&self) -> u64 {
+        fs::read_dir(&self.dir)
+            .map(|entries| {
+                entries
+                    .filter_map(|e| e.ok())
+                    .filter(|e| e.path().extension().map_or(false, |ext| ext == "gsl"))
+                    .filter_map(|e| e.metadata().ok())
+                    .map(|m| m.len())
+                    .sum()
+            })
+            .unwrap_or(0)
+    }
+
+    /// Name shared by a repository's status files and their lock; no file
+    /// of this exact name exists
+    fn base_for(&self, repo_path: &str) -> PathBuf {
+        let mut hasher = Fnv64::new();
+        hasher.write(repo_path.as_bytes());
+        self.dir.join(format!("{:016x}.gsl", hasher.finish()))
+    }
+
+    /// Existing generations of a repository's status file, as (generation, path)
+    fn generations(&self, base: &Path) -> Result<Vec<(u64, PathBuf)>> {
+        let stem = base.file_stem().unwrap_or_default().to_string_lossy().to_string();
+        let mut found = Vec::new();
+        for entry in fs::read_dir(&self.dir)? {
+            let entry = entry?;
+            let name = entry.file_name();
+            let generation = name.to_str()
+                .and_then(|name| name.strip_prefix(stem.as_str()))
+                .and_then(|rest| rest.strip_prefix('-'))
+                .and_then(|rest| rest.strip_suffix(".gsl"))
+                .and_then(|generation| generation.parse::<u64>().ok());
+            if let Some(generation) = generation {
+                found.push((generation, entry.path()));
+            }
+        }
+        found.sort();
+        Ok(found)
+    }
+
+    /// Newest generation of a repository's status file
+    fn current_file(&self, base: &Path) -> Result<Option<(u64, PathBuf)>> {
+        Ok(self.generations(base)?.pop())
+    }
+
+    /// Current view of a repository's file, reopening it after writes
+    fn view(&self, repo_path: &str) -> Result<Option<Arc<View>>> {
+        let base = self.base_for(repo_path);
+
+        let cached = self.views.read().unwrap().get(&base).cloned();
+        if let Some(view) = &cached {
+            if view.is_current() {
+                return Ok(cached);
+            }
+        }
+
+        // Only look for a newer generation once this one has been replaced
+        let path = match cached.filter(|view| load_u64(&view.map, REPLACED_FIELD) == 0) {
+            Some(view) => Some(view.path.clone()),
+            None => self.current_file(&base)?.map(|(_, path)| path),
+        };
+        let view = match path.map(|path| View::open(&path)).transpose()?.flatten() {
+            Some(view) => Arc::new(view),
+            None => {
+                self.views.write().unwrap().remove(&base);
+                return Ok(None);
+            }
+        };
+        self.views.write().unwrap().insert(base, view.clone());
+        Ok(Some(view))
+    }
+
+    /// Append a snapshot or delta (or an invalidation when `rows` is None)
+    fn append(&self, repo_path: &str, rows: Option<Vec<(Vec<u8>, u8)>>, fingerprint: u64, cache_time: i64) -> Result<()> {
+        let name = self.base_for(repo_path);
+        let _lock = LockFile::acquire(&name.with_extension("gsl.lock"))?;
+
+        let (mut generation, mut path) = self.current_file(&name)?
+            .unwrap_or_else(|| (0, generation_path(&name, 0)));
+        let mut file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(false)
+            .open(&path)
+            .with_context(|| format!("Failed to open status log {}", path.display()))?;
+
+        let mut magic = [0u8; 8];
+        let len = file.metadata()?.len();
+        let valid_header = len >= HEADER_LEN as u64
+            && file.read_exact(&mut magic).is_ok()
+            && &magic[..4] == FILE_MAGIC
+            && magic[4..8] == FORMAT_VERSION.to_le_bytes();
+        if !valid_header {
+            // Someone may have mapped a damaged file; start the next
+            // generation rather than rewrite it
+            if len > 0 {
+                generation += 1;
+                path = generation_path(&name, generation);
+                file = OpenOptions::new()
+                    .read(true)
+                    .write(true)
+                    .create_new(true)
+                    .open(&path)
+                    .with_context(|| format!("Failed to create status log {}", path.display()))?;
+            }
+            file.write_all(&new_header(0))?;
+        }
+
+        // Another process may have written since our last read; diff against the file
+        let current = View::open(&path)?;
+        let base = current.as_ref().filter(|v| v.state().is_some());
+
+        let (record, live_len) = match rows {
+            None => (encode(KIND_SNAPSHOT, FLAG_INVALIDATED, 0, 0, 0, 0, &[]), 0),
+            Some(rows) => {
+                let previous = base.map(|v| v.rows()).unwrap_or_default();
+                let changes = diff(&previous, &rows);
+                let depth = base.map_or(0, |v| v.depth());
+
+                match base {
+                    Some(view) if depth < MAX_DELTA_DEPTH && changes.len() * 4 <= previous.len() => {
+                        let record = encode(KIND_DELTA, 0, view.head, fingerprint, cache_time, depth + 1, &changes);
+                        let live = view.live_len() + record.len() as u64;
+                        (record, live)
+                    }
+                    _ => {
+                        let record = encode(KIND_SNAPSHOT, 0, 0, fingerprint, cache_time, 0, &rows);
+                        let live = record.len() as u64;
+                        (record, live)
+                    }
+                }
+            }
+        };
+
+        let offset = file.seek(SeekFrom::End(0))?;
+        file.write_all(&record)?;
+        publish_head(&file, offset)?;
+
+        // Compact once dead records outweigh live ones
+        let file_len = offset + record.len() as u64;
+        if file_len >= COMPACT_MIN_BYTES && file_len - HEADER_LEN as u64 > 2 * live_len {
+            let snapshot = View::open(&path)?.map(|view| match view.state() {
+                Some((fingerprint, cache_time)) => {
+                    encode(KIND_SNAPSHOT, 0, 0, fingerprint, cache_time, 0, &view.rows())
+                }
+                None => encode(KIND_SNAPSHOT, FLAG_INVALIDATED, 0, 0, 0, 0, &[]),
+            });
+            if let Some(snapshot) = snapshot {
+                // Our own maps of the old file go first, so it can be deleted
+                drop(current);
+                self.views.write().unwrap().remove(&name);
+                match compact(&name, generation, &file, &snapshot) {
+                    Ok(()) => {
+                        drop(file);
+                        remove_generations(&self.generations(&name)?, generation + 1);
+                    }
+                    Err(e) => tracing::debug!("failed to compact {}: {:#}", path.display(), e),
+                }
+            }
+        }
+
+        Ok(())
+    }
+}
+
+/// A mapped status file and the record chain committed at `head`
+struct View {
+    path: PathBuf,
+    map: memmap2::Mmap,
+    head: u64,
+    /// Record offsets, newest first, ending at a snapshot
+    chain: Vec<u64>,
+}
+
+impl View {
+    /// Map a status file and validate its newest record chain
+    ///
+    /// Returns None if the file doesn't exist or holds no usable records.
+    fn open(path: &Path) -> Result<Option<View>> {
+        let file = match File::open(path) {
+            Ok(file) => file,
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(None),
+            Err(e) => return Err(e).with_context(|| format!("Failed to open status log {}", path.display())),
+        };
+
+        // The head may point past our mapping if a writer appended meanwhile
+        for _ in 0..4 {
+            if file.metadata()?.len() < HEADER_LEN as u64 {
+                return Ok(None);
+            }
+
+            // SAFETY: status files are only ever appended to, never truncated,
+            // rewritten in place or replaced (compaction starts a new file)
+            let map = unsafe { memmap2::Mmap::map(&file) }
+                .with_context(|| format!("Failed to map status log {}", path.display()))?;
+
+            if &map[..4] != FILE_MAGIC || read_u32(&map, 4) != FORMAT_VERSION {
+                return Ok(None);
+            }
+
+            let head = load_u64(&map, HEAD_FIELD);
+            if head == 0 {
+                return Ok(None);
+            }
+            let head_end = (head as usize).saturating_add(RECORD_HEADER_LEN);
+            if head_end > map.len()
+                || (head as usize).saturating_add(read_u64(&map, head as usize + 8) as usize) > map.len()
+            {
+                continue;
+            }
+
+            // Follow the delta chain down to its snapshot, verifying checksums
+            let mut chain = Vec::new();
+            let mut offset = head;
+            loop {
+                let record = match Record::parse(&map, offset, true) {
+                    Some(record) => record,
+                    None => return Ok(None),
+                };
+                chain.push(offset);
+                if record.kind == KIND_SNAPSHOT {
+                    break;
+                }
+                if chain.len() > MAX_DELTA_DEPTH as usize {
+                    return Ok(None);
+                }
+                offset = record.prev;
+            }
+
+            return Ok(Some(View { path: path.to_path_buf(), map, head, chain }));
+        }
+
+        Ok(None)
+    }
+
+    /// Whether no writer has published or compacted since this view was opened
+    fn is_current(&self) -> bool {
+        load_u64(&self.map, REPLACED_FIELD) == 0 && load_u64(&self.map, HEAD_FIELD) == self.head
+    }
+
+    fn record(&self, offset: u64) -> Record<'_> {
+        Record::parse(&self.map, offset, false).expect("validated when the view was opened")
+    }
+
+    fn state(&self) -> Option<(u64, i64)> {
+        let head = self.record(self.head);
+        (head.flags & FLAG_INVALIDATED == 0).then_some((head.fingerprint, head.cache_time))
+    }
+
+    fn depth(&self) -> u32 {
+        self.record(self.head).depth
+    }
+
+    fn live_len(&self) -> u64 {
+        self.chain.iter().map(|&offset| self.record(offset).len).sum()
+    }
+
+    fn lookup(&self, path: &[u8]) -> Option<u8> {
+        if self.state().is_none() {
+            return None;
+        }
+        for &offset in &self.chain {
+            if let Some(status) = self.record(offset).find(path) {
+                return (status != TOMBSTONE).then_some(status);
+            }
+        }
+        None
+    }
+
+    /// Materialize all rows, applying deltas oldest to newest
+    fn rows(&self) -> Vec<(Vec<u8>, u8)> {
+        if self.state().is_none() {
+            return Vec::new();
+        }
+
+        let mut records = self.chain.iter().rev().map(|&offset| self.record(offset));
+        let snapshot = records.next().expect("chain ends at a snapshot");
+        let mut rows: BTreeMap<&[u8], u8> = (0..snapshot.count).map(|i| snapshot.entry(i)).collect();
+
+        for delta in records {
+            for i in 0..delta.count {
+                let (path, status) = delta.entry(i);
+                if status == TOMBSTONE {
+                    rows.remove(path);
+                } else {
+                    rows.insert(path, status);
+                }
+            }
+        }
+
+        rows.into_iter().map(|(path, status)| (path.to_vec(), status)).collect()
+    }
+}
+
+/// A record borrowed from a mapped file
+struct Record<'a> {
+    kind: u8,
+    flags: u8,
+    len: u64,
+    prev: u64,
+    fingerprint: u64,
+    cache_time: i64,
+    count: usize,
+    depth: u32,
+    index: &'a [u8],
+    paths: &'a [u8],
+}
+
+impl<'a> Record<'a> {
+    fn parse(map: &'a [u8], offset: u64, verify: bool) -> Option<Self> {
+        let start = offset as usize;
+        let header = map.get(start..start.checked_add(RECORD_HEADER_LEN)?)?;
+        if &header[..4] != RECORD_MAGIC {
+            return None;
+        }
+
+        let len = read_u64(header, 8);
+        let count = read_u32(header, 40) as usize;
+        let body = map.get(start + RECORD_HEADER_LEN..start.checked_add(len as usize)?)?;
+        let index_len = count.checked_mul(INDEX_ENTRY_LEN)?;
+        if body.len() < index_len {
+            return None;
+        }
+
+        if verify {
+            let mut hasher = Fnv64::new();
+            hasher.write(body);
+            if hasher.finish() != read_u64(header, 48) {
+                return None;
+            }
+        }
+
+        let record = Record {
+            kind: header[4],
+            flags: header[5],
+            len,
+            prev: read_u64(header, 16),
+            fingerprint: read_u64(header, 24),
+            cache_time: read_u64(header, 32) as i64,
+            count,
+            depth: read_u32(header, 44),
+            index: &body[..index_len],
+            paths: &body[index_len..],
+        };
+
+        if verify {
+            // Bounds and sort order, so lookups on unverified parses can't go wrong
+            let mut last: Option<&[u8]> = None;
+            for i in 0..count {
+                let at = i * INDEX_ENTRY_LEN;
+                let start = read_u32(record.index, at) as usize;
+                let end = start.checked_add(read_u32(record.index, at + 4) as usize)?;
+                let path = record.paths.get(start..end)?;
+                if last.map_or(false, |last| last >= path) {
+                    return None;
+                }
+                last = Some(path);
+            }
+        }
+
+        Some(record)
+    }
+
+    fn entry(&self, i: usize) -> (&'a [u8], u8) {
+        let at = i * INDEX_ENTRY_LEN;
+        let start = read_u32(self.index, at) as usize;
+        let len = read_u32(self.index, at + 4) as usize;
+        (&self.paths[start..start + len], self.index[at + 8])
+    }
+
+    fn find(&self, path: &[u8]) -> Option<u8> {
+        let (mut low, mut high) = (0, self.count);
+        while low < high {
+            let mid = (low + high) / 2;
+            let (candidate, status) = self.entry(mid);
+            match candidate.cmp(path) {
+                std::cmp::Ordering::Less => low = mid + 1,
+                std::cmp::Ordering::Greater => high = mid,
+                std::cmp::Ordering::Equal => return Some(status),
+            }
+        }
+        None
+    }
+}
+
+/// Serialize a record from rows sorted by path
+fn encode(kind: u8, flags: u8, prev: u64, fingerprint: u64, cache_time: i64, depth: u32, rows: &[(Vec<u8>, u8)]) -> Vec<u8> {
+    let paths_len: usize = rows.iter().map(|(path, _)| path.len()).sum();
+    let len = RECORD_HEADER_LEN + rows.len() * INDEX_ENTRY_LEN + paths_len;
+
+    let mut out = Vec::with_capacity(len);
+    out.extend_from_slice(RECORD_MAGIC);
+    out.extend_from_slice(&[kind, flags, 0, 0]);
+    out.extend_from_slice(&(len as u64).to_le_bytes());
+    out.extend_from_slice(&prev.to_le_bytes());
+    out.extend_from_slice(&fingerprint.to_le_bytes());
+    out.extend_from_slice(&cache_time.to_le_bytes());
+    out.extend_from_slice(&(rows.len() as u32).to_le_bytes());
+    out.extend_from_slice(&depth.to_le_bytes());
+    out.extend_from_slice(&[0u8; 8]); // checksum, filled in below
+
+    let mut path_offset = 0u32;
+    for (path, status) in rows {
+        out.extend_from_slice(&path_offset.to_le_bytes());
+        out.extend_from_slice(&(path.len() as u32).to_le_bytes());
+        out.extend_from_slice(&[*status, 0, 0, 0]);
+        path_offset += path.len() as u32;
+    }
+    for (path, _) in rows {
+        out.extend_from_slice(path);
+    }
+
+    let mut hasher = Fnv64::new();
+    hasher.write(&out[RECORD_HEADER_LEN..]);
+    out[48..56].copy_from_slice(&hasher.finish().to_le_bytes());
+    out
+}
+
+/// Rows that differ between two sorted row sets (removals as tombstones)
+fn diff(old: &[(Vec<u8>, u8)], new: &[(Vec<u8>, u8)]) -> Vec<(Vec<u8>, u8)> {
+    let mut changes = Vec::new();
+    let (mut i, mut j) = (0, 0);
+
+    while i < old.len() || j < new.len() {
+        let order = match (old.get(i), new.get(j)) {
+            (Some(o), Some(n)) => o.0.cmp(&n.0),
+            (Some(_), None) => std::cmp::Ordering::Less,
+            (None, _) => std::cmp::Ordering::Greater,
+        };
+        match order {
+            std::cmp::Ordering::Less => {
+                changes.push((old[i].0.clone(), TOMBSTONE));
+                i += 1;
+            }
+            std::cmp::Ordering::Greater => {
+                changes.push(new[j].clone());
+                j += 1;
+            }
+            std::cmp::Ordering::Equal => {
+                if old[i].1 != new[j].1 {
+                    changes.push(new[j].clone());
+                }
+                i += 1;
+                j += 1;
+            }
+        }
+    }
+
+    changes
+}
+
+/// Atomically store the newest record offset in a file's header
+fn publish_head(file: &File, offset: u64) -> Result<()> {
+    store_header_field(file, HEAD_FIELD, offset)
+}
+
+fn store_header_field(file: &File, field: usize, value: u64) -> Result<()> {
+    // SAFETY: the header page is shared with readers, who only read it
+    // through atomic loads of the same aligned fields
+    let mut header = unsafe { memmap2::MmapOptions::new().len(HEADER_LEN).map_mut(file) }
+        .context("Failed to map status log header")?;
+    let slot = unsafe { &*(header.as_mut_ptr().add(field) as *const AtomicU64) };
+    slot.store(value, Ordering::Release);
+    Ok(())
+}
+
+/// Write `snapshot` as the next generation after `old`, then point `old`'s
+/// readers at it
+fn compact(base: &Path, generation: u64, old: &File, snapshot: &[u8]) -> Result<()> {
+    let next = generation_path(base, generation + 1);
+    let temp = next.with_extension("gsl.tmp");
+
+    let result = (|| -> Result<()> {
+        let mut file = File::create(&temp)?;
+        file.write_all(&new_header(HEADER_LEN as u64))?;
+        file.write_all(snapshot)?;
+        file.sync_data()?;
+        // Nothing has the new name open yet, so this works on Windows too
+        fs::rename(&temp, &next)?;
+        Ok(())
+    })();
+
+    match result {
+        Ok(()) => store_header_field(old, REPLACED_FIELD, generation + 1),
+        Err(e) => {
+            let _ = fs::remove_file(&temp);
+            Err(e)
+        }
+    }
+}
+
+/// Delete generations older than `current`; files still mapped elsewhere
+/// (which Windows won't delete) are retried after the next compaction
+fn remove_generations(generations: &[(u64, PathBuf)], current: u64) {
+    for (generation, path) in generations {
+        if *generation < current {
+            if let Err(e) = fs::remove_file(path) {
+                tracing::debug!("keeping old status log {}: {}", path.display(), e);
+            }
+        }
+    }
+}
+
+fn generation_path(base: &Path, generation: u64) -> PathBuf {
+    let stem = base.file_stem().unwrap_or_default().to_string_lossy();
+    base.with_file_name(format!("{}-{}.gsl", stem, generation))
+}
+
+fn new_header(head: u64) -> [u8; HEADER_LEN] {
+    let mut header = [0u8; HEADER_LEN];
+    header[..4].copy_from_slice(FILE_MAGIC);
+    header[4..8].copy_from_slice(&FORMAT_VERSION.to_le_bytes());
+    header[HEAD_FIELD..HEAD_FIELD + 8].copy_from_slice(&head.to_le_bytes());
+    header
+}
+
+fn load_u64(map: &[u8], field: usize) -> u64 {
+    // SAFETY: header fields are 8-aligned within a page-aligned mapping
+    let slot = unsafe { &*(map.as_ptr().add(field) as *const AtomicU64) };
+    slot.load(Ordering::Acquire)
+}
+
+fn read_u64(bytes: &[u8], at: usize) -> u64 {
+    u64::from_le_bytes(bytes[at..at + 8].try_into().unwrap())
+}
+
+fn read_u32(bytes: &[u8], at: usize) -> u32 {
+    u32::from_le_bytes(bytes[at..at + 4].try_into().unwrap())
+}
+
+/// Cross-process writer lock (a file created exclusively, removed on drop)
+///
+/// The file holds a token naming its owner, so a waiter stealing a stale lock
+/// can tell it moved that lock and not one another waiter just created.
+pub(crate) struct LockFile {
+    path: PathBuf,
+    token: String,
+}
+
+impl LockFile {
+    pub(crate) fn acquire(lock: &Path) -> Result<Self> {
+        static NEXT: AtomicU64 = AtomicU64::new(0);
+        let token = format!("{}-{}", std::process::id(), NEXT.fetch_add(1, Ordering::Relaxed));
+        let start = Instant::now();
+
+        loop {
+            match OpenOptions::new().write(true).create_new(true).open(lock) {
+                Ok(mut file) => {
+                    let lock = LockFile { path: lock.to_path_buf(), token };
+                    file.write_all(lock.token.as_bytes())
+                        .with_context(|| format!("Failed to write {}", lock.path.display()))?;
+                    return Ok(lock);
+                }
+                Err(e) if e.kind() == std::io::ErrorKind::AlreadyExists => {
+                    // A writer that crashed leaves its lock behind
+                    let stale = fs::metadata(lock)
+                        .and_then(|m| m.modified())
+                        .ok()
+                        .and_then(|t| SystemTime::now().duration_since(t).ok())
+                        .map_or(false, |age| age > LOCK_STALE);
+                    if stale {
+                        Self::steal(lock, &token);
+                        continue;
+                    }
+                    if start.elapsed() > LOCK_TIMEOUT {
+                        anyhow::bail!("Timed out waiting for lock {}", lock.display());
+                    }
+                    std::thread::sleep(Duration::from_millis(1));
+                }
+                Err(e) => return Err(e).with_context(|| format!("Failed to create {}", lock.display())),
+            }
+        }
+    }
+
+    /// Move a stale lock out of the way; the next `create_new` decides who
+    /// owns the lock
+    ///
+    /// Renaming is atomic, so of several waiters only one moves the stale
+    /// file. A waiter that instead moved a lock another waiter just created
+    /// puts it back.
+    fn steal(lock: &Path, token: &str) {
+        let stale = match fs::read(lock) {
+            Ok(owner) => owner,
+            Err(_) => return,
+        };
+        let aside = lock.with_extension(format!("stale-{}", token));
+        if fs::rename(lock, &aside).is_err() {
+            return;
+        }
+        if fs::read(&aside).map_or(true, |moved| moved != stale) {
+            let _ = fs::hard_link(&aside, lock);
+        }
+        let _ = fs::remove_file(&aside);
+    }
+}
+
+impl Drop for LockFile {
+    fn drop(&mut self) {
+        // Leave a lock stolen from us (after we held it past LOCK_STALE) alone
+        if fs::read(&self.path).map_or(false, |owner| owner == self.token.as_bytes()) {
+            let _ = fs::remove_file(&self.path);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_stale_lock_is_stolen() {
+        let temp_dir = TempDir::new().unwrap();
+        let path = temp_dir.path().join("status.gsl.lock");
+
+        // Left behind by a crashed writer
+        let file = File::create(&path).unwrap();
+        file.set_modified(SystemTime::now() - LOCK_STALE * 2).unwrap();
+        drop(file);
+
+        let lock = LockFile::acquire(&path).unwrap();
+        assert_eq!(fs::read(&path).unwrap(), lock.token.as_bytes());
+        assert_eq!(fs::read_dir(temp_dir.path()).unwrap().count(), 1);
+        drop(lock);
+        assert!(!path.exists());
+    }
+
+    fn entries(n: usize, status: FileStatus) -> Vec<FileStatusEntry> {
+        (0..n)
+            .map(|i| FileStatusEntry { path: format!("dir{}/file{}.txt", i % 7, i).into(), status })
+            .collect()
+    }
+
+    #[test]
+    fn test_snapshot_delta_and_invalidate() {
+        let temp_dir = TempDir::new().unwrap();
+        let writer = StatusLog::open(temp_dir.path()).unwrap();
+        let reader = StatusLog::open(temp_dir.path()).unwrap();
+
+        assert_eq!(reader.state("/repo").unwrap(), None);
+
+        let mut rows = entries(100, FileStatus::Modified);
+        writer.write("/repo", &rows, 42, 1000).unwrap();
+        assert_eq!(reader.state("/repo").unwrap(), Some((42, 1000)));
+        assert_eq!(reader.lookup("/repo", "dir3/file10.txt").unwrap(), Some(FileStatus::Modified));
+        assert_eq!(reader.lookup("/repo", "missing.txt").unwrap(), None);
+
+        // Small changes land as deltas on top of the snapshot
+        rows[10].status = FileStatus::Added;
+        rows.remove(20);
+        rows.push(FileStatusEntry { path: "new.txt".into(), status: FileStatus::Untracked });
+        writer.write("/repo", &rows, 43, 1001).unwrap();
+
+        assert_eq!(reader.lookup("/repo", "dir3/file10.txt").unwrap(), Some(FileStatus::Added));
+        assert_eq!(reader.lookup("/repo", "dir6/file20.txt").unwrap(), None);
+        assert_eq!(reader.lookup("/repo", "new.txt").unwrap(), Some(FileStatus::Untracked));
+        assert_eq!(reader.entries("/repo").unwrap().len(), 100);
+        assert_eq!(reader.view("/repo").unwrap().unwrap().chain.len(), 2);
+
+        writer.invalidate("/repo").unwrap();
+        assert_eq!(reader.state("/repo").unwrap(), None);
+        assert!(reader.entries("/repo").unwrap().is_empty());
+    }
+
+    #[test]
+    fn test_compaction_keeps_rows() {
+        let temp_dir = TempDir::new().unwrap();
+        let log = StatusLog::open(temp_dir.path()).unwrap();
+        let base = log.base_for("/repo");
+
+        // Alternating full rewrites grow the file past the compaction threshold
+        let modified = entries(20_000, FileStatus::Modified);
+        let added = entries(20_000, FileStatus::Added);
+        let old_view = {
+            log.write("/repo", &modified, 1, 1).unwrap();
+            log.view("/repo").unwrap().unwrap()
+        };
+        for i in 0..6 {
+            let rows = if i % 2 == 0 { &added } else { &modified };
+            log.write("/repo", rows, 2 + i, 1).unwrap();
+        }
+
+        // Compaction moved on to a new generation and deleted the old one
+        let (generation, file) = log.current_file(&base).unwrap().unwrap();
+        assert!(generation > 0);
+        assert_eq!(log.generations(&base).unwrap().len(), 1);
+        assert!(fs::metadata(&file).unwrap().len() < 2 * old_view.live_len() + HEADER_LEN as u64);
+        assert!(!old_view.is_current());
+        assert_eq!(log.state("/repo").unwrap(), Some((7, 1)));
+        assert_eq!(log.lookup("/repo", "dir1/file1.txt").unwrap(), Some(FileStatus::Modified));
+        assert_eq!(log.entries("/repo").unwrap().len(), 20_000);
+    }
+}
@@ -218,6 +218,10 @@ impl TempIgnoreManager {
     }
 
     /// Update the .git/info/exclude file with current temp ignores
+    ///
+    /// The output is deterministic and only written when it changes, so the
+    /// file does not grow on repeated updates and ignore caches keyed by its
+    /// mtime stay valid.
     fn update_exclude_file(&self) -> Result<()> {
         // Read existing exclude file
         let existing_content = if self.exclude_path.exists() {
@@ -235,19 +239,30 @@ impl TempIgnoreManager {
             .map(String::from)
             .collect();
 
-        // Remove old section
-        if let Some(start_idx) = lines.iter().position(|l| l.contains(marker_start)) {
-            if let Some(end_idx) = lines.iter().position(|l| l.contains(marker_end)) {
-                lines.drain(start_idx..=end_idx);
-            }
+        // Remove old section(s)
+        while let Some(start_idx) = lines.iter().position(|l| l.contains(marker_start)) {
+            match lines[start_idx..].iter().position(|l| l.contains(marker_end)) {
+                Some(len) => lines.drain(start_idx..=start_idx + len),
+                None => lines.drain(start_idx..),
+            };
+        }
+
+        // Drop the blank separator left behind by the previous section
+        while lines.last().map_or(false, |l| l.trim().is_empty()) {
+            lines.pop();
         }
 
         // Add new section if there are temp ignores
         if !self.ignores.is_empty() {
-            lines.push(String::new());
+            if !lines.is_empty() {
+                lines.push(String::new());
+            }
             lines.push(marker_start.to_string());
 
-            for (path, ignore) in &self.ignores {
+            let mut ignores: Vec<_> = self.ignores.iter().collect();
+            ignores.sort_by(|a, b| a.0.cmp(b.0));
+
+            for (path, ignore) in ignores {
                 let mut comment_parts = vec!["Temp:".to_string()];
 
                 if let Some(ref reason) = ignore.reason {
@@ -264,15 +279,24 @@ impl TempIgnoreManager {
                     IncludeCondition::Manual => {}
                 }
 
+                // Comments must be on their own line; git treats "#" mid-line as part of the pattern
                 let comment = comment_parts.join(" | ");
-                lines.push(format!("{}  # {}", path, comment));
+                lines.push(format!("# {}", comment));
+                lines.push(path.clone());
             }
 
             lines.push(marker_end.to_string());
         }
 
-        // Write back
-        fs::write(&self.exclude_path, lines.join("\n"))?;
+        let mut content = lines.join("\n");
+        if !content.is_empty() {
+            content.push('\n');
+        }
+
+        // Write back only if something changed
+        if content != existing_content {
+            fs::write(&self.exclude_path, content)?;
+        }
 
         Ok(())
     }
@@ -362,6 +386,31 @@ mod tests {
         fs::remove_dir_all(&temp_dir).unwrap();
     }
 
+    #[test]
+    fn test_exclude_file_stable() {
+        let temp_dir = env::temp_dir().join("gitscribe_test_exclude_stable");
+        fs::create_dir_all(&temp_dir.join(".git").join("info")).unwrap();
+        let exclude = temp_dir.join(".git").join("info").join("exclude");
+        fs::write(&exclude, "*.swp\n").unwrap();
+
+        let mut manager = TempIgnoreManager::new(&temp_dir).unwrap();
+        manager.add_temp_ignore("b.txt".to_string(), None, IncludeCondition::Manual, vec![]).unwrap();
+        manager.add_temp_ignore("a.txt".to_string(), None, IncludeCondition::Manual, vec![]).unwrap();
+        let first = fs::read_to_string(&exclude).unwrap();
+
+        for _ in 0..3 {
+            manager.include_file("a.txt").unwrap();
+            manager.add_temp_ignore("a.txt".to_string(), None, IncludeCondition::Manual, vec![]).unwrap();
+        }
+        assert_eq!(fs::read_to_string(&exclude).unwrap(), first);
+
+        manager.include_file("a.txt").unwrap();
+        manager.include_file("b.txt").unwrap();
+        assert_eq!(fs::read_to_string(&exclude).unwrap(), "*.swp\n");
+
+        fs::remove_dir_all(&temp_dir).unwrap();
+    }
+
     #[test]
     fn test_expiry() {
         let temp_dir = env::temp_dir().join("gitscribe_test_expiry");
@@ -0,0 +1,246 @@
+//! Status Cache Warm-up
+//!
+//! After a restart the first status query for each repository pays a cold
+//! scan: no working-tree watcher, stale rows and an empty page cache. The
+//! cache already knows which repositories matter (`last_accessed`), so at
+//! startup a background pass re-scans the most recently used ones at low CPU
+//! and I/O priority. It backs off as soon as foreground work competes with it.
+
+use anyhow::Result;
+use serde::{Deserialize, Serialize};
+use std::path::PathBuf;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+
+use crate::cache::{CacheBackend, StatusCache};
+use crate::scanner::{self, ScanOptions};
+use crate::Repository;
+
+/// Which repositories to warm and when to give up
+#[derive(Debug, Clone)]
+pub struct WarmupPolicy {
+    /// Most recently accessed repositories to scan
+    pub repositories: usize,
+    /// Scanner threads (kept low so foreground scans keep the CPU)
+    pub threads: usize,
+    /// Stop once the pass has run this long
+    pub max_duration: Duration,
+    /// Stop when the load average per CPU exceeds this (where the OS reports one)
+    pub max_load_per_cpu: f64,
+    /// How long to wait on database locks held by other connections
+    pub busy_timeout: Duration,
+}
+
+impl Default for WarmupPolicy {
+    fn default() -> Self {
+        Self {
+            repositories: 8,
+            threads: 2,
+            max_duration: Duration::from_secs(60),
+            max_load_per_cpu: 1.0,
+            busy_timeout: Duration::from_millis(100),
+        }
+    }
+}
+
+/// Why a warm-up pass ended before scanning every repository
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum WarmupStop {
+    /// A status query arrived from a caller
+    Foreground,
+    /// Another connection held the database
+    DatabaseBusy,
+    /// The system was already loaded
+    Load,
+    /// `max_duration` elapsed
+    Deadline,
+    Cancelled,
+}
+
+/// A repository scanned by the warm-up pass
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct WarmedRepository {
+    pub path: String,
+    pub entries: usize,
+    pub duration_ms: u64,
+}
+
+/// Outcome of a warm-up pass
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct WarmupReport {
+    pub warmed: Vec<WarmedRepository>,
+    /// Repositories that could not be opened or scanned
+    pub skipped: Vec<String>,
+    /// None if every selected repository was visited
+    pub stopped: Option<WarmupStop>,
+    pub duration_ms: u64,
+}
+
+/// Run one warm-up pass on the calling thread
+///
+/// Contention is checked before each repository, so a pass overruns its
+/// limits by at most one scan.
+pub fn run(cache: &StatusCache, policy: &WarmupPolicy, cancel: &AtomicBool) -> Result<WarmupReport> {
+    let start = Instant::now();
+    let foreground = StatusCache::foreground_queries();
+    let options = ScanOptions { threads: policy.threads.max(1), background: true };
+
+    let mut report = WarmupReport {
+        warmed: Vec::new(),
+        skipped: Vec::new(),
+        stopped: None,
+        duration_ms: 0,
+    };
+
+    for path in cache.recent_repositories(policy.repositories)? {
+        let stop = if cancel.load(Ordering::Relaxed) {
+            Some(WarmupStop::Cancelled)
+        } else if StatusCache::foreground_queries() != foreground {
+            Some(WarmupStop::Foreground)
+        } else if start.elapsed() >= policy.max_duration {
+            Some(WarmupStop::Deadline)
+        } else if load_per_cpu().map_or(false, |load| load > policy.max_load_per_cpu) {
+            Some(WarmupStop::Load)
+        } else {
+            None
+        };
+        if stop.is_some() {
+            report.stopped = stop;
+            break;
+        }
+
+        let scan_start = Instant::now();
+        let scanned = Repository::open(&path).and_then(|repo| cache.warm(&repo, &options));
+        match scanned {
+            Ok(entries) => report.warmed.push(WarmedRepository {
+                path,
+                entries,
+                duration_ms: scan_start.elapsed().as_millis() as u64,
+            }),
+            Err(e) if e.downcast_ref::<rusqlite::Error>().is_some() => {
+                tracing::debug!("cache warm-up stopped at {}: {}", path, e);
+                report.skipped.push(path);
+                report.stopped = Some(WarmupStop::DatabaseBusy);
+                break;
+            }
+            Err(e) => {
+                tracing::debug!("cache warm-up skipped {}: {}", path, e);
+                report.skipped.push(path);
+            }
+        }
+    }
+
+    report.duration_ms = start.elapsed().as_millis() as u64;
+    Ok(report)
+}
+
+/// One-minute load average divided by CPU count, where available
+fn load_per_cpu() -> Option<f64> {
+    #[cfg(target_os = "linux")]
+    {
+        let loadavg = std::fs::read_to_string("/proc/loadavg").ok()?;
+        let load: f64 = loadavg.split_whitespace().next()?.parse().ok()?;
+        let cpus = thread::available_parallelism().map(|n| n.get()).unwrap_or(1);
+        Some(load / cpus as f64)
+    }
+
+    #[cfg(not(target_os = "linux"))]
+    {
+        None
+    }
+}
+
+/// Background warm-up pass on its own cache connection
+///
+/// Start once when the core loads. Cancelled when dropped.
+pub struct Warmup {
+    cancel: Arc<AtomicBool>,
+    report: Arc<Mutex<Option<WarmupReport>>>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl Warmup {
+    /// Start warming the cache database at `db_path`
+    pub fn spawn(db_path: PathBuf, backend: CacheBackend, policy: WarmupPolicy) -> Result<Self> {
+        let cancel = Arc::new(AtomicBool::new(false));
+        let report = Arc::new(Mutex::new(None));
+        let (thread_cancel, thread_report) = (cancel.clone(), report.clone());
+
+        // Open on the caller's thread so configuration errors surface here
+        let cache = StatusCache::with_backend(&db_path, backend)?;
+        cache.set_busy_timeout(policy.busy_timeout)?;
+
+        let thread = thread::Builder::new()
+            .name("gitscribe-cache-warmup".to_string())
+            .spawn(move || {
+                scanner::enter_background_priority();
+                match run(&cache, &policy, &thread_cancel) {
+                    Ok(report) => {
+                        tracing::debug!(
+                            "cache warm-up scanned {} repositories in {} ms (stopped: {:?})",
+                            report.warmed.len(), report.duration_ms, report.stopped
+                        );
+                        *thread_report.lock().unwrap() = Some(report);
+                    }
+                    Err(e) => tracing::debug!("cache warm-up failed for {:?}: {}", db_path, e),
+                }
+            })?;
+
+        Ok(Warmup {
+            cancel,
+            report,
+            thread: Some(thread),
+        })
+    }
+
+    /// Stop before the next repository
+    pub fn cancel(&self) {
+        self.cancel.store(true, Ordering::Relaxed);
+    }
+
+    /// Report of the finished pass, or None while it is still running
+    pub fn report(&self) -> Option<WarmupReport> {
+        self.report.lock().unwrap().clone()
+    }
+}
+
+impl Drop for Warmup {
+    fn drop(&mut self) {
+        self.cancel();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tempfile::TempDir;
+
+    #[test]
+    fn test_warms_most_recent_first() {
+        let temp_dir = TempDir::new().unwrap();
+        let cache = StatusCache::new(temp_dir.path().join("cache.db")).unwrap();
+
+        let mut repos = Vec::new();
+        for name in ["old", "new"] {
+            let dir = temp_dir.path().join(name);
+            git2::Repository::init(&dir).unwrap();
+            std::fs::write(dir.join("a.txt"), "a").unwrap();
+            let repo = Repository::open(&dir).unwrap();
+            cache.get_cached_status(&repo, 0).unwrap();
+            repos.push(repo.path().to_string_lossy().to_string());
+        }
+
+        let policy = WarmupPolicy { repositories: 1, max_load_per_cpu: f64::INFINITY, ..Default::default() };
+        let report = run(&cache, &policy, &AtomicBool::new(false)).unwrap();
+
+        assert_eq!(report.stopped, None);
+        assert_eq!(report.warmed.len(), 1);
+        assert_eq!(report.warmed[0].path, repos[1]);
+        assert_eq!(report.warmed[0].entries, 1);
+    }
+}
@@ -62,9 +62,13 @@ RepositoryInfo GitRepository::GetInfo() {
         return info;
     }
 
-    // Check cache (1-second TTL)
+    // Check cache: valid while the fingerprint is unchanged (plus 1-second TTL if
+    // unwatched, or if the ahead/behind counts were incomplete)
     DWORD now = GetTickCount();
-    if (m_cacheTime != 0 && (now - m_cacheTime) < CACHE_TTL_MS) {
+    uint64_t fingerprint = 0;
+    int watched = gs_path_fingerprint(WideToUtf8(m_repoPath).c_str(), &fingerprint);
+    if (m_cacheTime != 0 && fingerprint == m_cachedFingerprint &&
+        ((watched == 1 && !m_cachedInfo.remotePending) || (now - m_cacheTime) < CACHE_TTL_MS)) {
         OutputDebugStringA("[GitScribe] Using cached repository info\n");
         return m_cachedInfo;
     }
@@ -80,6 +84,7 @@ RepositoryInfo GitRepository::GetInfo() {
         info.conflictedCount = gsInfo.conflicted_count;
         info.aheadCount = gsInfo.ahead_count;
         info.behindCount = gsInfo.behind_count;
+        info.remotePending = (gsInfo.remote_pending != 0);
     }
 
     // Get current branch
@@ -92,6 +97,7 @@ RepositoryInfo GitRepository::GetInfo() {
     // Update cache
     m_cachedInfo = info;
     m_cacheTime = now;
+    m_cachedFingerprint = fingerprint;
 
     return info;
 }
@@ -24,6 +24,7 @@ struct RepositoryInfo {
     unsigned int conflictedCount = 0;
     unsigned int aheadCount = 0;
     unsigned int behindCount = 0;
+    bool remotePending = false;  // ahead/behind cut short, may be stale
     std::wstring currentBranch;
 };
 
@@ -57,9 +58,10 @@ private:
     GSRepository* m_repo;
     std::wstring m_repoPath;
 
-    // Cache with 1-second TTL
+    // Cache validated by repository fingerprint (1-second TTL only when unwatched)
     mutable RepositoryInfo m_cachedInfo;
     mutable DWORD m_cacheTime = 0;
+    mutable uint64_t m_cachedFingerprint = 0;
     static const DWORD CACHE_TTL_MS = 1000; // 1 second
 
     // Helper to convert wstring to UTF-8
@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <mutex>
 #include <atomic>
+#include <cstdint>
 
 // Forward declare C API from gitscribe-core
 extern "C" {
@@ -25,6 +26,7 @@ extern "C" {
     void gs_repository_free(GSRepository* repo);
     GSStatusList* gs_repository_all_statuses(GSRepository* repo);
     void gs_status_list_free(GSStatusList* list);
+    int gs_path_fingerprint(const char* path, uint64_t* fingerprint);
 }
 
 #pragma comment(lib, "shlwapi.lib")
@@ -35,6 +37,8 @@ struct RepoStatusCache {
     std::unordered_map<std::wstring, int> folderStatuses; // folder path -> status (Modified if contains changes)
     std::wstring repoPath;                                // root path of repository
     DWORD timestamp;                                       // when cache was populated
+    uint64_t fingerprint;                                  // repository fingerprint at population
+    DWORD validatedAt;                                     // when fingerprint was last compared
 };
 
 // Path-to-repo mapping cache for fast lookups
@@ -55,7 +59,8 @@ static std::unordered_map<std::wstring, RepoStatusCache> g_repoCache;  // repoPa
 static std::unordered_map<std::wstring, PathRepoMapping> g_pathToRepo; // path -> repo root mapping
 static FastPathCache g_fastCache;                                       // Ultra-fast single entry cache
 static std::mutex g_cacheMutex;
-static const DWORD CACHE_TTL_MS = 30000;  // 30 second TTL (longer to avoid re-queries)
+static const DWORD CACHE_TTL_MS = 30000;  // 30 second TTL, only for repos without a watched fingerprint
+static const DWORD FINGERPRINT_RECHECK_MS = 100; // Reuse a fingerprint check for bursts of overlay queries
 static const DWORD PATH_MAPPING_TTL_MS = 60000; // 60 second TTL for path->repo mappings
 static const DWORD FAST_CACHE_TTL_MS = 200;    // 200ms TTL for fast cache
 
@@ -349,18 +354,37 @@ bool GitScribeOverlay::IsFileStatus(const std::wstring& path, GitStatus expected
 
     // Check if we have a cached repository status
     RepoStatusCache* cache = nullptr;
-    bool needsRefresh = false;
+    bool needsValidation = false;
 
     {
         std::lock_guard<std::mutex> lock(g_cacheMutex);
         auto it = g_repoCache.find(repoRoot);
 
-        if (it != g_repoCache.end()) {
-            if (now - it->second.timestamp < CACHE_TTL_MS) {
-                cache = &it->second;
-            } else {
-                needsRefresh = true;
-            }
+        if (it != g_repoCache.end() && now - it->second.validatedAt < FINGERPRINT_RECHECK_MS) {
+            cache = &it->second;
+        } else {
+            needsValidation = true;
+        }
+    }
+
+    // Compare the repository fingerprint instead of expiring on time alone
+    std::string utf8RepoPath = WideToUtf8(repoRoot);
+    uint64_t fingerprint = 0;
+    int watched = -1;
+    bool needsRefresh = false;
+
+    if (needsValidation) {
+        watched = gs_path_fingerprint(utf8RepoPath.c_str(), &fingerprint);
+
+        std::lock_guard<std::mutex> lock(g_cacheMutex);
+        auto it = g_repoCache.find(repoRoot);
+
+        // Without a watcher (or a fingerprint at all) in-place edits are invisible, so keep the TTL
+        if (it != g_repoCache.end() &&
+            it->second.fingerprint == fingerprint &&
+            (watched == 1 || now - it->second.timestamp < CACHE_TTL_MS)) {
+            it->second.validatedAt = now;
+            cache = &it->second;
         } else {
             needsRefresh = true;
         }
@@ -368,7 +392,6 @@ bool GitScribeOverlay::IsFileStatus(const std::wstring& path, GitStatus expected
 
     // If we need to refresh, do bulk query
     if (needsRefresh) {
-        std::string utf8RepoPath = WideToUtf8(repoRoot);
         GSRepository* repo = gs_repository_open(utf8RepoPath.c_str());
         if (!repo) {
             return false;
@@ -389,6 +412,8 @@ bool GitScribeOverlay::IsFileStatus(const std::wstring& path, GitStatus expected
             RepoStatusCache newCache;
             newCache.repoPath = repoRoot;
             newCache.timestamp = now;
+            newCache.fingerprint = fingerprint;  // Taken before the query, so later changes invalidate
+            newCache.validatedAt = now;
 
             // Store all file statuses and build folder status map
             for (size_t i = 0; i < list->count; i++) {